@@ -0,0 +1,134 @@
+// RUN: %hc %s -O3 -o %t.out && %t.out
+
+// latency and CPU usage of the wait modes, on simulated signals
+//
+// A completer thread plays the device: it completes each operation after
+// its duration, setting the signal and waking up blocked waiters, like the
+// interrupt of a completion signal.  For each mode and operation duration the
+// benchmark reports the wake-up latency (from completion to the return of
+// the wait) and the CPU time the waiting thread used, per wait.
+//
+//   blocked:  block on the signal (hcWaitModeBlocked)
+//   active:   poll the signal (hcWaitModeActive)
+//   adaptive: Kalmar::AdaptiveWaitPolicy (hcWaitModeAdaptive)
+//
+// hcc `hcc-config --cxxflags --ldflags` wait.cpp -o wait
+// ./wait [waits per duration] [max spin us] [yield us]
+
+#include <kalmar_wait.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+typedef std::chrono::steady_clock clock_type;
+
+class SimSignal {
+public:
+  SimSignal() : value(1) {}
+
+  bool done() { return value.load(std::memory_order_acquire) == 0; }
+
+  void block() {
+    std::unique_lock<std::mutex> l(mutex);
+    cv.wait(l, [this] { return done(); });
+  }
+
+  // completer side
+  void complete() {
+    completedAt = clock_type::now();
+    {
+      std::lock_guard<std::mutex> l(mutex);
+      value.store(0, std::memory_order_release);
+    }
+    cv.notify_all();
+  }
+
+  clock_type::time_point completedAt;
+
+private:
+  std::atomic<int> value;
+  std::mutex mutex;
+  std::condition_variable cv;
+};
+
+enum Mode { BLOCKED, ACTIVE, ADAPTIVE };
+
+static double threadCpuUs() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+struct Result {
+  double latencyUs;
+  double cpuUs;
+};
+
+Result run(Mode mode, Kalmar::AdaptiveWaitPolicy& policy, std::chrono::microseconds duration, int waits) {
+  double latency = 0;
+  double cpu = 0;
+  for (int i = 0; i < waits; ++i) {
+    SimSignal signal;
+    std::thread completer([&] {
+      std::this_thread::sleep_for(duration);
+      signal.complete();
+    });
+
+    double c0 = threadCpuUs();
+    switch (mode) {
+      case BLOCKED:
+        signal.block();
+        break;
+      case ACTIVE:
+        while (!signal.done())
+          ;
+        break;
+      case ADAPTIVE:
+        policy.wait(&duration, signal);
+        break;
+    }
+    auto woke = clock_type::now();
+    cpu += threadCpuUs() - c0;
+
+    completer.join();
+    latency += std::chrono::duration<double, std::micro>(woke - signal.completedAt).count();
+  }
+  return Result{ latency / waits, cpu / waits };
+}
+
+int main(int argc, char* argv[]) {
+  int waits = (argc > 1) ? std::atoi(argv[1]) : 200;
+  int maxSpinUs = (argc > 2) ? std::atoi(argv[2]) : 200;
+  int yieldUs = (argc > 3) ? std::atoi(argv[3]) : 50;
+
+  const int durations[] = { 10, 50, 150, 1000, 5000 };
+  const char* names[] = { "blocked", "active", "adaptive" };
+
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << waits << " waits per duration, adaptive spin <= " << maxSpinUs
+            << " us, yield " << yieldUs << " us\n";
+  std::cout << std::setw(12) << "duration us" << std::setw(10) << "mode"
+            << std::setw(14) << "latency us" << std::setw(14) << "cpu us"
+            << std::setw(10) << "cpu %" << "\n";
+
+  for (int d : durations) {
+    std::chrono::microseconds duration(d);
+    for (int m = BLOCKED; m <= ADAPTIVE; ++m) {
+      // a fresh policy per duration, warmed up like a kernel seen before
+      Kalmar::AdaptiveWaitPolicy policy(maxSpinUs, yieldUs);
+      run(static_cast<Mode>(m), policy, duration, 4);
+      Result r = run(static_cast<Mode>(m), policy, duration, waits);
+      std::cout << std::setw(12) << d << std::setw(10) << names[m]
+                << std::setw(14) << r.latencyUs << std::setw(14) << r.cpuUs
+                << std::setw(10) << (100.0 * r.cpuUs / (d + r.latencyUs)) << "\n";
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,80 @@
+// RUN: %hc %s -O3 -o %t.out -lhc_am && HCC_HSA_RUNTIME=mock %t.out
+
+// throughput of allocate -> launch -> free loops
+//
+// Each iteration allocates a scratch buffer, launches a kernel writing it,
+// and frees it:
+//
+//   sync:  am_alloc, kernel, wait for the kernel, am_free
+//   async: accelerator_view::alloc_async, kernel, free_async, so the host
+//          never waits and the freed buffer is reused by the next iteration
+//
+// Without a GPU, run it on the CPU emulation of the HSA runtime, where
+// kernels take HCC_MOCK_KERNEL_US:
+//   HCC_HSA_RUNTIME=mock HCC_MOCK_KERNEL_US=20 ./alloc_launch_free
+//
+// hcc `hcc-config --cxxflags --ldflags` alloc_launch_free.cpp -lhc_am -o alloc_launch_free
+// ./alloc_launch_free [iterations] [buffer KB]
+
+#include <hc.hpp>
+#include <hc_am.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+typedef std::chrono::steady_clock clock_type;
+
+void launch(hc::accelerator_view& av, int* p, int n) {
+  hc::parallel_for_each(av, hc::extent<1>(n), [=](hc::index<1> idx) [[hc]] {
+    p[idx[0]] = idx[0];
+  });
+}
+
+double runSync(hc::accelerator& acc, hc::accelerator_view& av, int iterations, int n) {
+  auto t0 = clock_type::now();
+  for (int i = 0; i < iterations; ++i) {
+    int* p = static_cast<int*>(hc::am_alloc(n * sizeof(int), acc, 0));
+    launch(av, p, n);
+    av.wait();
+    hc::am_free(p);
+  }
+  return std::chrono::duration<double>(clock_type::now() - t0).count();
+}
+
+double runAsync(hc::accelerator_view& av, int iterations, int n) {
+  auto t0 = clock_type::now();
+  for (int i = 0; i < iterations; ++i) {
+    int* p = static_cast<int*>(av.alloc_async(n * sizeof(int)));
+    launch(av, p, n);
+    av.free_async(p);
+  }
+  av.wait();
+  return std::chrono::duration<double>(clock_type::now() - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+  int iterations = (argc > 1) ? std::atoi(argv[1]) : 2000;
+  int kb = (argc > 2) ? std::atoi(argv[2]) : 256;
+  int n = kb * 1024 / sizeof(int);
+
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.create_view();
+
+  // warm up the kernel and the pool
+  runSync(acc, av, 10, n);
+  runAsync(av, 10, n);
+
+  double sync = runSync(acc, av, iterations, n);
+  double async = runAsync(av, iterations, n);
+
+  std::cout << std::fixed << std::setprecision(0);
+  std::cout << iterations << " iterations, " << kb << " KB buffers\n";
+  std::cout << std::setw(8) << "mode" << std::setw(14) << "iter/s" << std::setw(14) << "us/iter" << "\n";
+  std::cout << std::setw(8) << "sync" << std::setw(14) << iterations / sync
+            << std::setw(14) << std::setprecision(1) << 1e6 * sync / iterations << std::setprecision(0) << "\n";
+  std::cout << std::setw(8) << "async" << std::setw(14) << iterations / async
+            << std::setw(14) << std::setprecision(1) << 1e6 * async / iterations << "\n";
+  return 0;
+}
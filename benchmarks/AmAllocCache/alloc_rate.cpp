@@ -0,0 +1,151 @@
+// RUN: %hc %s -O3 -o %t.out && %t.out
+
+// allocation rate of scratch buffers with and without the am_alloc cache
+//
+// The memory pool is simulated: each allocation and each free costs a fixed
+// time, holding a lock like the driver calls behind
+// hsa_amd_memory_pool_allocate / hsa_amd_memory_pool_free, and a host
+// allocation additionally costs its mapping to the peers.  Each thread
+// allocates a few buffers of random sizes, touches them, and frees them, like
+// a request handler.  For each thread count the benchmark reports the
+// allocate + free pairs per second going straight to the pool and through
+// Kalmar::AllocCache (HCC_AM_CACHE_SIZE), and the hit rate of the cache.
+//
+// The same loop on am_alloc / am_free can be run without a GPU on the CPU
+// emulation of the HSA runtime, HCC_HSA_RUNTIME=mock HCC_AM_CACHE_SIZE=<MB>.
+//
+// hcc `hcc-config --cxxflags --ldflags` alloc_rate.cpp -o alloc_rate
+// ./alloc_rate [pairs per thread] [pool call us] [map us] [cache MB]
+
+#include <kalmar_alloc_cache.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock clock_type;
+
+static void spinFor(std::chrono::microseconds us) {
+  auto end = clock_type::now() + us;
+  while (clock_type::now() < end)
+    ;
+}
+
+// key: 0 device memory, 1 pinned host memory
+class SimPool {
+public:
+  typedef int Key;
+
+  SimPool(int callUs, int mapUs) : callUs(callUs), mapUs(mapUs) {}
+
+  void* allocate(const int& key, size_t size) {
+    {
+      std::lock_guard<std::mutex> l(mutex);
+      spinFor(callUs);
+    }
+    void* ptr = std::malloc(size);
+    if (key == 1)
+      spinFor(mapUs);
+    return ptr;
+  }
+
+  void free(const int&, void* ptr) {
+    {
+      std::lock_guard<std::mutex> l(mutex);
+      spinFor(callUs);
+    }
+    std::free(ptr);
+  }
+
+private:
+  std::chrono::microseconds callUs;
+  std::chrono::microseconds mapUs;
+  std::mutex mutex;
+};
+
+struct PoolRef {
+  typedef int Key;
+  SimPool* pool;
+  void* allocate(const int& key, size_t size) { return pool->allocate(key, size); }
+  void free(const int& key, void* ptr) { pool->free(key, ptr); }
+};
+
+typedef Kalmar::AllocCache<PoolRef> Cache;
+
+// allocate + free pairs per second over all threads
+template <typename Alloc, typename Free>
+double run(int threads, int pairs, Alloc alloc, Free release) {
+  auto t0 = clock_type::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      unsigned seed = t + 1;
+      for (int i = 0; i < pairs; i += 4) {
+        void* held[4];
+        int keys[4];
+        for (int j = 0; j < 4; ++j) {
+          seed = seed * 1103515245 + 12345;
+          // 4 KB to 4 MB
+          size_t size = size_t(4096) << ((seed >> 16) % 11);
+          keys[j] = (seed >> 8) % 4 == 0;
+          held[j] = alloc(keys[j], size);
+          static_cast<char*>(held[j])[0] = 1;
+        }
+        for (int j = 0; j < 4; ++j)
+          release(keys[j], held[j]);
+      }
+    });
+  }
+  for (auto& w : workers)
+    w.join();
+  double s = std::chrono::duration<double>(clock_type::now() - t0).count();
+  return threads * pairs / s;
+}
+
+int main(int argc, char* argv[]) {
+  int pairs = (argc > 1) ? std::atoi(argv[1]) : 2000;
+  int callUs = (argc > 2) ? std::atoi(argv[2]) : 20;
+  int mapUs = (argc > 3) ? std::atoi(argv[3]) : 50;
+  size_t cacheMB = (argc > 4) ? std::atoi(argv[4]) : 256;
+
+  const int threadCounts[] = { 1, 2, 4, 8 };
+
+  std::cout << std::fixed << std::setprecision(0);
+  std::cout << pairs << " allocate/free pairs per thread, pool call " << callUs
+            << " us, peer mapping " << mapUs << " us, cache " << cacheMB << " MB\n";
+  std::cout << std::setw(8) << "threads" << std::setw(16) << "pool pairs/s"
+            << std::setw(16) << "cached pairs/s" << std::setw(10) << "speedup"
+            << std::setw(10) << "hit %" << "\n";
+
+  for (int threads : threadCounts) {
+    SimPool pool(callUs, mapUs);
+
+    double direct = run(threads, pairs,
+                        [&](int key, size_t size) { return pool.allocate(key, size); },
+                        [&](int key, void* ptr) { pool.free(key, ptr); });
+
+    Kalmar::AllocCacheStats stats;
+    double cached;
+    {
+      Cache cache(PoolRef{ &pool }, cacheMB << 20, (cacheMB << 20) / 4);
+      cached = run(threads, pairs,
+                   [&](int key, size_t size) {
+                     bool fresh;
+                     return cache.allocate(key, size, &fresh);
+                   },
+                   [&](int, void* ptr) { cache.release(ptr); });
+      stats = cache.getStats();
+    }
+
+    std::cout << std::setw(8) << threads << std::setw(16) << direct
+              << std::setw(16) << cached << std::setprecision(1)
+              << std::setw(10) << cached / direct
+              << std::setw(10) << 100.0 * stats.hits / (stats.hits + stats.misses + stats.bypassed)
+              << std::setprecision(0) << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,97 @@
+// RUN: %hc %s -O3 -lhc_am -o %t.out && %t.out
+
+// benchmark for completion_future::then
+//
+// chained: each continuation launches the next kernel and attaches the next
+//          continuation to it, so a continuation runs only once the previous
+//          one has; measures the latency from kernel completion to callback.
+// fan-out: a continuation is attached to each of many kernels in flight, as
+//          request-serving code does, and the time until all have run is
+//          measured.
+//
+// hcc `hcc-config --cxxflags --ldflags` then.cpp -lhc_am -o then
+// ./then [chained continuations] [fan-out kernels]
+
+#include <hc.hpp>
+#include <hc_am.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+struct Chain {
+  hc::accelerator_view av;
+  int* counter;
+  int remaining;
+  std::promise<void> done;
+
+  Chain(const hc::accelerator_view& av, int* counter, int n) : av(av), counter(counter), remaining(n) {}
+
+  void next() {
+    if (remaining-- == 0) {
+      done.set_value();
+      return;
+    }
+    int* c = counter;
+    hc::completion_future cf = hc::parallel_for_each(av, hc::extent<1>(1), [=](hc::index<1>&) [[hc]] {
+      (*c)++;
+    });
+    cf.then([this] { next(); });
+  }
+};
+
+int main(int argc, char* argv[]) {
+  int chained = (argc > 1) ? std::atoi(argv[1]) : 100000;
+  int fanout = (argc > 2) ? std::atoi(argv[2]) : 100000;
+
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.get_default_view();
+  int* counter = static_cast<int*>(hc::am_alloc(sizeof(int), acc, amHostCoherent));
+  *counter = 0;
+
+  std::cout << std::fixed << std::setprecision(2);
+
+  // warm up, loads the kernels
+  hc::parallel_for_each(av, hc::extent<1>(1), [=](hc::index<1>&) [[hc]] { (*counter)++; }).wait();
+
+  {
+    Chain chain(av, counter, chained);
+    auto t0 = std::chrono::steady_clock::now();
+    chain.next();
+    chain.done.get_future().wait();
+    auto t1 = std::chrono::steady_clock::now();
+    double us = std::chrono::duration<double, std::micro>(t1 - t0).count();
+    std::cout << "chained: " << chained << " continuations in " << us / 1000 << " ms, "
+              << us / chained << " us per kernel + continuation\n";
+  }
+
+  {
+    std::atomic<int> ran(0);
+    std::promise<void> done;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < fanout; ++i) {
+      hc::completion_future cf = hc::parallel_for_each(av, hc::extent<1>(1), [=](hc::index<1>&) [[hc]] {
+        (*counter)++;
+      });
+      cf.then([&, fanout] {
+        if (++ran == fanout)
+          done.set_value();
+      });
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    done.get_future().wait();
+    auto t2 = std::chrono::steady_clock::now();
+    std::cout << "fan-out: " << fanout << " continuations, launched in "
+              << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms, all ran after "
+              << std::chrono::duration<double, std::milli>(t2 - t0).count() << " ms\n";
+  }
+
+  av.wait();
+  bool ok = (*counter == 1 + chained + fanout);
+  hc::am_free(counter);
+  return !ok;
+}
@@ -0,0 +1,191 @@
+// RUN: %hc %s -O3 -o %t.out && %t.out
+
+// random-access kernels on large CPU-runtime buffers with 4 KB and 2 MB pages
+//
+// The kernels run like kernels of the CPU accelerator, one worker per
+// hardware thread, on a buffer allocated either like the CPU runtime did
+// before huge pages (kalmar_aligned_alloc, 4 KB pages) or with
+// Kalmar::HugePageAllocator (transparent huge pages, or the hugetlbfs pool
+// with HCC_HUGE_PAGE_HUGETLB=1):
+//
+//   gather:  sum of table[random index], like a lookup kernel
+//   update:  table[random index] ^= value, like GUPS
+//   strided: one access per 4 KB page, like a column of a row-major matrix
+//
+// The benchmark reports the accesses per second of each kernel, and the
+// data TLB misses per access when the perf_event counters are available.
+//
+// hcc `hcc-config --cxxflags --ldflags` random_access.cpp -o random_access
+// ./random_access [MB] [accesses per worker]
+
+#include <kalmar_aligned_alloc.h>
+#include <kalmar_huge_pages.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock clock_type;
+
+// data TLB load misses of the process and the threads it creates, -1 if the
+// counter is not available
+class TlbMisses {
+public:
+  TlbMisses() : fd(-1) {
+#if defined(__linux__)
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+  }
+  ~TlbMisses() {
+#if defined(__linux__)
+    if (fd >= 0)
+      close(fd);
+#endif
+  }
+  void start() {
+#if defined(__linux__)
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+  long long stop() {
+    long long count = -1;
+#if defined(__linux__)
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd, &count, sizeof(count)) != sizeof(count))
+        count = -1;
+    }
+#endif
+    return count;
+  }
+
+private:
+  int fd;
+};
+
+struct Result {
+  double accessesPerSec;
+  double missesPerAccess;  // -1 if not counted
+};
+
+// run kernel(part, seed) on each worker
+template <typename Kernel>
+Result run(int parts, size_t accesses, Kernel kernel) {
+  TlbMisses misses;
+  misses.start();
+  auto t0 = clock_type::now();
+  std::vector<std::thread> workers;
+  for (int part = 0; part < parts; ++part)
+    workers.emplace_back([=] { kernel(part, uint64_t(part) * 0x9E3779B97F4A7C15ULL + 1); });
+  for (auto& w : workers)
+    w.join();
+  double s = std::chrono::duration<double>(clock_type::now() - t0).count();
+  long long count = misses.stop();
+  double total = double(parts) * accesses;
+  return Result{ total / s, count < 0 ? -1.0 : count / total };
+}
+
+static inline uint64_t next(uint64_t& x) {
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return x;
+}
+
+int main(int argc, char* argv[]) {
+  size_t mb = (argc > 1) ? std::atoi(argv[1]) : 1024;
+  size_t accesses = (argc > 2) ? std::atoi(argv[2]) : 4000000;
+  size_t bytes = mb << 20;
+  size_t n = bytes / sizeof(uint64_t);
+  int parts = std::thread::hardware_concurrency();
+
+  Kalmar::HugePageAllocator huge(Kalmar::HugePageAllocator::HUGE_PAGE, Kalmar::getHugePageHugetlb());
+
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << mb << " MB table, " << parts << " workers, " << accesses << " accesses per worker\n";
+  std::cout << std::setw(10) << "kernel" << std::setw(10) << "pages"
+            << std::setw(16) << "Maccesses/s" << std::setw(18) << "TLB misses/access" << "\n";
+
+  const char* kernels[] = { "gather", "update", "strided" };
+  for (int k = 0; k < 3; ++k) {
+    double rate[2];
+    for (int hugePages = 0; hugePages < 2; ++hugePages) {
+      uint64_t* table = static_cast<uint64_t*>(hugePages ? huge.allocate(bytes)
+                                                         : Kalmar::kalmar_aligned_alloc(0x1000, bytes));
+      for (size_t i = 0; i < n; ++i)
+        table[i] = i;
+
+      std::vector<uint64_t> sums(parts, 0);
+      uint64_t* out = sums.data();
+      Result r;
+      if (k == 0) {
+        r = run(parts, accesses, [=](int part, uint64_t x) {
+          uint64_t sum = 0;
+          for (size_t i = 0; i < accesses; ++i)
+            sum += table[next(x) % n];
+          out[part] = sum;
+        });
+      } else if (k == 1) {
+        r = run(parts, accesses, [=](int, uint64_t x) {
+          for (size_t i = 0; i < accesses; ++i) {
+            uint64_t v = next(x);
+            table[v % n] ^= v;
+          }
+        });
+      } else {
+        const size_t stride = 4096 / sizeof(uint64_t);
+        r = run(parts, accesses, [=](int part, uint64_t x) {
+          uint64_t sum = 0;
+          size_t i = (x % n) / stride * stride;
+          for (size_t a = 0; a < accesses; ++a) {
+            sum += table[i];
+            i += stride;
+            if (i >= n)
+              i -= n - 1;
+          }
+          out[part] = sum;
+        });
+      }
+      rate[hugePages] = r.accessesPerSec;
+
+      std::cout << std::setw(10) << kernels[k] << std::setw(10) << (hugePages ? "2 MB" : "4 KB")
+                << std::setw(16) << r.accessesPerSec / 1e6;
+      if (r.missesPerAccess < 0)
+        std::cout << std::setw(18) << "n/a";
+      else
+        std::cout << std::setw(18) << std::setprecision(3) << r.missesPerAccess << std::setprecision(1);
+      std::cout << "\n";
+
+      if (hugePages)
+        huge.free(table);
+      else
+        Kalmar::kalmar_aligned_free(table);
+    }
+    std::cout << std::setw(10) << "" << std::setw(10) << "speedup" << std::setw(16) << rate[1] / rate[0] << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,126 @@
+// RUN: %hc %s -O3 -o %t.out && %t.out
+
+// STREAM-style memory bandwidth of the CPU accelerator with each NUMA policy
+//
+// The kernels copy, scale, add and triad run like kernels of the CPU
+// accelerator: one worker per hardware thread, each on its share of the
+// rows (see partitioned_task).  The arrays are allocated like arrays of the
+// CPU accelerator, freshly mapped by Kalmar::NumaPageAllocator when they are
+// placed, and placed:
+//
+//   none:        written by the host thread first, so on its node, like
+//                arrays initialized from host data; workers not pinned
+//   first_touch: Kalmar::numaFirstTouch, each worker's rows on its node;
+//                workers pinned (HCC_CPU_NUMA_POLICY=first_touch
+//                HCC_CPU_PIN_WORKERS=1)
+//   interleave:  Kalmar::numaInterleave, pages spread over the nodes;
+//                workers not pinned (HCC_CPU_NUMA_POLICY=interleave)
+//
+// The benchmark reports the best bandwidth of each kernel over the
+// iterations, counting the bytes read and written like STREAM.  On a host
+// with one node the three policies are the same.
+//
+// hcc `hcc-config --cxxflags --ldflags` stream.cpp -o stream
+// ./stream [MB per array] [iterations]
+
+#include <kalmar_aligned_alloc.h>
+#include <kalmar_numa.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock clock_type;
+
+// run body(begin, end) on the rows of each worker, like a CPU kernel
+template <typename Body>
+double launch(int parts, size_t n, bool pin, Body body) {
+  auto t0 = clock_type::now();
+  std::vector<std::thread> workers;
+  for (int part = 0; part < parts; ++part) {
+    workers.emplace_back([=] {
+      if (pin)
+        Kalmar::pinThreadToCpu(Kalmar::CpuTopology::get().cpuOfWorker(part, parts));
+      body(n * part / parts, n * (part + 1) / parts);
+    });
+  }
+  for (auto& w : workers)
+    w.join();
+  return std::chrono::duration<double>(clock_type::now() - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+  size_t mb = (argc > 1) ? std::atoi(argv[1]) : 512;
+  int iterations = (argc > 2) ? std::atoi(argv[2]) : 10;
+  size_t n = mb * 1024 * 1024 / sizeof(double);
+  size_t bytes = n * sizeof(double);
+  int parts = std::thread::hardware_concurrency();
+
+  const Kalmar::CpuTopology& topology = Kalmar::CpuTopology::get();
+  std::cout << std::fixed << std::setprecision(0);
+  std::cout << "3 arrays of " << mb << " MB, " << parts << " workers, "
+            << topology.cpus().size() << " CPUs on " << topology.nodes().size() << " nodes\n";
+  std::cout << std::setw(12) << "policy" << std::setw(10) << "copy" << std::setw(10) << "scale"
+            << std::setw(10) << "add" << std::setw(10) << "triad" << "   MB/s\n";
+
+  const char* names[] = { "none", "first_touch", "interleave" };
+  Kalmar::NumaPageAllocator numaPages;
+  auto alloc = [&numaPages](size_t size) {
+    void* p = numaPages.allocate(size);
+    return static_cast<double*>(p ? p : Kalmar::kalmar_aligned_alloc(0x1000, size));
+  };
+  for (int policy = 0; policy < 3; ++policy) {
+    Kalmar::cpuNumaSettings().policy = policy;
+    double* a = alloc(bytes);
+    double* b = alloc(bytes);
+    double* c = alloc(bytes);
+    bool pin = false;
+    for (double* p : { a, b, c }) {
+      if (policy == Kalmar::enums::hcNumaPolicyFirstTouch) {
+        Kalmar::numaFirstTouch(p, bytes, parts);
+        pin = true;
+      } else if (policy == Kalmar::enums::hcNumaPolicyInterleave) {
+        Kalmar::numaInterleave(p, bytes);
+      }
+    }
+    // the host writes the data, after the placement
+    for (size_t i = 0; i < n; ++i) {
+      a[i] = 1.0;
+      b[i] = 2.0;
+      c[i] = 0.0;
+    }
+
+    const double scalar = 3.0;
+    double best[4] = { 1e30, 1e30, 1e30, 1e30 };
+    for (int it = 0; it < iterations; ++it) {
+      best[0] = std::min(best[0], launch(parts, n, pin, [=](size_t i0, size_t i1) {
+        for (size_t i = i0; i < i1; ++i) c[i] = a[i];
+      }));
+      best[1] = std::min(best[1], launch(parts, n, pin, [=](size_t i0, size_t i1) {
+        for (size_t i = i0; i < i1; ++i) b[i] = scalar * c[i];
+      }));
+      best[2] = std::min(best[2], launch(parts, n, pin, [=](size_t i0, size_t i1) {
+        for (size_t i = i0; i < i1; ++i) c[i] = a[i] + b[i];
+      }));
+      best[3] = std::min(best[3], launch(parts, n, pin, [=](size_t i0, size_t i1) {
+        for (size_t i = i0; i < i1; ++i) a[i] = b[i] + scalar * c[i];
+      }));
+    }
+
+    const double moved[4] = { 2.0 * bytes, 2.0 * bytes, 3.0 * bytes, 3.0 * bytes };
+    std::cout << std::setw(12) << names[policy];
+    for (int k = 0; k < 4; ++k)
+      std::cout << std::setw(10) << moved[k] / best[k] / 1e6;
+    std::cout << "\n";
+
+    for (double* p : { a, b, c }) {
+      if (!numaPages.free(p))
+        Kalmar::kalmar_aligned_free(p);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,142 @@
+// RUN: %hc %s -O3 -o %t.out && %t.out
+
+// benchmark for the parallel merge, set operations and selection
+//
+// Every algorithm is timed against its std:: counterpart on the same
+// input, and the results are checked to be identical.
+//
+// hcc `hcc-config --cxxflags --ldflags` merge.cpp -o merge
+// ./merge [elements] [iterations]
+
+#include <coordinate>
+#include <experimental/algorithm>
+#include <experimental/execution_policy>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using std::experimental::parallel::par;
+
+template<typename F>
+double time_ms(int iters, F f) {
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iters; ++i)
+    f();
+  auto t1 = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(t1 - t0).count() / iters;
+}
+
+void report(const char* name, double std_ms, double par_ms) {
+  std::cout << std::setw(26) << name
+            << std::setw(12) << std_ms
+            << std::setw(12) << par_ms
+            << std::setw(10) << std_ms / par_ms << "x\n";
+}
+
+int main(int argc, char* argv[]) {
+  size_t N = (argc > 1) ? std::atol(argv[1]) : (32 << 20);
+  int iters = (argc > 2) ? std::atoi(argv[2]) : 5;
+
+  std::mt19937 gen(5566);
+  std::uniform_int_distribution<int> dis(0, static_cast<int>(N));
+
+  std::vector<int> a(N), b(N);
+  for (auto& v : a) v = dis(gen);
+  for (auto& v : b) v = dis(gen);
+  std::vector<int> unsorted(a);
+  std::sort(std::begin(a), std::end(a));
+  std::sort(std::begin(b), std::end(b));
+
+  std::vector<int> expected(2 * N), result(2 * N);
+  bool ok = true;
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "elements per input: " << N << ", iterations: " << iters << "\n";
+  std::cout << std::setw(26) << "algorithm"
+            << std::setw(12) << "std (ms)"
+            << std::setw(12) << "par (ms)"
+            << std::setw(11) << "speedup" << "\n";
+
+  {
+    double s = time_ms(iters, [&] {
+      std::merge(std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(expected));
+    });
+    double p = time_ms(iters, [&] {
+      std::experimental::parallel::
+      merge(par, std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(result));
+    });
+    ok &= (expected == result);
+    report("merge", s, p);
+  }
+
+  {
+    std::vector<int>::iterator e, r;
+    double s = time_ms(iters, [&] {
+      e = std::set_union(std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(expected));
+    });
+    double p = time_ms(iters, [&] {
+      r = std::experimental::parallel::
+          set_union(par, std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(result));
+    });
+    ok &= (e - std::begin(expected)) == (r - std::begin(result));
+    ok &= std::equal(std::begin(expected), e, std::begin(result));
+    report("set_union", s, p);
+  }
+
+  {
+    std::vector<int>::iterator e, r;
+    double s = time_ms(iters, [&] {
+      e = std::set_intersection(std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(expected));
+    });
+    double p = time_ms(iters, [&] {
+      r = std::experimental::parallel::
+          set_intersection(par, std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(result));
+    });
+    ok &= (e - std::begin(expected)) == (r - std::begin(result));
+    ok &= std::equal(std::begin(expected), e, std::begin(result));
+    report("set_intersection", s, p);
+  }
+
+  {
+    std::vector<int> v1, v2;
+    double s = 0.0, p = 0.0;
+    for (int i = 0; i < iters; ++i) {
+      v1 = unsorted;
+      v2 = unsorted;
+      s += time_ms(1, [&] {
+        std::nth_element(std::begin(v1), std::begin(v1) + N / 2, std::end(v1));
+      });
+      p += time_ms(1, [&] {
+        std::experimental::parallel::
+        nth_element(par, std::begin(v2), std::begin(v2) + N / 2, std::end(v2));
+      });
+    }
+    ok &= (v1[N / 2] == v2[N / 2]);
+    report("nth_element (median)", s / iters, p / iters);
+  }
+
+  {
+    const size_t k = 1000;
+    std::vector<int> v1, v2;
+    double s = 0.0, p = 0.0;
+    for (int i = 0; i < iters; ++i) {
+      v1 = unsorted;
+      v2 = unsorted;
+      s += time_ms(1, [&] {
+        std::partial_sort(std::begin(v1), std::begin(v1) + k, std::end(v1));
+      });
+      p += time_ms(1, [&] {
+        std::experimental::parallel::
+        partial_sort(par, std::begin(v2), std::begin(v2) + k, std::end(v2));
+      });
+    }
+    ok &= std::equal(std::begin(v1), std::begin(v1) + k, std::begin(v2));
+    report("partial_sort (top 1000)", s / iters, p / iters);
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
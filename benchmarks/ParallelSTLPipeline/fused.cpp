@@ -0,0 +1,105 @@
+// RUN: %hc %s -O3 -o %t.out && %t.out
+
+// benchmark for lazy fused pipelines
+//
+// transform -> filter -> reduce is computed twice on device-resident data:
+// once as separate algorithms, where every stage reads and writes a full
+// temporary, and once through make_pipeline, where the stages run inside
+// the reduction kernel and only the input is read.
+//
+// The kernels launched by each path are counted with the kernel and copy
+// profiler (hc::set_profiling), which also reports at exit.
+//
+// hcc `hcc-config --cxxflags --ldflags` fused.cpp -o fused
+// ./fused [elements] [iterations]
+
+#include <hc.hpp>
+#include <coordinate>
+#include <experimental/algorithm>
+#include <experimental/numeric>
+#include <experimental/execution_policy>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using std::experimental::parallel::par;
+using std::experimental::parallel::device_begin;
+using std::experimental::parallel::device_end;
+using std::experimental::parallel::make_pipeline;
+
+// kernels recorded by the profiler since the last reset; a kernel is
+// recorded when the queue releases it, after a wait
+static uint64_t kernelLaunches() {
+  hc::accelerator().get_default_view().wait();
+  uint64_t launches = 0;
+  for (auto& k : Kalmar::KernelProfiler::get().getKernels())
+    launches += k.count;
+  return launches;
+}
+
+int main(int argc, char* argv[]) {
+  size_t N = (argc > 1) ? std::atol(argv[1]) : (16 << 20);
+  int iters = (argc > 2) ? std::atoi(argv[2]) : 10;
+
+  auto f = [](float& v) [[hc,cpu]] { return v * 2.0f + 1.0f; };
+  auto p = [](const float& v) [[hc,cpu]] { return v > 1000.0f; };
+  auto np = [](const float& v) [[hc,cpu]] { return !(v > 1000.0f); };
+
+  std::vector<float> input(N);
+  for (size_t i = 0; i < N; ++i)
+    input[i] = static_cast<float>(i % 2048);
+
+  hc::array<float> d_input(N, std::begin(input));
+  hc::array<float> d_tmp(N);
+
+  hc::set_profiling(true);
+
+  // separate algorithms, filtered elements are replaced by 0
+  float unfused_sum = 0.0f;
+  hc::reset_profile();
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iters; ++i) {
+    std::experimental::parallel::
+    transform(par, device_begin(d_input), device_end(d_input), device_begin(d_tmp), f);
+    std::experimental::parallel::
+    replace_if(par, device_begin(d_tmp), device_end(d_tmp), p, 0.0f);
+    unfused_sum = std::experimental::parallel::
+                  reduce(par, device_begin(d_tmp), device_end(d_tmp), 0.0f);
+  }
+  auto t1 = std::chrono::high_resolution_clock::now();
+  uint64_t unfused_launches = kernelLaunches();
+
+  // fused pipeline
+  auto pipe = make_pipeline(device_begin(d_input), device_end(d_input))
+                .transform(f).filter(np);
+  float fused_sum = 0.0f;
+  hc::reset_profile();
+  auto t2 = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iters; ++i) {
+    fused_sum = std::experimental::parallel::
+                reduce(par, pipe, 0.0f, std::plus<float>());
+  }
+  auto t3 = std::chrono::high_resolution_clock::now();
+  uint64_t fused_launches = kernelLaunches();
+
+  double unfused_ms = std::chrono::duration<double, std::milli>(t1 - t0).count() / iters;
+  double fused_ms = std::chrono::duration<double, std::milli>(t3 - t2).count() / iters;
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "elements: " << N << ", iterations: " << iters << "\n";
+  std::cout << std::setw(12) << "unfused:"
+            << std::setw(12) << unfused_ms << " ms/iter, "
+            << std::setw(10) << double(unfused_launches) / iters << " kernels/iter\n";
+  std::cout << std::setw(12) << "fused:"
+            << std::setw(12) << fused_ms << " ms/iter, "
+            << std::setw(10) << double(fused_launches) / iters << " kernels/iter\n";
+  std::cout << "speedup: " << unfused_ms / fused_ms << "x\n";
+
+  // both paths must compute the same value
+  float diff = unfused_sum - fused_sum;
+  if (diff < 0) diff = -diff;
+  return (diff <= 1e-3f * (unfused_sum < 0 ? -unfused_sum : unfused_sum)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
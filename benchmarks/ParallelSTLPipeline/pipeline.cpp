@@ -0,0 +1,120 @@
+// RUN: %hc %s -O3 -o %t.out && %t.out
+
+// benchmark for a chain of parallel STL algorithms
+//
+// The same transform -> replace_if -> transform -> reduce pipeline is run
+// twice: once over std::vector iterators, where every algorithm wraps host
+// memory into a temporary array_view and synchronizes it back to the host,
+// and once over device_iterator on hc::array, where intermediates stay on
+// the accelerator and only the final scalar comes back.
+//
+// The host<->device traffic of each path is measured with the kernel and
+// copy profiler (hc::set_profiling), which also reports at exit.
+//
+// hcc `hcc-config --cxxflags --ldflags` pipeline.cpp -o pipeline
+// ./pipeline [elements] [iterations]
+
+#include <hc.hpp>
+#include <coordinate>
+#include <experimental/algorithm>
+#include <experimental/numeric>
+#include <experimental/execution_policy>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using std::experimental::parallel::par;
+using std::experimental::parallel::device_begin;
+using std::experimental::parallel::device_end;
+
+// host<->device copies recorded by the profiler since the last reset
+struct Transfers {
+  uint64_t count;
+  double mb;
+};
+
+static Transfers transfers() {
+  Transfers t = { 0, 0.0 };
+  for (auto& c : Kalmar::KernelProfiler::get().getCopies()) {
+    if (c.kind == hc::hcMemcpyHostToDevice || c.kind == hc::hcMemcpyDeviceToHost) {
+      t.count += c.count;
+      t.mb += c.bytes / (1024.0 * 1024.0);
+    }
+  }
+  return t;
+}
+
+int main(int argc, char* argv[]) {
+  size_t N = (argc > 1) ? std::atol(argv[1]) : (16 << 20);
+  int iters = (argc > 2) ? std::atoi(argv[2]) : 10;
+
+  auto f = [](float& v) [[hc,cpu]] { return v * 2.0f + 1.0f; };
+  auto g = [](float& v) [[hc,cpu]] { return v * 0.5f; };
+  auto p = [](const float& v) [[hc,cpu]] { return v > 1000.0f; };
+
+  std::vector<float> input(N);
+  for (size_t i = 0; i < N; ++i)
+    input[i] = static_cast<float>(i % 2048);
+
+  hc::set_profiling(true);
+
+  // host iterators
+  std::vector<float> tmp1(N), tmp2(N);
+  float host_sum = 0.0f;
+  hc::reset_profile();
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iters; ++i) {
+    std::experimental::parallel::
+    transform(par, std::begin(input), std::end(input), std::begin(tmp1), f);
+    std::experimental::parallel::
+    replace_if(par, std::begin(tmp1), std::end(tmp1), p, 0.0f);
+    std::experimental::parallel::
+    transform(par, std::begin(tmp1), std::end(tmp1), std::begin(tmp2), g);
+    host_sum = std::experimental::parallel::
+               reduce(par, std::begin(tmp2), std::end(tmp2), 0.0f);
+  }
+  auto t1 = std::chrono::high_resolution_clock::now();
+  Transfers host_transfers = transfers();
+
+  // device iterators, the upload of the input is counted
+  hc::reset_profile();
+  hc::array<float> d_input(N, std::begin(input));
+  hc::array<float> d_tmp1(N), d_tmp2(N);
+  float device_sum = 0.0f;
+  auto t2 = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iters; ++i) {
+    std::experimental::parallel::
+    transform(par, device_begin(d_input), device_end(d_input), device_begin(d_tmp1), f);
+    std::experimental::parallel::
+    replace_if(par, device_begin(d_tmp1), device_end(d_tmp1), p, 0.0f);
+    std::experimental::parallel::
+    transform(par, device_begin(d_tmp1), device_end(d_tmp1), device_begin(d_tmp2), g);
+    device_sum = std::experimental::parallel::
+                 reduce(par, device_begin(d_tmp2), device_end(d_tmp2), 0.0f);
+  }
+  auto t3 = std::chrono::high_resolution_clock::now();
+  Transfers device_transfers = transfers();
+
+  double host_ms = std::chrono::duration<double, std::milli>(t1 - t0).count() / iters;
+  double device_ms = std::chrono::duration<double, std::milli>(t3 - t2).count() / iters;
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "elements: " << N << ", iterations: " << iters << "\n";
+  std::cout << std::setw(20) << "host iterators:"
+            << std::setw(12) << host_ms << " ms/iter, "
+            << std::setw(10) << host_transfers.mb / iters << " MB host<->device/iter in "
+            << double(host_transfers.count) / iters << " copies\n";
+  std::cout << std::setw(20) << "device iterators:"
+            << std::setw(12) << device_ms << " ms/iter, "
+            << std::setw(10) << device_transfers.mb / iters << " MB host<->device/iter in "
+            << double(device_transfers.count) / iters << " copies\n";
+  std::cout << "speedup: " << host_ms / device_ms << "x\n";
+
+  // both paths must compute the same value
+  float diff = host_sum - device_sum;
+  if (diff < 0) diff = -diff;
+  return (diff <= 1e-3f * (host_sum < 0 ? -host_sum : host_sum)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,87 @@
+// RUN: %hc %s -O3 -o %t.out && %t.out
+
+// benchmark for the parallel searching algorithms
+//
+// A single matching element is placed at a varying position of a large
+// range, and std::find is compared against parallel find on host and on
+// device iterators. With the early cut-off, the parallel time should grow
+// with the position of the hit rather than with the size of the range.
+//
+// hcc `hcc-config --cxxflags --ldflags` find.cpp -o find
+// ./find [elements] [iterations]
+
+#include <coordinate>
+#include <experimental/algorithm>
+#include <experimental/execution_policy>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using std::experimental::parallel::par;
+using std::experimental::parallel::device_begin;
+using std::experimental::parallel::device_end;
+
+template<typename F>
+double time_ms(int iters, F f) {
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iters; ++i)
+    f();
+  auto t1 = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(t1 - t0).count() / iters;
+}
+
+int main(int argc, char* argv[]) {
+  size_t N = (argc > 1) ? std::atol(argv[1]) : (64 << 20);
+  int iters = (argc > 2) ? std::atoi(argv[2]) : 10;
+
+  // hit position as a fraction of the range, 1.0 means no hit
+  const double fractions[] = { 0.0, 0.0001, 0.01, 0.1, 0.5, 0.9, 1.0 };
+
+  std::vector<int> input(N, 0);
+  hc::array<int> d_input(N);
+
+  bool ok = true;
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "elements: " << N << ", iterations: " << iters << "\n";
+  std::cout << std::setw(10) << "hit at"
+            << std::setw(14) << "std (ms)"
+            << std::setw(14) << "host (ms)"
+            << std::setw(14) << "device (ms)" << "\n";
+
+  for (double f : fractions) {
+    size_t pos = static_cast<size_t>(f * N);
+    std::fill(std::begin(input), std::end(input), 0);
+    if (pos < N)
+      input[pos] = 1;
+    hc::copy(std::begin(input), std::end(input), d_input);
+
+    std::vector<int>::iterator r_std, r_host;
+    long r_dev = 0;
+
+    double std_ms = time_ms(iters, [&] {
+      r_std = std::find(std::begin(input), std::end(input), 1);
+    });
+    double host_ms = time_ms(iters, [&] {
+      r_host = std::experimental::parallel::
+               find(par, std::begin(input), std::end(input), 1);
+    });
+    double dev_ms = time_ms(iters, [&] {
+      r_dev = std::experimental::parallel::
+              find(par, device_begin(d_input), device_end(d_input), 1) -
+              device_begin(d_input);
+    });
+
+    ok &= (r_std == r_host);
+    ok &= (r_dev == r_std - std::begin(input));
+
+    std::cout << std::setw(10) << f
+              << std::setw(14) << std_ms
+              << std::setw(14) << host_ms
+              << std::setw(14) << dev_ms << "\n";
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,77 @@
+// RUN: %hc %s -O3 -o %t.out -lhc_am && HCC_HSA_RUNTIME=mock %t.out
+
+// push_back-heavy workloads on pinned vectors, with and without the pool
+//
+// Each round fills a few vectors element by element, like staging buffers
+// of a producer, then drops them.  The vectors use:
+//
+//   std:    std::allocator, pageable memory, for reference
+//   pinned: hc::pinned_vector, which pins, maps to the peers and unpins each
+//           block of the doubling growth
+//   pooled: hc::pooled_pinned_vector, whose blocks come from a
+//           hc::pinned_host_pool and are pinned once
+//
+// Without a GPU, run it on the CPU emulation of the HSA runtime:
+//   HCC_HSA_RUNTIME=mock ./push_back
+//
+// hcc `hcc-config --cxxflags --ldflags` push_back.cpp -lhc_am -o push_back
+// ./push_back [rounds] [elements per vector] [vectors per round]
+
+#include <hc.hpp>
+#include <hc_am.hpp>
+#include <pinned_vector.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+typedef std::chrono::steady_clock clock_type;
+
+template <typename Vector>
+double run(int rounds, int elements, int vectors, const typename Vector::allocator_type& alloc) {
+  auto t0 = clock_type::now();
+  for (int r = 0; r < rounds; ++r) {
+    std::vector<Vector> held;
+    for (int v = 0; v < vectors; ++v) {
+      held.emplace_back(alloc);
+      Vector& vec = held.back();
+      for (int i = 0; i < elements; ++i)
+        vec.push_back(float(i));
+    }
+  }
+  return std::chrono::duration<double>(clock_type::now() - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+  int rounds = (argc > 1) ? std::atoi(argv[1]) : 50;
+  int elements = (argc > 2) ? std::atoi(argv[2]) : 100000;
+  int vectors = (argc > 3) ? std::atoi(argv[3]) : 8;
+
+  hc::pinned_host_pool pool;
+  hc::am_pool_allocator<float> pooled(&pool);
+
+  // warm up the runtime and the pool
+  run<std::vector<float, hc::am_pool_allocator<float>>>(1, elements, vectors, pooled);
+
+  double plain = run<std::vector<float>>(rounds, elements, vectors, std::allocator<float>());
+  double pinned = run<hc::pinned_vector<float>>(rounds, elements, vectors, hc::am_allocator<float>());
+  double pooledTime = run<std::vector<float, hc::am_pool_allocator<float>>>(rounds, elements, vectors, pooled);
+
+  double pushes = double(rounds) * elements * vectors;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << rounds << " rounds of " << vectors << " vectors of " << elements << " floats\n";
+  std::cout << std::setw(8) << "vector" << std::setw(16) << "Mpush_back/s" << std::setw(12) << "ms/round" << "\n";
+  std::cout << std::setw(8) << "std" << std::setw(16) << pushes / plain / 1e6
+            << std::setw(12) << 1e3 * plain / rounds << "\n";
+  std::cout << std::setw(8) << "pinned" << std::setw(16) << pushes / pinned / 1e6
+            << std::setw(12) << 1e3 * pinned / rounds << "\n";
+  std::cout << std::setw(8) << "pooled" << std::setw(16) << pushes / pooledTime / 1e6
+            << std::setw(12) << 1e3 * pooledTime / rounds << "\n";
+
+  hc::pinned_host_pool_stats stats = pool.get_stats();
+  std::cout << "pool: " << stats.large.hits << " reused blocks, " << stats.large.misses
+            << " pinned blocks, " << stats.small.slabsCreated << " pinned chunks\n";
+  return 0;
+}
@@ -0,0 +1,81 @@
+// RUN: %hc %s -O3 -o %t.out && %t.out
+
+// cost of recording a runtime event: binary tracer vs. HCC_DB text output
+//
+// Each thread records events like the runtime does around a dispatch:
+//
+//   off:      Kalmar::TraceScope with tracing off, the cost left in the runtime
+//   trace:    Kalmar::TraceScope with tracing on, to the ring buffer of the thread
+//   dbout:    a DBOUT-like message formatted with a std::stringstream and
+//             written to std::cerr (redirect it: ./overhead 2>/dev/null)
+//
+// hcc `hcc-config --cxxflags --ldflags` overhead.cpp -o overhead
+// ./overhead [events per thread] [threads] 2>/dev/null
+
+#include <kalmar_trace.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock clock_type;
+
+// million events per second over all the threads, the events of each
+// thread recorded by record(i)
+template <typename Record>
+double run(int events, int threads, Record record) {
+  auto t0 = clock_type::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([=] {
+      for (int i = 0; i < events; ++i)
+        record(i);
+    });
+  }
+  for (auto& w : workers)
+    w.join();
+  double s = std::chrono::duration<double>(clock_type::now() - t0).count();
+  return double(events) * threads / s / 1e6;
+}
+
+int main(int argc, char* argv[]) {
+  int events = (argc > 1) ? std::atoi(argv[1]) : 1000000;
+  int threads = (argc > 2) ? std::atoi(argv[2]) : 4;
+
+  Kalmar::Tracer& tracer = Kalmar::Tracer::get();
+  const char* name = tracer.intern("_ZZ4mainEN3_EC__019__cxxamp_trampolineEPfi");
+
+  double off = run(events, threads, [=](int i) {
+    Kalmar::TraceScope trace(Kalmar::TraceDispatch, name, i, 1);
+  });
+
+  tracer.enable();
+  double on = run(events, threads, [=](int i) {
+    Kalmar::TraceScope trace(Kalmar::TraceDispatch, name, i, 1);
+  });
+  tracer.disable();
+
+  // fewer events: the text output is much slower
+  int textEvents = events / 10;
+  double text = run(textEvents, threads, [=](int i) {
+    std::stringstream sstream;
+    sstream << "   hcc-cmd tid:" << 1 << " dispatch kernel " << name << " grid=" << i << " queue#0.1\n";
+    std::cerr << sstream.str();
+  });
+
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << threads << " threads, " << events << " events per thread\n";
+  std::cout << std::setw(8) << "events" << std::setw(12) << "Mevents/s" << "\n";
+  std::cout << std::setw(8) << "off" << std::setw(12) << off << "\n";
+  std::cout << std::setw(8) << "trace" << std::setw(12) << on << "\n";
+  std::cout << std::setw(8) << "dbout" << std::setw(12) << text << "\n";
+
+  std::ostringstream json;
+  size_t exported = tracer.exportChrome(json);
+  std::cout << exported << " events kept, " << json.str().size() / 1024 << " KB of JSON\n";
+  return 0;
+}
@@ -0,0 +1,141 @@
+// RUN: %hc %s -O3 -o %t.out && %t.out
+
+// throughput and memory footprint of small buffers with and without slabs
+//
+// Each thread allocates a working set of small buffers of random sizes,
+// touches them, and replaces them one at a time, like the temporaries of a
+// sequence of small kernels.  The buffers come either each from its own page
+// aligned allocation, like array buffers of the CPU runtime before slabs, or
+// from Kalmar::SlabAllocator (HCC_SLAB_MAX_SIZE).  The benchmark reports the
+// allocate + free pairs per second, and the memory reserved for the working
+// set against the bytes requested.
+//
+// hcc `hcc-config --cxxflags --ldflags` small_buffers.cpp -o small_buffers
+// ./small_buffers [pairs per thread] [working set per thread] [max size]
+
+#include <kalmar_slab.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock clock_type;
+
+// page aligned allocations, counting the pages they take
+struct PageBackend {
+  std::atomic<size_t>* reserved;
+
+  void* allocate(size_t size) {
+    *reserved += (size + 0xfff) & ~size_t(0xfff);
+    return Kalmar::kalmar_aligned_alloc(0x1000, size);
+  }
+  void free(void* ptr, size_t size) {
+    *reserved -= (size + 0xfff) & ~size_t(0xfff);
+    Kalmar::kalmar_aligned_free(ptr);
+  }
+};
+
+struct Result {
+  double pairsPerSec;
+  size_t requested;  // bytes of the working sets
+  size_t reserved;   // bytes reserved for them, at the end of the run
+};
+
+// Alloc(size) -> void*, Free(ptr, size), Reserved() -> bytes
+template <typename Alloc, typename Free, typename Reserved>
+Result run(int threads, int pairs, int live, size_t maxSize,
+           Alloc alloc, Free release, Reserved reserved) {
+  std::atomic<size_t> requested(0);
+  std::atomic<int> ready(0);
+  std::atomic<bool> done(false);
+  Result r;
+
+  auto t0 = clock_type::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      unsigned seed = t + 1;
+      std::vector<std::pair<char*, size_t> > held(live);
+      auto next = [&] {
+        seed = seed * 1103515245 + 12345;
+        size_t size = 16 + (seed >> 8) % maxSize;
+        char* p = static_cast<char*>(alloc(size));
+        p[0] = 1;
+        p[size - 1] = 1;
+        return std::make_pair(p, size);
+      };
+      for (auto& h : held)
+        h = next();
+      for (int i = 0; i < pairs; ++i) {
+        seed = seed * 1103515245 + 12345;
+        auto& h = held[(seed >> 16) % live];
+        release(h.first, h.second);
+        h = next();
+      }
+      size_t bytes = 0;
+      for (auto& h : held)
+        bytes += h.second;
+      requested += bytes;
+      // hold the working set until every thread is done
+      ready++;
+      while (!done)
+        std::this_thread::yield();
+      for (auto& h : held)
+        release(h.first, h.second);
+    });
+  }
+  while (ready != threads)
+    std::this_thread::yield();
+  double s = std::chrono::duration<double>(clock_type::now() - t0).count();
+  r.pairsPerSec = threads * double(pairs) / s;
+  r.requested = requested;
+  r.reserved = reserved();
+  done = true;
+  for (auto& w : workers)
+    w.join();
+  return r;
+}
+
+int main(int argc, char* argv[]) {
+  int pairs = (argc > 1) ? std::atoi(argv[1]) : 200000;
+  int live = (argc > 2) ? std::atoi(argv[2]) : 1000;
+  size_t maxSize = (argc > 3) ? std::atoi(argv[3]) : 4096;
+
+  const int threadCounts[] = { 1, 2, 4, 8 };
+
+  std::cout << std::fixed << std::setprecision(0);
+  std::cout << pairs << " allocate/free pairs per thread, " << live
+            << " buffers of 16 to " << maxSize + 16 << " bytes held per thread\n";
+  std::cout << std::setw(8) << "threads" << std::setw(16) << "pages pairs/s"
+            << std::setw(16) << "slab pairs/s" << std::setw(10) << "speedup"
+            << std::setw(12) << "pages MB" << std::setw(12) << "slab MB"
+            << std::setw(12) << "needed MB" << "\n";
+
+  for (int threads : threadCounts) {
+    std::atomic<size_t> pageBytes(0);
+    PageBackend pages{ &pageBytes };
+    Result direct = run(threads, pairs, live, maxSize,
+                        [&](size_t size) { return pages.allocate(size); },
+                        [&](void* ptr, size_t size) { pages.free(ptr, size); },
+                        [&] { return size_t(pageBytes); });
+
+    Kalmar::SlabAllocator<Kalmar::AlignedSlabBackend> slab(Kalmar::AlignedSlabBackend(), 64 * 1024);
+    Result slabbed = run(threads, pairs, live, maxSize,
+                         [&](size_t size) { return slab.allocate(size); },
+                         [&](void* ptr, size_t) { slab.free(ptr); },
+                         [&] { return slab.getStats().bytesReserved; });
+
+    std::cout << std::setw(8) << threads << std::setw(16) << direct.pairsPerSec
+              << std::setw(16) << slabbed.pairsPerSec << std::setprecision(1)
+              << std::setw(10) << slabbed.pairsPerSec / direct.pairsPerSec
+              << std::setw(12) << direct.reserved / 1048576.0
+              << std::setw(12) << slabbed.reserved / 1048576.0
+              << std::setw(12) << slabbed.requested / 1048576.0
+              << std::setprecision(0) << "\n";
+  }
+  return 0;
+}
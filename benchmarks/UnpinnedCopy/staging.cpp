@@ -0,0 +1,222 @@
+// RUN: %hc %s -O3 -o %t.out && %t.out
+
+// bandwidth benchmark for the staging path of unpinned host-to-device copies
+//
+// The GPU DMA engine is simulated by threads draining staging buffers into a
+// "device" buffer at a fixed bandwidth, so the benchmark measures the host
+// side of UnpinnedCopyEngine::CopyHostToDeviceStaging without a GPU: staging
+// rings shared by concurrent copies, streaming stores, and packing split over
+// helper threads (Kalmar::memcpy_nt and Kalmar::CopyWorkerPool).
+//
+// hcc `hcc-config --cxxflags --ldflags` staging.cpp -o staging
+// ./staging [MB per copy] [copying threads] [DMA GB/s] [buffer KB] [buffers per ring]
+
+#include <kalmar_staging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Copies submitted to a simulated DMA engine.  A signal is set to 1 when a
+// transfer is submitted and to 0 once it is done, like the completion signals
+// of hsa_amd_memory_async_copy.
+class SimDma {
+public:
+  SimDma(int engines, double gbPerSec) : nsPerByte(1.0 / gbPerSec), done(false) {
+    for (int i = 0; i < engines; ++i)
+      threads.emplace_back([this] { work(); });
+  }
+
+  ~SimDma() {
+    {
+      std::lock_guard<std::mutex> l(mutex);
+      done = true;
+    }
+    cv.notify_all();
+    for (auto& t : threads)
+      t.join();
+  }
+
+  void copy(char* dst, const char* src, size_t n, std::atomic<int>* signal) {
+    signal->store(1, std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> l(mutex);
+      transfers.push_back(Transfer{dst, src, n, signal});
+    }
+    cv.notify_one();
+  }
+
+  static void wait(std::atomic<int>* signal) {
+    while (signal->load(std::memory_order_acquire) != 0)
+      std::this_thread::yield();
+  }
+
+private:
+  struct Transfer {
+    char* dst;
+    const char* src;
+    size_t n;
+    std::atomic<int>* signal;
+  };
+
+  void work() {
+    std::unique_lock<std::mutex> l(mutex);
+    for (;;) {
+      cv.wait(l, [this] { return done || !transfers.empty(); });
+      if (done)
+        return;
+      Transfer t = transfers.front();
+      transfers.pop_front();
+      l.unlock();
+
+      auto end = std::chrono::steady_clock::now() +
+                 std::chrono::nanoseconds(static_cast<long long>(t.n * nsPerByte));
+      memcpy(t.dst, t.src, t.n);
+      // a DMA engine doesn't use the CPU while it transfers
+      std::this_thread::sleep_until(end);
+      t.signal->store(0, std::memory_order_release);
+
+      l.lock();
+    }
+  }
+
+  const double nsPerByte;
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<Transfer> transfers;
+  bool done;
+};
+
+struct Ring {
+  std::vector<std::unique_ptr<char[]>> buffers;
+  std::unique_ptr<std::atomic<int>[]> signals;
+  std::mutex lock;
+
+  Ring(int count, size_t size) : signals(new std::atomic<int>[count]) {
+    for (int i = 0; i < count; ++i) {
+      buffers.emplace_back(new char[size]);
+      memset(buffers.back().get(), 0, size);
+      signals[i].store(0);
+    }
+  }
+};
+
+struct Config {
+  const char* name;
+  int rings;
+  bool nonTemporal;
+  int packThreads;
+};
+
+// Same pipeline as CopyHostToDeviceStaging: pack a buffer, hand it to the DMA
+// engine, move to the next buffer of the ring once it has been drained.
+void stagedCopy(std::vector<std::unique_ptr<Ring>>& rings, std::atomic<unsigned>& nextRing,
+                SimDma& dma, Kalmar::CopyWorkerPool* packers, const Config& c,
+                char* dst, const char* src, size_t n, size_t bufferSize) {
+  unsigned first = nextRing.fetch_add(1) % rings.size();
+  Ring* ring = nullptr;
+  for (size_t i = 0; i < rings.size() && !ring; ++i) {
+    Ring* r = rings[(first + i) % rings.size()].get();
+    if (r->lock.try_lock())
+      ring = r;
+  }
+  if (!ring) {
+    ring = rings[first].get();
+    ring->lock.lock();
+  }
+  std::lock_guard<std::mutex> l(ring->lock, std::adopt_lock);
+
+  int count = static_cast<int>(ring->buffers.size());
+  int index = 0;
+  for (size_t offset = 0; offset < n; offset += bufferSize) {
+    size_t bytes = std::min(bufferSize, n - offset);
+    SimDma::wait(&ring->signals[index]);
+
+    char* staging = ring->buffers[index].get();
+    if (packers)
+      packers->copy(staging, src + offset, bytes, c.nonTemporal);
+    else if (c.nonTemporal)
+      Kalmar::memcpy_nt(staging, src + offset, bytes);
+    else
+      memcpy(staging, src + offset, bytes);
+
+    dma.copy(dst + offset, staging, bytes, &ring->signals[index]);
+    index = (index + 1) % count;
+  }
+  for (int i = 0; i < count; ++i)
+    SimDma::wait(&ring->signals[i]);
+}
+
+int main(int argc, char* argv[]) {
+  size_t N = ((argc > 1) ? std::atol(argv[1]) : 64) << 20;
+  int threads = (argc > 2) ? std::atoi(argv[2]) : 4;
+  double gbPerSec = (argc > 3) ? std::atof(argv[3]) : 12.0;
+  size_t bufferSize = ((argc > 4) ? std::atol(argv[4]) : 4096) << 10;
+  int buffers = (argc > 5) ? std::atoi(argv[5]) : 2;
+  const int iters = 4;
+
+  // one engine per copying thread, so that the DMA side scales with the rings
+  SimDma dma(threads, gbPerSec);
+
+  std::vector<std::vector<char>> src(threads, std::vector<char>(N, 1));
+  std::vector<std::vector<char>> dst(threads, std::vector<char>(N, 0));
+
+  const Config configs[] = {
+    {"1 ring, memcpy",               1,       false, 0},
+    {"1 ring, streaming",            1,       true,  0},
+    {"rings, memcpy",                threads, false, 0},
+    {"rings, streaming",             threads, true,  0},
+    {"rings, streaming, 4 packers",  threads, true,  4},
+  };
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "copies of " << (N >> 20) << " MB from " << threads << " threads, "
+            << buffers << " x " << (bufferSize >> 10) << " KB buffers per ring, DMA at "
+            << gbPerSec << " GB/s per engine\n";
+  std::cout << std::setw(30) << "configuration" << std::setw(12) << "GB/s" << "\n";
+
+  bool ok = true;
+  for (const Config& c : configs) {
+    std::vector<std::unique_ptr<Ring>> rings;
+    for (int i = 0; i < c.rings; ++i)
+      rings.emplace_back(new Ring(buffers, bufferSize));
+    std::atomic<unsigned> nextRing(0);
+    std::unique_ptr<Kalmar::CopyWorkerPool> packers(
+        c.packThreads ? new Kalmar::CopyWorkerPool(c.packThreads) : nullptr);
+
+    for (auto& d : dst)
+      memset(d.data(), 0, N);
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t] {
+        for (int i = 0; i < iters; ++i)
+          stagedCopy(rings, nextRing, dma, packers.get(), c, dst[t].data(), src[t].data(), N, bufferSize);
+      });
+    }
+    for (auto& w : workers)
+      w.join();
+    auto t1 = std::chrono::steady_clock::now();
+
+    double s = std::chrono::duration<double>(t1 - t0).count();
+    std::cout << std::setw(30) << c.name
+              << std::setw(12) << (double(N) * threads * iters / s / 1e9) << "\n";
+
+    for (int t = 0; t < threads; ++t)
+      ok &= (dst[t] == src[t]);
+  }
+
+  return !ok;
+}
@@ -51,6 +51,7 @@
 #define GL_BLOCKED  0x8
 #define DISPATCH_HSA_KERNEL_CF    0x10
 #define DISPATCH_HSA_KERNEL_NOCF  0x20
+#define PFE_BATCHED 0x40
 
 int p_tests = 0xff;
 //int p_tests = DISPATCH_HSA_KERNEL_CF+DISPATCH_HSA_KERNEL_NOCF;
@@ -59,6 +60,7 @@ int p_useSystemScope = false;
 
 int p_dispatch_count = DISPATCH_COUNT;
 int p_burst_count = 1;
+int p_batch_size = 32; // doorbell coalescing for PFE_BATCHED
 int p_execute_any_order = 0;
 
 int p_queue_wait = 0; // use queue wait vs event wait
@@ -168,6 +170,7 @@ void usage() {
     printf (" --system_scope, -S        : Use system-scope acquire/release for GL submissions\n");
     printf (" --queue_wait, -W          : Use queue-level wait rather than event-level");
     printf (" --execute_any_order,-a    : Create queue with execute_any_order (no barrier bit)\n");
+    printf (" --batch_size, -B          : Packets per doorbell ring for the batched pfe test\n");
 };
 
 int main(int argc, char* argv[]) {
@@ -195,6 +198,10 @@ int main(int argc, char* argv[]) {
         if (++i >= argc || !parseInt(argv[i], &p_tests)) {
             failed ("Bad tests");
         };
+    } else if (!strcmp(arg, "--batch_size") || (!strcmp(arg, "-B"))) {
+        if (++i >= argc || !parseInt(argv[i], &p_batch_size)) {
+            failed ("Bad batch_size");
+        };
     } else if (!strcmp(arg, "--execute_any_order") || (!strcmp(arg, "-a"))) {
         p_execute_any_order = true;
     } else if (!strcmp(arg, "--system_scope") || (!strcmp(arg, "-S"))) {
@@ -296,6 +303,36 @@ int main(int argc, char* argv[]) {
   }
 
 
+  if (p_tests & PFE_BATCHED) {
+      // Dispatch throughput with one doorbell ring per packet, then with the
+      // rings coalesced by an accelerator_view::batch_scope
+      for (int batched = 0; batched < 2; ++batched) {
+        start = std::chrono::high_resolution_clock::now();
+        for(int i = 0; i < p_dispatch_count; ++i) {
+          hc::completion_future cf;
+          {
+            std::unique_ptr<hc::accelerator_view::batch_scope> batch;
+            if (batched) {
+                batch.reset(new hc::accelerator_view::batch_scope(av, p_batch_size, 0));
+            }
+            for (int j=0; j<p_burst_count ;j++) {
+                cf = hc::parallel_for_each(av, hc::extent<3>(lp.grid_dim.x*lp.group_dim.x,1,1).tile(lp.group_dim.x,1,1),
+                [=](hc::index<3>& idx) __HC__ {
+                });
+            };
+          }
+          cf.wait(hc::hcWaitModeActive);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> dur = end - start;
+        double packets = double(p_dispatch_count) * p_burst_count;
+        std::cout << std::setw(TW) << (batched ? "pfe packets/s, batched:                 "
+                                               : "pfe packets/s, unbatched:               ")
+                  << std::setprecision(8) << packets / dur.count() << "\n";
+      }
+  }
+
+
   if (p_tests & GL_ACTIVE) {
       // Timing null grid_launch call, active wait
       for(int i = 0; i < p_dispatch_count; ++i) {
@@ -9,3 +9,6 @@
 ./bench --dispatch_count 5000 --burst_count 100   --tests 0x30 $@
 
 
+
+# Doorbell coalescing, packets/s with and without batching:
+./bench --dispatch_count 500 --burst_count 1000 --batch_size 64 --tests 0x40 $@
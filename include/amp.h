@@ -2056,6 +2056,7 @@ struct cpu_helper<K, Kernel, K>
 
 template <typename Kernel, int N>
 void partitioned_task(const Kernel& ker, const extent<N>& ext, int part) {
+    Kalmar::pinCpuWorker(part, Kalmar::NTHREAD);
     index<N> idx;
     int start = ext[0] * part / Kalmar::NTHREAD;
     int end = ext[0] * (part + 1) / Kalmar::NTHREAD;
@@ -2067,6 +2068,7 @@ void partitioned_task(const Kernel& ker, const extent<N>& ext, int part) {
 
 template <typename Kernel, int D0>
 void partitioned_task_tile(Kernel const& f, tiled_extent<D0> const& ext, int part) {
+    Kalmar::pinCpuWorker(part, Kalmar::NTHREAD);
     int start = (ext[0] / D0) * part / Kalmar::NTHREAD;
     int end = (ext[0] / D0) * (part + 1) / Kalmar::NTHREAD;
     int stride = end - start;
@@ -2097,6 +2099,7 @@ void partitioned_task_tile(Kernel const& f, tiled_extent<D0> const& ext, int par
 }
 template <typename Kernel, int D0, int D1>
 void partitioned_task_tile(Kernel const& f, tiled_extent<D0, D1> const& ext, int part) {
+    Kalmar::pinCpuWorker(part, Kalmar::NTHREAD);
     int start = (ext[0] / D0) * part / Kalmar::NTHREAD;
     int end = (ext[0] / D0) * (part + 1) / Kalmar::NTHREAD;
     int stride = end - start;
@@ -2131,6 +2134,7 @@ void partitioned_task_tile(Kernel const& f, tiled_extent<D0, D1> const& ext, int
 
 template <typename Kernel, int D0, int D1, int D2>
 void partitioned_task_tile(Kernel const& f, tiled_extent<D0, D1, D2> const& ext, int part) {
+    Kalmar::pinCpuWorker(part, Kalmar::NTHREAD);
     int start = (ext[0] / D0) * part / Kalmar::NTHREAD;
     int end = (ext[0] / D0) * (part + 1) / Kalmar::NTHREAD;
     int stride = end - start;
@@ -15,13 +15,18 @@ namespace experimental {
 namespace parallel {
 inline namespace v1 {
 
+#include "device_iterator.inl"
 #include "type_utils.inl"
 #include "kernel_launch.inl"
 #include "reduce.inl"
 #include "transform.inl"
 #include "transform_reduce.inl"
+#include "pipeline.inl"
 #include "sort.inl"
 #include "stablesort.inl"
+#include "find.inl"
+#include "merge.inl"
+#include "nth_element.inl"
 
 namespace details {
 
@@ -48,9 +53,7 @@ void generate_impl(ForwardIterator first, ForwardIterator last,
   // FIXME: [[hc]] will cause g() having ambient context,
   //        use restrict(amp) temporarily
   using _Ty = typename std::iterator_traits<ForwardIterator>::value_type;
-  auto first_ = utils::get_pointer(first);
-  hc::array_view<_Ty> av(hc::extent<1>(N), first_);
-  av.discard_data();
+  auto av = utils::get_output_view<_Ty>(first, N);
   kernel_launch(N, [av, g](hc::index<1> idx) restrict(amp) {
     av(idx) = g();
   });
@@ -77,8 +80,7 @@ void for_each_impl(InputIterator first, InputIterator last,
   }
 
   using _Ty = typename std::iterator_traits<InputIterator>::value_type;
-  auto first_ = utils::get_pointer(first);
-  hc::array_view<_Ty> av(hc::extent<1>(N), first_);
+  auto av = utils::get_view<_Ty>(first, N);
   kernel_launch(N, [av, f](hc::index<1> idx) [[hc]] {
     f(av(idx));
   });
@@ -105,8 +107,7 @@ void replace_if_impl(ForwardIterator first, ForwardIterator last,
   }
 
   using _Ty = typename std::iterator_traits<ForwardIterator>::value_type;
-  auto first_ = utils::get_pointer(first);
-  hc::array_view<_Ty> av(hc::extent<1>(N), first_);
+  auto av = utils::get_view<_Ty>(first, N);
   kernel_launch(N, [av, f, new_value](hc::index<1> idx) [[hc]] {
     if (f(av(idx)))
       av(idx) = new_value;
@@ -140,11 +141,8 @@ OutputIterator replace_copy_if_impl(InputIterator first, InputIterator last,
   if (N >= 0) {
     using _Ty = typename std::iterator_traits<InputIterator>::value_type;
     using _Td = typename std::iterator_traits<OutputIterator>::value_type;
-    auto first_ = utils::get_pointer(first);
-    auto d_first_ = utils::get_pointer(d_first);
-    hc::array_view<const _Ty> av(hc::extent<1>(N), first_);
-    hc::array_view<_Td> dv(hc::extent<1>(N), d_first_);
-    dv.discard_data();
+    auto av = utils::get_view<const _Ty>(first, N);
+    auto dv = utils::get_output_view<_Td>(d_first, N);
     kernel_launch(N, [av, dv, f, new_value](hc::index<1> idx) [[hc]] {
       _Ty p = av(idx);
       dv(idx) = f(p) ? new_value : p;
@@ -178,11 +176,8 @@ OutputIterator adjacent_difference_impl(InputIterator first, InputIterator last,
   if (N >= 0) {
     using _Ty = typename std::iterator_traits<InputIterator>::value_type;
     using _Td = typename std::iterator_traits<OutputIterator>::value_type;
-    auto first_ = utils::get_pointer(first);
-    auto d_first_ = utils::get_pointer(d_first);
-    hc::array_view<const _Ty> av(hc::extent<1>(N), first_);
-    hc::array_view<_Td> dv(hc::extent<1>(N), d_first_);
-    dv.discard_data();
+    auto av = utils::get_view<const _Ty>(first, N);
+    auto dv = utils::get_output_view<_Td>(d_first, N);
     kernel_launch(N, [av, dv, f](hc::index<1> idx) [[hc]] {
       dv(idx) = idx[0] != 0 ? f(av(idx), av(idx[0] - 1)) : av(idx);
     });
@@ -212,10 +207,8 @@ OutputIterator swap_ranges_impl(InputIterator first, InputIterator last,
   if (N >= 0) {
     using _Ty = typename std::iterator_traits<InputIterator>::value_type;
     using _Td = typename std::iterator_traits<OutputIterator>::value_type;
-    auto first_ = utils::get_pointer(first);
-    auto d_first_ = utils::get_pointer(d_first);
-    hc::array_view<_Ty> av(hc::extent<1>(N), first_);
-    hc::array_view<_Td> dv(hc::extent<1>(N), d_first_);
+    auto av = utils::get_view<_Ty>(first, N);
+    auto dv = utils::get_view<_Td>(d_first, N);
     kernel_launch(N, [av, dv](hc::index<1> idx) [[hc]] {
       std::swap(av(idx), dv(idx));
     });
@@ -21,195 +21,6 @@ namespace experimental {
 namespace parallel {
 inline namespace v1 {
 
-/**
- * Parallel version of std::mismatch in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename InputIt1, typename InputIt2>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, std::pair<InputIt1, InputIt2>>::type
-mismatch(ExecutionPolicy&& exec,
-         InputIt1 first1, InputIt1 last1,
-         InputIt2 first2) {
-    return std::mismatch(first1, last1, first2);
-}
-
-template <typename ExecutionPolicy, typename InputIt1, typename InputIt2, typename BinaryPredicate>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, std::pair<InputIt1, InputIt2>>::type
-mismatch(ExecutionPolicy&& exec,
-         InputIt1 first1, InputIt1 last1,
-         InputIt2 first2,
-         BinaryPredicate p) {
-    return std::mismatch(first1, last1, first2, p);
-}
-/**@}*/
-
-
-/**
- * Parallel version of std::find in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- */
-template <typename ExecutionPolicy, typename InputIt, typename T>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, InputIt>::type
-find(ExecutionPolicy&& exec,
-     InputIt first, InputIt last,
-     const T& value) {
-    return std::find(first, last, value);
-}
-
-
-/**
- * Parallel version of std::find_if in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- */
-template <typename ExecutionPolicy, typename InputIt, typename UnaryPredicate>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, InputIt>::type
-find_if(ExecutionPolicy&& exec,
-        InputIt first, InputIt last,
-        UnaryPredicate p) {
-    return std::find_if(first, last, p);
-}
-
-
-/**
- * Parallel version of std::find_if_not in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- */
-template <typename ExecutionPolicy, typename InputIt, typename UnaryPredicate>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, InputIt>::type
-find_if_not(ExecutionPolicy&& exec,
-            InputIt first, InputIt last,
-            UnaryPredicate p) {
-    return std::find_if_not(first, last, p);
-}
-
-
-/**
- * Parallel version of std::find_end in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename ForwardIt1, typename ForwardIt2>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, ForwardIt1>::type
-find_end(ExecutionPolicy&& exec,
-         ForwardIt1 first, ForwardIt1 last,
-         ForwardIt2 s_first, ForwardIt2 s_last) {
-    return std::find_end(first, last, s_first, s_last);
-}
-
-template <typename ExecutionPolicy, typename ForwardIt1, typename ForwardIt2, typename BinaryPredicate>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, ForwardIt1>::type
-find_end(ExecutionPolicy&& exec,
-         ForwardIt1 first, ForwardIt1 last,
-         ForwardIt2 s_first, ForwardIt2 s_last,
-         BinaryPredicate p) {
-    return std::find_end(first, last, s_first, s_last, p);
-}
-/**@}*/
-
-
-/**
- * Parallel version of std::find_first_of in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename InputIt, typename ForwardIt>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, InputIt>::type
-find_first_of(ExecutionPolicy&& exec,
-              InputIt first, InputIt last,
-              ForwardIt s_first, ForwardIt s_last) {
-    return std::find_first_of(first, last, s_first, s_last);
-}
-
-template <typename ExecutionPolicy, typename InputIt, typename ForwardIt, typename BinaryPredicate>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, InputIt>::type
-find_first_of(ExecutionPolicy&& exec,
-              InputIt first, InputIt last,
-              ForwardIt s_first, ForwardIt s_last,
-              BinaryPredicate p) {
-    return std::find_first_of(first, last, s_first, s_last, p);
-}
-/**@}*/
-
-
-/**
- * Parallel version of std::adjacent_find in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename ForwardIt>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, ForwardIt>::type
-adjacent_find(ExecutionPolicy&& exec,
-              ForwardIt first, ForwardIt last) {
-    return std::adjacent_find(first, last);
-}
-
-template <typename ExecutionPolicy, typename ForwardIt, typename BinaryPredicate>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, ForwardIt>::type
-adjacent_find(ExecutionPolicy&& exec,
-              ForwardIt first, ForwardIt last,
-              BinaryPredicate p) {
-    return std::adjacent_find(first, last, p);
-}
-/**@}*/
-
-
-/**
- * Parallel version of std::search in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename ForwardIt1, typename ForwardIt2>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, ForwardIt1>::type
-search(ExecutionPolicy&& exec,
-       ForwardIt1 first, ForwardIt1 last,
-       ForwardIt2 s_first, ForwardIt2 s_last) {
-    return std::search(first, last, s_first, s_last);
-}
-
-template <typename ExecutionPolicy, typename ForwardIt1, typename ForwardIt2, typename BinaryPredicate>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, ForwardIt1>::type
-search(ExecutionPolicy&& exec,
-       ForwardIt1 first, ForwardIt1 last,
-       ForwardIt2 s_first, ForwardIt2 s_last,
-       BinaryPredicate p) {
-    return std::search(first, last, s_first, s_last, p);
-}
-/**@}*/
-
-
-/**
- * Parallel version of std::search_n in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename ForwardIt, typename Size, typename T>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, ForwardIt>::type
-search_n(ExecutionPolicy&& exec,
-         ForwardIt first, ForwardIt last, Size count, const T& value) {
-    return std::search_n(first, last, count, value);
-}
-
-template <typename ExecutionPolicy, typename ForwardIt, typename Size, typename T, typename BinaryPredicate>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, ForwardIt>::type
-search_n(ExecutionPolicy&& exec,
-         ForwardIt first, ForwardIt last,
-         Size count, const T& value,
-         BinaryPredicate p) {
-    return std::search_n(first, last, count, value, p);
-}
-/**@}*/
-
-
 /**
  * Parallel version of std::copy_if in <algorithm>
  *
@@ -505,29 +316,6 @@ is_sorted_until(ExecutionPolicy&& exec,
 
 
 
-/**
- * Parallel version of std::partial_sort in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename RandomIt>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, void>::type
-partial_sort(ExecutionPolicy&& exec,
-             RandomIt first, RandomIt middle, RandomIt last) {
-    return std::partial_sort(first, middle, last);
-}
-
-template <typename ExecutionPolicy, typename RandomIt, typename Compare>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, void>::type
-partial_sort(ExecutionPolicy&& exec,
-             RandomIt first, RandomIt middle, RandomIt last,
-             Compare comp) {
-    return std::partial_sort(first, middle, last, comp);
-}
-/**@}*/
-
-
 /**
  * Parallel version of std::partial_sort_copy in <algorithm>
  *
@@ -553,78 +341,6 @@ partial_sort_copy(ExecutionPolicy&& exec,
 /**@}*/
 
 
-/**
- * Parallel version of std::nth_element in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename RandomIt>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, void>::type
-nth_element(ExecutionPolicy&& exec,
-            RandomIt first, RandomIt nth, RandomIt last) {
-    return std::nth_element(first, nth, last);
-}
-
-template <typename ExecutionPolicy, typename RandomIt, typename Compare>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, void>::type
-nth_element(ExecutionPolicy&& exec,
-            RandomIt first, RandomIt nth, RandomIt last,
-            Compare comp) {
-    return std::nth_element(first, nth, last, comp);
-}
-/**@}*/
-
-
-/**
- * Parallel version of std::merge in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename InputIt1, typename InputIt2, typename OutputIt>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, OutputIt>::type
-merge(ExecutionPolicy&& exec,
-      InputIt1 first1, InputIt1 last1,
-      InputIt2 first2, InputIt2 last2,
-      OutputIt d_first) {
-    return std::merge(first1, last1, first2, last2, d_first);
-}
-
-template <typename ExecutionPolicy, typename InputIt1, typename InputIt2, typename OutputIt, typename Compare>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, OutputIt>::type
-merge(ExecutionPolicy&& exec,
-      InputIt1 first1, InputIt1 last1,
-      InputIt2 first2, InputIt2 last2,
-      OutputIt d_first, Compare comp) {
-    return std::merge(first1, last1, first2, last2, d_first, comp);
-}
-/**@}*/
-
-
-
-/**
- * Parallel version of std::inplace_merge in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename BidirIt>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, void>::type
-inplace_merge(ExecutionPolicy&& exec,
-              BidirIt first, BidirIt middle, BidirIt last) {
-    return std::inplace_merge(first, middle, last);
-}
-
-template <typename ExecutionPolicy, typename BidirIt, typename Compare>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, void>::type
-inplace_merge(ExecutionPolicy&& exec,
-              BidirIt first, BidirIt middle, BidirIt last, Compare comp) {
-    return std::inplace_merge(first, middle, last, comp);
-}
-/**@}*/
-
-
 /**
  * Parallel version of std::includes in <algorithm>
  *
@@ -650,113 +366,6 @@ includes(ExecutionPolicy&& exec,
 /**@}*/
 
 
-/**
- * Parallel version of std::set_difference in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename InputIt1, typename InputIt2, typename OutputIt>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, OutputIt>::type
-set_difference(ExecutionPolicy&& exec,
-               InputIt1 first1, InputIt1 last1,
-               InputIt2 first2, InputIt2 last2,
-               OutputIt d_first) {
-    return std::set_difference(first1, last1, first2, last2, d_first);
-}
-
-template <typename ExecutionPolicy, typename InputIt1, typename InputIt2, typename OutputIt, typename Compare>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, OutputIt>::type
-set_difference(ExecutionPolicy&& exec,
-               InputIt1 first1, InputIt1 last1,
-               InputIt2 first2, InputIt2 last2,
-               OutputIt d_first,
-               Compare comp) {
-    return std::set_difference(first1, last2, first2, last2, d_first, comp);
-}
-/**@}*/
-
-
-/**
- * Parallel version of std::set_intersection in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename InputIt1, typename InputIt2, typename OutputIt>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, OutputIt>::type
-set_intersection(ExecutionPolicy&& exec,
-                 InputIt1 first1, InputIt1 last1,
-                 InputIt2 first2, InputIt2 last2,
-                 OutputIt d_first) {
-    return std::set_intersection(first1, last1, first2, last2, d_first);
-}
-
-template <typename ExecutionPolicy, typename InputIt1, typename InputIt2, typename OutputIt, typename Compare>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, OutputIt>::type
-set_intersection(ExecutionPolicy&& exec,
-                 InputIt1 first1, InputIt1 last1,
-                 InputIt2 first2, InputIt2 last2,
-                 OutputIt d_first, Compare comp) {
-    return std::set_intersection(first1, last1, first2, last2, d_first, comp);
-}
-/**@}*/
-
-
-/**
- * Parallel version of std::set_symmetric_difference in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename InputIt1, typename InputIt2, typename OutputIt>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, OutputIt>::type
-set_symmetric_difference(ExecutionPolicy&& exec,
-                         InputIt1 first1, InputIt1 last1,
-                         InputIt2 first2, InputIt2 last2,
-                         OutputIt d_first) {
-    return std::set_symmetric_difference(first1, last1, first2, last2, d_first);
-}
-
-template <typename ExecutionPolicy, typename InputIt1, typename InputIt2, typename OutputIt, typename Compare>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, OutputIt>::type
-set_symmetric_difference(ExecutionPolicy&& exec,
-                         InputIt1 first1, InputIt1 last1,
-                         InputIt2 first2, InputIt2 last2,
-                         OutputIt d_first,
-                         Compare comp) {
-    return std::set_symmetric_difference(first1, last1, first2, last2, d_first, comp);
-}
-/**@}*/
-
-
-/**
- * Parallel version of std::set_union in <algorithm>
- *
- * FIXME: this algorithm is implemented sequentially currently
- * @{
- */
-template <typename ExecutionPolicy, typename InputIt1, typename InputIt2, typename OutputIt>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, OutputIt>::type
-set_union(ExecutionPolicy&& exec,
-          InputIt1 first1, InputIt1 last1,
-          InputIt2 first2, InputIt2 last2,
-          OutputIt d_first) {
-    return std::set_union(first1, last1, first2, last2, d_first);
-}
-
-template <typename ExecutionPolicy, typename InputIt1, typename InputIt2, typename OutputIt, typename Compare>
-typename std::enable_if<is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value, OutputIt>::type
-set_union(ExecutionPolicy&& exec,
-          InputIt1 first1, InputIt1 last1,
-          InputIt2 first2, InputIt2 last2,
-          OutputIt d_first,
-          Compare comp) {
-    return std::set_union(first1, last1, first2, last2, d_first, comp);
-}
-/**@}*/
-
-
 /**
  * Parallel version of std::is_heap in <algorithm>
  *
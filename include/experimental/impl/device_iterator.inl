@@ -0,0 +1,129 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+/**
+ * A random access iterator over a rank-1 hc::array_view.
+ *
+ * Parallel algorithms given a device_iterator run directly on the storage
+ * behind the view instead of wrapping host memory into a temporary
+ * array_view. When the view refers to an hc::array or to memory obtained
+ * from hc::am_alloc, the data stays on the accelerator between algorithm
+ * calls, so a chain of algorithms does not copy its intermediates back to
+ * the host.
+ *
+ * Dereferencing a device_iterator on the host is allowed (it is what the
+ * sequential fallbacks do), but it synchronizes the view to the host.
+ */
+template<typename T>
+class device_iterator {
+public:
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef typename std::remove_const<T>::type value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef T* pointer;
+  typedef T& reference;
+
+  explicit device_iterator(const hc::array_view<T, 1>& av,
+                           difference_type pos = 0)
+    : av_(av), pos_(pos) {}
+
+  reference operator*() const { return av_[static_cast<int>(pos_)]; }
+  pointer operator->() const { return &**this; }
+  reference operator[](difference_type n) const {
+    return av_[static_cast<int>(pos_ + n)];
+  }
+
+  device_iterator& operator++() { ++pos_; return *this; }
+  device_iterator& operator--() { --pos_; return *this; }
+  device_iterator operator++(int) { device_iterator t(*this); ++pos_; return t; }
+  device_iterator operator--(int) { device_iterator t(*this); --pos_; return t; }
+  device_iterator& operator+=(difference_type n) { pos_ += n; return *this; }
+  device_iterator& operator-=(difference_type n) { pos_ -= n; return *this; }
+
+  device_iterator operator+(difference_type n) const {
+    return device_iterator(av_, pos_ + n);
+  }
+  device_iterator operator-(difference_type n) const {
+    return device_iterator(av_, pos_ - n);
+  }
+  friend device_iterator operator+(difference_type n, const device_iterator& it) {
+    return it + n;
+  }
+  difference_type operator-(const device_iterator& other) const {
+    return pos_ - other.pos_;
+  }
+
+  bool operator==(const device_iterator& other) const { return pos_ == other.pos_; }
+  bool operator!=(const device_iterator& other) const { return pos_ != other.pos_; }
+  bool operator< (const device_iterator& other) const { return pos_ <  other.pos_; }
+  bool operator> (const device_iterator& other) const { return pos_ >  other.pos_; }
+  bool operator<=(const device_iterator& other) const { return pos_ <= other.pos_; }
+  bool operator>=(const device_iterator& other) const { return pos_ >= other.pos_; }
+
+  /**
+   * Returns the section [*this, *this + n) of the underlying array_view.
+   * Used by the algorithms to obtain the data to capture in a kernel.
+   */
+  hc::array_view<T, 1> get_view(size_t n) const {
+    return av_.section(static_cast<int>(pos_), static_cast<int>(n));
+  }
+
+private:
+  hc::array_view<T, 1> av_;
+  difference_type pos_;
+};
+
+/**
+ * Iterators over an hc::array_view of rank 1.
+ * @{
+ */
+template<typename T>
+device_iterator<T> device_begin(const hc::array_view<T, 1>& av) {
+  return device_iterator<T>(av);
+}
+
+template<typename T>
+device_iterator<T> device_end(const hc::array_view<T, 1>& av) {
+  return device_iterator<T>(av, av.get_extent().size());
+}
+/**@}*/
+
+/**
+ * Iterators over an hc::array of rank 1. The array must outlive the
+ * iterators.
+ * @{
+ */
+template<typename T>
+device_iterator<T> device_begin(hc::array<T, 1>& arr) {
+  return device_iterator<T>(hc::array_view<T, 1>(arr));
+}
+
+template<typename T>
+device_iterator<T> device_end(hc::array<T, 1>& arr) {
+  return device_iterator<T>(hc::array_view<T, 1>(arr), arr.get_extent().size());
+}
+/**@}*/
+
+/**
+ * Iterator over N elements of device memory, e.g. a pointer returned by
+ * hc::am_alloc. The memory is neither copied nor released; it must stay
+ * allocated while the iterator is in use. The end of the range is
+ * device_begin(ptr, N, av) + N.
+ *
+ * @param[in] ptr Device pointer to the first element.
+ * @param[in] N Number of elements.
+ * @param[in] av The accelerator_view owning the memory.
+ */
+template<typename T>
+device_iterator<T> device_begin(T* ptr, size_t N,
+                                const hc::accelerator_view& av =
+                                  hc::accelerator().get_default_view()) {
+  hc::array<T, 1> arr(hc::extent<1>(N), av, ptr);
+  return device_iterator<T>(hc::array_view<T, 1>(arr));
+}
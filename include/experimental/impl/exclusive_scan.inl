@@ -78,6 +78,7 @@ exclusive_scan(ExecutionPolicy&& exec,
                OutputIterator result,
                T init, BinaryOperation binary_op) {
   if (utils::isParallel(exec)) {
+    details::launch_scope scope(exec);
     return exclusive_scan(first, last, result, init, binary_op);
   } else {
     return details::exclusive_scan_impl(first, last, result, init, binary_op,
@@ -0,0 +1,390 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+/**
+ * Searching algorithms
+ *
+ * find, find_if, find_if_not, find_end, find_first_of, adjacent_find,
+ * search, search_n and mismatch all reduce to the same problem: the
+ * smallest position i in [0, N) at which a test succeeds. It is computed by
+ * find_index_impl:
+ *
+ *  - the positions are visited in windows of growing size, starting at
+ *    FIND_FIRST_WINDOW and multiplied by FIND_WINDOW_GROWTH each time, one
+ *    kernel per window; no further window is launched once a match is
+ *    known, so a hit near the beginning costs little more than a single
+ *    small kernel
+ *  - inside a window every tile scans blocks of FIND_BLOCK_SIZE positions,
+ *    and a match is recorded with an atomic minimum; before starting a
+ *    block a tile reads the current minimum and stops if it lies before
+ *    the block, so blocks beyond a known hit skip their work
+ *
+ * find_end looks for the largest position instead, which is the smallest
+ * one with the positions reversed.
+ */
+
+namespace utils {
+// functors captured by a kernel are copied to the device bytewise, the
+// search, merge, set and selection algorithms fall back to the sequential
+// version for functors which do not allow it (e.g. lambdas capturing a
+// std::vector)
+template<class... F>
+struct isKernelCopyable : std::true_type {};
+
+template<class F, class... Rest>
+struct isKernelCopyable<F, Rest...>
+  : std::integral_constant<bool, std::is_trivially_copyable<F>::value &&
+                                 isKernelCopyable<Rest...>::value> {};
+
+// iterator category used to dispatch the search algorithms
+template<class It, class... F>
+using search_tag = typename std::conditional<isKernelCopyable<F...>::value,
+                                             tag<It>,
+                                             std::input_iterator_tag>::type;
+
+// same, for the algorithms dispatched on a tag of their own
+template<class Tag, class... F>
+using functor_tag = typename std::conditional<isKernelCopyable<F...>::value,
+                                              Tag,
+                                              std::input_iterator_tag>::type;
+} // namespace utils
+
+namespace details {
+
+#define FIND_TILE_SIZE 256
+#define FIND_BLOCK_SIZE (FIND_TILE_SIZE * 8)
+#define FIND_MAX_TILES 1024
+#define FIND_FIRST_WINDOW (1 << 16)
+#define FIND_WINDOW_GROWTH 4
+
+// a == b for operands of possibly different types, used by the overloads
+// without a predicate
+struct equal_to_any {
+  template<typename T1, typename T2>
+  bool operator()(const T1& a, const T2& b) const __CPU__ __HC__ {
+    return a == b;
+  }
+};
+
+// smallest i in [0, N) for which test(i) is true, N if there is none
+template<typename Test>
+int find_index_impl(const int N, Test test) {
+  int found = N;
+  hc::array_view<int> found_(hc::extent<1>(1), &found);
+
+  int window = FIND_FIRST_WINDOW;
+  for (int start = 0; start < N; ) {
+    const int end = (N - start > window) ? start + window : N;
+    const int blocks = (end - start + FIND_BLOCK_SIZE - 1) / FIND_BLOCK_SIZE;
+    const int numTiles = blocks < FIND_MAX_TILES ? blocks : FIND_MAX_TILES;
+
+    kernel_launch(numTiles * FIND_TILE_SIZE,
+                  [ test, found_, start, end, blocks, numTiles ]
+                  ( hc::tiled_index<1> t_idx ) [[hc]]
+                  {
+                    tile_static int cut;
+                    int l = t_idx.local[0];
+
+                    for (int b = t_idx.tile[0]; b < blocks; b += numTiles) {
+                      int bbegin = start + b * FIND_BLOCK_SIZE;
+                      int bend = bbegin + FIND_BLOCK_SIZE < end ? bbegin + FIND_BLOCK_SIZE : end;
+
+                      if (l == 0)
+                        cut = found_[0];
+                      t_idx.barrier.wait();
+                      // the blocks left to this tile are all beyond a hit
+                      if (cut < bbegin)
+                        break;
+
+                      for (int i = bbegin + l; i < bend; i += FIND_TILE_SIZE) {
+                        if (test(i)) {
+                          hc::atomic_fetch_min(&found_[0], i);
+                          break;
+                        }
+                      }
+                      t_idx.barrier.wait();
+                    }
+                  }, FIND_TILE_SIZE);
+
+    found_.synchronize();
+    if (found < N)
+      break;
+    // the next window starts where this one ended, and only then grows
+    start = end;
+    window = (window < N / FIND_WINDOW_GROWTH) ? window * FIND_WINDOW_GROWTH : N;
+  }
+  return found;
+}
+
+// largest i in [0, N) for which test(i) is true, N if there is none
+template<typename Test>
+int find_last_index_impl(const int N, Test test) {
+  int found = find_index_impl(N, [test, N](int i) [[hc]] { return test(N - 1 - i); });
+  return found == N ? N : N - 1 - found;
+}
+
+// find_if
+// std::find_if forwarder
+template<typename InputIt, typename UnaryPredicate>
+InputIt find_if_impl(InputIt first, InputIt last,
+                     UnaryPredicate p,
+                     std::input_iterator_tag) {
+  return std::find_if(first, last, p);
+}
+
+// parallel::find_if
+template<typename InputIt, typename UnaryPredicate>
+InputIt find_if_impl(InputIt first, InputIt last,
+                     UnaryPredicate p,
+                     std::random_access_iterator_tag) {
+  const size_t N = static_cast<size_t>(std::distance(first, last));
+  if (N <= details::PARALLELIZE_THRESHOLD) {
+    return find_if_impl(first, last, p, std::input_iterator_tag{});
+  }
+
+  typedef typename std::iterator_traits<InputIt>::value_type _Tp;
+  auto first_ = utils::get_view<const _Tp>(first, N);
+  int i = find_index_impl(N, [first_, p](int i) [[hc]] {
+    return p(first_[i]) ? true : false;
+  });
+  return first + i;
+}
+
+// mismatch
+// std::mismatch forwarder
+template<typename InputIt1, typename InputIt2, typename BinaryPredicate>
+std::pair<InputIt1, InputIt2>
+mismatch_impl(InputIt1 first1, InputIt1 last1,
+              InputIt2 first2,
+              BinaryPredicate p,
+              std::input_iterator_tag) {
+  return std::mismatch(first1, last1, first2, p);
+}
+
+// parallel::mismatch
+template<typename InputIt1, typename InputIt2, typename BinaryPredicate>
+std::pair<InputIt1, InputIt2>
+mismatch_impl(InputIt1 first1, InputIt1 last1,
+              InputIt2 first2,
+              BinaryPredicate p,
+              std::random_access_iterator_tag) {
+  const size_t N = static_cast<size_t>(std::distance(first1, last1));
+  if (N <= details::PARALLELIZE_THRESHOLD) {
+    return mismatch_impl(first1, last1, first2, p, std::input_iterator_tag{});
+  }
+
+  typedef typename std::iterator_traits<InputIt1>::value_type _Tp1;
+  typedef typename std::iterator_traits<InputIt2>::value_type _Tp2;
+  auto first1_ = utils::get_view<const _Tp1>(first1, N);
+  auto first2_ = utils::get_view<const _Tp2>(first2, N);
+  int i = find_index_impl(N, [first1_, first2_, p](int i) [[hc]] {
+    return p(first1_[i], first2_[i]) ? false : true;
+  });
+  return { first1 + i, first2 + i };
+}
+
+// adjacent_find
+// std::adjacent_find forwarder
+template<typename ForwardIt, typename BinaryPredicate>
+ForwardIt adjacent_find_impl(ForwardIt first, ForwardIt last,
+                             BinaryPredicate p,
+                             std::input_iterator_tag) {
+  return std::adjacent_find(first, last, p);
+}
+
+// parallel::adjacent_find
+template<typename ForwardIt, typename BinaryPredicate>
+ForwardIt adjacent_find_impl(ForwardIt first, ForwardIt last,
+                             BinaryPredicate p,
+                             std::random_access_iterator_tag) {
+  const size_t N = static_cast<size_t>(std::distance(first, last));
+  if (N <= details::PARALLELIZE_THRESHOLD) {
+    return adjacent_find_impl(first, last, p, std::input_iterator_tag{});
+  }
+
+  typedef typename std::iterator_traits<ForwardIt>::value_type _Tp;
+  auto first_ = utils::get_view<const _Tp>(first, N);
+  int i = find_index_impl(N - 1, [first_, p](int i) [[hc]] {
+    return p(first_[i], first_[i + 1]) ? true : false;
+  });
+  return (i == N - 1) ? last : first + i;
+}
+
+// find_first_of
+// std::find_first_of forwarder
+template<typename InputIt, typename ForwardIt, typename BinaryPredicate>
+InputIt find_first_of_impl(InputIt first, InputIt last,
+                           ForwardIt s_first, ForwardIt s_last,
+                           BinaryPredicate p,
+                           std::input_iterator_tag) {
+  return std::find_first_of(first, last, s_first, s_last, p);
+}
+
+// parallel::find_first_of
+//
+// the candidates [s_first, s_last) are copied to a temporary first, so
+// they can come from any forward iterator
+template<typename InputIt, typename ForwardIt, typename BinaryPredicate>
+InputIt find_first_of_impl(InputIt first, InputIt last,
+                           ForwardIt s_first, ForwardIt s_last,
+                           BinaryPredicate p,
+                           std::random_access_iterator_tag) {
+  const size_t N = static_cast<size_t>(std::distance(first, last));
+  if (N <= details::PARALLELIZE_THRESHOLD || s_first == s_last) {
+    return find_first_of_impl(first, last, s_first, s_last, p,
+             std::input_iterator_tag{});
+  }
+
+  typedef typename std::iterator_traits<InputIt>::value_type _Tp;
+  typedef typename std::iterator_traits<ForwardIt>::value_type _Ts;
+  std::vector<_Ts> s(s_first, s_last);
+  const int M = static_cast<int>(s.size());
+  auto first_ = utils::get_view<const _Tp>(first, N);
+  hc::array_view<const _Ts> s_(hc::extent<1>(M), s);
+  int i = find_index_impl(N, [first_, s_, M, p](int i) [[hc]] {
+    for (int j = 0; j < M; ++j) {
+      if (p(first_[i], s_[j]))
+        return true;
+    }
+    return false;
+  });
+  return first + i;
+}
+
+// search and find_end
+// std::search forwarder
+template<typename ForwardIt1, typename ForwardIt2, typename BinaryPredicate>
+ForwardIt1 search_impl(ForwardIt1 first, ForwardIt1 last,
+                       ForwardIt2 s_first, ForwardIt2 s_last,
+                       BinaryPredicate p,
+                       std::input_iterator_tag) {
+  return std::search(first, last, s_first, s_last, p);
+}
+
+// parallel::search
+template<typename ForwardIt1, typename ForwardIt2, typename BinaryPredicate>
+ForwardIt1 search_impl(ForwardIt1 first, ForwardIt1 last,
+                       ForwardIt2 s_first, ForwardIt2 s_last,
+                       BinaryPredicate p,
+                       std::random_access_iterator_tag) {
+  const size_t N = static_cast<size_t>(std::distance(first, last));
+  const size_t M = static_cast<size_t>(std::distance(s_first, s_last));
+  if (M == 0 || M > N) {
+    return (M == 0) ? first : last;
+  }
+  // number of positions the pattern can start at
+  const size_t P = N - M + 1;
+  if (P <= details::PARALLELIZE_THRESHOLD) {
+    return search_impl(first, last, s_first, s_last, p,
+             std::input_iterator_tag{});
+  }
+
+  typedef typename std::iterator_traits<ForwardIt1>::value_type _Tp;
+  typedef typename std::iterator_traits<ForwardIt2>::value_type _Ts;
+  std::vector<_Ts> s(s_first, s_last);
+  const int M_ = static_cast<int>(M);
+  auto first_ = utils::get_view<const _Tp>(first, N);
+  hc::array_view<const _Ts> s_(hc::extent<1>(M_), s);
+  int i = find_index_impl(P, [first_, s_, M_, p](int i) [[hc]] {
+    for (int j = 0; j < M_; ++j) {
+      if (!p(first_[i + j], s_[j]))
+        return false;
+    }
+    return true;
+  });
+  return (i == static_cast<int>(P)) ? last : first + i;
+}
+
+// std::find_end forwarder
+template<typename ForwardIt1, typename ForwardIt2, typename BinaryPredicate>
+ForwardIt1 find_end_impl(ForwardIt1 first, ForwardIt1 last,
+                         ForwardIt2 s_first, ForwardIt2 s_last,
+                         BinaryPredicate p,
+                         std::input_iterator_tag) {
+  return std::find_end(first, last, s_first, s_last, p);
+}
+
+// parallel::find_end
+template<typename ForwardIt1, typename ForwardIt2, typename BinaryPredicate>
+ForwardIt1 find_end_impl(ForwardIt1 first, ForwardIt1 last,
+                         ForwardIt2 s_first, ForwardIt2 s_last,
+                         BinaryPredicate p,
+                         std::random_access_iterator_tag) {
+  const size_t N = static_cast<size_t>(std::distance(first, last));
+  const size_t M = static_cast<size_t>(std::distance(s_first, s_last));
+  if (M == 0 || M > N) {
+    return last;
+  }
+  const size_t P = N - M + 1;
+  if (P <= details::PARALLELIZE_THRESHOLD) {
+    return find_end_impl(first, last, s_first, s_last, p,
+             std::input_iterator_tag{});
+  }
+
+  typedef typename std::iterator_traits<ForwardIt1>::value_type _Tp;
+  typedef typename std::iterator_traits<ForwardIt2>::value_type _Ts;
+  std::vector<_Ts> s(s_first, s_last);
+  const int M_ = static_cast<int>(M);
+  auto first_ = utils::get_view<const _Tp>(first, N);
+  hc::array_view<const _Ts> s_(hc::extent<1>(M_), s);
+  int i = find_last_index_impl(P, [first_, s_, M_, p](int i) [[hc]] {
+    for (int j = 0; j < M_; ++j) {
+      if (!p(first_[i + j], s_[j]))
+        return false;
+    }
+    return true;
+  });
+  return (i == static_cast<int>(P)) ? last : first + i;
+}
+
+// search_n
+// std::search_n forwarder
+template<typename ForwardIt, typename Size, typename T, typename BinaryPredicate>
+ForwardIt search_n_impl(ForwardIt first, ForwardIt last,
+                        Size count, const T& value,
+                        BinaryPredicate p,
+                        std::input_iterator_tag) {
+  return std::search_n(first, last, count, value, p);
+}
+
+// parallel::search_n
+template<typename ForwardIt, typename Size, typename T, typename BinaryPredicate>
+ForwardIt search_n_impl(ForwardIt first, ForwardIt last,
+                        Size count, const T& value,
+                        BinaryPredicate p,
+                        std::random_access_iterator_tag) {
+  const size_t N = static_cast<size_t>(std::distance(first, last));
+  if (count <= 0) {
+    return first;
+  }
+  const size_t M = static_cast<size_t>(count);
+  if (M > N) {
+    return last;
+  }
+  const size_t P = N - M + 1;
+  if (P <= details::PARALLELIZE_THRESHOLD) {
+    return search_n_impl(first, last, count, value, p,
+             std::input_iterator_tag{});
+  }
+
+  typedef typename std::iterator_traits<ForwardIt>::value_type _Tp;
+  const int M_ = static_cast<int>(M);
+  const T value_ = value;
+  auto first_ = utils::get_view<const _Tp>(first, N);
+  int i = find_index_impl(P, [first_, value_, M_, p](int i) [[hc]] {
+    for (int j = 0; j < M_; ++j) {
+      if (!p(first_[i + j], value_))
+        return false;
+    }
+    return true;
+  });
+  return (i == static_cast<int>(P)) ? last : first + i;
+}
+
+} // namespace details
@@ -75,6 +75,7 @@ inclusive_scan(ExecutionPolicy&& exec,
                OutputIterator result,
                BinaryOperation binary_op, T init) {
   if (utils::isParallel(exec)) {
+    details::launch_scope scope(exec);
     return inclusive_scan(first, last, result, binary_op, init);
   } else {
     return details::inclusive_scan_impl(first, last, result, binary_op, init,
@@ -2,13 +2,83 @@
 
 namespace details {
 
+// where and how kernel_launch enqueues kernels
+//
+// set up by launch_scope for the duration of an algorithm call, so the
+// implementations do not have to carry the execution policy around
+struct launch_state {
+    // accelerator_view to launch on, the auto selected one if null
+    const hc::accelerator_view* av = nullptr;
+    // do not wait for kernels to complete
+    bool async = false;
+    // policy which collects the completion_future of launched kernels
+    const accelerator_view_execution_policy* policy = nullptr;
+};
+
+inline launch_state& current_launch() {
+    static thread_local launch_state state;
+    return state;
+}
+
+template<class ExecutionPolicy>
+inline void set_launch(launch_state&, const ExecutionPolicy&) {}
+
+// without on() there is no policy object to record the completion_future
+// in, the caller could neither wait for the kernels nor see their errors:
+// the algorithm waits for them, on the auto selected accelerator_view
+inline void set_launch(launch_state& state,
+                       const parallel_task_execution_policy&) {
+    state.av = nullptr;
+    state.async = false;
+    state.policy = nullptr;
+}
+
+inline void set_launch(launch_state& state,
+                       const accelerator_view_execution_policy& exec) {
+    state.av = &exec.get_accelerator_view();
+    state.async = exec.is_task();
+    state.policy = &exec;
+}
+
+// binds kernel_launch to the accelerator_view and mode of an execution
+// policy, restoring the previous binding on destruction so algorithms
+// calling other algorithms nest properly
+class launch_scope {
+public:
+    template<class ExecutionPolicy>
+    explicit launch_scope(const ExecutionPolicy& exec)
+        : saved(current_launch()) {
+        set_launch(current_launch(), exec);
+    }
+    ~launch_scope() { current_launch() = saved; }
+
+    launch_scope(const launch_scope&) = delete;
+    launch_scope& operator=(const launch_scope&) = delete;
+
+private:
+    launch_state saved;
+};
+
 // hc kernel invocation
 template<typename Kernel>
 inline void kernel_launch(int N, Kernel k, int tile = 0) {
+    const launch_state& state = current_launch();
+    hc::accelerator_view av = state.av ? *state.av
+                                       : hc::accelerator::get_auto_selection_view();
+    hc::completion_future cf;
     if (tile != 0) {
-        hc::parallel_for_each(hc::extent<1>(N).tile(tile), k).wait();
+        cf = hc::parallel_for_each(av, hc::extent<1>(N).tile(tile), k, 1);
+    } else {
+        cf = hc::parallel_for_each(av, hc::extent<1>(N), k, 1);
+    }
+
+    if (state.async) {
+        // kernels of one algorithm are ordered by the in-order queue, the
+        // last future therefore covers all of them
+        if (state.policy)
+            state.policy->set_future(cf);
     } else {
-        hc::parallel_for_each(hc::extent<1>(N), k).wait();
+        cf.wait();
     }
 }
 
@@ -0,0 +1,295 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+/**
+ * Merge and set operations
+ *
+ * Both are partitioned along the merge path: the merged sequence of two
+ * sorted ranges A and B is split into pieces of MERGE_ITEMS_PER_THREAD
+ * elements, and every work-item finds where its piece starts in A and B by
+ * a binary search on the diagonal k = i + j (merge_path_search). Each piece
+ * is then merged sequentially, so the total work stays linear.
+ *
+ * Set operations also walk the merged sequence, and decide for each
+ * element whether it is part of the result: the r-th copy of a value in A
+ * is matched with the r-th copy of the same value in B, the number of
+ * copies in the other range is found with the binary searches of
+ * stablesort.inl. Since the decision only depends on the element, the
+ * pieces are independent: a first kernel counts the elements every piece
+ * keeps, and a second one writes them at the offsets scanned on the host.
+ */
+
+namespace details {
+
+#define MERGE_ITEMS_PER_THREAD 16
+
+// set operation performed by set_op_impl
+enum set_op_kind {
+  SET_UNION,
+  SET_INTERSECTION,
+  SET_DIFFERENCE,
+  SET_SYMMETRIC_DIFFERENCE
+};
+
+// number of elements of A among the first k elements of the stable merge
+// of A and B, where equivalent elements of A come first
+template<typename ViewA, typename ViewB, typename Compare>
+int merge_path_search(const ViewA& a, int n1, const ViewB& b, int n2,
+                      int k, const Compare& comp) [[hc]] {
+  int lo = k > n2 ? k - n2 : 0;
+  int hi = k < n1 ? k : n1;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (comp(b[k - 1 - mid], a[mid]))
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return lo;
+}
+
+// merge
+
+// std::merge forwarder
+template<typename InputIt1, typename InputIt2,
+         typename OutputIt, typename Compare>
+OutputIt merge_impl(InputIt1 first1, InputIt1 last1,
+                    InputIt2 first2, InputIt2 last2,
+                    OutputIt d_first, Compare comp,
+                    std::input_iterator_tag) {
+  return std::merge(first1, last1, first2, last2, d_first, comp);
+}
+
+// merge the sorted views a and b into out, out must not overlap them
+template<typename ViewA, typename ViewB, typename ViewO, typename Compare>
+void merge_views(const ViewA& a, int n1, const ViewB& b, int n2,
+                 const ViewO& out, Compare comp) {
+  const int N = n1 + n2;
+  const int threads = (N + MERGE_ITEMS_PER_THREAD - 1) / MERGE_ITEMS_PER_THREAD;
+
+  kernel_launch(threads, [a, n1, b, n2, out, N, comp](hc::index<1> idx) [[hc]] {
+    int k = idx[0] * MERGE_ITEMS_PER_THREAD;
+    int k_end = k + MERGE_ITEMS_PER_THREAD < N ? k + MERGE_ITEMS_PER_THREAD : N;
+    int i = merge_path_search(a, n1, b, n2, k, comp);
+    int j = k - i;
+    for (; k < k_end; ++k) {
+      if (j >= n2 || (i < n1 && !comp(b[j], a[i])))
+        out[k] = a[i++];
+      else
+        out[k] = b[j++];
+    }
+  });
+}
+
+// parallel::merge
+template<typename InputIt1, typename InputIt2,
+         typename OutputIt, typename Compare>
+OutputIt merge_impl(InputIt1 first1, InputIt1 last1,
+                    InputIt2 first2, InputIt2 last2,
+                    OutputIt d_first, Compare comp,
+                    std::random_access_iterator_tag) {
+  const int n1 = static_cast<int>(std::distance(first1, last1));
+  const int n2 = static_cast<int>(std::distance(first2, last2));
+  if (n1 + n2 <= details::PARALLELIZE_THRESHOLD) {
+    return merge_impl(first1, last1, first2, last2, d_first, comp,
+             std::input_iterator_tag{});
+  }
+
+  typedef typename std::iterator_traits<InputIt1>::value_type _T1;
+  typedef typename std::iterator_traits<InputIt2>::value_type _T2;
+  typedef typename std::iterator_traits<OutputIt>::value_type _To;
+  auto first1_ = utils::get_view<const _T1>(first1, n1);
+  auto first2_ = utils::get_view<const _T2>(first2, n2);
+  auto d_first_ = utils::get_output_view<_To>(d_first, n1 + n2);
+  merge_views(first1_, n1, first2_, n2, d_first_, comp);
+  return d_first + (n1 + n2);
+}
+
+// inplace_merge
+// std::inplace_merge forwarder
+template<typename BidirIt, typename Compare>
+void inplace_merge_impl(BidirIt first, BidirIt middle, BidirIt last,
+                        Compare comp,
+                        std::input_iterator_tag) {
+  std::inplace_merge(first, middle, last, comp);
+}
+
+// parallel::inplace_merge
+//
+// merged into a temporary on the accelerator, then copied back
+template<typename BidirIt, typename Compare>
+void inplace_merge_impl(BidirIt first, BidirIt middle, BidirIt last,
+                        Compare comp,
+                        std::random_access_iterator_tag) {
+  const int n1 = static_cast<int>(std::distance(first, middle));
+  const int n2 = static_cast<int>(std::distance(middle, last));
+  const int N = n1 + n2;
+  if (N <= details::PARALLELIZE_THRESHOLD || n1 == 0 || n2 == 0) {
+    inplace_merge_impl(first, middle, last, comp, std::input_iterator_tag{});
+    return;
+  }
+
+  typedef typename std::iterator_traits<BidirIt>::value_type _Tp;
+  auto first_ = utils::get_view<_Tp>(first, N);
+  hc::array_view<_Tp> tmp((hc::extent<1>(N)));
+  merge_views(first_.section(0, n1), n1, first_.section(n1, n2), n2, tmp, comp);
+  kernel_launch(N, [first_, tmp](hc::index<1> idx) [[hc]] {
+    first_(idx) = tmp(idx);
+  });
+}
+
+// set_union, set_intersection, set_difference and set_symmetric_difference
+
+// element sinks for set_op_walk: the counting pass drops the elements,
+// the writing pass stores them after the offset of its piece
+struct set_op_discard {
+  template<typename T>
+  void operator()(int, const T&) const [[hc]] {}
+};
+
+template<typename ViewO>
+struct set_op_store {
+  ViewO out;
+  int offset;
+
+  template<typename T>
+  void operator()(int pos, const T& v) const [[hc]] { out[offset + pos] = v; }
+};
+
+// walk the piece [k, k_end) of the merged sequence, pass the elements the
+// set operation keeps to emit, and return how many are kept
+template<typename ViewA, typename ViewB, typename Compare, typename Emit>
+int set_op_walk(const ViewA& a, int n1, const ViewB& b, int n2,
+                int k, int k_end, int op, const Compare& comp,
+                const Emit& emit) [[hc]] {
+  int i = merge_path_search(a, n1, b, n2, k, comp);
+  int j = k - i;
+  int count = 0;
+
+  // rank of the current element among the equivalent elements of its own
+  // range, and number of equivalent elements in the other range; -1 until
+  // the first element of a range is seen in this piece
+  int ra = -1, na = 0;
+  int rb = -1, nb = 0;
+  bool keep_a_needs_count = (op != SET_UNION);
+  bool keep_b = (op == SET_UNION || op == SET_SYMMETRIC_DIFFERENCE);
+
+  for (; k < k_end; ++k) {
+    if (j >= n2 || (i < n1 && !comp(b[j], a[i]))) {
+      bool keep = true;
+      if (keep_a_needs_count) {
+        if (ra < 0 || comp(a[i - 1], a[i])) {
+          // first of a run, which may have started in a previous piece
+          ra = i - sort_lowerBoundBinary(a, 0, i, a[i], comp);
+          nb = sort_upperBoundBinary(b, 0, n2, a[i], comp) -
+               sort_lowerBoundBinary(b, 0, n2, a[i], comp);
+        } else {
+          ++ra;
+        }
+        keep = (op == SET_INTERSECTION) ? (ra < nb) : (ra >= nb);
+      }
+      if (keep)
+        emit(count++, a[i]);
+      ++i;
+    } else {
+      if (keep_b) {
+        if (rb < 0 || comp(b[j - 1], b[j])) {
+          rb = j - sort_lowerBoundBinary(b, 0, j, b[j], comp);
+          na = sort_upperBoundBinary(a, 0, n1, b[j], comp) -
+               sort_lowerBoundBinary(a, 0, n1, b[j], comp);
+        } else {
+          ++rb;
+        }
+        if (rb >= na)
+          emit(count++, b[j]);
+      }
+      ++j;
+    }
+  }
+  return count;
+}
+
+// std:: set operation forwarder
+template<typename InputIt1, typename InputIt2,
+         typename OutputIt, typename Compare>
+OutputIt set_op_impl(InputIt1 first1, InputIt1 last1,
+                     InputIt2 first2, InputIt2 last2,
+                     OutputIt d_first, Compare comp, int op,
+                     std::input_iterator_tag) {
+  switch (op) {
+  case SET_UNION:
+    return std::set_union(first1, last1, first2, last2, d_first, comp);
+  case SET_INTERSECTION:
+    return std::set_intersection(first1, last1, first2, last2, d_first, comp);
+  case SET_DIFFERENCE:
+    return std::set_difference(first1, last1, first2, last2, d_first, comp);
+  default:
+    return std::set_symmetric_difference(first1, last1, first2, last2, d_first, comp);
+  }
+}
+
+// parallel set operations
+template<typename InputIt1, typename InputIt2,
+         typename OutputIt, typename Compare>
+OutputIt set_op_impl(InputIt1 first1, InputIt1 last1,
+                     InputIt2 first2, InputIt2 last2,
+                     OutputIt d_first, Compare comp, int op,
+                     std::random_access_iterator_tag) {
+  const int n1 = static_cast<int>(std::distance(first1, last1));
+  const int n2 = static_cast<int>(std::distance(first2, last2));
+  const int N = n1 + n2;
+  if (N <= details::PARALLELIZE_THRESHOLD) {
+    return set_op_impl(first1, last1, first2, last2, d_first, comp, op,
+             std::input_iterator_tag{});
+  }
+
+  typedef typename std::iterator_traits<InputIt1>::value_type _T1;
+  typedef typename std::iterator_traits<InputIt2>::value_type _T2;
+  typedef typename std::iterator_traits<OutputIt>::value_type _To;
+  auto first1_ = utils::get_view<const _T1>(first1, n1);
+  auto first2_ = utils::get_view<const _T2>(first2, n2);
+
+  const int threads = (N + MERGE_ITEMS_PER_THREAD - 1) / MERGE_ITEMS_PER_THREAD;
+
+  // pass 1: number of elements kept by every piece
+  std::vector<int> counts(threads);
+  hc::array_view<int> counts_(hc::extent<1>(threads), counts);
+  counts_.discard_data();
+  kernel_launch(threads, [first1_, n1, first2_, n2, N, op, comp, counts_]
+                         (hc::index<1> idx) [[hc]] {
+    int k = idx[0] * MERGE_ITEMS_PER_THREAD;
+    int k_end = k + MERGE_ITEMS_PER_THREAD < N ? k + MERGE_ITEMS_PER_THREAD : N;
+    counts_(idx) = set_op_walk(first1_, n1, first2_, n2, k, k_end, op, comp,
+                               set_op_discard());
+  });
+  counts_.synchronize();
+
+  int total = 0;
+  for (int t = 0; t < threads; ++t) {
+    int c = counts[t];
+    counts[t] = total;
+    total += c;
+  }
+  if (total == 0)
+    return d_first;
+
+  // pass 2: write them at their offset
+  hc::array_view<const int> offsets_(hc::extent<1>(threads), counts);
+  auto d_first_ = utils::get_output_view<_To>(d_first, total);
+  kernel_launch(threads, [first1_, n1, first2_, n2, N, op, comp, offsets_, d_first_]
+                         (hc::index<1> idx) [[hc]] {
+    int k = idx[0] * MERGE_ITEMS_PER_THREAD;
+    int k_end = k + MERGE_ITEMS_PER_THREAD < N ? k + MERGE_ITEMS_PER_THREAD : N;
+    set_op_store<decltype(d_first_)> store = { d_first_, offsets_(idx) };
+    set_op_walk(first1_, n1, first2_, n2, k, k_end, op, comp, store);
+  });
+  return d_first + total;
+}
+
+} // namespace details
@@ -0,0 +1,190 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+/**
+ * Selection
+ *
+ * nth_element is a quickselect whose partition step runs on the
+ * accelerator. Every round:
+ *
+ *  - gathers SELECT_SAMPLES evenly spaced elements of the active range and
+ *    takes their median as the pivot
+ *  - counts, per piece of SELECT_ITEMS_PER_THREAD elements, how many are
+ *    less than and equivalent to the pivot, scans the counts on the host
+ *    and scatters the range into a three-way partition
+ *  - continues in the part which holds the nth position, and stops at
+ *    once if that is the part equivalent to the pivot
+ *
+ * Once the active range is below SELECT_SEQ_THRESHOLD it is finished with
+ * std::nth_element on the host. partial_sort selects the boundary element
+ * this way and then sorts the prefix in front of it only.
+ */
+
+namespace details {
+
+#define SELECT_SAMPLES 63
+#define SELECT_ITEMS_PER_THREAD 64
+#define SELECT_SEQ_THRESHOLD 4096
+
+// std::nth_element forwarder
+template<typename RandomIt, typename Compare>
+void nth_element_impl(RandomIt first, RandomIt nth, RandomIt last,
+                      Compare comp,
+                      std::input_iterator_tag) {
+  std::nth_element(first, nth, last, comp);
+}
+
+// parallel::nth_element
+template<typename RandomIt, typename Compare>
+void nth_element_impl(RandomIt first, RandomIt nth, RandomIt last,
+                      Compare comp,
+                      std::random_access_iterator_tag) {
+  const int N = static_cast<int>(std::distance(first, last));
+  const int n = static_cast<int>(std::distance(first, nth));
+  if (N <= SELECT_SEQ_THRESHOLD || n >= N) {
+    nth_element_impl(first, nth, last, comp, std::input_iterator_tag{});
+    return;
+  }
+
+  typedef typename std::iterator_traits<RandomIt>::value_type _Tp;
+  auto first_ = utils::get_view<_Tp>(first, N);
+  hc::array_view<_Tp> tmp((hc::extent<1>(N)));
+
+  int lo = 0;
+  int hi = N;
+  while (hi - lo > SELECT_SEQ_THRESHOLD) {
+    const int len = hi - lo;
+    auto range = first_.section(lo, len);
+    auto out = tmp.section(0, len);
+
+    // pivot
+    std::vector<_Tp> samples(SELECT_SAMPLES);
+    hc::array_view<_Tp> samples_(hc::extent<1>(SELECT_SAMPLES), samples);
+    samples_.discard_data();
+    kernel_launch(SELECT_SAMPLES, [range, samples_, len](hc::index<1> idx) [[hc]] {
+      samples_(idx) = range[static_cast<int>((long long)idx[0] * len / SELECT_SAMPLES)];
+    });
+    samples_.synchronize();
+    std::nth_element(std::begin(samples), std::begin(samples) + SELECT_SAMPLES / 2,
+                     std::end(samples), comp);
+    const _Tp pivot = samples[SELECT_SAMPLES / 2];
+
+    // pass 1: elements less than and equivalent to the pivot in every piece
+    const int threads = (len + SELECT_ITEMS_PER_THREAD - 1) / SELECT_ITEMS_PER_THREAD;
+    std::vector<int> counts(2 * threads);
+    hc::array_view<int> counts_(hc::extent<1>(2 * threads), counts);
+    counts_.discard_data();
+    kernel_launch(threads, [range, len, pivot, comp, counts_](hc::index<1> idx) [[hc]] {
+      int begin = idx[0] * SELECT_ITEMS_PER_THREAD;
+      int end = begin + SELECT_ITEMS_PER_THREAD < len ? begin + SELECT_ITEMS_PER_THREAD : len;
+      int less = 0, equal = 0;
+      for (int i = begin; i < end; ++i) {
+        if (comp(range[i], pivot))
+          ++less;
+        else if (!comp(pivot, range[i]))
+          ++equal;
+      }
+      counts_[2 * idx[0]] = less;
+      counts_[2 * idx[0] + 1] = equal;
+    });
+    counts_.synchronize();
+
+    int L = 0, E = 0;
+    for (int t = 0; t < threads; ++t) {
+      L += counts[2 * t];
+      E += counts[2 * t + 1];
+    }
+    const int rank = n - lo;
+    if (E == len) {
+      // every element is equivalent to the pivot, any order will do
+      return;
+    }
+
+    // offsets of every piece in the three parts
+    std::vector<int> offsets(3 * threads);
+    int less_off = 0, equal_off = L, greater_off = L + E;
+    for (int t = 0; t < threads; ++t) {
+      int size = (t + 1) * SELECT_ITEMS_PER_THREAD < len ? SELECT_ITEMS_PER_THREAD
+                                                          : len - t * SELECT_ITEMS_PER_THREAD;
+      offsets[3 * t] = less_off;
+      offsets[3 * t + 1] = equal_off;
+      offsets[3 * t + 2] = greater_off;
+      less_off += counts[2 * t];
+      equal_off += counts[2 * t + 1];
+      greater_off += size - counts[2 * t] - counts[2 * t + 1];
+    }
+
+    // pass 2: scatter into the partition and copy it back
+    hc::array_view<const int> offsets_(hc::extent<1>(3 * threads), offsets);
+    kernel_launch(threads, [range, out, len, pivot, comp, offsets_](hc::index<1> idx) [[hc]] {
+      int begin = idx[0] * SELECT_ITEMS_PER_THREAD;
+      int end = begin + SELECT_ITEMS_PER_THREAD < len ? begin + SELECT_ITEMS_PER_THREAD : len;
+      int less = offsets_[3 * idx[0]];
+      int equal = offsets_[3 * idx[0] + 1];
+      int greater = offsets_[3 * idx[0] + 2];
+      for (int i = begin; i < end; ++i) {
+        _Tp v = range[i];
+        if (comp(v, pivot))
+          out[less++] = v;
+        else if (!comp(pivot, v))
+          out[equal++] = v;
+        else
+          out[greater++] = v;
+      }
+    });
+    kernel_launch(len, [range, out](hc::index<1> idx) [[hc]] {
+      range(idx) = out(idx);
+    });
+
+    if (rank < L) {
+      hi = lo + L;
+    } else if (rank < L + E) {
+      // the nth element is equivalent to the pivot and already in place
+      return;
+    } else {
+      lo = lo + L + E;
+    }
+  }
+
+  // finish the remaining range on the host
+  auto rest_ = first_.section(lo, hi - lo);
+  std::vector<_Tp> rest(hi - lo);
+  hc::copy(rest_, std::begin(rest));
+  std::nth_element(std::begin(rest), std::begin(rest) + (n - lo), std::end(rest), comp);
+  hc::copy(std::begin(rest), std::end(rest), rest_);
+}
+
+// partial_sort
+// std::partial_sort forwarder
+template<typename RandomIt, typename Compare>
+void partial_sort_impl(RandomIt first, RandomIt middle, RandomIt last,
+                       Compare comp,
+                       std::input_iterator_tag) {
+  std::partial_sort(first, middle, last, comp);
+}
+
+// parallel::partial_sort
+template<typename RandomIt, typename Compare>
+void partial_sort_impl(RandomIt first, RandomIt middle, RandomIt last,
+                       Compare comp,
+                       std::random_access_iterator_tag) {
+  const int N = static_cast<int>(std::distance(first, last));
+  if (N <= SELECT_SEQ_THRESHOLD || first == middle) {
+    partial_sort_impl(first, middle, last, comp, std::input_iterator_tag{});
+    return;
+  }
+
+  // [first, middle - 1) holds the smallest elements afterwards, in any order
+  nth_element_impl(first, middle - 1, last, comp,
+                   std::random_access_iterator_tag{});
+  sort_impl(first, middle - 1, comp,
+            typename std::iterator_traits<RandomIt>::iterator_category());
+}
+
+} // namespace details
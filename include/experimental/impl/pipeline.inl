@@ -0,0 +1,546 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+/**
+ * Lazy pipelines
+ *
+ * A pipeline_view describes a range together with a chain of element-wise
+ * stages (transform and filter) which are not evaluated when the view is
+ * built. Passing the view to one of the terminal algorithms (reduce, copy,
+ * inclusive_scan) evaluates the stages inside the kernel of that algorithm,
+ * so no intermediate range is ever materialized:
+ *
+ *   auto p = make_pipeline(first, last).transform(f).filter(pred);
+ *   auto sum = reduce(par, p, T{}, std::plus<T>());
+ *
+ * computes in one kernel what would otherwise take a transform, a copy_if
+ * and a reduce over two full-size temporaries.
+ *
+ * Stages must be callable on the accelerator ([[hc]]). Terminal algorithms
+ * taking a filtered pipeline produce a compacted output: only elements kept
+ * by every filter are written, in their original order.
+ */
+
+namespace details {
+
+// A stage maps an input element to an output element, and returns false
+// if the element is dropped by a filter.
+
+template<typename T>
+struct identity_stage {
+  typedef T value_type;
+
+  bool operator()(const T& in, value_type& out) const __CPU__ __HC__ {
+    out = in;
+    return true;
+  }
+};
+
+template<typename Prev, typename F>
+struct transform_stage {
+  typedef typename Prev::value_type input_type;
+  typedef typename std::decay<
+            decltype(std::declval<F>()(std::declval<input_type&>()))>::type value_type;
+
+  transform_stage(const Prev& prev, const F& f) : prev(prev), f(f) {}
+
+  template<typename In>
+  bool operator()(const In& in, value_type& out) const __CPU__ __HC__ {
+    input_type tmp;
+    if (!prev(in, tmp))
+      return false;
+    out = f(tmp);
+    return true;
+  }
+
+  Prev prev;
+  F f;
+};
+
+template<typename Prev, typename Predicate>
+struct filter_stage {
+  typedef typename Prev::value_type value_type;
+
+  filter_stage(const Prev& prev, const Predicate& p) : prev(prev), p(p) {}
+
+  template<typename In>
+  bool operator()(const In& in, value_type& out) const __CPU__ __HC__ {
+    if (!prev(in, out))
+      return false;
+    return p(out);
+  }
+
+  Prev prev;
+  Predicate p;
+};
+
+} // namespace details
+
+/**
+ * A range with a lazily evaluated chain of stages. Created with
+ * make_pipeline and extended with transform() and filter(); each call
+ * returns a new view and leaves the original unchanged.
+ */
+template<typename InputIterator, typename Stage>
+class pipeline_view {
+public:
+  typedef InputIterator iterator;
+  typedef Stage stage_type;
+  typedef typename Stage::value_type value_type;
+
+  pipeline_view(InputIterator first, InputIterator last, const Stage& stage)
+    : first_(first), last_(last), stage_(stage) {}
+
+  /**
+   * Appends a stage applying f to every element.
+   */
+  template<typename F>
+  pipeline_view<InputIterator, details::transform_stage<Stage, F>>
+  transform(F f) const {
+    return { first_, last_, details::transform_stage<Stage, F>(stage_, f) };
+  }
+
+  /**
+   * Appends a stage dropping elements for which p returns false.
+   */
+  template<typename Predicate>
+  pipeline_view<InputIterator, details::filter_stage<Stage, Predicate>>
+  filter(Predicate p) const {
+    return { first_, last_, details::filter_stage<Stage, Predicate>(stage_, p) };
+  }
+
+  InputIterator begin() const { return first_; }
+  InputIterator end() const { return last_; }
+  const Stage& stage() const { return stage_; }
+
+private:
+  InputIterator first_;
+  InputIterator last_;
+  Stage stage_;
+};
+
+/**
+ * Creates a pipeline_view over [first, last) with no stage.
+ */
+template<typename InputIterator>
+pipeline_view<InputIterator,
+              details::identity_stage<typename std::iterator_traits<InputIterator>::value_type>>
+make_pipeline(InputIterator first, InputIterator last) {
+  typedef typename std::iterator_traits<InputIterator>::value_type _Tp;
+  return { first, last, details::identity_stage<_Tp>() };
+}
+
+namespace utils {
+template<typename T>
+struct isPipeline : std::false_type {};
+
+template<typename InputIterator, typename Stage>
+struct isPipeline<pipeline_view<InputIterator, Stage>> : std::true_type {};
+
+template<typename T>
+using isPipelineView = isPipeline<typename std::decay<T>::type>;
+} // namespace utils
+
+namespace details {
+
+#define PIPELINE_TILE_SIZE 256
+#define PIPELINE_MAX_TILES 1024
+
+// combine two partial results which may each be empty
+#define _PIPELINE_COMBINE(_VAL, _VALID, _OVAL, _OVALID) \
+    if (_OVALID) { \
+      _VAL = (_VALID) ? binary_op(_VAL, _OVAL) : _OVAL; \
+      _VALID = 1; \
+    }
+
+// sequential evaluation, used for small ranges and the seq policy
+template<typename InputIterator, typename Stage, typename T, typename BinaryOperation>
+T pipeline_reduce_seq(InputIterator first, InputIterator last,
+                      const Stage& stage, T init, BinaryOperation binary_op) {
+  typename Stage::value_type v;
+  for (; first != last; ++first) {
+    if (stage(*first, v))
+      init = binary_op(init, v);
+  }
+  return init;
+}
+
+template<typename InputIterator, typename Stage, typename OutputIterator>
+OutputIterator pipeline_copy_seq(InputIterator first, InputIterator last,
+                                 const Stage& stage, OutputIterator d_first) {
+  typename Stage::value_type v;
+  for (; first != last; ++first) {
+    if (stage(*first, v))
+      *d_first++ = v;
+  }
+  return d_first;
+}
+
+template<typename InputIterator, typename Stage, typename OutputIterator,
+         typename BinaryOperation>
+OutputIterator pipeline_scan_seq(InputIterator first, InputIterator last,
+                                 const Stage& stage, OutputIterator d_first,
+                                 BinaryOperation binary_op) {
+  typename Stage::value_type v, sum;
+  bool valid = false;
+  for (; first != last; ++first) {
+    if (stage(*first, v)) {
+      sum = valid ? binary_op(sum, v) : v;
+      valid = true;
+      *d_first++ = sum;
+    }
+  }
+  return d_first;
+}
+
+// reduce: every work-item folds the elements it keeps, then each tile
+// folds its work-items; a per-value flag marks partial results which did
+// not see any element, so no identity element is required
+template<typename RandomAccessIterator, typename Stage, typename T,
+         typename BinaryOperation>
+T pipeline_reduce_impl(RandomAccessIterator first, RandomAccessIterator last,
+                       const Stage& stage, T init,
+                       BinaryOperation binary_op) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type _Ti;
+  typedef typename Stage::value_type _Tv;
+
+  const int N = static_cast<int>(std::distance(first, last));
+  int numTiles = (N + PIPELINE_TILE_SIZE - 1) / PIPELINE_TILE_SIZE;
+  numTiles = numTiles < PIPELINE_MAX_TILES ? numTiles : PIPELINE_MAX_TILES;
+  const int length = numTiles * PIPELINE_TILE_SIZE;
+
+  std::vector<T> r(numTiles);
+  std::vector<int> rv(numTiles);
+  hc::array_view<T> result(hc::extent<1>(numTiles), r);
+  hc::array_view<int> result_valid(hc::extent<1>(numTiles), rv);
+  result.discard_data();
+  result_valid.discard_data();
+  auto first_ = utils::get_view<const _Ti>(first, N);
+
+  kernel_launch(length,
+                [ first_, N, length, stage, result, result_valid, binary_op ]
+                ( hc::tiled_index<1> t_idx ) [[hc]]
+                {
+                  tile_static T scratch[PIPELINE_TILE_SIZE];
+                  tile_static int scratch_valid[PIPELINE_TILE_SIZE];
+                  unsigned int tileIndex = t_idx.local[0];
+
+                  T acc;
+                  int valid = 0;
+                  _Tv v;
+                  for (int gx = t_idx.global[0]; gx < N; gx += length) {
+                    if (stage(first_[gx], v)) {
+                      T tv = v;
+                      _PIPELINE_COMBINE(acc, valid, tv, 1);
+                    }
+                  }
+                  scratch[tileIndex] = acc;
+                  scratch_valid[tileIndex] = valid;
+                  t_idx.barrier.wait();
+
+                  for (unsigned int w = PIPELINE_TILE_SIZE / 2; w > 0; w >>= 1) {
+                    if (tileIndex < w) {
+                      T mine = scratch[tileIndex];
+                      int mine_valid = scratch_valid[tileIndex];
+                      _PIPELINE_COMBINE(mine, mine_valid,
+                                        scratch[tileIndex + w],
+                                        scratch_valid[tileIndex + w]);
+                      scratch[tileIndex] = mine;
+                      scratch_valid[tileIndex] = mine_valid;
+                    }
+                    t_idx.barrier.wait();
+                  }
+
+                  if (tileIndex == 0) {
+                    result[t_idx.tile[0]] = scratch[0];
+                    result_valid[t_idx.tile[0]] = scratch_valid[0];
+                  }
+                }, PIPELINE_TILE_SIZE);
+
+  result.synchronize();
+  result_valid.synchronize();
+  for (int i = 0; i < numTiles; ++i) {
+    if (rv[i])
+      init = binary_op(init, r[i]);
+  }
+  return init;
+}
+
+// copy and inclusive_scan
+//
+// The range is split into one contiguous chunk per tile. The first kernel
+// counts (and for a scan, folds) the elements each chunk keeps; the
+// per-chunk results are scanned on the host, which is cheap since there
+// are at most PIPELINE_MAX_TILES of them. The second kernel walks every
+// chunk again, scans it within the tile and writes the kept elements at
+// their final, compacted position. Stages are evaluated in both kernels
+// instead of storing their results.
+template<typename RandomAccessIterator, typename Stage,
+         typename OutputIterator, typename BinaryOperation>
+OutputIterator pipeline_compact_impl(RandomAccessIterator first,
+                                     RandomAccessIterator last,
+                                     const Stage& stage,
+                                     OutputIterator d_first,
+                                     BinaryOperation binary_op,
+                                     const bool scan) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type _Ti;
+  typedef typename std::iterator_traits<OutputIterator>::value_type _To;
+  typedef typename Stage::value_type _Tv;
+
+  const int N = static_cast<int>(std::distance(first, last));
+  int numTiles = (N + PIPELINE_TILE_SIZE - 1) / PIPELINE_TILE_SIZE;
+  numTiles = numTiles < PIPELINE_MAX_TILES ? numTiles : PIPELINE_MAX_TILES;
+  const int chunk = (N + numTiles - 1) / numTiles;
+  const int length = numTiles * PIPELINE_TILE_SIZE;
+
+  auto first_ = utils::get_view<const _Ti>(first, N);
+
+  // pass 1: per chunk count and sum
+  std::vector<int> counts(numTiles);
+  std::vector<_Tv> sums(numTiles);
+  hc::array_view<int> counts_(hc::extent<1>(numTiles), counts);
+  hc::array_view<_Tv> sums_(hc::extent<1>(numTiles), sums);
+  counts_.discard_data();
+  sums_.discard_data();
+
+  kernel_launch(length,
+                [ first_, N, chunk, stage, counts_, sums_, binary_op, scan ]
+                ( hc::tiled_index<1> t_idx ) [[hc]]
+                {
+                  tile_static int scratch_count[PIPELINE_TILE_SIZE];
+                  tile_static _Tv scratch[PIPELINE_TILE_SIZE];
+                  tile_static int scratch_valid[PIPELINE_TILE_SIZE];
+                  unsigned int tileIndex = t_idx.local[0];
+                  int begin = t_idx.tile[0] * chunk;
+                  int end = begin + chunk < N ? begin + chunk : N;
+
+                  // every work-item handles a contiguous part of the chunk,
+                  // so partial sums can be folded in order
+                  int sub = (chunk + PIPELINE_TILE_SIZE - 1) / PIPELINE_TILE_SIZE;
+                  int tbegin = begin + tileIndex * sub;
+                  int tend = tbegin + sub < end ? tbegin + sub : end;
+
+                  int count = 0;
+                  _Tv acc;
+                  _Tv v;
+                  int valid = 0;
+                  for (int gx = tbegin; gx < tend; ++gx) {
+                    if (stage(first_[gx], v)) {
+                      ++count;
+                      if (scan) {
+                        _PIPELINE_COMBINE(acc, valid, v, 1);
+                      }
+                    }
+                  }
+                  scratch_count[tileIndex] = count;
+                  scratch[tileIndex] = acc;
+                  scratch_valid[tileIndex] = valid;
+                  t_idx.barrier.wait();
+
+                  // interleaved tree, each step combines neighbours
+                  for (unsigned int s = 1; s < PIPELINE_TILE_SIZE; s <<= 1) {
+                    if ((tileIndex % (2 * s)) == 0) {
+                      count += scratch_count[tileIndex + s];
+                      scratch_count[tileIndex] = count;
+                      if (scan) {
+                        _PIPELINE_COMBINE(acc, valid,
+                                          scratch[tileIndex + s],
+                                          scratch_valid[tileIndex + s]);
+                        scratch[tileIndex] = acc;
+                        scratch_valid[tileIndex] = valid;
+                      }
+                    }
+                    t_idx.barrier.wait();
+                  }
+
+                  if (tileIndex == 0) {
+                    counts_[t_idx.tile[0]] = count;
+                    sums_[t_idx.tile[0]] = acc;
+                  }
+                }, PIPELINE_TILE_SIZE);
+
+  counts_.synchronize();
+  if (scan)
+    sums_.synchronize();
+
+  // exclusive scan of the per chunk results
+  std::vector<int> offsets(numTiles);
+  std::vector<_Tv> carries(numTiles);
+  std::vector<int> carries_valid(numTiles);
+  int total = 0;
+  _Tv carry;
+  int carry_valid = 0;
+  for (int i = 0; i < numTiles; ++i) {
+    offsets[i] = total;
+    carries[i] = carry;
+    carries_valid[i] = carry_valid;
+    if (counts[i]) {
+      total += counts[i];
+      if (scan) {
+        _PIPELINE_COMBINE(carry, carry_valid, sums[i], 1);
+      }
+    }
+  }
+  if (total == 0)
+    return d_first;
+
+  // pass 2: scan every chunk and write the kept elements
+  hc::array_view<const int> offsets_(hc::extent<1>(numTiles), offsets);
+  hc::array_view<const _Tv> carries_(hc::extent<1>(numTiles), carries);
+  hc::array_view<const int> carries_valid_(hc::extent<1>(numTiles), carries_valid);
+  auto d_first_ = utils::get_output_view<_To>(d_first, total);
+
+  kernel_launch(length,
+                [ first_, d_first_, N, chunk, stage, offsets_, carries_,
+                  carries_valid_, binary_op, scan ]
+                ( hc::tiled_index<1> t_idx ) [[hc]]
+                {
+                  tile_static int scratch_count[PIPELINE_TILE_SIZE];
+                  tile_static _Tv scratch[PIPELINE_TILE_SIZE];
+                  tile_static int scratch_valid[PIPELINE_TILE_SIZE];
+                  int l = t_idx.local[0];
+                  int tile = t_idx.tile[0];
+                  int begin = tile * chunk;
+                  int end = begin + chunk < N ? begin + chunk : N;
+
+                  int offset = offsets_[tile];
+                  _Tv carry = carries_[tile];
+                  int carry_valid = carries_valid_[tile];
+
+                  for (int base = begin; base < end; base += PIPELINE_TILE_SIZE) {
+                    int gx = base + l;
+                    _Tv v;
+                    int keep = (gx < end) && stage(first_[gx], v);
+
+                    // inclusive Hillis-Steele scan of the round within the tile
+                    t_idx.barrier.wait();
+                    scratch_count[l] = keep;
+                    scratch[l] = v;
+                    scratch_valid[l] = keep;
+                    for (int off = 1; off < PIPELINE_TILE_SIZE; off *= 2) {
+                      t_idx.barrier.wait();
+                      int c = scratch_count[l];
+                      _Tv x = scratch[l];
+                      int xv = scratch_valid[l];
+                      if (l >= off) {
+                        c += scratch_count[l - off];
+                        if (scan && scratch_valid[l - off]) {
+                          x = xv ? binary_op(scratch[l - off], x) : scratch[l - off];
+                          xv = 1;
+                        }
+                      }
+                      t_idx.barrier.wait();
+                      scratch_count[l] = c;
+                      scratch[l] = x;
+                      scratch_valid[l] = xv;
+                    }
+                    t_idx.barrier.wait();
+
+                    if (keep) {
+                      int dst = offset + scratch_count[l] - 1;
+                      if (scan) {
+                        _Tv s = scratch[l];
+                        d_first_[dst] = carry_valid ? binary_op(carry, s) : s;
+                      } else {
+                        d_first_[dst] = v;
+                      }
+                    }
+
+                    // carry the round over to the next one
+                    offset += scratch_count[PIPELINE_TILE_SIZE - 1];
+                    if (scan) {
+                      _PIPELINE_COMBINE(carry, carry_valid,
+                                        scratch[PIPELINE_TILE_SIZE - 1],
+                                        scratch_valid[PIPELINE_TILE_SIZE - 1]);
+                    }
+                  }
+                }, PIPELINE_TILE_SIZE);
+
+  return d_first + total;
+}
+
+} // namespace details
+
+/**
+ * Reduces the elements of a pipeline in a single kernel.
+ *
+ * Return: GENERALIZED_SUM(binary_op, init, s(*first), ...) over the elements
+ * kept by the stages s of the pipeline.
+ */
+template<typename ExecutionPolicy, typename Pipeline,
+         typename T, typename BinaryOperation,
+         utils::EnableIf<utils::isExecutionPolicy<ExecutionPolicy>> = nullptr,
+         utils::EnableIf<utils::isPipelineView<Pipeline>> = nullptr>
+T
+reduce(ExecutionPolicy&& exec,
+       const Pipeline& p,
+       T init,
+       BinaryOperation binary_op) {
+  const size_t N = static_cast<size_t>(std::distance(p.begin(), p.end()));
+  if (utils::isParallel(exec) && N > details::PARALLELIZE_THRESHOLD) {
+    details::launch_scope scope(exec);
+    return details::pipeline_reduce_impl(p.begin(), p.end(), p.stage(),
+                                         init, binary_op);
+  } else {
+    return details::pipeline_reduce_seq(p.begin(), p.end(), p.stage(),
+                                        init, binary_op);
+  }
+}
+
+/**
+ * Writes the elements of a pipeline to [d_first, d_first + M), where M is
+ * the number of elements kept by its filters.
+ *
+ * Return: d_first + M
+ */
+template<typename ExecutionPolicy, typename Pipeline,
+         typename OutputIterator,
+         utils::EnableIf<utils::isExecutionPolicy<ExecutionPolicy>> = nullptr,
+         utils::EnableIf<utils::isPipelineView<Pipeline>> = nullptr>
+OutputIterator
+copy(ExecutionPolicy&& exec,
+     const Pipeline& p,
+     OutputIterator d_first) {
+  typedef typename Pipeline::value_type _Tp;
+  const size_t N = static_cast<size_t>(std::distance(p.begin(), p.end()));
+  if (utils::isParallel(exec) && N > details::PARALLELIZE_THRESHOLD) {
+    details::launch_scope scope(exec);
+    return details::pipeline_compact_impl(p.begin(), p.end(), p.stage(),
+                                          d_first, std::plus<_Tp>(), false);
+  } else {
+    return details::pipeline_copy_seq(p.begin(), p.end(), p.stage(), d_first);
+  }
+}
+
+/**
+ * Writes the inclusive scan of the elements of a pipeline to
+ * [d_first, d_first + M), where M is the number of elements kept by its
+ * filters.
+ *
+ * Return: d_first + M
+ */
+template<typename ExecutionPolicy, typename Pipeline,
+         typename OutputIterator, typename BinaryOperation,
+         utils::EnableIf<utils::isExecutionPolicy<ExecutionPolicy>> = nullptr,
+         utils::EnableIf<utils::isPipelineView<Pipeline>> = nullptr>
+OutputIterator
+inclusive_scan(ExecutionPolicy&& exec,
+               const Pipeline& p,
+               OutputIterator d_first,
+               BinaryOperation binary_op) {
+  const size_t N = static_cast<size_t>(std::distance(p.begin(), p.end()));
+  if (utils::isParallel(exec) && N > details::PARALLELIZE_THRESHOLD) {
+    details::launch_scope scope(exec);
+    return details::pipeline_compact_impl(p.begin(), p.end(), p.stage(),
+                                          d_first, binary_op, true);
+  } else {
+    return details::pipeline_scan_seq(p.begin(), p.end(), p.stage(),
+                                      d_first, binary_op);
+  }
+}
@@ -126,11 +126,10 @@ T reduce_impl(RandomAccessIterator first, RandomAccessIterator last,
     numTiles = static_cast< int >((N/REDUCE_WAVEFRONT_SIZE)>= numTiles?(numTiles):
                                   (std::ceil( static_cast< float >( N ) / REDUCE_WAVEFRONT_SIZE) ));
 
-    auto f_ = utils::get_pointer(first);
     using _Ty = typename std::iterator_traits<RandomAccessIterator>::value_type;
     std::vector<T> r(numTiles);
     hc::array_view<T> result(hc::extent<1>(numTiles), r);
-    hc::array_view<const _Ty> first_(hc::extent<1>(N), f_);
+    auto first_ = utils::get_view<const _Ty>(first, N);
     result.discard_data();
     kernel_launch(length,
                   [ first_, N, length, result, binary_op ]
@@ -225,6 +224,7 @@ reduce(ExecutionPolicy&& exec,
                InputIterator first, InputIterator last, T init,
                BinaryOperation binary_op) {
   if (utils::isParallel(exec)) {
+    details::launch_scope scope(exec);
     return reduce(first, last, init, binary_op);
   } else {
     return details::reduce_impl(first, last, init, binary_op,
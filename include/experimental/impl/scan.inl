@@ -71,8 +71,7 @@ void scan_impl(
 	unsigned int	   tempBuffsize = (sizeInputBuff); 
 	unsigned int	   iteration = (tempBuffsize-1)/max_ext; 
 
-    auto f_ = utils::get_pointer(first);
-    hc::array_view<iType> first_(hc::extent<1>(numElements), f_);
+    auto first_ = utils::get_view<iType>(first, numElements);
     for(unsigned int i=0; i<=iteration; i++)
 	{
 	    unsigned int extent_sz =  (tempBuffsize > max_ext) ? max_ext : tempBuffsize; 
@@ -225,9 +224,7 @@ void scan_impl(
      *********************************************************************************/
 	tempBuffsize = (sizeInputBuff); 
 	iteration = (tempBuffsize-1)/max_ext; 
-    auto re_ = utils::get_pointer(result);
-    hc::array_view<oType> re(hc::extent<1>(numElements), re_);
-    re.discard_data();
+    auto re = utils::get_output_view<oType>(result, numElements);
 
     for(unsigned int a=0; a<=iteration ; a++)
     {
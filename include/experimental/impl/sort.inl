@@ -336,8 +336,7 @@ void sort_enqueue_int_uint(InputIt &first, InputIt &last, Compare comp, bool int
 	}
 
 	int bits;
-    auto f_ = utils::get_pointer(first);
-    hc::array_view<Values> first_(hc::extent<1>(orig_szElements), f_);
+    auto first_ = utils::get_view<Values>(first, orig_szElements);
 	for(bits = 0; bits < (sizeof(Values) * 8); bits += RADIX)
     {
           cdata.m_startBit = bits;
@@ -832,8 +831,7 @@ sort_dispatch(const InputIt& first, const InputIt& last, const Compare& comp)
     for(size_t temp = szElements; temp > 1; temp >>= 1)
         ++numStages;
 
-    auto f_ = utils::get_pointer(first);
-    hc::array_view<T> first_(hc::extent<1>(szElements), f_);
+    auto first_ = utils::get_view<T>(first, szElements);
     for(stage = 0; stage < numStages; ++stage)
     {
         for(passOfStage = 0; passOfStage < stage + 1; ++passOfStage) {
@@ -2,6 +2,49 @@
 
 namespace details {
 
+// binary searches in the sorted range data[left, right), shared with the
+// merge and set algorithms
+
+// first index whose element is not less than searchVal
+template< typename sType, typename Container, typename Compare >
+unsigned int sort_lowerBoundBinary( const Container& data, int left, int right, const sType& searchVal, const Compare& lessOp ) [[hc]]
+{
+    int firstIndex = left;
+    int lastIndex = right;
+    
+    while( firstIndex < lastIndex )
+    {
+        unsigned int midIndex = ( firstIndex + lastIndex ) / 2;
+        sType midValue = data[ midIndex ];
+        
+        if( lessOp( midValue, searchVal ) )
+            firstIndex = midIndex+1;
+        else
+            lastIndex = midIndex;
+    }
+    return firstIndex;
+}
+
+// first index whose element is greater than searchVal
+template< typename sType, typename Container, typename Compare >
+unsigned int sort_upperBoundBinary( const Container& data, int left, int right, const sType& searchVal, const Compare& lessOp ) [[hc]]
+{
+    int firstIndex = left;
+    int lastIndex = right;
+
+    while( firstIndex < lastIndex )
+    {
+        unsigned int midIndex = ( firstIndex + lastIndex ) / 2;
+        sType midValue = data[ midIndex ];
+
+        if( lessOp( searchVal, midValue ) )
+            lastIndex = midIndex;
+        else
+            firstIndex = midIndex+1;
+    }
+    return firstIndex;
+}
+
 // FIXME: stablesort algorithm implementation breaks in Clang 4.0 as of now
 #if 0
 
@@ -37,54 +80,6 @@ stablesort_dispatch(InputIt first, InputIt last, Compare comp)
 #define _max(a,b)    (((a) > (b)) ? (a) : (b))
 #define _min(a,b)    (((a) < (b)) ? (a) : (b))
 
-template< typename sType, typename Container, typename Compare >
-unsigned int sort_lowerBoundBinary( Container& data, int left, int right, sType searchVal, Compare& lessOp ) [[hc]]
-{
-    int firstIndex = left;
-    int lastIndex = right;
-    
-    while( firstIndex < lastIndex )
-    {
-        unsigned int midIndex = ( firstIndex + lastIndex ) / 2;
-        sType midValue = data[ midIndex ];
-        
-        if( lessOp( midValue, searchVal ) )
-            firstIndex = midIndex+1;
-        else
-            lastIndex = midIndex;
-    }
-    return firstIndex;
-}
-
-template< typename sType, typename Container, typename Compare >
-unsigned int  sort_upperBoundBinary( Container& data, unsigned int left, unsigned int right, sType searchVal, Compare& lessOp ) [[hc]]
-{
-    unsigned int upperBound = sort_lowerBoundBinary( data, left, right, searchVal, lessOp );
-    
-    if( upperBound != right )
-    {
-        int mid = 0;
-        sType upperValue = data[ upperBound ];
-        while( !lessOp( upperValue, searchVal ) && !lessOp( searchVal, upperValue) && (upperBound < right))
-        {
-            mid = (upperBound + right)/2;
-            sType midValue = data[mid];
-            if( !lessOp( midValue, searchVal ) && !lessOp( searchVal, midValue) )
-            {
-                upperBound = mid + 1;
-            }   
-            else
-            {
-                right = mid;
-                upperBound++;
-            }
-            upperValue = data[ upperBound ];
-        }
-    }
-    return upperBound;
-}
-
-
 template<typename InputIt, typename Compare>
 typename std::enable_if<
     !(std::is_same< typename std::iterator_traits<InputIt >::value_type, unsigned int >::value || 
@@ -113,8 +108,7 @@ stablesort_dispatch(const InputIt& first, const InputIt& last, const Compare& co
 	unsigned int	   tempBuffsize = globalRange; 
 	unsigned int	   iteration = (globalRange-1)/max_ext; 
 
-    auto f_ = utils::get_pointer(first);
-    hc::array_view<iType> first_(hc::extent<1>(vecSize), f_);
+    auto first_ = utils::get_view<iType>(first, vecSize);
     for(unsigned int i=0; i<=iteration; i++)
 	{
 	    unsigned int extent_sz =  (tempBuffsize > max_ext) ? max_ext : tempBuffsize; 
@@ -217,9 +211,8 @@ stablesort_dispatch(const InputIt& first, const InputIt& last, const Compare& co
     unsigned int vecPow2 = (vecSize & (vecSize-1));
     numMerges += vecPow2? 1: 0;
 
-    std::vector<iType> tmp(vecSize);
-    hc::array_view<iType> tmpBuffer(hc::extent<1>(vecSize), tmp);
-    tmpBuffer.discard_data();
+    // scratch space lives on the device only, it is never read on the host
+    hc::array_view<iType> tmpBuffer((hc::extent<1>(vecSize)));
 
 
     hc::extent< 1 > globalSizeK1( globalRange );
@@ -302,8 +295,7 @@ stablesort_dispatch(const InputIt& first, const InputIt& last, const Compare& co
     }
     if( numMerges & 1 )
     {
-       tmpBuffer.synchronize();
-       std::copy(std::begin(tmp), std::end(tmp), first);
+       tmpBuffer.copy_to(first_);
     }
 
     return;
@@ -43,11 +43,8 @@ OutputIterator transform_impl(RandomAccessIterator first,
 
   using _Ti = typename std::iterator_traits<RandomAccessIterator>::value_type;
   using _To = typename std::iterator_traits<RandomAccessIterator>::value_type;
-  auto f_ = utils::get_pointer(first);
-  auto d_ = utils::get_pointer(d_first);
-  hc::array_view<_Ti> first_(hc::extent<1>(N), f_);
-  hc::array_view<_To> d_first_(hc::extent<1>(N), d_);
-  d_first_.discard_data();
+  auto first_ = utils::get_view<_Ti>(first, N);
+  auto d_first_ = utils::get_output_view<_To>(d_first, N);
 
   kernel_launch(N, [d_first_, first_, unary_op](hc::index<1> idx) [[hc]] {
     d_first_[idx[0]] = unary_op(first_[idx[0]]);
@@ -73,13 +70,9 @@ OutputIterator transform_impl(RandomAccessIterator first1,
 
   using _Ti = typename std::iterator_traits<RandomAccessIterator>::value_type;
   using _To = typename std::iterator_traits<RandomAccessIterator>::value_type;
-  auto f1 = utils::get_pointer(first1);
-  auto f2 = utils::get_pointer(first2);
-  auto d_ = utils::get_pointer(d_first);
-  hc::array_view<_Ti> first1_(hc::extent<1>(N), f1);
-  hc::array_view<_Ti> first2_(hc::extent<1>(N), f2);
-  hc::array_view<_To> d_first_(hc::extent<1>(N), d_);
-  d_first_.discard_data();
+  auto first1_ = utils::get_view<_Ti>(first1, N);
+  auto first2_ = utils::get_view<_Ti>(first2, N);
+  auto d_first_ = utils::get_output_view<_To>(d_first, N);
 
   kernel_launch(N, [d_first_, first1_, first2_, binary_op](hc::index<1> idx) [[hc]] {
     d_first_[idx[0]] = binary_op(first1_[idx[0]], first2_[idx[0]]);
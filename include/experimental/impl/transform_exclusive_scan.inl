@@ -33,6 +33,7 @@ transform_exclusive_scan(ExecutionPolicy&& exec,
                          UnaryOperation unary_op,
                          T init, BinaryOperation binary_op) {
   if (utils::isParallel(exec)) {
+    details::launch_scope scope(exec);
     int numElements = static_cast< int >( std::distance( first, last ) );
     details::transform_scan_impl(first, last, result, unary_op, init, binary_op, false);
     return result + numElements;
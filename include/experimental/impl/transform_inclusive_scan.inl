@@ -36,6 +36,7 @@ transform_inclusive_scan(ExecutionPolicy&& exec,
                UnaryOperation unary_op,
                BinaryOperation binary_op, T init) {
   if (utils::isParallel(exec)) {
+    details::launch_scope scope(exec);
     int numElements = static_cast< int >( std::distance( first, last ) );
     details::transform_scan_impl(first, last, result, unary_op, init, binary_op);
     return result + numElements;
@@ -72,6 +73,7 @@ transform_inclusive_scan(ExecutionPolicy&& exec,
                          UnaryOperation unary_op,
                          BinaryOperation binary_op) {
   if (utils::isParallel(exec)) {
+    details::launch_scope scope(exec);
     int numElements = static_cast< int >( std::distance( first, last ) );
     typedef typename std::iterator_traits<OutputIterator>::value_type Type;
     details::transform_scan_impl(first, last, result, unary_op, Type{}, binary_op);
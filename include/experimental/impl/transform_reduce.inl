@@ -51,9 +51,8 @@ T transform_reduce(InputIterator first, InputIterator last,
                                 (std::ceil( static_cast< float >( N ) / _T_REDUCE_WAVEFRONT_SIZE) ));
 
   std::unique_ptr<T[]> r(new T[numTiles]);
-  auto f_ = utils::get_pointer(first);
   hc::array_view<T> result(hc::extent<1>(numTiles), r.get());
-  hc::array_view<_Tp> first_(hc::extent<1>(N), f_);
+  auto first_ = utils::get_view<_Tp>(first, N);
   result.discard_data();
   auto transform_op = unary_op;
   details::kernel_launch(length, [first_, N, length, transform_op, result, binary_op] (hc::tiled_index<1> t_idx) [[hc]]
@@ -123,6 +122,7 @@ transform_reduce(ExecutionPolicy&& exec,
                  UnaryOperation unary_op,
                  T init, BinaryOperation binary_op) {
   if (utils::isParallel(exec)) {
+    details::launch_scope scope(exec);
     return transform_reduce(first, last, unary_op, init, binary_op);
   } else {
     typedef typename std::iterator_traits<InputIterator>::value_type _Tp;
@@ -177,12 +177,12 @@ T inner_product(ExecutionPolicy&& exec,
     return std::inner_product(first1, last1, first2, value, op1, op2);
   }
 
-  /// OPTIMIZE: remove the unnecessary buffer on cpu
+  // the intermediate buffer lives on the accelerator only
   typedef typename std::iterator_traits<InputIt1>::value_type _Tp;
-  std::vector<_Tp> dist(N, _Tp());
+  hc::array<_Tp> dist((hc::extent<1>(N)));
 
   // implement inner_product by transform & reduce
-  transform(exec, first1, last1, first2, std::begin(dist), op2);
-  return reduce(exec, std::begin(dist), std::end(dist), value, op1);
+  transform(exec, first1, last1, first2, device_begin(dist), op2);
+  return reduce(exec, device_begin(dist), device_end(dist), value, op1);
 }
 /**@}*/
@@ -66,8 +66,7 @@ transform_scan_impl(
 	const unsigned int max_ext = (tile_limit*kernel0_WgSize);
 	unsigned int	   tempBuffsize = (sizeInputBuff/2); 
 	unsigned int	   iteration = (tempBuffsize-1)/max_ext; 
-    auto f_ = utils::get_pointer(first);
-    hc::array_view<iType> first_(hc::extent<1>(numElements), f_);
+    auto first_ = utils::get_view<iType>(first, numElements);
  
 
     for(unsigned int i=0; i<=iteration; i++)
@@ -235,9 +234,7 @@ transform_scan_impl(
 	tempBuffsize = (sizeInputBuff); 
 	iteration = (tempBuffsize-1)/max_ext; 
 
-    auto r_ = utils::get_pointer(result);
-    hc::array_view<oType> re(hc::extent<1>(numElements), r_);
-    re.discard_data();
+    auto re = utils::get_output_view<oType>(result, numElements);
     for(unsigned int a=0; a<=iteration ; a++)
 	{
 	    unsigned int extent_sz =  (tempBuffsize > max_ext) ? max_ext : tempBuffsize; 
@@ -19,6 +19,21 @@ template<class It>
 using isRandomAccessIt = std::is_base_of<std::random_access_iterator_tag,
                                          tag<It>>;
 
+// true if every iterator is a random access one, used by algorithms taking
+// several ranges which are only parallel when all of them are
+template<class... It>
+struct isRandomAccessIts : std::true_type {};
+
+template<class It, class... Rest>
+struct isRandomAccessIts<It, Rest...>
+  : std::integral_constant<bool, isRandomAccessIt<It>::value &&
+                                 isRandomAccessIts<Rest...>::value> {};
+
+template<class... It>
+using rangesTag = typename std::conditional<isRandomAccessIts<It...>::value,
+                                            std::random_access_iterator_tag,
+                                            std::input_iterator_tag>::type;
+
 template<class ExecutionPolicy>
 using isExecutionPolicy =
         is_execution_policy<typename std::decay<ExecutionPolicy>::type>;
@@ -48,5 +63,39 @@ inline std::bounds_iterator<N>
 get_pointer(std::bounds_iterator<N> it) { return it; }
 
 
+// get an array_view of N elements starting at an iterator
+//
+// host iterators are wrapped into a new array_view over host memory, which
+// is copied to the device on launch and synchronized back to the host when
+// the view is destroyed; device iterators return a section of the view they
+// hold, so no host transfer happens
+template<typename T, typename Iterator>
+inline hc::array_view<T>
+get_view(Iterator it, size_t N) {
+  return hc::array_view<T>(hc::extent<1>(N), get_pointer(it));
+}
+
+template<typename T, typename U>
+inline hc::array_view<T>
+get_view(const device_iterator<U>& it, size_t N) { return it.get_view(N); }
+
+// get an array_view of N elements to be overwritten by a kernel
+//
+// the previous content of host memory is discarded so it is not copied to
+// the device; device iterators are left untouched because discarding a
+// section would invalidate the whole underlying buffer
+template<typename T, typename Iterator>
+inline hc::array_view<T>
+get_output_view(Iterator it, size_t N) {
+  hc::array_view<T> av = get_view<T>(it, N);
+  av.discard_data();
+  return av;
+}
+
+template<typename T, typename U>
+inline hc::array_view<T>
+get_output_view(const device_iterator<U>& it, size_t N) { return it.get_view(N); }
+
+
 } // namespace utils
 
@@ -80,6 +80,12 @@ using runtime_exception = Kalmar::runtime_exception;
 using invalid_compute_domain = Kalmar::invalid_compute_domain;
 using accelerator_view_removed = Kalmar::accelerator_view_removed;
 
+/**
+ * Counts of the runtime events of hcRuntimeCounter, indexed by the counter,
+ * with to_json() to dump them.
+ */
+using runtime_counters = Kalmar::RuntimeCounterValues;
+
 // ------------------------------------------------------------------------
 // global functions
 // ------------------------------------------------------------------------
@@ -103,6 +109,33 @@ inline uint64_t get_tick_frequency() {
     return Kalmar::getContext()->getSystemTickFrequency();
 }
 
+/**
+ * Start or stop the profiling of the kernels and copies of all the
+ * accelerators.  The profiler aggregates the durations per kernel name and
+ * launch configuration, and the copies per direction, and reports them at
+ * exit.  HCC_PROFILE=1 (or csv) starts it with the process, HCC_PROFILE_FILE
+ * redirects the report from stderr to a file.
+ */
+inline void set_profiling(bool enable) {
+    Kalmar::KernelProfiler::get().enable(enable);
+}
+
+/**
+ * Get the report of the profiler so far.
+ *
+ * @param[in] csv CSV rather than a table sorted by the total kernel time.
+ */
+inline std::string get_profile_report(bool csv = false) {
+    return Kalmar::KernelProfiler::get().report(csv);
+}
+
+/**
+ * Clear the kernels and copies recorded by the profiler.
+ */
+inline void reset_profile() {
+    Kalmar::KernelProfiler::get().reset();
+}
+
 #define GET_SYMBOL_ADDRESS(acc, symbol) \
     acc.get_symbol_address( #symbol );
 
@@ -214,9 +247,31 @@ public:
      *                     default it would be hcWaitModeBlocked.
      *                     hcWaitModeActive would be used to reduce latency with
      *                     the expense of using one CPU core for active waiting.
+     *                     hcWaitModeAdaptive spins for a budget learned from
+     *                     recent waits, then yields, then blocks.
      */
     void wait(hcWaitMode waitMode = hcWaitModeBlocked) { pQueue->wait(waitMode); }
 
+    /**
+     * Sets the wait mode used for blocked waits on this accelerator_view and
+     * on the completion_future objects of its commands: with
+     * hcWaitModeAdaptive, waits requested with hcWaitModeBlocked (the
+     * default) spin briefly before blocking. The initial mode is given by the
+     * HCC_WAIT_MODE environment variable.
+     *
+     * @param waitMode[in] hcWaitModeBlocked or hcWaitModeAdaptive.
+     */
+    void set_wait_mode(hcWaitMode waitMode) {
+        if (waitMode != hcWaitModeActive) {
+            pQueue->set_wait_mode(waitMode);
+        }
+    }
+
+    /**
+     * Returns the wait mode used for blocked waits on this accelerator_view.
+     */
+    hcWaitMode get_wait_mode() const { return pQueue->get_wait_mode(); }
+
     /**
      * Sends the queued up commands in the accelerator_view to the device for
      * execution.
@@ -415,6 +470,36 @@ public:
                                      hcCommandKind copyDir, const hc::AmPointerInfo &srcInfo, const hc::AmPointerInfo &dstInfo, 
                                      const hc::accelerator *copyAcc);
 
+    /**
+     * Allocates size_bytes bytes of device memory for the commands enqueued
+     * to this accelerator_view from now on, without synchronizing with the host.
+     *
+     * The memory comes from a pool of the accelerator_view holding the memory
+     * released with free_async.  On an execute_in_order accelerator_view, memory
+     * released by free_async is reused right away, since the commands using the
+     * new allocation execute after the ones using the freed memory.  Otherwise
+     * it is reused once the commands enqueued before free_async have completed.
+     * The pool keeps up to HCC_ASYNC_POOL_SIZE MB of freed memory.
+     *
+     * The memory can be used like memory of am_alloc, but is released with
+     * free_async: am_free rejects it.  Memory still allocated when the
+     * accelerator_view is destroyed is left to am_free.
+     *
+     * @return A pointer to the memory, or nullptr if it could not be allocated
+     *         or the accelerator_view does not support it.
+     */
+    void* alloc_async(size_t size_bytes) { return pQueue->allocAsync(size_bytes); }
+
+    /**
+     * Releases memory of alloc_async once the commands enqueued to this
+     * accelerator_view so far have completed.  The call returns right away,
+     * the commands may still use the memory.
+     *
+     * A runtime exception is thrown if ptr was not allocated with alloc_async on
+     * this accelerator_view.
+     */
+    void free_async(void* ptr) { pQueue->freeAsync(ptr); }
+
     /**
      * Compares "this" accelerator_view with the passed accelerator_view object
      * to determine if they represent the same underlying object.
@@ -605,11 +690,62 @@ public:
         pQueue->dispatch_hsa_kernel(aql, args, argsize, cf);
     }
 
+    /**
+     * Makes the commands held back by a batch_scope visible to the device.
+     * Same as flush().
+     */
     void ring_doorbell()
     {
         pQueue->ring_doorbell();
     }
 
+    /**
+     * Coalesces the doorbell rings of the commands dispatched into an
+     * accelerator_view while the scope is alive.
+     *
+     * Every command written to an HSA queue is normally followed by a
+     * doorbell ring, a write to uncached memory which notifies the packet
+     * processor. Within a batch_scope the commands are written into the queue
+     * right away but their doorbell is rung once for several of them:
+     *  - when @p max_packets commands are pending,
+     *  - when the oldest pending command has waited @p max_microseconds, as
+     *    seen by the next dispatch,
+     *  - at the exit of the outermost batch_scope,
+     *  - on flush(), ring_doorbell(), wait() or when waiting for the
+     *    completion_future of a pending command.
+     * Markers and copies are never held back and also release the pending
+     * commands. A zero limit disables the corresponding limit.
+     *
+     * Scopes may be nested, the innermost policy applies. Commands which are
+     * not waited on still execute eventually, but only after one of the
+     * events above.
+     *
+     * @code
+     * {
+     *     hc::accelerator_view::batch_scope batch(av, 32);
+     *     for (int i = 0; i < n; ++i)
+     *         hc::parallel_for_each(av, ext, kernel);
+     * } // the remaining commands are rung here
+     * @endcode
+     */
+    class batch_scope {
+    public:
+        explicit batch_scope(const accelerator_view& av,
+                             uint32_t max_packets = 64,
+                             uint32_t max_microseconds = 100)
+            : pQueue(av.pQueue) {
+            pQueue->begin_batch(max_packets, max_microseconds);
+        }
+
+        ~batch_scope() { pQueue->end_batch(); }
+
+        batch_scope(const batch_scope&) = delete;
+        batch_scope& operator=(const batch_scope&) = delete;
+
+    private:
+        std::shared_ptr<Kalmar::KalmarQueue> pQueue;
+    };
+
     /**
      * Set a CU affinity to specific command queues. 
      * The setting is permanent until the queue is destroyed or CU affinity is
@@ -632,6 +768,19 @@ public:
         return false;
      }
 
+    /**
+     * Get the counts of the runtime events of this accelerator_view since it
+     * was created: the waits forced by too many commands in flight, the
+     * system-scope markers inserted for HCC_OPT_FLUSH and the hardware queues
+     * taken from it.  The pool growths and the unpinned copies are only
+     * counted on the accelerator, see accelerator::get_runtime_counters.
+     *
+     * The counters are always kept, HCC_DB is not needed.
+     */
+    runtime_counters get_runtime_counters() const {
+        return pQueue->getRuntimeCounters();
+    }
+
 private:
     accelerator_view(std::shared_ptr<Kalmar::KalmarQueue> pQueue) : pQueue(pQueue) {}
     std::shared_ptr<Kalmar::KalmarQueue> pQueue;
@@ -1116,6 +1265,43 @@ public:
         return pDev->has_cpu_accessible_am();
     };
 
+    /**
+     * Set how a CPU accelerator runs kernels on a NUMA host.
+     *
+     * @p policy places the pages of the arrays of at least 1 MB created from
+     * now on: hcNumaPolicyFirstTouch on the node of the kernel worker which
+     * computes on their rows, hcNumaPolicyInterleave spread over the nodes.
+     * @p pin_workers runs each kernel worker on a CPU of its own, consecutive
+     * workers on the same node, so that the first-touch placement holds.
+     * The settings are shared by the CPU accelerators of the process, and
+     * default to HCC_CPU_NUMA_POLICY and HCC_CPU_PIN_WORKERS.
+     *
+     * @return false if the accelerator is not a CPU accelerator.
+     */
+    bool set_cpu_numa_policy(hcNumaPolicy policy, bool pin_workers = true) {
+        return pDev->setNumaPolicy(policy, pin_workers);
+    }
+
+    /**
+     * Return the placement of the arrays of a CPU accelerator, see
+     * set_cpu_numa_policy.  hcNumaPolicyNone for the other accelerators.
+     */
+    hcNumaPolicy get_cpu_numa_policy() const {
+        return pDev->getNumaPolicy();
+    }
+
+    /**
+     * Get the counts of the runtime events of this accelerator and all its
+     * accelerator_views since the start of the process, see hcRuntimeCounter.
+     * The signal pool is shared by the accelerators, so its growths are
+     * counted for the process.  All the counts are 0 on the CPU accelerator.
+     *
+     * The counters are always kept, HCC_DB is not needed.
+     */
+    runtime_counters get_runtime_counters() const {
+        return pDev->getRuntimeCounters();
+    }
+
     Kalmar::KalmarDevice *get_dev_ptr() const { return pDev; }; 
 
 private:
@@ -1144,7 +1330,7 @@ public:
      * object which does not refer to any asynchronous operation. Default
      * constructed completion_future objects have valid() == false
      */
-    completion_future() : __amp_future(), __thread_then(nullptr), __asyncOp(nullptr) {};
+    completion_future() : __amp_future(), __asyncOp(nullptr) {};
 
     /**
      * Copy constructor. Constructs a new completion_future object that referes
@@ -1154,7 +1340,7 @@ public:
      *                  initialize this.
      */
     completion_future(const completion_future& other)
-        : __amp_future(other.__amp_future), __thread_then(other.__thread_then), __asyncOp(other.__asyncOp) {}
+        : __amp_future(other.__amp_future), __asyncOp(other.__asyncOp) {}
 
     /**
      * Move constructor. Move constructs a new completion_future object that
@@ -1166,7 +1352,7 @@ public:
      *                  completion_future
      */
     completion_future(completion_future&& other)
-        : __amp_future(std::move(other.__amp_future)), __thread_then(other.__thread_then), __asyncOp(other.__asyncOp) {}
+        : __amp_future(std::move(other.__amp_future)), __asyncOp(other.__asyncOp) {}
 
     /**
      * Copy assignment. Copy assigns the contents of other to this. This method
@@ -1179,7 +1365,6 @@ public:
     completion_future& operator=(const completion_future& _Other) {
         if (this != &_Other) {
            __amp_future = _Other.__amp_future;
-           __thread_then = _Other.__thread_then;
            __asyncOp = _Other.__asyncOp;
         }
         return (*this);
@@ -1197,7 +1382,6 @@ public:
     completion_future& operator=(completion_future&& _Other) {
         if (this != &_Other) {
             __amp_future = std::move(_Other.__amp_future);
-            __thread_then = _Other.__thread_then;
            __asyncOp = _Other.__asyncOp;
         }
         return (*this);
@@ -1237,14 +1421,18 @@ public:
      * std::shared_future<void> member methods with same names.
      *
      * @param waitMode[in] An optional parameter to specify the wait mode. By
-     *                     default it would be hcWaitModeBlocked.
+     *                     default it would be hcWaitModeBlocked, or the wait
+     *                     mode of the accelerator_view of the operation.
      *                     hcWaitModeActive would be used to reduce latency with
      *                     the expense of using one CPU core for active waiting.
+     *                     hcWaitModeAdaptive spins for a budget learned from
+     *                     recent waits, then yields, then blocks.
      */
     void wait(hcWaitMode mode = hcWaitModeBlocked) const {
         if (this->valid()) {
             if (__asyncOp != nullptr) {
-                __asyncOp->setWaitMode(mode);
+                Kalmar::KalmarQueue* queue = __asyncOp->getQueue();
+                __asyncOp->setWaitMode(queue ? queue->resolve_wait_mode(mode) : mode);
             }   
             //TODO-ASYNC - need to reclaim older AsyncOps here.
             __amp_future.wait();
@@ -1277,6 +1465,11 @@ public:
      * executed upon completion of the asynchronous operation associated with
      * this completion_future object. The completion callback func should have
      * an operator() that is valid when invoked with non arguments, i.e., "func()".
+     *
+     * func is copied and run on a thread of the runtime shared by all the
+     * callbacks, in the order the operations complete; the callbacks attached
+     * to one operation run in the order they were attached. A callback should
+     * not block on the completion of another callback.
      */
     // FIXME: notice we removed const from the signature here
     //        the original signature in the specification should be
@@ -1285,14 +1478,8 @@ public:
     template<typename functor>
     void then(const functor & func) {
 #if __KALMAR_ACCELERATOR__ != 1
-      // could only assign once
-      if (__thread_then == nullptr) {
-        // spawn a new thread to wait on the future and then execute the callback functor
-        __thread_then = new std::thread([&]() __CPU__ {
-          this->wait();
-          if(this->valid())
-            func();
-        });
+      if (this->valid()) {
+        Kalmar::addCompletionCallback(__asyncOp, __amp_future, std::function<void()>(func));
       }
 #endif
     }
@@ -1370,12 +1557,6 @@ public:
     }
 
     ~completion_future() {
-      if (__thread_then != nullptr) {
-        __thread_then->join();
-      }
-      delete __thread_then;
-      __thread_then = nullptr;
-      
       if (__asyncOp != nullptr) {
         __asyncOp = nullptr;
       }
@@ -1389,13 +1570,12 @@ public:
 
 private:
     std::shared_future<void> __amp_future;
-    std::thread* __thread_then = nullptr;
     std::shared_ptr<Kalmar::KalmarAsyncOp> __asyncOp;
 
     completion_future(std::shared_ptr<Kalmar::KalmarAsyncOp> event) : __amp_future(*(event->getFuture())), __asyncOp(event) {}
 
     completion_future(const std::shared_future<void> &__future)
-        : __amp_future(__future), __thread_then(nullptr), __asyncOp(nullptr) {}
+        : __amp_future(__future), __asyncOp(nullptr) {}
 
     friend class Kalmar::HSAQueue;
     
@@ -3760,6 +3940,7 @@ struct cpu_helper<K, Kernel, K>
 
 template <typename Kernel, int N>
 void partitioned_task(const Kernel& ker, const extent<N>& ext, int part) {
+    Kalmar::pinCpuWorker(part, Kalmar::NTHREAD);
     index<N> idx;
     int start = ext[0] * part / Kalmar::NTHREAD;
     int end = ext[0] * (part + 1) / Kalmar::NTHREAD;
@@ -3771,6 +3952,7 @@ void partitioned_task(const Kernel& ker, const extent<N>& ext, int part) {
 
 template <typename Kernel>
 void partitioned_task_tile_1D(Kernel const& f, tiled_extent<1> const& ext, int part) {
+    Kalmar::pinCpuWorker(part, Kalmar::NTHREAD);
     int D0 = ext.tile_dim[0];
     int start = (ext[0] / D0) * part / Kalmar::NTHREAD;
     int end = (ext[0] / D0) * (part + 1) / Kalmar::NTHREAD;
@@ -3803,6 +3985,7 @@ void partitioned_task_tile_1D(Kernel const& f, tiled_extent<1> const& ext, int p
 
 template <typename Kernel>
 void partitioned_task_tile_2D(Kernel const& f, tiled_extent<2> const& ext, int part) {
+    Kalmar::pinCpuWorker(part, Kalmar::NTHREAD);
     int D0 = ext.tile_dim[0];
     int D1 = ext.tile_dim[1];
     int start = (ext[0] / D0) * part / Kalmar::NTHREAD;
@@ -3839,6 +4022,7 @@ void partitioned_task_tile_2D(Kernel const& f, tiled_extent<2> const& ext, int p
 
 template <typename Kernel>
 void partitioned_task_tile_3D(Kernel const& f, tiled_extent<3> const& ext, int part) {
+    Kalmar::pinCpuWorker(part, Kalmar::NTHREAD);
     int D0 = ext.tile_dim[0];
     int D1 = ext.tile_dim[1];
     int D2 = ext.tile_dim[2];
@@ -3879,11 +4063,31 @@ void partitioned_task_tile_3D(Kernel const& f, tiled_extent<3> const& ext, int p
     delete [] tidx;
 }
 
+// grid and tile sizes of a launch for the profiler, x (the last index) first
+template <int N>
+Kalmar::KernelDims cpu_kernel_dims(extent<N> const& ext)
+{
+    Kalmar::KernelDims dims;
+    dims.dims = N < 3 ? N : 3;
+    for (int i = 0; i < dims.dims; ++i)
+        dims.grid[i] = ext[N - 1 - i];
+    return dims;
+}
+
+template <int N>
+Kalmar::KernelDims cpu_kernel_dims(tiled_extent<N> const& ext)
+{
+    Kalmar::KernelDims dims = cpu_kernel_dims(static_cast<extent<N> const&>(ext));
+    for (int i = 0; i < dims.dims; ++i)
+        dims.tile[i] = ext.tile_dim[N - 1 - i];
+    return dims;
+}
+
 template <typename Kernel, int N>
 completion_future launch_cpu_task_async(const std::shared_ptr<Kalmar::KalmarQueue>& pQueue, Kernel const& f,
                      extent<N> const& compute_domain)
 {
-    Kalmar::CPUKernelRAII<Kernel> obj(pQueue, f);
+    Kalmar::CPUKernelRAII<Kernel> obj(pQueue, f, cpu_kernel_dims(compute_domain));
     for (int i = 0; i < Kalmar::NTHREAD; ++i)
         obj[i] = std::thread(partitioned_task<Kernel, N>, std::cref(f), std::cref(compute_domain), i);
     // FIXME wrap the above operation into the completion_future object
@@ -3894,7 +4098,7 @@ template <typename Kernel>
 completion_future launch_cpu_task_async(const std::shared_ptr<Kalmar::KalmarQueue>& pQueue, Kernel const& f,
                      tiled_extent<1> const& compute_domain)
 {
-    Kalmar::CPUKernelRAII<Kernel> obj(pQueue, f);
+    Kalmar::CPUKernelRAII<Kernel> obj(pQueue, f, cpu_kernel_dims(compute_domain));
     for (int i = 0; i < Kalmar::NTHREAD; ++i)
         obj[i] = std::thread(partitioned_task_tile_1D<Kernel>,
                              std::cref(f), std::cref(compute_domain), i);
@@ -3906,7 +4110,7 @@ template <typename Kernel>
 completion_future launch_cpu_task_async(const std::shared_ptr<Kalmar::KalmarQueue>& pQueue, Kernel const& f,
                      tiled_extent<2> const& compute_domain)
 {
-    Kalmar::CPUKernelRAII<Kernel> obj(pQueue, f);
+    Kalmar::CPUKernelRAII<Kernel> obj(pQueue, f, cpu_kernel_dims(compute_domain));
     for (int i = 0; i < Kalmar::NTHREAD; ++i)
         obj[i] = std::thread(partitioned_task_tile_2D<Kernel>,
                              std::cref(f), std::cref(compute_domain), i);
@@ -3918,7 +4122,7 @@ template <typename Kernel>
 completion_future launch_cpu_task_async(const std::shared_ptr<Kalmar::KalmarQueue>& pQueue, Kernel const& f,
                      tiled_extent<3> const& compute_domain)
 {
-    Kalmar::CPUKernelRAII<Kernel> obj(pQueue, f);
+    Kalmar::CPUKernelRAII<Kernel> obj(pQueue, f, cpu_kernel_dims(compute_domain));
     for (int i = 0; i < Kalmar::NTHREAD; ++i)
         obj[i] = std::thread(partitioned_task_tile_3D<Kernel>,
                              std::cref(f), std::cref(compute_domain), i);
@@ -7537,6 +7741,30 @@ completion_future parallel_for_each(const tiled_extent<1>& compute_domain, const
     return parallel_for_each(accelerator::get_auto_selection_view(), compute_domain, f, lastKernel);
 }
 
+template <int N, typename Kernel>
+completion_future parallel_for_each(const accelerator_view& av, const extent<N>& compute_domain, const Kernel& f) {
+    uint32_t lastKernel = 1;
+    return parallel_for_each(av, compute_domain, f, lastKernel);
+}
+
+template <typename Kernel>
+completion_future parallel_for_each(const accelerator_view& av, const tiled_extent<3>& compute_domain, const Kernel& f) {
+    uint32_t lastKernel = 1;
+    return parallel_for_each(av, compute_domain, f, lastKernel);
+}
+
+template <typename Kernel>
+completion_future parallel_for_each(const accelerator_view& av, const tiled_extent<2>& compute_domain, const Kernel& f) {
+    uint32_t lastKernel = 1;
+    return parallel_for_each(av, compute_domain, f, lastKernel);
+}
+
+template <typename Kernel>
+completion_future parallel_for_each(const accelerator_view& av, const tiled_extent<1>& compute_domain, const Kernel& f) {
+    uint32_t lastKernel = 1;
+    return parallel_for_each(av, compute_domain, f, lastKernel);
+}
+
 template <int N, typename Kernel, typename _Tp>
 struct pfe_helper
 {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "hc.hpp"
+#include "kalmar_alloc_cache.h"
 #include <initializer_list>
 
 typedef int am_status_t;
@@ -65,6 +66,15 @@ namespace hc {
  * Flags:
  *  amHostPinned : Allocated pinned host memory and map it into the address space of the specified accelerator.
  *
+ * If HCC_AM_SLAB_MAX_SIZE is set, device memory blocks up to that many KB (64 at most)
+ * are sub-allocated from larger slabs.  Such a block is not the start of an
+ * HSA allocation: it can't be exported with hsa_amd_ipc_memory_create, and
+ * mapping it to peers with am_map_to_peers maps its whole slab.
+ *
+ * On the CPU accelerator (HCC_RUNTIME=CPU), the block is host memory, tracked
+ * like device memory: am_memtracker_getinfo, am_copy, am_map_to_peers (a no-op)
+ * and accelerator_view::copy work on it as they do on a GPU.
+ *
  *
  * @return : On success, pointer to the newly allocated memory is returned.
  * The pointer is typecast to the desired return type.
@@ -78,11 +88,25 @@ auto_voidp am_alloc(size_t size, hc::accelerator &acc, unsigned flags);
 /**
  * Free a block of memory previously allocated with am_alloc.
  *
- * @return AM_SUCCESS
+ * Memory of accelerator_view::alloc_async belongs to the pool of its
+ * accelerator_view, and is released with accelerator_view::free_async: am_free
+ * rejects it as long as the accelerator_view exists.
+ *
+ * @return AM_SUCCESS, or AM_ERROR_MISC if @p ptr is not memory of am_alloc
  * @see am_alloc, am_copy
  */
 am_status_t am_free(void*  ptr);
 
+/** \cond HIDDEN_SYMBOLS */
+/**
+ * Mark memory of am_alloc as a block of the pool of alloc_async, which am_free
+ * rejects, or give it back to am_free if @p owned is false.
+ *
+ * @return AM_SUCCESS, or AM_ERROR_MISC if @p ptr is not memory of am_alloc
+ */
+am_status_t am_memtracker_set_pool_owned(void* ptr, bool owned);
+/** \endcond */
+
 
 /**
  * Copy @p size bytes of memory from @p src to @ dst.  The memory areas (src+size and dst+size) must not overlap.
@@ -194,6 +218,10 @@ am_status_t am_map_to_peers(void* ptr, size_t num_peer, const hc::accelerator* p
  * @p size size of hostPtr to be page-locked
  * @p visibleAc pointer to hcc accelerators to which the hostPtr should be visible
  * @p numVisibleAc number of elements in visibleAc
+ *
+ * On the CPU accelerator, the range is only tracked and mlock'ed, as far as
+ * RLIMIT_MEMLOCK allows.
+ *
  * @return AM_SUCCESS if lock is successfully.
  * @return AM_ERROR_MISC if lock is unsuccessful.
  */
@@ -209,6 +237,63 @@ am_status_t am_memory_host_lock(hc::accelerator &ac, void *hostPtr, size_t size,
  */
 am_status_t am_memory_host_unlock(hc::accelerator &ac, void *hostPtr);
 
+/*
+ * Counters of the cache of host memory pinned by the runtime for copies
+ */
+typedef Kalmar::PinnedHostCacheStats AmPinnedHostCacheStats;
+
+/*
+ * Drop the host memory pinned by the runtime for copies in a range
+ *
+ * With HCC_PIN_CACHE_SIZE > 0 the runtime keeps the host memory of unpinned
+ * copies pinned for later copies.  Call this before unmapping or freeing host
+ * memory which has been copied from or to: otherwise a later allocation at the
+ * same address would be copied with the pages of the freed memory.
+ * am_memory_host_unlock does this for the unlocked range.  By default ranges
+ * are unpinned as soon as their copies complete and this is not needed.
+ *
+ * @p hostPtr start of the host memory range
+ * @p size size of the range
+ * @return AM_SUCCESS
+ */
+am_status_t am_memory_host_cache_invalidate(const void *hostPtr, size_t size);
+
+/*
+ * Get the counters of the pinned host memory cache of an accelerator
+ *
+ * @p ac accelerator
+ * @p stats pointer to the counters to write
+ * @return AM_SUCCESS if the counters were written.
+ * @return AM_ERROR_MISC if @p stats is NULL or @p ac has no pinned host memory cache.
+ */
+am_status_t am_memory_host_cache_stats(const hc::accelerator &ac, AmPinnedHostCacheStats *stats);
+
+/*
+ * Counters of the cache of blocks freed with am_free
+ */
+typedef Kalmar::AllocCacheStats AmAllocCacheStats;
+
+/*
+ * Get the counters of the am_alloc cache
+ *
+ * The cache is enabled by setting HCC_AM_CACHE_SIZE to the number of MB of
+ * freed blocks to keep for later am_alloc calls.
+ *
+ * @p stats pointer to the counters to write
+ * @return AM_SUCCESS if the counters were written.
+ * @return AM_ERROR_MISC if @p stats is NULL or the cache is disabled.
+ */
+am_status_t am_alloc_cache_stats(AmAllocCacheStats *stats);
+
+/*
+ * Free the blocks held by the am_alloc cache, e.g. before allocating memory
+ * outside of am_alloc.  am_alloc does this itself when a pool runs out of
+ * memory.
+ *
+ * @return AM_SUCCESS
+ */
+am_status_t am_alloc_cache_trim();
+
 
 }; // namespace hc
 
@@ -0,0 +1,282 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// counters of an AllocCache
+struct AllocCacheStats {
+    uint64_t hits;        ///< allocations served by a cached block
+    uint64_t misses;      ///< allocations which went to the backend
+    uint64_t bypassed;    ///< allocations too large to be cached
+    uint64_t evictions;   ///< cached blocks freed to stay under the size cap
+    uint64_t trims;       ///< backend failures which made the cache free its blocks
+    uint64_t failures;    ///< allocations the backend failed even after a trim
+    size_t   blocksCached;///< free blocks currently held
+    size_t   bytesCached; ///< bytes of the free blocks currently held
+    size_t   bytesInUse;  ///< bytes of the blocks handed out and not released
+};
+
+/// Size of the size class of @p size bytes: 4 classes per power of two above
+/// @p minBlock, a power of two.
+inline size_t allocSizeClass(size_t size, size_t minBlock) {
+    if (size <= minBlock) {
+        return minBlock;
+    }
+    size_t pow2 = minBlock;
+    while (pow2 < size) {
+        pow2 <<= 1;
+    }
+    size_t step = pow2 / 8;
+    return (size + step - 1) / step * step;
+}
+
+/// Cache of freed memory blocks, binned by size class.
+///
+/// Allocating from and freeing to the driver costs a system call each time,
+/// and for host memory the mapping of the block to every agent.  The cache
+/// keeps released blocks and hands them out again to requests of the same
+/// key and size class.  A key identifies where the memory comes from (the
+/// pool, the accelerator and the allocation flags); blocks are never shared
+/// across keys.
+///
+/// Sizes are rounded up to a size class: 4 classes per power of two, so at
+/// most 25% of a block is wasted, and no class is smaller than @p minBlock.
+/// Requests above @p maxBlock are passed through to the backend.  The free
+/// blocks are freed in least recently released order when their bytes exceed
+/// the cap, and all of them when the backend runs out of memory, before the
+/// allocation is retried.
+///
+/// @p Backend provides:
+///   typedef ... Key;                              // ordered with <
+///   void* allocate(const Key& key, size_t size);  // nullptr on failure
+///   void free(const Key& key, void* ptr);
+template <typename Backend>
+class AllocCache {
+public:
+    typedef typename Backend::Key Key;
+
+    AllocCache(const Backend& backend, size_t maxBytes, size_t maxBlock, size_t minBlock = 4096)
+        : backend(backend), maxBytes(maxBytes), maxBlock(maxBlock), minBlock(minBlock), stats() {}
+
+    ~AllocCache() {
+        for (auto& b : lru) {
+            backend.free(b.bin->first.first, b.ptr);
+        }
+    }
+
+    AllocCache(const AllocCache&) = delete;
+    AllocCache& operator=(const AllocCache&) = delete;
+
+    /// Size of the block allocate() hands out for @p size bytes.
+    size_t blockSize(size_t size) const {
+        return (size > maxBlock) ? size : allocSizeClass(size, minBlock);
+    }
+
+    /// Allocate @p size bytes for @p key.  @p fresh is set when the block
+    /// comes from the backend rather than from the cache, so the caller has to
+    /// do the setup a block keeps across reuses (e.g. mapping it to peers).
+    void* allocate(const Key& key, size_t size, bool* fresh) {
+        size_t bsize = blockSize(size);
+        *fresh = true;
+
+        if (bsize > maxBlock) {
+            {
+                std::lock_guard<std::mutex> l(mutex);
+                stats.bypassed++;
+            }
+            void* ptr = backend.allocate(key, bsize);
+            if (ptr == nullptr && trim()) {
+                ptr = backend.allocate(key, bsize);
+            }
+            return ptr;
+        }
+
+        std::unique_lock<std::mutex> l(mutex);
+        BinIter bin = bins.insert(std::make_pair(BinKey(key, bsize), Bin())).first;
+        if (!bin->second.empty()) {
+            auto pos = bin->second.back();
+            bin->second.pop_back();
+            void* ptr = pos->ptr;
+            stats.bytesCached -= bsize;
+            lru.erase(pos);
+            stats.blocksCached = lru.size();
+            live[ptr] = bin;
+            stats.bytesInUse += bsize;
+            stats.hits++;
+            *fresh = false;
+            return ptr;
+        }
+        stats.misses++;
+        l.unlock();
+
+        void* ptr = backend.allocate(key, bsize);
+        if (ptr == nullptr && trim()) {
+            ptr = backend.allocate(key, bsize);
+        }
+
+        l.lock();
+        if (ptr == nullptr) {
+            stats.failures++;
+            return nullptr;
+        }
+        live[ptr] = bin;
+        stats.bytesInUse += bsize;
+        return ptr;
+    }
+
+    /// Return a block of allocate() to the cache.  Returns false, and leaves
+    /// the block alone, if it was not allocated through the cache.
+    bool release(void* ptr) {
+        std::lock_guard<std::mutex> l(mutex);
+
+        auto it = live.find(ptr);
+        if (it == live.end()) {
+            return false;
+        }
+        BinIter bin = it->second;
+        live.erase(it);
+        size_t bsize = bin->first.second;
+        stats.bytesInUse -= bsize;
+
+        auto pos = lru.insert(lru.end(), Block{ ptr, bin, bin->second.size() });
+        bin->second.push_back(pos);
+        stats.bytesCached += bsize;
+        stats.blocksCached = lru.size();
+
+        while (stats.bytesCached > maxBytes && !lru.empty()) {
+            evict(lru.begin());
+            stats.evictions++;
+        }
+        return true;
+    }
+
+    /// Free a block of allocate() to the backend instead of caching it, e.g.
+    /// because its setup failed.
+    void discard(const Key& key, void* ptr) {
+        {
+            std::lock_guard<std::mutex> l(mutex);
+            auto it = live.find(ptr);
+            if (it != live.end()) {
+                stats.bytesInUse -= it->second->first.second;
+                live.erase(it);
+            }
+        }
+        backend.free(key, ptr);
+    }
+
+    /// Free the cached blocks of the keys matching @p pred.  Returns the
+    /// number of blocks freed.
+    template <typename Pred>
+    size_t flush(Pred pred) {
+        std::lock_guard<std::mutex> l(mutex);
+        return flushLocked(pred);
+    }
+
+    /// Like flush(), and also forget the blocks of these keys still in use:
+    /// their owner frees them to the backend directly.
+    template <typename Pred>
+    size_t reset(Pred pred) {
+        std::lock_guard<std::mutex> l(mutex);
+
+        size_t count = flushLocked(pred);
+        for (auto it = live.begin(); it != live.end();) {
+            if (pred(it->second->first.first)) {
+                stats.bytesInUse -= it->second->first.second;
+                it = live.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return count;
+    }
+
+    /// Free all the cached blocks.  Returns whether there were any.
+    bool trim() {
+        std::lock_guard<std::mutex> l(mutex);
+
+        if (lru.empty()) {
+            return false;
+        }
+        while (!lru.empty()) {
+            evict(lru.begin());
+        }
+        stats.trims++;
+        return true;
+    }
+
+    AllocCacheStats getStats() {
+        std::lock_guard<std::mutex> l(mutex);
+        return stats;
+    }
+
+private:
+    struct Block;
+    typedef std::pair<Key, size_t> BinKey;
+    typedef std::vector<typename std::list<Block>::iterator> Bin;  // most recently released last
+    typedef typename std::map<BinKey, Bin>::iterator BinIter;
+
+    struct Block {
+        void* ptr;
+        BinIter bin;
+        size_t binPos;  // index in bin->second
+    };
+    typedef typename std::list<Block>::iterator BlockIter;
+
+    template <typename Pred>
+    size_t flushLocked(Pred pred) {
+        size_t count = 0;
+        for (auto it = lru.begin(); it != lru.end();) {
+            auto next = std::next(it);
+            if (pred(it->bin->first.first)) {
+                evict(it);
+                count++;
+            }
+            it = next;
+        }
+        return count;
+    }
+
+    // free a cached block to the backend
+    void evict(BlockIter pos) {
+        Bin& bin = pos->bin->second;
+        size_t i = pos->binPos;
+        bin[i] = bin.back();
+        bin[i]->binPos = i;
+        bin.pop_back();
+
+        backend.free(pos->bin->first.first, pos->ptr);
+        stats.bytesCached -= pos->bin->first.second;
+        lru.erase(pos);
+        stats.blocksCached = lru.size();
+    }
+
+    Backend backend;
+    const size_t maxBytes;
+    const size_t maxBlock;
+    const size_t minBlock;
+
+    std::mutex mutex;
+    std::map<BinKey, Bin> bins;
+    std::list<Block> lru;                        // free blocks, least recently released first
+    std::unordered_map<void*, BinIter> live;     // blocks handed out, and their bin
+    AllocCacheStats stats;
+};
+
+} // namespace Kalmar
+/** \endcond */
@@ -0,0 +1,206 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// Runs the continuations attached with completion_future::then().
+///
+/// All continuations run on a single dispatcher thread, in the order their
+/// operations complete; the continuations of one operation run in the order
+/// they were attached.  No thread is created per continuation.
+///
+/// An operation which can signal its own completion is asked to, through
+///   bool Op::notifyOnCompletion(void (*callback)(void*), void* data);
+/// which calls callback(data) once, from any thread, when the operation is
+/// done (possibly before returning), or returns false if it can't.  Those
+/// operations, and futures without an operation, are waited for by a waiter
+/// thread in the order they were added.
+class CompletionDispatcher {
+public:
+    typedef std::function<void()> Callback;
+
+    CompletionDispatcher() : done(false), pendingCount(0) {
+        worker = std::thread([this] { work(); });
+        waiter = std::thread([this] { waitFutures(); });
+    }
+
+    /// runs the continuations still pending before returning
+    ~CompletionDispatcher() {
+        {
+            std::unique_lock<std::mutex> l(mutex);
+            drained.wait(l, [this] { return pendingCount == 0; });
+            done = true;
+        }
+        readyCv.notify_all();
+        waitingCv.notify_all();
+        worker.join();
+        waiter.join();
+    }
+
+    CompletionDispatcher(const CompletionDispatcher&) = delete;
+    CompletionDispatcher& operator=(const CompletionDispatcher&) = delete;
+
+    /// run @p fn once @p future, which belongs to @p op if not null, is ready
+    template <typename Op>
+    void add(const std::shared_ptr<Op>& op, const std::shared_future<void>& future, Callback fn) {
+        if (!op) {
+            addWaiting(nullptr, future, std::vector<Callback>(1, std::move(fn)));
+            return;
+        }
+
+        Pending* p;
+        {
+            std::lock_guard<std::mutex> l(mutex);
+            pendingCount++;
+            auto it = pending.find(op.get());
+            if (it != pending.end()) {
+                // completion already requested, keep the order of attachment
+                it->second->callbacks.push_back(std::move(fn));
+                return;
+            }
+            p = new Pending{ this, op, future, std::vector<Callback>(1, std::move(fn)) };
+            pending[op.get()] = p;
+        }
+
+        // may complete right away, so not under the lock
+        if (!op->notifyOnCompletion(&CompletionDispatcher::complete, p)) {
+            std::vector<Callback> callbacks;
+            {
+                std::lock_guard<std::mutex> l(mutex);
+                pending.erase(op.get());
+                callbacks.swap(p->callbacks);
+                pendingCount -= callbacks.size();
+            }
+            addWaiting(p->op, p->future, std::move(callbacks));
+            delete p;
+        }
+    }
+
+    /// continuations attached and not run yet
+    size_t getPendingCount() {
+        std::lock_guard<std::mutex> l(mutex);
+        return pendingCount;
+    }
+
+private:
+    struct Pending {
+        CompletionDispatcher* self;
+        std::shared_ptr<void> op;       // kept alive until its continuations ran
+        std::shared_future<void> future;
+        std::vector<Callback> callbacks;
+    };
+
+    struct Ready {
+        std::shared_ptr<void> op;
+        std::vector<Callback> callbacks;
+    };
+
+    // called by the operation once it is done
+    static void complete(void* data) {
+        Pending* p = static_cast<Pending*>(data);
+        CompletionDispatcher* self = p->self;
+        {
+            std::lock_guard<std::mutex> l(self->mutex);
+            self->pending.erase(p->op.get());
+            self->ready.push_back(Ready{ std::move(p->op), std::move(p->callbacks) });
+        }
+        self->readyCv.notify_one();
+        delete p;
+    }
+
+    void addWaiting(const std::shared_ptr<void>& op, const std::shared_future<void>& future,
+                    std::vector<Callback> callbacks) {
+        {
+            std::lock_guard<std::mutex> l(mutex);
+            pendingCount += callbacks.size();
+            waiting.push_back(Waiting{ op, future, std::move(callbacks) });
+        }
+        waitingCv.notify_one();
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> l(mutex);
+        for (;;) {
+            readyCv.wait(l, [this] { return done || !ready.empty(); });
+            if (ready.empty()) {
+                return;
+            }
+            Ready r = std::move(ready.front());
+            ready.pop_front();
+            l.unlock();
+
+            for (auto& fn : r.callbacks) {
+                fn();
+            }
+            // the operation may be released here, not in the notifying thread
+            r.op.reset();
+
+            l.lock();
+            pendingCount -= r.callbacks.size();
+            if (pendingCount == 0) {
+                drained.notify_all();
+            }
+        }
+    }
+
+    void waitFutures() {
+        std::unique_lock<std::mutex> l(mutex);
+        for (;;) {
+            waitingCv.wait(l, [this] { return done || !waiting.empty(); });
+            if (waiting.empty()) {
+                return;
+            }
+            Waiting w = std::move(waiting.front());
+            waiting.pop_front();
+            l.unlock();
+
+            if (w.future.valid()) {
+                w.future.wait();
+            }
+
+            l.lock();
+            ready.push_back(Ready{ std::move(w.op), std::move(w.callbacks) });
+            readyCv.notify_one();
+        }
+    }
+
+    struct Waiting {
+        std::shared_ptr<void> op;
+        std::shared_future<void> future;
+        std::vector<Callback> callbacks;
+    };
+
+    std::mutex mutex;
+    std::condition_variable readyCv;
+    std::condition_variable waitingCv;
+    std::condition_variable drained;
+    std::unordered_map<const void*, Pending*> pending;  // completion requested, by operation
+    std::deque<Waiting> waiting;                         // waited for by the waiter thread
+    std::deque<Ready> ready;                             // to run by the worker, in order
+    bool done;
+    size_t pendingCount;
+
+    std::thread worker;
+    std::thread waiter;
+};
+
+} // namespace Kalmar
+/** \endcond */
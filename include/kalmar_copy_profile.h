@@ -0,0 +1,98 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// Fastest unpinned copy algorithm measured for copies of about sizeBytes.
+struct CopyChoice {
+    size_t sizeBytes;
+    int    mode;       // UnpinnedCopyEngine::CopyMode
+    double bandwidth;  // MB/s
+};
+
+/// Measurements of the unpinned copy algorithms for one device and
+/// direction, used by HCC_UNPINNED_COPY_MODE=4.
+///
+/// Profiles are saved as text lines "<key> <size> <mode> <MB/s>", where the
+/// key names the device, the NUMA nodes and the direction, so that the
+/// measurements of several devices share a file.
+class CopyProfile {
+public:
+    bool empty() const { return choices.empty(); }
+    const std::vector<CopyChoice>& get() const { return choices; }
+
+    void add(const CopyChoice& c) {
+        auto it = std::upper_bound(choices.begin(), choices.end(), c,
+                                   [](const CopyChoice& a, const CopyChoice& b) { return a.sizeBytes < b.sizeBytes; });
+        choices.insert(it, c);
+    }
+
+    /// algorithm for a copy of @p sizeBytes: the one of the measured size
+    /// closest on a log scale, @p fallback if nothing was measured
+    int choose(size_t sizeBytes, int fallback) const {
+        if (choices.empty()) {
+            return fallback;
+        }
+        size_t i = 0;
+        while ((i + 1 < choices.size()) &&
+               (sizeBytes >= std::sqrt(double(choices[i].sizeBytes) * choices[i + 1].sizeBytes))) {
+            i++;
+        }
+        return choices[i].mode;
+    }
+
+    /// add the lines of @p key read from @p in, whose mode @p allowed(mode)
+    /// accepts; returns whether the profile has any measurement
+    template <typename Allowed>
+    bool load(std::istream& in, const std::string& key, Allowed allowed) {
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, key.size() + 1, key + " ") != 0) {
+                continue;
+            }
+            std::istringstream fields(line.substr(key.size() + 1));
+            CopyChoice c;
+            if ((fields >> c.sizeBytes >> c.mode >> c.bandwidth) && (c.sizeBytes > 0) && allowed(c.mode)) {
+                add(c);
+            }
+        }
+        return !choices.empty();
+    }
+
+    /// copy the lines of @p in other than those of @p key to @p out, followed
+    /// by the measurements of this profile under @p key
+    bool save(std::istream& in, std::ostream& out, const std::string& key) const {
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, key.size() + 1, key + " ") != 0) {
+                out << line << "\n";
+            }
+        }
+        for (const CopyChoice& c : choices) {
+            out << key << " " << c.sizeBytes << " " << c.mode << " " << c.bandwidth << "\n";
+        }
+        return bool(out);
+    }
+
+private:
+    std::vector<CopyChoice> choices;  // sorted by size
+};
+
+} // namespace Kalmar
+/** \endcond */
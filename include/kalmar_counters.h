@@ -0,0 +1,128 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+namespace Kalmar {
+namespace enums {
+
+/// events of the runtime which cost performance, counted by the accelerators
+/// and accelerator_views
+enum hcRuntimeCounter {
+    hcCounterSignalPoolGrowth = 0,   ///< completion signal pool grown (process-wide)
+    hcCounterKernargPoolGrowth = 1,  ///< kernel argument pool grown
+    hcCounterKernargNonPool = 2,     ///< kernel arguments too large for the pool, allocated apart
+    hcCounterInflightDrain = 3,      ///< queue waited on because it had too many commands in flight
+    hcCounterQueueSteal = 4,         ///< hardware queue taken away from an idle queue
+    hcCounterSysReleaseMarker = 5,   ///< system-scope marker inserted for HCC_OPT_FLUSH
+    hcCounterCopyH2DStaging = 6,     ///< unpinned host to device copy through staging buffers
+    hcCounterCopyH2DPinInPlace = 7,  ///< unpinned host to device copy pinning the host memory
+    hcCounterCopyH2DMemcpy = 8,      ///< unpinned host to device copy by the CPU (large BAR)
+    hcCounterCopyD2HStaging = 9,     ///< unpinned device to host copy through staging buffers
+    hcCounterCopyD2HPinInPlace = 10, ///< unpinned device to host copy pinning the host memory
+    hcCounterBufferBarrier = 11,     ///< barrier packet ordering a kernel after the kernels it shares buffers with, on any-order queues
+    hcCounterCount = 12
+};
+
+} // namespace enums
+} // namespace Kalmar
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// Values of the runtime counters at some point, see RuntimeCounters.
+struct RuntimeCounterValues {
+    uint64_t values[enums::hcCounterCount];
+
+    RuntimeCounterValues() : values() {}
+
+    uint64_t operator[](enums::hcRuntimeCounter counter) const { return values[counter]; }
+    uint64_t& operator[](enums::hcRuntimeCounter counter) { return values[counter]; }
+
+    RuntimeCounterValues& operator+=(const RuntimeCounterValues& other) {
+        for (int i = 0; i < enums::hcCounterCount; ++i)
+            values[i] += other.values[i];
+        return *this;
+    }
+
+    /// name of @p counter in to_json()
+    static const char* name(enums::hcRuntimeCounter counter) {
+        static const char* const names[enums::hcCounterCount] = {
+            "signal_pool_growth",
+            "kernarg_pool_growth",
+            "kernarg_non_pool",
+            "inflight_drain",
+            "queue_steal",
+            "sys_release_marker",
+            "copy_h2d_staging",
+            "copy_h2d_pin_in_place",
+            "copy_h2d_memcpy",
+            "copy_d2h_staging",
+            "copy_d2h_pin_in_place",
+            "buffer_barrier"
+        };
+        return (counter >= 0 && counter < enums::hcCounterCount) ? names[counter] : "unknown";
+    }
+
+    /// the counters as a JSON object, {"signal_pool_growth":0,...}
+    std::string to_json() const {
+        std::ostringstream os;
+        os << "{";
+        for (int i = 0; i < enums::hcCounterCount; ++i) {
+            os << (i ? "," : "") << "\"" << name(enums::hcRuntimeCounter(i)) << "\":" << values[i];
+        }
+        os << "}";
+        return os.str();
+    }
+};
+
+/// Counts the events of hcRuntimeCounter.
+///
+/// The counts only ever grow and are updated with relaxed atomics next to
+/// the event, which is always much more expensive than the increment, so
+/// they are kept whether or not anybody reads them.
+class RuntimeCounters {
+public:
+    RuntimeCounters() {
+        for (auto& c : counts)
+            c.store(0, std::memory_order_relaxed);
+    }
+
+    void add(enums::hcRuntimeCounter counter, uint64_t n = 1) {
+        counts[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t get(enums::hcRuntimeCounter counter) const {
+        return counts[counter].load(std::memory_order_relaxed);
+    }
+
+    /// add the current counts to @p values
+    void addTo(RuntimeCounterValues& values) const {
+        for (int i = 0; i < enums::hcCounterCount; ++i)
+            values.values[i] += counts[i].load(std::memory_order_relaxed);
+    }
+
+    RuntimeCounterValues snapshot() const {
+        RuntimeCounterValues values;
+        addTo(values);
+        return values;
+    }
+
+private:
+    RuntimeCounters(const RuntimeCounters&) = delete;
+    RuntimeCounters& operator=(const RuntimeCounters&) = delete;
+
+    std::atomic<uint64_t> counts[enums::hcCounterCount];
+};
+
+} // namespace Kalmar
+/** \endcond */
@@ -0,0 +1,75 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+
+#include "kalmar_aligned_alloc.h"
+#include "kalmar_huge_pages.h"
+#include "kalmar_numa.h"
+#include "kalmar_slab.h"
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// Memory of the arrays of the CPU accelerators (CPUDevice of every runtime,
+/// CPUFallbackDevice of the CPU runtime).
+///
+/// Small buffers come from slabs, large ones from huge pages (see
+/// getHugePageMinSize()), the others placed on the NUMA nodes from mappings of
+/// their own (see numaPlace()), and the rest from the heap.
+///
+/// Buffers up to 64 KB come from slabs, unless the runtime sets another size
+/// from its settings (HCC_SLAB_MAX_SIZE of the HSA runtime).
+class CPUBufferAllocator {
+public:
+    static const size_t DEFAULT_SLAB_MAX_SIZE = 64 * 1024;
+
+    CPUBufferAllocator()
+        : slab(AlignedSlabBackend(), DEFAULT_SLAB_MAX_SIZE),
+          huge(getHugePageMinSize(), getHugePageHugetlb()) {}
+
+    CPUBufferAllocator(const CPUBufferAllocator&) = delete;
+    CPUBufferAllocator& operator=(const CPUBufferAllocator&) = delete;
+
+    /// Largest buffer carved out of slabs, 0 disables them.  Set before the
+    /// first allocation.
+    void setSlabMaxSize(size_t bytes) {
+        slab.setMaxSize(bytes);
+    }
+
+    void* allocate(size_t count) {
+        void* ptr = slab.allocate(count);
+        if (ptr == nullptr) {
+            ptr = huge.allocate(count);
+            if (ptr == nullptr) {
+                ptr = numaPages.allocate(count);
+            }
+            if (ptr == nullptr) {
+                ptr = kalmar_aligned_alloc(0x1000, count);
+            }
+            // pages of large arrays placed for the kernel workers
+            numaPlace(ptr, count);
+        }
+        return ptr;
+    }
+
+    void free(void* ptr) {
+        if (!slab.free(ptr) && !huge.free(ptr) && !numaPages.free(ptr)) {
+            kalmar_aligned_free(ptr);
+        }
+    }
+
+private:
+    SlabAllocator<AlignedSlabBackend> slab;
+    HugePageAllocator huge;
+    NumaPageAllocator numaPages;
+};
+
+} // namespace Kalmar
+/** \endcond */
@@ -11,6 +11,8 @@
 #include "kalmar_runtime.h"
 #include "kalmar_serialize.h"
 
+#include <typeinfo>
+
 namespace Kalmar {
 template <int D0, int D1=0, int D2=0> class tiled_extent;
 
@@ -23,19 +25,28 @@ class CPUKernelRAII
     const std::shared_ptr<Kalmar::KalmarQueue> pQueue;
     const Kernel& f;
     std::vector<std::thread> th;
+    // for the profiler, begin is 0 when not profiling
+    KernelDims dims;
+    uint64_t begin;
 public:
-    CPUKernelRAII(const std::shared_ptr<Kalmar::KalmarQueue> pQueue, const Kernel& f)
-        : pQueue(pQueue), f(f), th(NTHREAD) {
+    CPUKernelRAII(const std::shared_ptr<Kalmar::KalmarQueue> pQueue, const Kernel& f,
+                  const KernelDims& dims = KernelDims())
+        : pQueue(pQueue), f(f), th(NTHREAD), dims(dims), begin(0) {
         CPUVisitor vis(pQueue);
         Serialize s(&vis);
         f.__cxxamp_serialize(s);
         CLAMP::enter_kernel();
+        if (profilingEnabled())
+            begin = KernelProfiler::now();
     }
     std::thread& operator[](int i) { return th[i]; }
     ~CPUKernelRAII() {
         for (auto& t : th)
             if (t.joinable())
                 t.join();
+        if (begin != 0)
+            KernelProfiler::get().recordKernel(typeid(Kernel).name(), dims, pQueue.get(),
+                                               KernelProfiler::now() - begin);
         CPUVisitor vis(pQueue);
         Serialize ss(&vis);
         f.__cxxamp_serialize(ss);
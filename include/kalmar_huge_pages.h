@@ -0,0 +1,186 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// counters of a HugePageAllocator
+struct HugePageStats {
+    uint64_t allocs;       ///< allocations backed by huge pages
+    uint64_t hugetlbAllocs;///< of which from the hugetlbfs pool
+    uint64_t fallbacks;    ///< hugetlbfs allocations which fell back to transparent huge pages
+    uint64_t frees;        ///< allocations unmapped
+    size_t   bytesMapped;  ///< bytes currently mapped, rounded to huge pages
+};
+
+/// Allocator of large host buffers backed by 2 MB pages.
+///
+/// Buffers of at least @p minSize bytes are mapped on their own, rounded up
+/// and aligned to 2 MB, so that the kernel can back them with huge pages and
+/// strided or random accesses miss the TLB far less often.  They use:
+///  - transparent huge pages, with madvise(MADV_HUGEPAGE), by default;
+///  - the hugetlbfs pool (MAP_HUGETLB) when @p hugetlb is set, falling back
+///    to transparent huge pages when the pool is exhausted.
+/// Smaller buffers, and any buffer off Linux, are left to the caller.
+class HugePageAllocator {
+public:
+    static const size_t HUGE_PAGE = 2 << 20;
+
+    HugePageAllocator(size_t minSize, bool hugetlb)
+        : minSize(minSize), hugetlb(hugetlb), stats() {}
+
+    ~HugePageAllocator() {
+        for (auto& m : maps) {
+            unmap(m.first, m.second);
+        }
+    }
+
+    HugePageAllocator(const HugePageAllocator&) = delete;
+    HugePageAllocator& operator=(const HugePageAllocator&) = delete;
+
+    /// Whether allocations of @p size bytes use huge pages.
+    bool handles(size_t size) const {
+#if defined(__linux__)
+        return minSize != 0 && size >= minSize;
+#else
+        return false;
+#endif
+    }
+
+    /// Allocate @p size bytes aligned to 2 MB.  Returns nullptr if the size
+    /// is not handled or the mapping failed.
+    void* allocate(size_t size) {
+        if (!handles(size)) {
+            return nullptr;
+        }
+        size_t bytes = (size + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+        bool fromPool = false;
+        void* ptr = nullptr;
+#if defined(__linux__)
+#if defined(MAP_HUGETLB)
+        if (hugetlb) {
+            ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            fromPool = (ptr != MAP_FAILED);
+        }
+#endif
+        if (!fromPool) {
+            ptr = mapAligned(bytes);
+            if (ptr == nullptr) {
+                return nullptr;
+            }
+#if defined(MADV_HUGEPAGE)
+            madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+        }
+#endif
+
+        std::lock_guard<std::mutex> l(mutex);
+        maps[ptr] = bytes;
+        stats.allocs++;
+        if (fromPool) {
+            stats.hugetlbAllocs++;
+        } else if (hugetlb) {
+            stats.fallbacks++;
+        }
+        stats.bytesMapped += bytes;
+        return ptr;
+    }
+
+    /// Free a buffer of allocate().  Returns false, and leaves the pointer
+    /// alone, if it was not allocated here.
+    bool free(void* ptr) {
+        size_t bytes;
+        {
+            std::lock_guard<std::mutex> l(mutex);
+            auto it = maps.find(ptr);
+            if (it == maps.end()) {
+                return false;
+            }
+            bytes = it->second;
+            maps.erase(it);
+            stats.frees++;
+            stats.bytesMapped -= bytes;
+        }
+        unmap(ptr, bytes);
+        return true;
+    }
+
+    HugePageStats getStats() {
+        std::lock_guard<std::mutex> l(mutex);
+        return stats;
+    }
+
+private:
+    // anonymous mapping of @p bytes aligned to a huge page: map one more huge
+    // page and trim both ends
+    static void* mapAligned(size_t bytes) {
+#if defined(__linux__)
+        size_t len = bytes + HUGE_PAGE;
+        void* raw = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            return nullptr;
+        }
+        uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned = (begin + HUGE_PAGE - 1) & ~uintptr_t(HUGE_PAGE - 1);
+        if (aligned != begin) {
+            munmap(raw, aligned - begin);
+        }
+        size_t tail = begin + len - (aligned + bytes);
+        if (tail != 0) {
+            munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+        }
+        return reinterpret_cast<void*>(aligned);
+#else
+        return nullptr;
+#endif
+    }
+
+    static void unmap(void* ptr, size_t bytes) {
+#if defined(__linux__)
+        munmap(ptr, bytes);
+#endif
+    }
+
+    const size_t minSize;
+    const bool hugetlb;
+
+    std::mutex mutex;
+    std::map<void*, size_t> maps;  // buffers and their mapped size
+    HugePageStats stats;
+};
+
+/// Smallest allocation of the CPU runtime backed by huge pages:
+/// HCC_HUGE_PAGE_MIN_SIZE MB, 4 by default, 0 disables the huge pages.
+inline size_t getHugePageMinSize() {
+    const char* env = getenv("HCC_HUGE_PAGE_MIN_SIZE");
+    long mb = env ? atol(env) : 4;
+    return (mb > 0) ? size_t(mb) << 20 : 0;
+}
+
+/// Whether the huge pages of the CPU runtime come from the hugetlbfs pool:
+/// HCC_HUGE_PAGE_HUGETLB=1.  Transparent huge pages otherwise.
+inline bool getHugePageHugetlb() {
+    const char* env = getenv("HCC_HUGE_PAGE_HUGETLB");
+    return env && atoi(env) != 0;
+}
+
+} // namespace Kalmar
+/** \endcond */
@@ -0,0 +1,343 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Kalmar {
+namespace enums {
+
+/// placement of the memory of the arrays of the CPU accelerators on NUMA hosts
+enum hcNumaPolicy {
+    hcNumaPolicyNone = 0,        ///< on the node of the thread which touches a page first
+    hcNumaPolicyFirstTouch = 1,  ///< on the node of the kernel worker which computes on it
+    hcNumaPolicyInterleave = 2   ///< spread over the nodes, page by page
+};
+
+} // namespace enums
+} // namespace Kalmar
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// CPUs the process may run on, ordered by NUMA node.
+///
+/// Without NUMA information (or off Linux) all the CPUs are on node 0.
+class CpuTopology {
+public:
+    static const CpuTopology& get() {
+        static CpuTopology topology;
+        return topology;
+    }
+
+    /// allowed CPUs, by node then by number
+    const std::vector<int>& cpus() const { return cpuList; }
+
+    /// node of the allowed CPU @p cpu
+    int nodeOf(int cpu) const {
+        for (size_t i = 0; i < cpuList.size(); ++i) {
+            if (cpuList[i] == cpu) {
+                return cpuNode[i];
+            }
+        }
+        return 0;
+    }
+
+    /// nodes of the allowed CPUs
+    const std::vector<int>& nodes() const { return nodeList; }
+
+    /// CPU of worker @p part of @p parts.  Consecutive parts, which compute on
+    /// consecutive rows, share a node.
+    int cpuOfWorker(int part, int parts) const {
+        if (cpuList.empty() || parts <= 0) {
+            return -1;
+        }
+        return cpuList[size_t(part % parts) * cpuList.size() / size_t(parts)];
+    }
+
+private:
+    CpuTopology() {
+#if defined(__linux__)
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            return;
+        }
+        std::vector<int> node(CPU_SETSIZE, 0);
+        if (DIR* dir = opendir("/sys/devices/system/node")) {
+            while (struct dirent* entry = readdir(dir)) {
+                int n;
+                if (sscanf(entry->d_name, "node%d", &n) != 1) {
+                    continue;
+                }
+                std::ifstream file(std::string("/sys/devices/system/node/") + entry->d_name + "/cpulist");
+                std::string list;
+                std::getline(file, list);
+                // "0-3,8-11"
+                for (const char* p = list.c_str(); *p;) {
+                    char* end;
+                    long first = strtol(p, &end, 10);
+                    long last = first;
+                    if (end == p) {
+                        break;
+                    }
+                    if (*end == '-') {
+                        p = end + 1;
+                        last = strtol(p, &end, 10);
+                    }
+                    for (long c = first; c <= last && c < CPU_SETSIZE; ++c) {
+                        node[c] = n;
+                    }
+                    p = (*end == ',') ? end + 1 : end;
+                }
+            }
+            closedir(dir);
+        }
+        for (int n = 0; n < CPU_SETSIZE; ++n) {
+            bool seen = false;
+            for (int c = 0; c < CPU_SETSIZE; ++c) {
+                if (CPU_ISSET(c, &allowed) && node[c] == n) {
+                    cpuList.push_back(c);
+                    cpuNode.push_back(n);
+                    seen = true;
+                }
+            }
+            if (seen) {
+                nodeList.push_back(n);
+            }
+            if (cpuList.size() == size_t(CPU_COUNT(&allowed))) {
+                break;
+            }
+        }
+#endif
+    }
+
+    std::vector<int> cpuList;
+    std::vector<int> cpuNode;
+    std::vector<int> nodeList;
+};
+
+/// NUMA settings of the CPU accelerators, shared by the process.
+///
+/// Initialized from HCC_CPU_NUMA_POLICY (none, first_touch or interleave)
+/// and HCC_CPU_PIN_WORKERS (1 pins each kernel worker to a CPU).
+struct CpuNumaSettings {
+    std::atomic<int> policy;
+    std::atomic<bool> pinWorkers;
+
+    /// arrays smaller than this are left alone
+    static const size_t MIN_BYTES = 1 << 20;
+};
+
+inline CpuNumaSettings& cpuNumaSettings() {
+    static CpuNumaSettings* settings = [] {
+        CpuNumaSettings* s = new CpuNumaSettings;
+        const char* policy = getenv("HCC_CPU_NUMA_POLICY");
+        s->policy = enums::hcNumaPolicyNone;
+        if (policy && strcmp(policy, "first_touch") == 0) {
+            s->policy = enums::hcNumaPolicyFirstTouch;
+        } else if (policy && strcmp(policy, "interleave") == 0) {
+            s->policy = enums::hcNumaPolicyInterleave;
+        }
+        const char* pin = getenv("HCC_CPU_PIN_WORKERS");
+        s->pinWorkers = pin && atoi(pin) != 0;
+        return s;
+    }();
+    return *settings;
+}
+
+/// Run the calling thread on @p cpu only.  Returns false if it could not.
+inline bool pinThreadToCpu(int cpu) {
+#if defined(__linux__)
+    if (cpu < 0) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+/// Called by kernel worker @p part of @p parts of the CPU accelerators before
+/// it runs: pins it to its CPU if the workers are pinned.
+inline void pinCpuWorker(int part, int parts) {
+    if (cpuNumaSettings().pinWorkers) {
+        pinThreadToCpu(CpuTopology::get().cpuOfWorker(part, parts));
+    }
+}
+
+/// Interleave the pages of [@p ptr, @p ptr + @p bytes) over the nodes of the
+/// allowed CPUs.  @p ptr is page aligned.  Pages already in use are moved.
+inline bool numaInterleave(void* ptr, size_t bytes) {
+#if defined(__linux__) && defined(SYS_mbind)
+    const std::vector<int>& nodes = CpuTopology::get().nodes();
+    if (nodes.size() < 2) {
+        return false;
+    }
+    const int MPOL_INTERLEAVE_ = 3;
+    const unsigned MPOL_MF_MOVE_ = 1 << 1;
+    const size_t bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(size_t(nodes.back()) / bits + 1, 0);
+    for (int n : nodes) {
+        mask[n / bits] |= 1UL << (n % bits);
+    }
+    long page = sysconf(_SC_PAGESIZE);
+    size_t len = (bytes + page - 1) & ~size_t(page - 1);
+    return syscall(SYS_mbind, ptr, len, MPOL_INTERLEAVE_, mask.data(),
+                   mask.size() * bits + 1, MPOL_MF_MOVE_) == 0;
+#else
+    return false;
+#endif
+}
+
+/// Touch the pages of [@p ptr, @p ptr + @p bytes) from @p parts threads
+/// pinned like the kernel workers, each the share of the rows its worker
+/// computes on, so that they are allocated on the worker's node.  The
+/// contents are not preserved.
+///
+/// Pages touched before stay where they are: the memory has to be freshly
+/// mapped, see NumaPageAllocator.
+inline void numaFirstTouch(void* ptr, size_t bytes, int parts) {
+#if defined(__linux__)
+    if (CpuTopology::get().nodes().size() < 2) {
+        return;
+    }
+    long page = sysconf(_SC_PAGESIZE);
+    char* base = static_cast<char*>(ptr);
+    std::vector<std::thread> touch;
+    for (int i = 0; i < parts; ++i) {
+        touch.emplace_back([=] {
+            pinThreadToCpu(CpuTopology::get().cpuOfWorker(i, parts));
+            size_t begin = bytes * i / parts;
+            size_t end = bytes * (i + 1) / parts;
+            for (size_t offset = begin; offset < end; offset += page) {
+                base[offset] = 0;
+            }
+        });
+    }
+    for (auto& t : touch) {
+        t.join();
+    }
+#endif
+}
+
+/// Whether numaPlace() places new arrays of @p bytes.
+inline bool numaPlaces(size_t bytes) {
+    return bytes >= CpuNumaSettings::MIN_BYTES && cpuNumaSettings().policy != enums::hcNumaPolicyNone;
+}
+
+/// Allocator of the arrays numaPlace() places.
+///
+/// Memory of malloc may have been touched by an earlier allocation, and its
+/// pages already be on some node.  Each array is instead an anonymous mapping
+/// of its own, whose pages are allocated by the first touch, and unmapped
+/// when freed.  Arrays numaPlaces() leaves alone, and any array off Linux,
+/// are left to the caller.
+class NumaPageAllocator {
+public:
+    NumaPageAllocator() {}
+
+    ~NumaPageAllocator() {
+        for (auto& m : maps) {
+            unmap(m.first, m.second);
+        }
+    }
+
+    NumaPageAllocator(const NumaPageAllocator&) = delete;
+    NumaPageAllocator& operator=(const NumaPageAllocator&) = delete;
+
+    /// Map @p size bytes, page aligned.  Returns nullptr if the array is not
+    /// placed or the mapping failed.
+    void* allocate(size_t size) {
+#if defined(__linux__)
+        if (!numaPlaces(size)) {
+            return nullptr;
+        }
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> l(mutex);
+        maps[ptr] = size;
+        return ptr;
+#else
+        return nullptr;
+#endif
+    }
+
+    /// Free an array of allocate().  Returns false, and leaves the pointer
+    /// alone, if it was not allocated here.
+    bool free(void* ptr) {
+        size_t bytes;
+        {
+            std::lock_guard<std::mutex> l(mutex);
+            auto it = maps.find(ptr);
+            if (it == maps.end()) {
+                return false;
+            }
+            bytes = it->second;
+            maps.erase(it);
+        }
+        unmap(ptr, bytes);
+        return true;
+    }
+
+private:
+    static void unmap(void* ptr, size_t bytes) {
+#if defined(__linux__)
+        munmap(ptr, bytes);
+#endif
+    }
+
+    std::mutex mutex;
+    std::map<void*, size_t> maps;  // arrays and their size
+};
+
+/// Place a new array of the CPU accelerators according to cpuNumaSettings().
+/// The array comes from a fresh mapping, such as NumaPageAllocator's.
+inline void numaPlace(void* ptr, size_t bytes) {
+    if (ptr == nullptr || !numaPlaces(bytes)) {
+        return;
+    }
+    switch (cpuNumaSettings().policy) {
+    case enums::hcNumaPolicyFirstTouch:
+        numaFirstTouch(ptr, bytes, std::thread::hardware_concurrency());
+        break;
+    case enums::hcNumaPolicyInterleave:
+        numaInterleave(ptr, bytes);
+        break;
+    default:
+        break;
+    }
+}
+
+} // namespace Kalmar
+/** \endcond */
@@ -0,0 +1,278 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <map>
+#include <mutex>
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// counters of a PinnedHostCache
+struct PinnedHostCacheStats {
+    uint64_t hits;          ///< acquires served by a range already pinned
+    uint64_t misses;        ///< acquires which had to pin memory
+    uint64_t merges;        ///< cached ranges merged into a larger one on a miss
+    uint64_t evictions;     ///< ranges unpinned to stay under the size cap
+    uint64_t invalidations; ///< ranges dropped by invalidate()
+    uint64_t failures;      ///< acquires the backend could not pin
+    size_t   entries;       ///< ranges currently pinned
+    size_t   bytesPinned;   ///< bytes currently pinned
+};
+
+/// Cache of pinned (page-locked) host memory ranges.
+///
+/// Pinning host memory for a DMA copy costs a round trip to the kernel driver
+/// each time.  The cache keeps ranges pinned after the copy has completed so
+/// that copying the same host buffers again finds them already registered.
+///
+/// Ranges are rounded to pages.  A miss merges the unused cached ranges it
+/// overlaps or touches into a single registration.  Ranges not in use are
+/// unpinned in least recently used order when the pinned bytes exceed the
+/// cap; a cap of 0 unpins a range as soon as it is released.
+///
+/// A pinned range holds the physical pages which were mapped when it was
+/// pinned.  The cache can't see the memory being freed: if it is unmapped
+/// and a later mapping reuses the address, a hit hands the device the old
+/// pages.  Ranges kept after their release are therefore only correct when
+/// the owner of the memory calls invalidate() before unmapping it.
+///
+/// @p Backend provides:
+///   bool lock(void* host, size_t size, void** va);  // pin, return device va
+///   void unlock(void* host);                        // unpin a lock()ed range
+template <typename Backend>
+class PinnedHostCache {
+public:
+    enum Status {
+        PIN_OK,     ///< range pinned, *va is the address to use for the device
+        PIN_BUSY,   ///< range overlaps a cached range in use and can't be merged
+        PIN_FAILED  ///< the backend could not pin the range
+    };
+
+    PinnedHostCache(const Backend& backend, size_t maxBytes, size_t pageSize = 4096)
+        : backend(backend), maxBytes(maxBytes), pageSize(pageSize), stats() {}
+
+    ~PinnedHostCache() {
+        for (auto& e : entries) {
+            backend.unlock(reinterpret_cast<void*>(e.first));
+        }
+    }
+
+    PinnedHostCache(const PinnedHostCache&) = delete;
+    PinnedHostCache& operator=(const PinnedHostCache&) = delete;
+
+    /// Pin [host, host+size) and return the address the device uses for @p host
+    /// in @p va.  Each PIN_OK has to be paired with a release(host).
+    Status acquire(const void* host, size_t size, void** va) {
+        std::lock_guard<std::mutex> l(mutex);
+
+        uintptr_t p = reinterpret_cast<uintptr_t>(host);
+        uintptr_t begin = p & ~(pageSize - 1);
+        uintptr_t end = (p + (size ? size : 1) + pageSize - 1) & ~(pageSize - 1);
+
+        auto it = find(p);
+        if (it != entries.end() && !it->second.stale && end <= it->first + it->second.size) {
+            Entry& e = it->second;
+            e.refs++;
+            touch(e);
+            stats.hits++;
+            *va = static_cast<char*>(e.va) + (p - it->first);
+            return PIN_OK;
+        }
+        stats.misses++;
+
+        // collect the cached ranges overlapping or adjacent to the new one
+        auto first = entries.lower_bound(begin);
+        if (first != entries.begin()) {
+            auto prev = std::prev(first);
+            if (prev->first + prev->second.size >= begin) {
+                first = prev;
+            }
+        }
+        auto last = first;
+        int merged = 0;
+        for (; last != entries.end() && last->first <= end; ++last) {
+            const Entry& e = last->second;
+            bool overlaps = (last->first < end) && (last->first + e.size > begin);
+            if (e.refs != 0 || e.stale) {
+                if (overlaps) {
+                    return PIN_BUSY;
+                }
+                // only touches the new range: keep it separate
+                if (last == first) {
+                    ++first;
+                } else {
+                    break;
+                }
+                continue;
+            }
+            if (last->first < begin) {
+                begin = last->first;
+            }
+            if (last->first + e.size > end) {
+                end = last->first + e.size;
+            }
+            merged++;
+        }
+
+        // unpin the merged ranges and pin their union
+        for (auto i = first; i != last;) {
+            if (i->second.refs == 0 && !i->second.stale) {
+                backend.unlock(reinterpret_cast<void*>(i->first));
+                stats.bytesPinned -= i->second.size;
+                lru.erase(i->second.lruPos);
+                i = entries.erase(i);
+            } else {
+                ++i;
+            }
+        }
+        stats.merges += merged;
+
+        void* base_va = nullptr;
+        if (!backend.lock(reinterpret_cast<void*>(begin), end - begin, &base_va) || base_va == nullptr) {
+            stats.failures++;
+            stats.entries = entries.size();
+            return PIN_FAILED;
+        }
+
+        Entry& e = entries[begin];
+        e.size = end - begin;
+        e.va = base_va;
+        e.refs = 1;
+        e.stale = false;
+        e.lruPos = lru.insert(lru.end(), begin);
+        stats.bytesPinned += e.size;
+        stats.entries = entries.size();
+        trim();
+
+        *va = static_cast<char*>(base_va) + (p - begin);
+        return PIN_OK;
+    }
+
+    /// Release a range returned by acquire().  Unknown pointers are ignored.
+    void release(const void* host) {
+        std::lock_guard<std::mutex> l(mutex);
+
+        auto it = find(reinterpret_cast<uintptr_t>(host));
+        if (it == entries.end() || it->second.refs == 0) {
+            return;
+        }
+        if (--it->second.refs == 0 && it->second.stale) {
+            erase(it);
+        }
+        trim();
+    }
+
+    /// Drop the cached ranges overlapping [host, host+size), e.g. because the
+    /// memory is about to be freed or unlocked by the application.  Ranges in
+    /// use are unpinned by their last release().
+    void invalidate(const void* host, size_t size) {
+        std::lock_guard<std::mutex> l(mutex);
+
+        uintptr_t begin = reinterpret_cast<uintptr_t>(host);
+        uintptr_t end = begin + (size ? size : 1);
+
+        auto it = entries.lower_bound(begin & ~(pageSize - 1));
+        if (it != entries.begin() && std::prev(it)->first + std::prev(it)->second.size > begin) {
+            --it;
+        }
+        while (it != entries.end() && it->first < end) {
+            if (it->second.stale) {
+                ++it;
+                continue;
+            }
+            stats.invalidations++;
+            if (it->second.refs == 0) {
+                it = erase(it);
+            } else {
+                it->second.stale = true;
+                ++it;
+            }
+        }
+    }
+
+    /// Unpin all the ranges not in use.
+    void flush() {
+        std::lock_guard<std::mutex> l(mutex);
+
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.refs == 0) {
+                it = erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    PinnedHostCacheStats getStats() {
+        std::lock_guard<std::mutex> l(mutex);
+        return stats;
+    }
+
+    size_t getMaxBytes() const { return maxBytes; }
+
+private:
+    struct Entry {
+        size_t size;
+        void* va;
+        int refs;
+        bool stale;  // invalidated while in use
+        std::list<uintptr_t>::iterator lruPos;
+    };
+    typedef typename std::map<uintptr_t, Entry>::iterator iterator;
+
+    // entry containing address p
+    iterator find(uintptr_t p) {
+        auto it = entries.upper_bound(p);
+        if (it == entries.begin()) {
+            return entries.end();
+        }
+        --it;
+        return (p < it->first + it->second.size) ? it : entries.end();
+    }
+
+    void touch(Entry& e) {
+        lru.splice(lru.end(), lru, e.lruPos);
+    }
+
+    iterator erase(iterator it) {
+        backend.unlock(reinterpret_cast<void*>(it->first));
+        stats.bytesPinned -= it->second.size;
+        lru.erase(it->second.lruPos);
+        it = entries.erase(it);
+        stats.entries = entries.size();
+        return it;
+    }
+
+    // unpin least recently used ranges not in use until under the cap
+    void trim() {
+        for (auto pos = lru.begin(); stats.bytesPinned > maxBytes && pos != lru.end();) {
+            auto it = entries.find(*pos++);
+            if (it->second.refs == 0) {
+                erase(it);
+                stats.evictions++;
+            }
+        }
+    }
+
+    Backend backend;
+    const size_t maxBytes;
+    const size_t pageSize;
+
+    std::mutex mutex;
+    std::map<uintptr_t, Entry> entries;  // pinned ranges by page-aligned base
+    std::list<uintptr_t> lru;            // bases, least recently used first
+    PinnedHostCacheStats stats;
+};
+
+} // namespace Kalmar
+/** \endcond */
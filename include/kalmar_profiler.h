@@ -0,0 +1,412 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// grid and tile (workgroup) sizes of a kernel launch, x (fastest varying) first
+struct KernelDims {
+    int dims;        ///< 0 if unknown
+    size_t grid[3];
+    size_t tile[3];  ///< 0 if not tiled
+    KernelDims() : dims(0), grid{1, 1, 1}, tile{0, 0, 0} {}
+};
+
+/// Histogram of durations in ns, with 8 buckets per power of two: the
+/// percentiles are within 6% of the exact ones.
+class DurationHistogram {
+public:
+    static const int SUB = 8;
+    static const int BUCKETS = 62 * SUB;
+
+    DurationHistogram() : counts(BUCKETS, 0), total(0) {}
+
+    void add(uint64_t ns) {
+        counts[bucketOf(ns)]++;
+        total++;
+    }
+
+    /// duration below which a fraction @p p of the samples fall, the middle
+    /// of its bucket
+    uint64_t percentile(double p) const {
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = uint64_t(p * (total - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return lowerBound(i) + width(i) / 2;
+            }
+        }
+        return lowerBound(BUCKETS - 1);
+    }
+
+    static int bucketOf(uint64_t ns) {
+        if (ns < SUB) {
+            return int(ns);
+        }
+        int e = 63 - __builtin_clzll(ns);
+        return (e - 2) * SUB + int((ns >> (e - 3)) - SUB);
+    }
+
+    static uint64_t lowerBound(int bucket) {
+        if (bucket < SUB) {
+            return bucket;
+        }
+        int e = bucket / SUB + 2;
+        return uint64_t(SUB + bucket % SUB) << (e - 3);
+    }
+
+    static uint64_t width(int bucket) {
+        return bucket < SUB ? 1 : uint64_t(1) << (bucket / SUB - 1);
+    }
+
+private:
+    std::vector<uint32_t> counts;
+    uint64_t total;
+};
+
+/// aggregated launches of a kernel with a grid and tile size
+struct KernelProfile {
+    std::string name;          ///< demangled
+    KernelDims dims;
+    std::set<int> queues;      ///< queues it ran on, numbered in order of first use
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t minNs;
+    uint64_t maxNs;
+    uint64_t p50Ns, p95Ns, p99Ns;
+};
+
+/// aggregated copies of a direction
+struct CopyStats {
+    int kind;                  ///< hcCommandKind, hcMemcpyHostToHost .. hcMemcpyDeviceToDevice
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t timedCount;       ///< synchronous copies, whose duration is known
+    uint64_t timedBytes;
+    uint64_t timedNs;
+};
+
+/// Opt-in profiler of the kernels and copies of the runtimes.
+///
+/// The runtimes report each kernel with its duration, grid and tile sizes
+/// and queue, and each copy with its direction and size (and duration when
+/// synchronous).  The profiler aggregates them per kernel name and launch
+/// configuration, and per copy direction, and reports a table sorted by the
+/// total kernel time, or CSV.
+///
+/// Environment:
+///   HCC_PROFILE=1|table|csv  profile from the start and report at exit
+///   HCC_PROFILE_FILE=<file>  report to file rather than stderr
+class KernelProfiler {
+public:
+    static const int COPY_KINDS = 4;
+
+    /// the process profiler, set up from the environment on first use
+    static KernelProfiler& get() {
+        // leaked: reported at exit, after the static destructors
+        static KernelProfiler* profiler = new KernelProfiler();
+        return *profiler;
+    }
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+
+    /// clock of the host-measured durations, in ns
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /// start or stop profiling; the first start also reports at exit
+    void enable(bool enable = true) {
+        if (enable) {
+            std::call_once(exitReport, [] { atexit([] { KernelProfiler::get().reportAtExit(); }); });
+        }
+        on.store(enable, std::memory_order_relaxed);
+    }
+
+    /// a kernel of @p name (mangled or not) ran for @p ns on @p queue
+    void recordKernel(const char* name, const KernelDims& dims, const void* queue, uint64_t ns) {
+        std::lock_guard<std::mutex> l(mutex);
+        Key key(name ? name : "<unknown>", dims.dims,
+                dims.grid[0], dims.grid[1], dims.grid[2], dims.tile[0], dims.tile[1], dims.tile[2]);
+        Entry& e = kernels[key];
+        if (e.count == 0) {
+            e.dims = dims;
+            e.minNs = ns;
+        }
+        e.queues.insert(queueId(queue));
+        e.count++;
+        e.totalNs += ns;
+        e.minNs = std::min(e.minNs, ns);
+        e.maxNs = std::max(e.maxNs, ns);
+        e.histogram.add(ns);
+    }
+
+    /// a copy of @p kind (hcCommandKind) moved @p bytes, in @p ns if known (0 otherwise)
+    void recordCopy(int kind, size_t bytes, uint64_t ns) {
+        if (kind < 0 || kind >= COPY_KINDS) {
+            return;
+        }
+        std::lock_guard<std::mutex> l(mutex);
+        CopyStats& c = copies[kind];
+        c.count++;
+        c.bytes += bytes;
+        if (ns != 0) {
+            c.timedCount++;
+            c.timedBytes += bytes;
+            c.timedNs += ns;
+        }
+    }
+
+    /// kernel profiles, by decreasing total time
+    std::vector<KernelProfile> getKernels() {
+        std::vector<KernelProfile> out;
+        std::lock_guard<std::mutex> l(mutex);
+        for (auto& k : kernels) {
+            const Entry& e = k.second;
+            KernelProfile p = { demangle(std::get<0>(k.first)), e.dims, e.queues, e.count, e.totalNs,
+                                e.minNs, e.maxNs, clamp(e, e.histogram.percentile(0.50)),
+                                clamp(e, e.histogram.percentile(0.95)), clamp(e, e.histogram.percentile(0.99)) };
+            out.push_back(p);
+        }
+        std::stable_sort(out.begin(), out.end(), [] (const KernelProfile& a, const KernelProfile& b) {
+            return a.totalNs > b.totalNs;
+        });
+        return out;
+    }
+
+    /// copy profiles, of the directions used
+    std::vector<CopyStats> getCopies() {
+        std::vector<CopyStats> out;
+        std::lock_guard<std::mutex> l(mutex);
+        for (int k = 0; k < COPY_KINDS; ++k) {
+            if (copies[k].count) {
+                out.push_back(copies[k]);
+            }
+        }
+        return out;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> l(mutex);
+        kernels.clear();
+        queues.clear();
+        for (int k = 0; k < COPY_KINDS; ++k) {
+            copies[k] = CopyStats{ k, 0, 0, 0, 0, 0 };
+        }
+    }
+
+    void report(std::ostream& os, bool csv) {
+        std::vector<KernelProfile> ks = getKernels();
+        std::vector<CopyStats> cs = getCopies();
+        if (csv) {
+            os << "kernel,grid,tile,queues,calls,total_ns,avg_ns,min_ns,p50_ns,p95_ns,p99_ns,max_ns\n";
+            for (auto& k : ks) {
+                os << "\"" << csvEscape(k.name) << "\"," << dimString(k.dims, false) << "," << dimString(k.dims, true)
+                   << "," << queueString(k.queues, ' ') << "," << k.count << "," << k.totalNs << "," << k.totalNs / k.count
+                   << "," << k.minNs << "," << k.p50Ns << "," << k.p95Ns << "," << k.p99Ns << "," << k.maxNs << "\n";
+            }
+            os << "\ncopy,count,bytes,timed_count,timed_bytes,timed_ns\n";
+            for (auto& c : cs) {
+                os << copyName(c.kind) << "," << c.count << "," << c.bytes << "," << c.timedCount
+                   << "," << c.timedBytes << "," << c.timedNs << "\n";
+            }
+            return;
+        }
+
+        uint64_t total = 0, calls = 0;
+        for (auto& k : ks) {
+            total += k.totalNs;
+            calls += k.count;
+        }
+        char line[256];
+        snprintf(line, sizeof(line), "HCC kernel profile: %zu kernels, %llu calls, %.3f ms\n",
+                 ks.size(), (unsigned long long)calls, total / 1e6);
+        os << line;
+        snprintf(line, sizeof(line), "%10s %6s %8s %10s %10s %10s %10s %10s %10s  %-14s %-10s %-7s %s\n",
+                 "total(ms)", "%", "calls", "avg(us)", "min(us)", "p50(us)", "p95(us)", "p99(us)", "max(us)",
+                 "grid", "tile", "queues", "kernel");
+        os << line;
+        for (auto& k : ks) {
+            snprintf(line, sizeof(line), "%10.3f %6.2f %8llu %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f  %-14s %-10s %-7s ",
+                     k.totalNs / 1e6, total ? 100.0 * k.totalNs / total : 0.0, (unsigned long long)k.count,
+                     k.totalNs / 1e3 / k.count, k.minNs / 1e3, k.p50Ns / 1e3, k.p95Ns / 1e3, k.p99Ns / 1e3,
+                     k.maxNs / 1e3, dimString(k.dims, false).c_str(), dimString(k.dims, true).c_str(),
+                     queueString(k.queues, ',').c_str());
+            os << line << k.name << "\n";
+        }
+        if (!cs.empty()) {
+            snprintf(line, sizeof(line), "\n%-16s %8s %14s %12s %10s\n", "copy", "count", "bytes", "sync(ms)", "GB/s");
+            os << line;
+            for (auto& c : cs) {
+                snprintf(line, sizeof(line), "%-16s %8llu %14llu %12.3f %10.2f\n", copyName(c.kind),
+                         (unsigned long long)c.count, (unsigned long long)c.bytes, c.timedNs / 1e6,
+                         c.timedNs ? double(c.timedBytes) / c.timedNs : 0.0);
+                os << line;
+            }
+        }
+    }
+
+    std::string report(bool csv) {
+        std::ostringstream os;
+        report(os, csv);
+        return os.str();
+    }
+
+private:
+    // name, dims, grid x, y, z, tile x, y, z
+    typedef std::tuple<std::string, int, size_t, size_t, size_t, size_t, size_t, size_t> Key;
+
+    struct Entry {
+        KernelDims dims;
+        std::set<int> queues;
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t minNs = 0;
+        uint64_t maxNs = 0;
+        DurationHistogram histogram;
+    };
+
+    KernelProfiler() : on(false), csv(false) {
+        reset();
+        const char* profile = getenv("HCC_PROFILE");
+        if (profile && *profile && strcmp(profile, "0") != 0) {
+            csv = (strcmp(profile, "csv") == 0);
+            const char* file = getenv("HCC_PROFILE_FILE");
+            if (file) {
+                path = file;
+            }
+            enable();
+        }
+    }
+
+    void reportAtExit() {
+        if (path.empty()) {
+            report(std::cerr, csv);
+        } else {
+            std::ofstream file(path);
+            report(file, csv);
+        }
+    }
+
+    int queueId(const void* queue) {
+        auto it = queues.find(queue);
+        if (it == queues.end()) {
+            it = queues.insert(std::make_pair(queue, int(queues.size()))).first;
+        }
+        return it->second;
+    }
+
+    // the histogram is coarser than the extremes
+    static uint64_t clamp(const Entry& e, uint64_t ns) {
+        return std::min(std::max(ns, e.minNs), e.maxNs);
+    }
+
+    static std::string demangle(const std::string& name) {
+        int status = 0;
+        char* d = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+        std::string out = (status == 0 && d) ? d : name;
+        free(d);
+        return out;
+    }
+
+    static std::string dimString(const KernelDims& dims, bool tile) {
+        if (dims.dims == 0 || (tile && dims.tile[0] == 0)) {
+            return "-";
+        }
+        std::string s;
+        for (int i = 0; i < dims.dims; ++i) {
+            s += (i ? "x" : "") + std::to_string(tile ? dims.tile[i] : dims.grid[i]);
+        }
+        return s;
+    }
+
+    static std::string queueString(const std::set<int>& queues, char sep) {
+        std::string s;
+        for (int q : queues) {
+            s += (s.empty() ? "" : std::string(1, sep)) + std::to_string(q);
+        }
+        return s;
+    }
+
+    static std::string csvEscape(const std::string& s) {
+        std::string out;
+        for (char c : s) {
+            out += (c == '"') ? std::string("\"\"") : std::string(1, c);
+        }
+        return out;
+    }
+
+    static const char* copyName(int kind) {
+        static const char* names[COPY_KINDS] = { "HostToHost", "HostToDevice", "DeviceToHost", "DeviceToDevice" };
+        return names[kind];
+    }
+
+    std::atomic<bool> on;
+    bool csv;
+    std::string path;
+    std::once_flag exitReport;
+
+    std::mutex mutex;
+    std::map<Key, Entry> kernels;
+    std::map<const void*, int> queues;
+    CopyStats copies[COPY_KINDS];
+};
+
+/// whether kernels and copies are being profiled
+inline bool profilingEnabled() {
+    return KernelProfiler::get().enabled();
+}
+
+/// records a synchronous copy lasting for the scope, if profiling is on when it begins
+class CopyProfileScope {
+public:
+    CopyProfileScope(int kind, size_t bytes)
+        : kind(kind), bytes(bytes), begin(profilingEnabled() ? KernelProfiler::now() : 0) {}
+
+    ~CopyProfileScope() {
+        if (begin != 0) {
+            uint64_t end = KernelProfiler::now();
+            KernelProfiler::get().recordCopy(kind, bytes, end > begin ? end - begin : 1);
+        }
+    }
+
+    CopyProfileScope(const CopyProfileScope&) = delete;
+    CopyProfileScope& operator=(const CopyProfileScope&) = delete;
+
+private:
+    int kind;
+    size_t bytes;
+    uint64_t begin;
+};
+
+} // namespace Kalmar
+/** \endcond */
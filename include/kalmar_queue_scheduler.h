@@ -0,0 +1,237 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// counters of a HwQueueScheduler
+struct HwQueueSchedulerStats {
+    uint64_t created;   ///< hardware queues created
+    uint64_t destroyed; ///< hardware queues destroyed
+    uint64_t reused;    ///< acquires served by an unassigned queue
+    uint64_t stolen;    ///< acquires served by taking the queue of an idle owner
+    uint64_t borrowed;  ///< acquires served by a queue of another priority
+    uint64_t waits;     ///< times an acquire blocked because no queue was available
+};
+
+/// Assigns the hardware queues of a device to the software queues
+/// (accelerator_views) using them.
+///
+/// At most maxPerPriority hardware queues are created per priority level
+/// (0 is the highest).  An owner acquires a queue:
+///  1. from the free list of its priority, in O(1);
+///  2. by creating one, under the cap;
+///  3. with borrowing on, from the free list of another priority;
+///  4. by stealing the queue of the least recently assigned idle owner of
+///     its priority, or with borrowing on of a lower priority; a higher
+///     priority owner only loses a queue it borrowed from this priority;
+///  5. otherwise it blocks until a queue is released, re-checking for idle
+///     owners with a growing timeout since owners become idle without
+///     telling the scheduler.
+///
+/// @p Backend provides:
+///   typedef ... Queue;  typedef ... Owner;
+///   Queue* create(int priority, Owner* owner);  // new queue assigned to owner
+///   void destroy(Queue* queue);
+///   void setPriority(Queue* queue, int priority);
+///   void assign(Queue* queue, Owner* owner);
+///   bool tryDetach(Queue* queue, Owner* owner); // if owner is idle, unlink
+///                                               // it from queue, must not block
+template <typename Backend>
+class HwQueueScheduler {
+public:
+    typedef typename Backend::Queue Queue;
+    typedef typename Backend::Owner Owner;
+
+    static const int PRIORITIES = 3;
+
+    HwQueueScheduler(const Backend& backend, size_t maxPerPriority, bool borrow)
+        : backend(backend), maxPerPriority(maxPerPriority ? maxPerPriority : 1), borrow(borrow), stats() {
+        std::fill(counts, counts + PRIORITIES, 0);
+    }
+
+    /// destroys the queues, which must have been released
+    ~HwQueueScheduler() {
+        for (auto& s : slots) {
+            backend.destroy(s.first);
+        }
+    }
+
+    HwQueueScheduler(const HwQueueScheduler&) = delete;
+    HwQueueScheduler& operator=(const HwQueueScheduler&) = delete;
+
+    /// assign a queue to @p owner, which has none, blocking until one is available
+    Queue* acquire(Owner* owner, int priority) {
+        std::unique_lock<std::mutex> l(mutex);
+
+        std::chrono::microseconds timeout(50);
+        for (;;) {
+            Queue* q = tryAcquire(owner, priority);
+            if (q) {
+                return q;
+            }
+
+            stats.waits++;
+            cv.wait_for(l, timeout);
+            timeout = std::min(timeout * 2, std::chrono::microseconds(10000));
+        }
+    }
+
+    /// @p queue is no longer used by @p owner: keep it for other owners, or
+    /// destroy it if there are more queues than the @p owners of the device.
+    /// Ignored if the queue has been stolen from @p owner in the meantime.
+    void release(Queue* queue, Owner* owner, size_t owners) {
+        {
+            std::lock_guard<std::mutex> l(mutex);
+
+            auto it = slots.find(queue);
+            if (it == slots.end()) {
+                return;
+            }
+            Slot& s = it->second;
+            if (s.owner != owner || owner == nullptr) {
+                return;
+            }
+            lru[s.priority].erase(s.pos);
+            s.owner = nullptr;
+
+            if (owners < slots.size()) {
+                counts[s.budget]--;
+                slots.erase(it);
+                backend.destroy(queue);
+                stats.destroyed++;
+            } else {
+                s.pos = free[s.priority].insert(free[s.priority].end(), queue);
+            }
+        }
+        cv.notify_one();
+    }
+
+    HwQueueSchedulerStats getStats() {
+        std::lock_guard<std::mutex> l(mutex);
+        return stats;
+    }
+
+    /// queues counted against the cap of @p priority
+    size_t getCount(int priority) {
+        std::lock_guard<std::mutex> l(mutex);
+        return counts[priority];
+    }
+
+private:
+    struct Slot {
+        int priority;
+        int budget;                             // priority it was created for, counted in counts[]
+        Owner* owner;                           // nullptr when in the free list
+        typename std::list<Queue*>::iterator pos; // in free[priority] or lru[priority]
+    };
+
+    Queue* tryAcquire(Owner* owner, int priority) {
+        if (!free[priority].empty()) {
+            Queue* q = free[priority].front();
+            free[priority].pop_front();
+            stats.reused++;
+            return assign(q, owner, priority);
+        }
+
+        if (counts[priority] < maxPerPriority) {
+            Queue* q = backend.create(priority, owner);
+            counts[priority]++;
+            Slot& s = slots[q];
+            s.priority = priority;
+            s.budget = priority;
+            s.owner = owner;
+            s.pos = lru[priority].insert(lru[priority].end(), q);
+            stats.created++;
+            return q;
+        }
+
+        if (borrow) {
+            for (int p = 0; p < PRIORITIES; ++p) {
+                if (p != priority && !free[p].empty()) {
+                    Queue* q = free[p].front();
+                    free[p].pop_front();
+                    stats.borrowed++;
+                    return move(q, owner, priority);
+                }
+            }
+        }
+
+        // idle owners, least recently assigned first: of the same priority,
+        // then queues of this priority borrowed by a higher one, then with
+        // borrowing of lower priorities
+        for (int i = 0; i < PRIORITIES; ++i) {
+            int p = (i == 0) ? priority : (i <= priority ? i - 1 : i);
+            if (p > priority && !borrow) {
+                break;
+            }
+            for (auto it = lru[p].begin(); it != lru[p].end(); ++it) {
+                Queue* q = *it;
+                Slot& s = slots[q];
+                if (p < priority && s.budget != priority) {
+                    continue;
+                }
+                if (s.owner == owner || !backend.tryDetach(q, s.owner)) {
+                    continue;
+                }
+                lru[p].erase(it);
+                s.owner = nullptr;
+                stats.stolen++;
+                if (p != priority) {
+                    stats.borrowed++;
+                    return move(q, owner, priority);
+                }
+                return assign(q, owner, priority);
+            }
+        }
+        return nullptr;
+    }
+
+    // give q, unlinked from the lists, to owner
+    Queue* assign(Queue* q, Owner* owner, int priority) {
+        Slot& s = slots[q];
+        s.owner = owner;
+        s.pos = lru[priority].insert(lru[priority].end(), q);
+        backend.assign(q, owner);
+        return q;
+    }
+
+    // same for a queue of another priority, which stays counted against the
+    // cap of the priority it was created for
+    Queue* move(Queue* q, Owner* owner, int priority) {
+        Slot& s = slots[q];
+        s.priority = priority;
+        backend.setPriority(q, priority);
+        return assign(q, owner, priority);
+    }
+
+    Backend backend;
+    const size_t maxPerPriority;
+    const bool borrow;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::unordered_map<Queue*, Slot> slots;
+    std::list<Queue*> free[PRIORITIES];  // unassigned queues
+    std::list<Queue*> lru[PRIORITIES];   // assigned queues, least recently assigned first
+    size_t counts[PRIORITIES];
+    HwQueueSchedulerStats stats;
+};
+
+} // namespace Kalmar
+/** \endcond */
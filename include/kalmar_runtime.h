@@ -2,6 +2,12 @@
 
 #include "hc_defines.h"
 #include "kalmar_aligned_alloc.h"
+#include "kalmar_completion.h"
+#include "kalmar_counters.h"
+#include "kalmar_cpu_buffers.h"
+#include "kalmar_numa.h"
+#include "kalmar_pinned_cache.h"
+#include "kalmar_profiler.h"
 
 namespace hc {
 class AmPointerInfo;
@@ -103,7 +109,8 @@ static inline bool isComputeQueueCommand(hcCommandKind k) {
 
 enum hcWaitMode {
     hcWaitModeBlocked = 0,
-    hcWaitModeActive = 1
+    hcWaitModeActive = 1,
+    hcWaitModeAdaptive = 2  ///< spin for a learned budget, then yield, then block
 };
 
 enum hcAgentProfile {
@@ -172,6 +179,16 @@ public:
    */
   virtual void setWaitMode(hcWaitMode mode) {}
 
+  /**
+   * Call callback(data) once the async operation has completed, from a
+   * runtime thread (or right away if it has already completed). Used by
+   * completion_future::then() to avoid a thread waiting per continuation.
+   *
+   * @return false if the operation can't notify its completion, the caller
+   *         then has to wait on the future of the operation.
+   */
+  virtual bool notifyOnCompletion(void (*callback)(void*), void* data) { return false; }
+
   uint64_t getSeqNum () const { return seqNum;};
   void     setSeqNum (uint64_t s) {seqNum = s;};
 
@@ -192,6 +209,69 @@ private:
 
 };
 
+/// DoorbellCoalescer
+/// Decides when a queue rings the doorbell of its hardware queue.
+///
+/// Every packet written is reported to packetWritten(), which returns true if
+/// the doorbell has to be rung now. Outside of a batch each packet is rung
+/// right away. Inside a batch (see hc::accelerator_view::batch_scope) packets
+/// accumulate until max_packets of them are pending, or the oldest one has
+/// been pending for max_microseconds; the remainder is rung when the
+/// outermost batch ends, or on flush() and wait(). The time limit is only
+/// checked as packets are written, there is no timer thread.
+class DoorbellCoalescer
+{
+public:
+  typedef std::chrono::steady_clock clock;
+
+  DoorbellCoalescer() : pending(0) {}
+
+  /// open a (possibly nested) batch, the innermost policy applies;
+  /// a zero limit disables that limit
+  void beginBatch(uint32_t maxPackets, uint32_t maxMicroseconds) {
+    batches.push_back(std::make_pair(maxPackets, maxMicroseconds));
+  }
+
+  /// close the innermost batch, returns true if the outermost one was closed
+  /// while packets are still waiting for the doorbell
+  bool endBatch() {
+    if (!batches.empty())
+      batches.pop_back();
+    return batches.empty() && pending != 0;
+  }
+
+  /// account for a packet written to the queue, @p deferred packets are not
+  /// rung outside of a batch either. @p capacity is the size of the hardware
+  /// queue: half of it pending is always rung, the packet processor cannot
+  /// consume packets it has not been told about and the writer would
+  /// eventually find the queue full.
+  bool packetWritten(bool deferred, uint32_t capacity, clock::time_point now = clock::now()) {
+    if (pending++ == 0)
+      oldest = now;
+    if (capacity != 0 && pending >= capacity / 2)
+      return true;
+    if (batches.empty())
+      return !deferred;
+    const std::pair<uint32_t, uint32_t>& policy = batches.back();
+    if (policy.first != 0 && pending >= policy.first)
+      return true;
+    return policy.second != 0 &&
+           now - oldest >= std::chrono::microseconds(policy.second);
+  }
+
+  /// the doorbell was rung, all written packets are visible to the device
+  void rung() { pending = 0; }
+
+  uint32_t getPending() const { return pending; }
+  bool inBatch() const { return !batches.empty(); }
+
+private:
+  // policies of the open batches, innermost last: <max packets, max us>
+  std::vector<std::pair<uint32_t, uint32_t>> batches;
+  uint32_t pending;
+  clock::time_point oldest;
+};
+
 /// KalmarQueue
 /// This is the implementation of accelerator_view
 /// KalamrQueue is responsible for data operations and launch kernel
@@ -200,7 +280,7 @@ class KalmarQueue
 public:
 
   KalmarQueue(KalmarDevice* pDev, queuing_mode mode = queuing_mode_automatic, execute_order order = execute_in_order, queue_priority priority = priority_normal, uint64_t deadline = -1)
-      : pDev(pDev), mode(mode), order(order), priority(priority), deadline(deadline) {}
+      : pDev(pDev), mode(mode), order(order), priority(priority), deadline(deadline), waitMode(hcWaitModeBlocked) {}
 
   virtual ~KalmarQueue() {}
 
@@ -251,6 +331,16 @@ public:
 
   uint64_t get_queue_deadline() const { return deadline; }
 
+  /// wait mode used instead of hcWaitModeBlocked on this queue, either
+  /// hcWaitModeBlocked or hcWaitModeAdaptive
+  hcWaitMode get_wait_mode() const { return waitMode; }
+  void set_wait_mode(hcWaitMode mode) { waitMode = mode; }
+
+  /// wait mode to use for a wait requested with @p mode
+  hcWaitMode resolve_wait_mode(hcWaitMode mode) const {
+    return (mode == hcWaitModeBlocked) ? waitMode : mode;
+  }
+
   /// get number of pending async operations in the queue
   virtual int getPendingAsyncOps() { return 0; }
 
@@ -294,6 +384,12 @@ public:
   // Copy src to dst synchronously
   virtual void copy(const void *src, void *dst, size_t size_bytes) { }
 
+  /// allocate device memory for the commands enqueued from now on
+  virtual void* allocAsync(size_t size_bytes) { return nullptr; }
+
+  /// free memory of allocAsync once the commands enqueued so far complete
+  virtual void freeAsync(void* ptr) { }
+
   /// copy src to dst, with caller providing extended information about the pointers.
   //// TODO - remove me, this form is deprecated.
   virtual void copy_ext(const void *src, void *dst, size_t size_bytes, hcCommandKind copyDir, const hc::AmPointerInfo &srcInfo, const hc::AmPointerInfo &dstInfo, bool forceUnpinnedCopy) { };
@@ -311,18 +407,27 @@ public:
                                    hc::completion_future *cf)  { };
 
   virtual void ring_doorbell() { };
- 
+
+  /// open and close a batch of dispatches whose doorbell rings are
+  /// coalesced, see DoorbellCoalescer
+  virtual void begin_batch(uint32_t maxPackets, uint32_t maxMicroseconds) { };
+  virtual void end_batch() { };
+
   /// set CU affinity of this queue.
   /// the setting is permanent until the queue is destroyed or another setting
   /// is called.
   virtual bool set_cu_mask(const std::vector<bool>& cu_mask) { return false; };
 
+  /// get the runtime counters of the events of this queue, see hcRuntimeCounter
+  virtual RuntimeCounterValues getRuntimeCounters() { return RuntimeCounterValues(); }
+
 private:
   KalmarDevice* pDev;
   queuing_mode mode;
   execute_order order;
   queue_priority priority;
   uint64_t deadline;
+  hcWaitMode waitMode;
 };
 
 /// KalmarDevice
@@ -445,6 +550,23 @@ public:
 
     virtual bool has_cpu_accessible_am() {return false;}
 
+    /// drop the pinned host memory cached for copies in [@p ptr, @p ptr + @p size)
+    virtual void invalidatePinnedHost(const void* ptr, size_t size) {}
+
+    /// get the counters of the pinned host memory cache, return false if the device has none
+    virtual bool getPinnedHostStats(PinnedHostCacheStats* stats) { return false; }
+
+    /// set the NUMA placement of the arrays and the pinning of the kernel workers,
+    /// return false if the device is not a CPU device
+    virtual bool setNumaPolicy(hcNumaPolicy policy, bool pinWorkers) { return false; }
+
+    /// get the NUMA placement of the arrays
+    virtual hcNumaPolicy getNumaPolicy() { return hcNumaPolicyNone; }
+
+    /// get the runtime counters of the events of this device and its queues,
+    /// see hcRuntimeCounter
+    virtual RuntimeCounterValues getRuntimeCounters() { return RuntimeCounterValues(); }
+
 };
 
 class CPUQueue final : public KalmarQueue
@@ -454,18 +576,41 @@ public:
   CPUQueue(KalmarDevice* pDev) : KalmarQueue(pDev) {}
 
   void read(void* device, void* dst, size_t count, size_t offset) override {
-      if (dst != device)
+      if (dst != device) {
+          CopyProfileScope profile(hcMemcpyDeviceToHost, count);
           memmove(dst, (char*)device + offset, count);
+      }
   }
 
   void write(void* device, const void* src, size_t count, size_t offset, bool blocking) override {
-      if (src != device)
+      if (src != device) {
+          CopyProfileScope profile(hcMemcpyHostToDevice, count);
           memmove((char*)device + offset, src, count);
+      }
   }
 
   void copy(void* src, void* dst, size_t count, size_t src_offset, size_t dst_offset, bool blocking) override {
-      if (src != dst)
+      if (src != dst) {
+          CopyProfileScope profile(hcMemcpyDeviceToDevice, count);
           memmove((char*)dst + dst_offset, (char*)src + src_offset, count);
+      }
+  }
+
+  // host memory on both sides, e.g. from am_alloc on the cpu accelerator
+  void copy(const void *src, void *dst, size_t size_bytes) override {
+      if (src != dst) {
+          CopyProfileScope profile(hcMemcpyHostToHost, size_bytes);
+          memmove(dst, src, size_bytes);
+      }
+  }
+
+  void copy_ext(const void *src, void *dst, size_t size_bytes, hcCommandKind copyDir, const hc::AmPointerInfo &srcInfo, const hc::AmPointerInfo &dstInfo, bool forceUnpinnedCopy) override {
+      copy(src, dst, size_bytes);
+  }
+
+  void copy_ext(const void *src, void *dst, size_t size_bytes, hcCommandKind copyDir, const hc::AmPointerInfo &srcInfo, const hc::AmPointerInfo &dstInfo,
+                const Kalmar::KalmarDevice *copyDev, bool forceUnpinnedCopy) override {
+      copy(src, dst, size_bytes);
   }
 
   void* map(void* device, size_t count, size_t offset, bool modify) override {
@@ -480,7 +625,13 @@ public:
 /// cpu accelerator
 class CPUDevice final : public KalmarDevice
 {
+    CPUBufferAllocator buffers;
 public:
+    CPUDevice() {}
+
+    /// see CPUBufferAllocator::setSlabMaxSize()
+    void setSlabMaxSize(size_t bytes) { buffers.setSlabMaxSize(bytes); }
+
     std::wstring get_path() const override { return L"cpu"; }
     std::wstring get_description() const override { return L"CPU Device"; }
     size_t get_mem() const override { return 0; }
@@ -491,8 +642,18 @@ public:
     uint32_t get_version() const override { return 0; }
 
     std::shared_ptr<KalmarQueue> createQueue(execute_order order = execute_in_order, queue_priority priority = priority_normal, uint64_t deadline = -1) override { return std::shared_ptr<KalmarQueue>(new CPUQueue(this)); }
-    void* create(size_t count, struct rw_info* /* not used */ ) override { return kalmar_aligned_alloc(0x1000, count); }
-    void release(void* ptr, struct rw_info* /* nout used */) override { kalmar_aligned_free(ptr); }
+    void* create(size_t count, struct rw_info* /* not used */ ) override {
+        return buffers.allocate(count);
+    }
+    void release(void* ptr, struct rw_info* /* nout used */) override {
+        buffers.free(ptr);
+    }
+    bool setNumaPolicy(hcNumaPolicy policy, bool pinWorkers) override {
+        cpuNumaSettings().policy = policy;
+        cpuNumaSettings().pinWorkers = pinWorkers;
+        return true;
+    }
+    hcNumaPolicy getNumaPolicy() override { return hcNumaPolicy(cpuNumaSettings().policy.load()); }
     void* CreateKernel(const char* fun, KalmarQueue *queue) { return nullptr; }
 };
 
@@ -561,10 +722,24 @@ public:
 
     /// get tick frequency
     virtual uint64_t getSystemTickFrequency() { return 0L; };
+
+    /// max bytes of memory freed with am_free kept for later am_alloc calls
+    /// (HCC_AM_CACHE_SIZE), 0 if hc_am does not cache
+    virtual size_t getAmCacheSize() { return 0; }
+
+    /// largest am_alloc block carved out of slabs (HCC_AM_SLAB_MAX_SIZE), 0 if
+    /// hc_am does not use slabs
+    virtual size_t getAmSlabMaxSize() { return 0; }
 };
 
 KalmarContext *getContext();
 
+/// run @p callback on the completion dispatcher of the runtime once @p future,
+/// the future of @p op if not null, is ready. See CompletionDispatcher.
+void addCompletionCallback(const std::shared_ptr<KalmarAsyncOp>& op,
+                           const std::shared_future<void>& future,
+                           std::function<void()> callback);
+
 namespace CLAMP {
 // used in parallel_for_each.h
 #if __KALMAR_ACCELERATOR__ == 2 || __KALMAR_CPU__ == 2
@@ -0,0 +1,265 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "kalmar_aligned_alloc.h"
+#include "kalmar_alloc_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// counters of a SlabAllocator
+struct SlabStats {
+    uint64_t allocs;        ///< blocks handed out
+    uint64_t frees;         ///< blocks given back
+    uint64_t slabsCreated;  ///< slabs allocated from the backend
+    uint64_t slabsReleased; ///< slabs freed to the backend
+    size_t   slabs;         ///< slabs currently held
+    size_t   bytesReserved; ///< bytes of the slabs currently held
+    size_t   bytesUsed;     ///< bytes of the blocks in use, rounded to their size class
+};
+
+/// Sub-allocator of small blocks out of larger slabs.
+///
+/// Allocating each small buffer from the backend rounds it up to a page and
+/// costs a call each.  Blocks up to @p maxSize bytes, and at most 64 KB, are
+/// instead carved out of slabs, one size class per slab (see allocSizeClass,
+/// from 256 bytes).  A slab holds 32 blocks, within 64 KB and 256 KB: larger
+/// classes get 4 to 32 blocks per slab.  Blocks are aligned to 64 bytes at
+/// least, and to their size class when it is a power of two up to 4 KB.
+///
+/// A slab with free blocks is reused before a new one is allocated; a slab
+/// whose blocks are all free is given back to the backend when its class
+/// already has another empty slab, or when the empty slabs kept would exceed
+/// 1 MB.
+///
+/// @p Backend provides:
+///   void* allocate(size_t size);  // a slab, aligned to 4 KB, nullptr on failure
+///   void free(void* ptr);
+template <typename Backend>
+class SlabAllocator {
+public:
+    static const size_t MIN_BLOCK = 256;
+    static const size_t MIN_SLAB = 64 * 1024;
+    static const size_t MAX_SLAB = 256 * 1024;
+    static const size_t MAX_EMPTY = 1024 * 1024;
+    static const size_t BLOCKS_PER_SLAB = 32;
+
+    SlabAllocator(const Backend& backend, size_t maxSize)
+        : backend(backend), maxSize(clampMaxSize(maxSize)), emptyBytes(0), stats() {}
+
+    ~SlabAllocator() {
+        reset();
+    }
+
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    /// Change the largest block carved out of slabs, before the first
+    /// allocation.
+    void setMaxSize(size_t size) {
+        maxSize = clampMaxSize(size);
+    }
+
+    /// Whether allocations of @p size bytes come from slabs.
+    bool handles(size_t size) const {
+        return size != 0 && size <= maxSize;
+    }
+
+    /// Allocate a block of @p size bytes.  Returns nullptr if the size is not
+    /// handled or the backend failed.
+    void* allocate(size_t size) {
+        if (!handles(size)) {
+            return nullptr;
+        }
+        size_t cls = allocSizeClass(size, MIN_BLOCK);
+
+        std::lock_guard<std::mutex> l(mutex);
+
+        std::list<Slab*>& partial = classes[cls].partial;
+        Slab* slab;
+        if (!partial.empty()) {
+            slab = partial.front();
+            if (slab->freeBlocks.size() == slab->capacity) {
+                classes[cls].empty--;
+                emptyBytes -= slab->bytes;
+            }
+        } else {
+            size_t bytes = cls * BLOCKS_PER_SLAB;
+            bytes = (bytes < MIN_SLAB) ? size_t(MIN_SLAB) : (bytes > MAX_SLAB ? size_t(MAX_SLAB) : bytes);
+            void* base = backend.allocate(bytes);
+            if (base == nullptr) {
+                return nullptr;
+            }
+            slab = new Slab;
+            slab->base = reinterpret_cast<uintptr_t>(base);
+            slab->bytes = bytes;
+            slab->cls = cls;
+            slab->capacity = bytes / cls;
+            // hand out the blocks in address order
+            for (uint32_t i = slab->capacity; i > 0; --i) {
+                slab->freeBlocks.push_back(i - 1);
+            }
+            slab->partialPos = partial.insert(partial.begin(), slab);
+            slabs[slab->base] = slab;
+            stats.slabsCreated++;
+            stats.slabs = slabs.size();
+            stats.bytesReserved += bytes;
+        }
+
+        uint32_t index = slab->freeBlocks.back();
+        slab->freeBlocks.pop_back();
+        if (slab->freeBlocks.empty()) {
+            partial.erase(slab->partialPos);
+            slab->partialPos = partial.end();
+        }
+        stats.allocs++;
+        stats.bytesUsed += cls;
+        return reinterpret_cast<void*>(slab->base + index * cls);
+    }
+
+    /// Free a block of allocate().  Returns false, and leaves the pointer
+    /// alone, if it is not the start of a block in use.
+    bool free(void* ptr) {
+        std::lock_guard<std::mutex> l(mutex);
+
+        Slab* slab = find(ptr);
+        if (slab == nullptr) {
+            return false;
+        }
+        uintptr_t offset = reinterpret_cast<uintptr_t>(ptr) - slab->base;
+        if (offset % slab->cls != 0) {
+            return false;
+        }
+
+        Class& c = classes[slab->cls];
+        if (slab->freeBlocks.empty()) {
+            slab->partialPos = c.partial.insert(c.partial.end(), slab);
+        }
+        slab->freeBlocks.push_back(uint32_t(offset / slab->cls));
+        stats.frees++;
+        stats.bytesUsed -= slab->cls;
+
+        if (slab->freeBlocks.size() == slab->capacity) {
+            if (c.empty != 0 || emptyBytes + slab->bytes > MAX_EMPTY) {
+                c.partial.erase(slab->partialPos);
+                release(slab);
+            } else {
+                c.empty++;
+                emptyBytes += slab->bytes;
+            }
+        }
+        return true;
+    }
+
+    /// Base and size of the slab containing @p ptr, or nullptr if @p ptr is
+    /// not in a slab.
+    void* slabOf(const void* ptr, size_t* bytes = nullptr) {
+        std::lock_guard<std::mutex> l(mutex);
+
+        Slab* slab = find(ptr);
+        if (slab == nullptr) {
+            return nullptr;
+        }
+        if (bytes) {
+            *bytes = slab->bytes;
+        }
+        return reinterpret_cast<void*>(slab->base);
+    }
+
+    /// Size class of the block of @p ptr, 0 if @p ptr is not in a slab.
+    size_t blockSize(const void* ptr) {
+        std::lock_guard<std::mutex> l(mutex);
+
+        Slab* slab = find(ptr);
+        return slab ? slab->cls : 0;
+    }
+
+    /// Free all the slabs, including the blocks still in use.
+    void reset() {
+        std::lock_guard<std::mutex> l(mutex);
+
+        while (!slabs.empty()) {
+            release(slabs.begin()->second);
+        }
+        classes.clear();
+        emptyBytes = 0;
+    }
+
+    SlabStats getStats() {
+        std::lock_guard<std::mutex> l(mutex);
+        return stats;
+    }
+
+private:
+    struct Slab {
+        uintptr_t base;
+        size_t bytes;
+        size_t cls;
+        uint32_t capacity;
+        std::vector<uint32_t> freeBlocks;         // indices, next one to hand out last
+        typename std::list<Slab*>::iterator partialPos;    // in the partial list of the class, if not full
+    };
+
+    struct Class {
+        std::list<Slab*> partial;  // slabs with free blocks
+        size_t empty;              // slabs with all blocks free
+        Class() : empty(0) {}
+    };
+
+    // slab containing p
+    Slab* find(const void* ptr) {
+        uintptr_t p = reinterpret_cast<uintptr_t>(ptr);
+        auto it = slabs.upper_bound(p);
+        if (it == slabs.begin()) {
+            return nullptr;
+        }
+        --it;
+        return (p < it->first + it->second->bytes) ? it->second : nullptr;
+    }
+
+    static size_t clampMaxSize(size_t size) {
+        return size < MAX_SLAB / 4 ? size : MAX_SLAB / 4;
+    }
+
+    void release(Slab* slab) {
+        backend.free(reinterpret_cast<void*>(slab->base));
+        stats.bytesUsed -= (slab->capacity - slab->freeBlocks.size()) * slab->cls;
+        stats.bytesReserved -= slab->bytes;
+        stats.slabsReleased++;
+        slabs.erase(slab->base);
+        stats.slabs = slabs.size();
+        delete slab;
+    }
+
+    Backend backend;
+    size_t maxSize;
+
+    std::mutex mutex;
+    size_t emptyBytes;                   // bytes of the slabs with all blocks free
+    std::map<size_t, Class> classes;     // by size class
+    std::map<uintptr_t, Slab*> slabs;    // by base address
+    SlabStats stats;
+};
+
+/// slabs of host memory
+struct AlignedSlabBackend {
+    void* allocate(size_t size) { return kalmar_aligned_alloc(0x1000, size); }
+    void free(void* ptr) { kalmar_aligned_free(ptr); }
+};
+
+
+} // namespace Kalmar
+/** \endcond */
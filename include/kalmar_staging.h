@@ -0,0 +1,188 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// Copy @p n bytes with streaming (non-temporal) stores, for destinations the
+/// CPU won't read again such as staging buffers drained by a DMA engine.  The
+/// data doesn't evict the caller's working set from the cache.
+///
+/// Ends with a store fence: streaming stores are weakly ordered, and have to
+/// be visible before a signal handing the buffer over is written.
+inline void memcpy_nt(void* dst, const void* src, size_t n) {
+#if defined(__SSE2__)
+    char* d = static_cast<char*>(dst);
+    const char* s = static_cast<const char*>(src);
+
+    size_t head = (16 - (reinterpret_cast<uintptr_t>(d) & 15)) & 15;
+    if (n < head + 64) {
+        memcpy(d, s, n);
+        return;
+    }
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    for (; n >= 64; n -= 64, d += 64, s += 64) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+        __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d), a);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), b);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), c);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), e);
+    }
+    _mm_sfence();
+    memcpy(d, s, n);
+#else
+    memcpy(dst, src, n);
+#endif
+}
+
+/// Helper threads splitting large CPU copies, so that packing a staging
+/// buffer isn't limited by the bandwidth of a single core.
+///
+/// Several threads may copy at the same time: their slices share the helpers,
+/// and a caller runs pending slices itself while it waits for its own.
+class CopyWorkerPool {
+public:
+    /// @p threads helper threads, copies are split in up to threads+1 slices
+    /// of at least @p minSlice bytes
+    CopyWorkerPool(int threads, size_t minSlice = 256 * 1024)
+        : minSlice(minSlice), done(false) {
+        for (int i = 0; i < threads; ++i) {
+            workers.emplace_back([this] { work(); });
+        }
+    }
+
+    ~CopyWorkerPool() {
+        {
+            std::lock_guard<std::mutex> l(mutex);
+            done = true;
+        }
+        cv.notify_all();
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+
+    CopyWorkerPool(const CopyWorkerPool&) = delete;
+    CopyWorkerPool& operator=(const CopyWorkerPool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    /// copy @p n bytes, with streaming stores if @p nonTemporal
+    void copy(void* dst, const void* src, size_t n, bool nonTemporal) {
+        size_t parts = n / minSlice;
+        if (parts > workers.size() + 1) {
+            parts = workers.size() + 1;
+        }
+        if (parts < 2) {
+            run(Slice{ static_cast<char*>(dst), static_cast<const char*>(src), n, nonTemporal, nullptr });
+            return;
+        }
+
+        // 64-byte slices keep the streaming stores aligned
+        size_t sliceBytes = ((n / parts) + 63) & ~size_t(63);
+        std::atomic<size_t> remaining(parts - 1);
+        {
+            std::lock_guard<std::mutex> l(mutex);
+            for (size_t i = 1; i < parts; ++i) {
+                size_t offset = i * sliceBytes;
+                size_t bytes = (i == parts - 1) ? n - offset : sliceBytes;
+                slices.push_back(Slice{ static_cast<char*>(dst) + offset, static_cast<const char*>(src) + offset,
+                                        bytes, nonTemporal, &remaining });
+            }
+        }
+        cv.notify_all();
+
+        run(Slice{ static_cast<char*>(dst), static_cast<const char*>(src), sliceBytes, nonTemporal, nullptr });
+
+        while (remaining.load(std::memory_order_acquire) != 0) {
+            Slice s;
+            if (pop(s)) {
+                run(s);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    struct Slice {
+        char* dst;
+        const char* src;
+        size_t n;
+        bool nonTemporal;
+        std::atomic<size_t>* remaining;
+    };
+
+    static void run(const Slice& s) {
+        if (s.nonTemporal) {
+            memcpy_nt(s.dst, s.src, s.n);
+        } else {
+            memcpy(s.dst, s.src, s.n);
+        }
+        if (s.remaining) {
+            s.remaining->fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    bool pop(Slice& s) {
+        std::lock_guard<std::mutex> l(mutex);
+        if (slices.empty()) {
+            return false;
+        }
+        s = slices.front();
+        slices.pop_front();
+        return true;
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> l(mutex);
+        for (;;) {
+            cv.wait(l, [this] { return done || !slices.empty(); });
+            if (done) {
+                return;
+            }
+            Slice s = slices.front();
+            slices.pop_front();
+            l.unlock();
+            run(s);
+            l.lock();
+        }
+    }
+
+    const size_t minSlice;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Slice> slices;
+    bool done;
+};
+
+} // namespace Kalmar
+/** \endcond */
@@ -0,0 +1,188 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "kalmar_alloc_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// counters of a StreamOrderedPool
+struct StreamPoolStats {
+    uint64_t reused;     ///< allocations served by a freed block
+    uint64_t allocated;  ///< allocations which went to the backend
+    uint64_t waits;      ///< allocations which waited for pending frees after the backend failed
+    uint64_t returned;   ///< freed blocks given back to the backend
+    size_t   bytesFree;  ///< bytes of the freed blocks held, pending or not
+    size_t   bytesInUse; ///< bytes of the blocks allocated and not freed
+};
+
+/// Pool of memory blocks allocated and freed in the order of the commands of
+/// a queue.
+///
+/// A block freed with release() may still be used by the commands already
+/// enqueued.  It is tagged with an event which completes after them, and is
+/// only reused:
+///  - right away by allocations of the same in-order queue, since the
+///    commands using the new allocation run after the ones using the old one;
+///  - once its event has completed otherwise.
+/// Blocks are binned by size class (see allocSizeClass).  Completed free
+/// blocks beyond @p maxBytes are given back to the backend, all of them when
+/// the backend runs out of memory, after which the allocation waits for the
+/// pending frees.
+///
+/// @p Backend provides:
+///   typedef ... Event;                  // e.g. the youngest command of the queue
+///   bool isDone(const Event& event);
+///   void wait(const Event& event);
+///   void* allocate(size_t size);        // nullptr on failure
+///   void free(void* ptr);
+///   void disown(void* ptr);             // block left to its user by the destructor
+template <typename Backend>
+class StreamOrderedPool {
+public:
+    typedef typename Backend::Event Event;
+
+    StreamOrderedPool(const Backend& backend, size_t maxBytes, size_t minBlock = 4096)
+        : backend(backend), maxBytes(maxBytes), minBlock(minBlock), stats() {}
+
+    /// Wait for the pending frees and give all the free blocks back.  Blocks
+    /// still allocated are left to their owner.
+    ~StreamOrderedPool() {
+        for (auto& bin : bins) {
+            for (auto& b : bin.second) {
+                backend.wait(b.event);
+                backend.free(b.ptr);
+            }
+        }
+        for (auto& l : live) {
+            backend.disown(l.first);
+        }
+    }
+
+    StreamOrderedPool(const StreamOrderedPool&) = delete;
+    StreamOrderedPool& operator=(const StreamOrderedPool&) = delete;
+
+    /// Allocate @p size bytes for the commands enqueued from now on.
+    /// @p inOrder: the queue runs its commands in order
+    void* allocate(size_t size, bool inOrder) {
+        std::lock_guard<std::mutex> l(mutex);
+
+        size_t bsize = allocSizeClass(size, minBlock);
+        auto bin = bins.find(bsize);
+        if (bin != bins.end() && !bin->second.empty()) {
+            Block& b = bin->second.front();
+            if (inOrder || backend.isDone(b.event)) {
+                void* ptr = b.ptr;
+                bin->second.pop_front();
+                stats.bytesFree -= bsize;
+                live[ptr] = bsize;
+                stats.bytesInUse += bsize;
+                stats.reused++;
+                return ptr;
+            }
+        }
+
+        void* ptr = backend.allocate(bsize);
+        if (ptr == nullptr) {
+            returnBlocks(0);
+            ptr = backend.allocate(bsize);
+        }
+        if (ptr == nullptr && stats.bytesFree != 0) {
+            stats.waits++;
+            for (auto& bin : bins) {
+                for (auto& b : bin.second) {
+                    backend.wait(b.event);
+                }
+            }
+            returnBlocks(0);
+            ptr = backend.allocate(bsize);
+        }
+        if (ptr != nullptr) {
+            live[ptr] = bsize;
+            stats.bytesInUse += bsize;
+            stats.allocated++;
+        }
+        return ptr;
+    }
+
+    /// Free a block of allocate() once @p event has completed.  Returns false
+    /// if the block was not allocated from this pool.
+    bool release(void* ptr, const Event& event) {
+        std::lock_guard<std::mutex> l(mutex);
+
+        auto it = live.find(ptr);
+        if (it == live.end()) {
+            return false;
+        }
+        size_t bsize = it->second;
+        live.erase(it);
+        stats.bytesInUse -= bsize;
+
+        bins[bsize].push_back(Block{ ptr, event });
+        stats.bytesFree += bsize;
+        if (stats.bytesFree > maxBytes) {
+            returnBlocks(maxBytes);
+        }
+        return true;
+    }
+
+    /// Give the free blocks whose frees have completed back to the backend.
+    void trim() {
+        std::lock_guard<std::mutex> l(mutex);
+        returnBlocks(0);
+    }
+
+    StreamPoolStats getStats() {
+        std::lock_guard<std::mutex> l(mutex);
+        return stats;
+    }
+
+private:
+    struct Block {
+        void* ptr;
+        Event event;
+    };
+
+    // give completed free blocks back until at most @p keep bytes are held,
+    // largest blocks first
+    void returnBlocks(size_t keep) {
+        for (auto bin = bins.rbegin(); bin != bins.rend() && stats.bytesFree > keep; ++bin) {
+            auto& blocks = bin->second;
+            for (auto b = blocks.begin(); b != blocks.end() && stats.bytesFree > keep;) {
+                if (backend.isDone(b->event)) {
+                    backend.free(b->ptr);
+                    stats.bytesFree -= bin->first;
+                    stats.returned++;
+                    b = blocks.erase(b);
+                } else {
+                    ++b;
+                }
+            }
+        }
+    }
+
+    Backend backend;
+    const size_t maxBytes;
+    const size_t minBlock;
+
+    std::mutex mutex;
+    std::map<size_t, std::deque<Block> > bins;  // free blocks by size class, in release order
+    std::unordered_map<void*, size_t> live;     // allocated blocks and their size class
+    StreamPoolStats stats;
+};
+
+} // namespace Kalmar
+/** \endcond */
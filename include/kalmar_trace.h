@@ -0,0 +1,364 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__linux__)
+#include <csignal>
+#include <unistd.h>
+#endif
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// kinds of traced runtime events
+enum TraceKind {
+    TraceDispatch = 0,   ///< kernel dispatch; args: grid size, queue
+    TraceCopy,           ///< copy; args: bytes, hcCommandKind
+    TraceMarker,         ///< marker / barrier packet; args: release scope, queue
+    TraceWait,           ///< host wait; args: wait mode, queue
+    TracePoolGrowth,     ///< signal or kernarg pool growth; args: new size
+    TraceQueueSteal,     ///< HSA queue taken from an idle accelerator_view; args: victim queue, HSA queue id
+    TraceKindCount
+};
+
+/// one event
+struct TraceRecord {
+    uint64_t begin;    ///< ns, steady clock
+    uint64_t end;      ///< ns, == begin for instant events
+    const char* name;  ///< string literal or Tracer::intern()
+    uint64_t arg0;
+    uint64_t arg1;
+    uint32_t kind;     ///< TraceKind
+    uint32_t tid;      ///< TraceBuffer of the thread
+};
+
+/// Ring buffer of the events of one thread.
+///
+/// Only its thread writes, without locks.  Once full, the oldest events are
+/// overwritten.  Each slot is a seqlock: the writer invalidates its sequence
+/// number, stores the record and publishes the sequence number of the event,
+/// so that a snapshot taken while the thread records skips the slots being
+/// overwritten.
+class TraceBuffer {
+public:
+    TraceBuffer(size_t capacity, uint32_t tid) : slots(roundUp(capacity)), tid(tid), head(0) {}
+
+    void push(const TraceRecord& r) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[h & (slots.size() - 1)];
+        slot.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.words[0].store(r.begin, std::memory_order_relaxed);
+        slot.words[1].store(r.end, std::memory_order_relaxed);
+        slot.words[2].store(reinterpret_cast<uintptr_t>(r.name), std::memory_order_relaxed);
+        slot.words[3].store(r.arg0, std::memory_order_relaxed);
+        slot.words[4].store(r.arg1, std::memory_order_relaxed);
+        slot.words[5].store(r.kind, std::memory_order_relaxed);
+        slot.seq.store(h + 1, std::memory_order_release);
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    /// append the events still in the buffer, oldest first, to @p out
+    void snapshot(std::vector<TraceRecord>& out) const {
+        const uint64_t size = slots.size();
+        uint64_t last = head.load(std::memory_order_acquire);
+        uint64_t first = last > size ? last - size : 0;
+        for (uint64_t i = first; i < last; ++i) {
+            const Slot& slot = slots[i & (size - 1)];
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            TraceRecord r;
+            r.begin = slot.words[0].load(std::memory_order_relaxed);
+            r.end = slot.words[1].load(std::memory_order_relaxed);
+            r.name = reinterpret_cast<const char*>(uintptr_t(slot.words[2].load(std::memory_order_relaxed)));
+            r.arg0 = slot.words[3].load(std::memory_order_relaxed);
+            r.arg1 = slot.words[4].load(std::memory_order_relaxed);
+            r.kind = uint32_t(slot.words[5].load(std::memory_order_relaxed));
+            r.tid = tid;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // overwritten since, or being overwritten
+            if (seq != i + 1 || slot.seq.load(std::memory_order_relaxed) != seq) {
+                continue;
+            }
+            out.push_back(r);
+        }
+    }
+
+    /// events recorded, including the overwritten ones
+    uint64_t recorded() const { return head.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq;       // event number + 1, 0 while written
+        std::atomic<uint64_t> words[6];  // the TraceRecord but the tid
+        Slot() : seq(0) {}
+    };
+
+    static size_t roundUp(size_t n) {
+        size_t p = 64;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    std::vector<Slot> slots;  // power of 2
+    const uint32_t tid;
+    std::atomic<uint64_t> head;
+};
+
+/// Binary tracer of runtime events.
+///
+/// The events go to a ring buffer per thread, with nanosecond timestamps,
+/// and are exported as Chrome trace JSON (chrome://tracing, Perfetto).  When
+/// tracing is off, recording an event costs a relaxed load and a branch.
+///
+/// Environment:
+///   HCC_TRACE=<file>        trace from the start, export to file at exit
+///   HCC_TRACE_BUFFER=<n>    events kept per thread, 65536 by default
+///   HCC_TRACE_SIGNAL=<sig>  also export on signal sig (e.g. 10, SIGUSR1)
+class Tracer {
+public:
+    /// the process tracer, set up from the environment on first use
+    static Tracer& get() {
+        // leaked: the buffers are read at exit, after the static destructors
+        static Tracer* tracer = new Tracer();
+        return *tracer;
+    }
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+
+    /// start recording, with @p capacity events per thread for the threads
+    /// which did not record yet
+    void enable(size_t capacity = 0) {
+        if (capacity != 0) {
+            this->capacity.store(capacity, std::memory_order_relaxed);
+        }
+        on.store(true, std::memory_order_relaxed);
+    }
+
+    void disable() { on.store(false, std::memory_order_relaxed); }
+
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /// record an event of the calling thread, instant if @p end == @p begin
+    void record(TraceKind kind, const char* name, uint64_t begin, uint64_t end,
+                uint64_t arg0 = 0, uint64_t arg1 = 0) {
+        TraceRecord r = { begin, end, name, arg0, arg1, uint32_t(kind), 0 };
+        threadBuffer()->push(r);
+    }
+
+    /// a copy of @p name which lives as long as the tracer
+    const char* intern(const std::string& name) {
+        std::lock_guard<std::mutex> l(mutex);
+        return names.insert(name).first->c_str();
+    }
+
+    /// events of all the threads, in each thread oldest first
+    std::vector<TraceRecord> snapshot() {
+        std::vector<TraceRecord> out;
+        std::lock_guard<std::mutex> l(mutex);
+        for (auto& b : buffers) {
+            b->snapshot(out);
+        }
+        return out;
+    }
+
+    /// write the events as Chrome trace JSON, returns the number of events
+    size_t exportChrome(std::ostream& os) {
+        static const char* categories[TraceKindCount] = {
+            "dispatch", "copy", "marker", "wait", "pool", "steal" };
+        static const char* argNames[TraceKindCount][2] = {
+            { "grid", "queue" }, { "bytes", "kind" }, { "scope", "queue" },
+            { "mode", "queue" }, { "size", "" }, { "victim", "hwqueue" } };
+
+        std::vector<TraceRecord> events = snapshot();
+        long pid = getPid();
+        os << "{\"traceEvents\":[\n";
+        char buf[160];
+        for (size_t i = 0; i < events.size(); ++i) {
+            const TraceRecord& e = events[i];
+            uint32_t kind = e.kind < TraceKindCount ? e.kind : 0;
+            os << (i ? ",\n" : "") << "{\"name\":\"";
+            writeEscaped(os, e.name ? e.name : categories[kind]);
+            snprintf(buf, sizeof(buf), "\",\"cat\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,",
+                     categories[kind], e.end > e.begin ? "X" : "i", e.begin / 1000.0);
+            os << buf;
+            if (e.end > e.begin) {
+                snprintf(buf, sizeof(buf), "\"dur\":%.3f,", (e.end - e.begin) / 1000.0);
+            } else {
+                snprintf(buf, sizeof(buf), "\"s\":\"t\",");
+            }
+            os << buf;
+            snprintf(buf, sizeof(buf), "\"pid\":%ld,\"tid\":%u,\"args\":{\"%s\":%llu",
+                     pid, e.tid, argNames[kind][0], (unsigned long long)e.arg0);
+            os << buf;
+            if (argNames[kind][1][0]) {
+                snprintf(buf, sizeof(buf), ",\"%s\":%llu", argNames[kind][1], (unsigned long long)e.arg1);
+                os << buf;
+            }
+            os << "}}";
+        }
+        os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+        return events.size();
+    }
+
+    /// export to @p path, false if it can't be written
+    bool exportChrome(const char* path) {
+        std::ofstream file(path);
+        if (!file) {
+            return false;
+        }
+        exportChrome(file);
+        return bool(file);
+    }
+
+private:
+    Tracer() : on(false), capacity(65536) {
+        const char* buffer = getenv("HCC_TRACE_BUFFER");
+        if (buffer && atol(buffer) > 0) {
+            capacity.store(atol(buffer), std::memory_order_relaxed);
+        }
+        const char* trace = getenv("HCC_TRACE");
+        if (trace && *trace) {
+            path = trace;
+            enable();
+            atexit([] { Tracer& t = Tracer::get(); t.exportChrome(t.path.c_str()); });
+            const char* sig = getenv("HCC_TRACE_SIGNAL");
+            if (sig && atoi(sig) > 0) {
+                exportOnSignal(atoi(sig));
+            }
+        }
+    }
+
+    TraceBuffer* threadBuffer() {
+        thread_local TraceBuffer* buffer = nullptr;
+        if (buffer == nullptr) {
+            std::lock_guard<std::mutex> l(mutex);
+            // never freed: the events outlive the thread
+            buffer = new TraceBuffer(capacity.load(std::memory_order_relaxed), uint32_t(buffers.size()));
+            buffers.push_back(buffer);
+        }
+        return buffer;
+    }
+
+    // Exporting is not async-signal-safe: the handler only wakes up an
+    // exporting thread through a pipe.
+    void exportOnSignal(int sig) {
+#if defined(__linux__)
+        static int fds[2] = { -1, -1 };
+        if (pipe(fds) != 0) {
+            return;
+        }
+        struct sigaction sa = {};
+        sa.sa_handler = [] (int) {
+            char c = 0;
+            ssize_t n = write(fds[1], &c, 1);
+            (void)n;
+        };
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(sig, &sa, nullptr);
+        std::thread([] {
+            char c;
+            while (read(fds[0], &c, 1) == 1) {
+                Tracer& t = Tracer::get();
+                t.exportChrome(t.path.c_str());
+            }
+        }).detach();
+#endif
+    }
+
+    static long getPid() {
+#if defined(__linux__)
+        return long(getpid());
+#else
+        return 0;
+#endif
+    }
+
+    static void writeEscaped(std::ostream& os, const char* s) {
+        for (; *s; ++s) {
+            unsigned char c = *s;
+            if (c == '"' || c == '\\') {
+                os << '\\' << c;
+            } else if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                os << buf;
+            } else {
+                os << c;
+            }
+        }
+    }
+
+    std::atomic<bool> on;
+    std::atomic<size_t> capacity;
+    std::string path;
+
+    std::mutex mutex;
+    std::vector<TraceBuffer*> buffers;
+    std::unordered_set<std::string> names;  // nodes are stable
+};
+
+/// whether runtime events are being traced
+inline bool traceEnabled() {
+    return Tracer::get().enabled();
+}
+
+/// record an instant event
+inline void traceInstant(TraceKind kind, const char* name, uint64_t arg0 = 0, uint64_t arg1 = 0) {
+    Tracer& t = Tracer::get();
+    if (t.enabled()) {
+        uint64_t now = Tracer::now();
+        t.record(kind, name, now, now, arg0, arg1);
+    }
+}
+
+/// records an event lasting for the scope, if tracing is on when it begins
+class TraceScope {
+public:
+    TraceScope(TraceKind kind, const char* name, uint64_t arg0 = 0, uint64_t arg1 = 0)
+        : kind(kind), name(name), arg0(arg0), arg1(arg1),
+          begin(traceEnabled() ? Tracer::now() : 0) {}
+
+    ~TraceScope() {
+        if (begin != 0) {
+            uint64_t end = Tracer::now();
+            // zero-length events are not instants
+            Tracer::get().record(kind, name, begin, end > begin ? end : begin + 1, arg0, arg1);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    TraceKind kind;
+    const char* name;
+    uint64_t arg0, arg1;
+    uint64_t begin;
+};
+
+} // namespace Kalmar
+/** \endcond */
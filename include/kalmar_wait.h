@@ -0,0 +1,132 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+/** \cond HIDDEN_SYMBOLS */
+namespace Kalmar {
+
+/// counters of an AdaptiveWaitPolicy
+struct AdaptiveWaitStats {
+    uint64_t spins;   ///< waits completed while spinning
+    uint64_t yields;  ///< waits completed while yielding the core
+    uint64_t blocks;  ///< waits which had to block
+};
+
+/// Spin-then-block waiting (hcWaitModeAdaptive).
+///
+/// Spinning has the lowest wake-up latency but burns a core, blocking frees
+/// the core but wakes up late.  The policy learns how long waits on each kind
+/// of operation (e.g. each kernel) take, as an exponential moving average,
+/// and:
+///  - spins for up to twice the average when that fits in the spin budget,
+///    so short operations are caught without a sleep;
+///  - then yields the core for the yield budget;
+///  - then blocks.
+/// Operations known to take longer than the spin budget skip the spinning.
+///
+/// @p Signal passed to wait() provides:
+///   bool done();   // poll, true once the operation has completed
+///   void block();  // wait for completion without using the CPU
+class AdaptiveWaitPolicy {
+public:
+    enum Phase { SPIN, YIELD, BLOCK };
+
+    /// budgets in microseconds, @p weight of the latest wait in the average
+    AdaptiveWaitPolicy(uint32_t maxSpinUs = 200, uint32_t yieldUs = 50, double weight = 0.25)
+        : maxSpin(maxSpinUs), yield(yieldUs), weight(weight), stats() {}
+
+    AdaptiveWaitPolicy(const AdaptiveWaitPolicy&) = delete;
+    AdaptiveWaitPolicy& operator=(const AdaptiveWaitPolicy&) = delete;
+
+    /// wait for @p signal, @p key identifies the kind of operation
+    template <typename Signal>
+    Phase wait(const void* key, Signal& signal) {
+        typedef std::chrono::steady_clock clock;
+        clock::time_point start = clock::now();
+
+        std::chrono::microseconds spin = spinBudget(key);
+        Phase phase = BLOCK;
+        if (signal.done()) {
+            phase = SPIN;
+        } else {
+            clock::time_point spinEnd = start + spin;
+            clock::time_point yieldEnd = spinEnd + yield;
+            while (clock::now() < spinEnd) {
+                if (signal.done()) {
+                    phase = SPIN;
+                    break;
+                }
+            }
+            while (phase == BLOCK && clock::now() < yieldEnd) {
+                std::this_thread::yield();
+                if (signal.done()) {
+                    phase = YIELD;
+                }
+            }
+            if (phase == BLOCK) {
+                signal.block();
+            }
+        }
+
+        record(key, phase, std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start));
+        return phase;
+    }
+
+    /// how long a wait on @p key would spin
+    std::chrono::microseconds spinBudget(const void* key) {
+        std::lock_guard<std::mutex> l(mutex);
+        auto it = averages.find(key);
+        if (it == averages.end()) {
+            // unknown yet: spin for the whole budget to learn short operations
+            return maxSpin;
+        }
+        double budget = 2 * it->second;
+        if (budget > maxSpin.count()) {
+            return std::chrono::microseconds(0);
+        }
+        return std::chrono::microseconds(static_cast<int64_t>(budget) + 1);
+    }
+
+    AdaptiveWaitStats getStats() {
+        std::lock_guard<std::mutex> l(mutex);
+        return stats;
+    }
+
+private:
+    void record(const void* key, Phase phase, std::chrono::microseconds elapsed) {
+        std::lock_guard<std::mutex> l(mutex);
+        auto it = averages.find(key);
+        if (it == averages.end()) {
+            averages[key] = static_cast<double>(elapsed.count());
+        } else {
+            it->second += weight * (elapsed.count() - it->second);
+        }
+        switch (phase) {
+            case SPIN:  stats.spins++;  break;
+            case YIELD: stats.yields++; break;
+            case BLOCK: stats.blocks++; break;
+        }
+    }
+
+    const std::chrono::microseconds maxSpin;
+    const std::chrono::microseconds yield;
+    const double weight;
+
+    std::mutex mutex;
+    std::unordered_map<const void*, double> averages;  // average wait in us, by key
+    AdaptiveWaitStats stats;
+};
+
+} // namespace Kalmar
+/** \endcond */
@@ -6,6 +6,8 @@
 #include <new>
 #include "hc.hpp"
 #include "hc_am.hpp"
+#include "kalmar_alloc_cache.h"
+#include "kalmar_slab.h"
 
 namespace hc
 {
@@ -47,6 +49,121 @@ bool operator!=(const am_allocator<T>&, const am_allocator<U>&) { return false;
 template<typename T>
 using pinned_vector = std::vector<T, am_allocator<T>>;
 
+
+// counters of a pinned_host_pool
+struct pinned_host_pool_stats {
+  Kalmar::SlabStats small;        // blocks carved out of pinned chunks
+  Kalmar::AllocCacheStats large;  // blocks pinned on their own, kept for reuse
+};
+
+// Pool of pinned host memory of an accelerator.
+//
+// am_allocator pins (and maps to all the peers) every block it allocates and
+// unpins it when freed, so a vector growing by doubling pins and unpins at
+// each step.  The pool instead:
+//  - carves blocks up to max_chunk_block bytes out of pinned chunks of at
+//    least 64 KB, one size class per chunk (see Kalmar::SlabAllocator);
+//  - keeps the larger blocks when they are freed, up to max_cached bytes, and
+//    hands them out again for requests of the same size class (see
+//    Kalmar::AllocCache).
+// Blocks are tracked like memory of am_alloc, through their chunk for the
+// small ones.  The memory is unpinned with the pool, or by trim().
+class pinned_host_pool {
+public:
+  explicit pinned_host_pool(const hc::accelerator& acc = hc::accelerator(),
+                            std::size_t max_cached = std::size_t(256) << 20,
+                            std::size_t max_chunk_block = std::size_t(64) << 10)
+    : chunks(Backend{acc}, max_chunk_block),
+      blocks(Backend{acc}, max_cached, max_cached / 4) {}
+
+  pinned_host_pool(const pinned_host_pool&) = delete;
+  pinned_host_pool& operator=(const pinned_host_pool&) = delete;
+
+  // Allocate @p bytes of pinned host memory, throw std::bad_alloc on failure.
+  void* allocate(std::size_t bytes) {
+    void* p = chunks.allocate(bytes);
+    if (p == nullptr && !chunks.handles(bytes)) {
+      bool fresh;
+      p = blocks.allocate(0, bytes, &fresh);
+    }
+    if (p == nullptr) { throw std::bad_alloc(); }
+    return p;
+  }
+
+  // Free a block of allocate().
+  void deallocate(void* p) {
+    if (!chunks.free(p) && !blocks.release(p)) {
+      hc::am_free(p);
+    }
+  }
+
+  // Unpin the large blocks kept for reuse.
+  void trim() { blocks.trim(); }
+
+  pinned_host_pool_stats get_stats() {
+    return pinned_host_pool_stats{ chunks.getStats(), blocks.getStats() };
+  }
+
+  // The pool of am_pool_allocator by default, on the default accelerator.
+  // Never destroyed: its memory stays pinned until the process exits.
+  static pinned_host_pool& get_default() {
+    static pinned_host_pool* pool = new pinned_host_pool();
+    return *pool;
+  }
+
+private:
+  struct Backend {
+    typedef int Key;
+    hc::accelerator acc;
+
+    void* allocate(std::size_t size) {
+      return hc::am_alloc(size, acc, amHostPinned);
+    }
+    void* allocate(const int&, std::size_t size) { return allocate(size); }
+    void free(void* p) { hc::am_free(p); }
+    void free(const int&, void* p) { free(p); }
+  };
+
+  Kalmar::SlabAllocator<Backend> chunks;
+  Kalmar::AllocCache<Backend> blocks;
+};
+
+// allocator of pinned host memory from a pinned_host_pool, for containers
+// which grow and shrink often:
+//   hc::pinned_host_pool pool(acc);
+//   std::vector<float, hc::am_pool_allocator<float>> v(hc::am_pool_allocator<float>(&pool));
+template <class T>
+struct am_pool_allocator {
+  typedef T value_type;
+
+  am_pool_allocator() : pool(&pinned_host_pool::get_default()) {}
+
+  explicit am_pool_allocator(pinned_host_pool* pool) : pool(pool) {}
+
+  template <class U> am_pool_allocator(const am_pool_allocator<U>& other) : pool(other.pool) {}
+
+  T* allocate(std::size_t n) {
+    if (n > std::size_t(-1) / sizeof(T)) { throw std::bad_alloc(); }
+    return static_cast<T*>(pool->allocate(n*sizeof(T)));
+  }
+
+  void deallocate(T* p, std::size_t) {
+    pool->deallocate(p);
+  }
+
+  pinned_host_pool* pool;
+};
+
+template <class T, class U>
+bool operator==(const am_pool_allocator<T>& a, const am_pool_allocator<U>& b) { return a.pool == b.pool; }
+
+template <class T, class U>
+bool operator!=(const am_pool_allocator<T>& a, const am_pool_allocator<U>& b) { return a.pool != b.pool; }
+
+// pinned_vector whose memory comes from the default pinned_host_pool
+template<typename T>
+using pooled_pinned_vector = std::vector<T, am_pool_allocator<T>>;
+
 } // namespace hc
 
 #endif // _PINNED_VECTOR_H
@@ -13,6 +13,8 @@
 
 #include <kalmar_runtime.h>
 #include <kalmar_aligned_alloc.h>
+#include <kalmar_cpu_buffers.h>
+#include <kalmar_numa.h>
 
 extern "C" void PushArgImpl(void *ker, int idx, size_t sz, const void *v) {}
 
@@ -25,18 +27,41 @@ public:
   CPUFallbackQueue(KalmarDevice* pDev) : KalmarQueue(pDev) {}
 
   void read(void* device, void* dst, size_t count, size_t offset) override {
-      if (dst != device)
+      if (dst != device) {
+          CopyProfileScope profile(hcMemcpyDeviceToHost, count);
           memmove(dst, (char*)device + offset, count);
+      }
   }
 
   void write(void* device, const void* src, size_t count, size_t offset, bool blocking) override {
-      if (src != device)
+      if (src != device) {
+          CopyProfileScope profile(hcMemcpyHostToDevice, count);
           memmove((char*)device + offset, src, count);
+      }
   }
 
   void copy(void* src, void* dst, size_t count, size_t src_offset, size_t dst_offset, bool blocking) override {
-      if (src != dst)
+      if (src != dst) {
+          CopyProfileScope profile(hcMemcpyDeviceToDevice, count);
           memmove((char*)dst + dst_offset, (char*)src + src_offset, count);
+      }
+  }
+
+  // host memory on both sides, e.g. from am_alloc on the cpu accelerator
+  void copy(const void *src, void *dst, size_t size_bytes) override {
+      if (src != dst) {
+          CopyProfileScope profile(hcMemcpyHostToHost, size_bytes);
+          memmove(dst, src, size_bytes);
+      }
+  }
+
+  void copy_ext(const void *src, void *dst, size_t size_bytes, hcCommandKind copyDir, const hc::AmPointerInfo &srcInfo, const hc::AmPointerInfo &dstInfo, bool forceUnpinnedCopy) override {
+      copy(src, dst, size_bytes);
+  }
+
+  void copy_ext(const void *src, void *dst, size_t size_bytes, hcCommandKind copyDir, const hc::AmPointerInfo &srcInfo, const hc::AmPointerInfo &dstInfo,
+                const Kalmar::KalmarDevice *copyDev, bool forceUnpinnedCopy) override {
+      copy(src, dst, size_bytes);
   }
 
   void* map(void* device, size_t count, size_t offset, bool modify) override {
@@ -50,6 +75,7 @@ public:
 
 class CPUFallbackDevice final : public KalmarDevice
 {
+    CPUBufferAllocator buffers;
 public:
     CPUFallbackDevice() : KalmarDevice() {}
 
@@ -63,11 +89,17 @@ public:
     uint32_t get_version() const override { return 0; }
 
     void* create(size_t count, struct rw_info* /* not used */) override {
-        return kalmar_aligned_alloc(0x1000, count);
+        return buffers.allocate(count);
     }
     void release(void *device, struct rw_info* /* not used */ ) override { 
-        kalmar_aligned_free(device);
+        buffers.free(device);
+    }
+    bool setNumaPolicy(hcNumaPolicy policy, bool pinWorkers) override {
+        cpuNumaSettings().policy = policy;
+        cpuNumaSettings().pinWorkers = pinWorkers;
+        return true;
     }
+    hcNumaPolicy getNumaPolicy() override { return hcNumaPolicy(cpuNumaSettings().policy.load()); }
     std::shared_ptr<KalmarQueue> createQueue(execute_order order = execute_in_order, queue_priority priority = priority_normal, uint64_t deadline = -1) override {
         return std::shared_ptr<KalmarQueue>(new CPUFallbackQueue(this));
     }
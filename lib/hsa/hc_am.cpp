@@ -1,10 +1,16 @@
 #include "hc_am.hpp"
 
 #include <cstdint>
+#include <cstring>
 #include <iomanip>
+#include <sys/mman.h>
 #include <hsa/hsa.h>
 #include <hsa/hsa_ext_amd.h>
 
+#include "hsa_api.h"
+#include "kalmar_alloc_cache.h"
+#include "kalmar_slab.h"
+
 #define DB_TRACKER 0
 
 #if DB_TRACKER 
@@ -19,6 +25,9 @@
 // Pointer Tracker Structures:
 //=========================================================================================================
 #include <map>
+#include <vector>
+#include <mutex>
+#include <set>
 #include <iostream>
 
 namespace hc {
@@ -112,7 +121,10 @@ std::ostream &operator<<(std::ostream &os, const hc::AmPointerInfo &ap)
        << std::left << " peers:" << std::right
        ;
 
-    printRocrPointerInfo(os, ap._isInDeviceMem ? ap._devicePointer : ap._hostPointer);
+    // ROCr knows nothing of the memory of the CPU accelerators
+    if (ap._acc.is_hsa_accelerator()) {
+        printRocrPointerInfo(os, ap._isInDeviceMem ? ap._devicePointer : ap._hostPointer);
+    }
     return os;
 }
 
@@ -127,7 +139,7 @@ typedef std::map<AmMemoryRange, hc::AmPointerInfo, AmMemoryRangeCompare> MapTrac
 public:
 
     void insert(void *pointer, hc::AmPointerInfo &p);
-    int remove(void *pointer);
+    int remove(void *pointer, hc::AmPointerInfo *removed = nullptr);
 
     MapTrackerType::iterator find(const void *hostPtr) ;
     
@@ -160,12 +172,20 @@ void AmPointerTracker::insert (void *pointer, hc::AmPointerInfo &p)
 
 
 //---
-// Return 1 if removed or 0 if not found.
-int AmPointerTracker::remove (void *pointer)
+// Return 1 if removed or 0 if not found.  The info of the range is copied to removed, if not NULL.
+int AmPointerTracker::remove (void *pointer, hc::AmPointerInfo *removed)
 {
     std::lock_guard<std::mutex> l (_mutex);
     mprintf ("remove: %p\n", pointer);
-    return _tracker.erase(AmMemoryRange(pointer,1));
+    auto iter = _tracker.find(AmMemoryRange(pointer,1));
+    if (iter == _tracker.end()) {
+        return 0;
+    }
+    if (removed) {
+        *removed = iter->second;
+    }
+    _tracker.erase(iter);
+    return 1;
 }
 
 
@@ -179,8 +199,22 @@ AmPointerTracker::MapTrackerType::iterator  AmPointerTracker::find (const void *
 }
 
 
+// Base of the slab containing ptr, NULL if ptr was not sub-allocated from a slab.
+static void *amSlabOf(const void *ptr);
+
+// The accelerators which are not HSA ones (the CPU accelerators of HCC_RUNTIME=CPU)
+// have their memory on the host: am_alloc takes it from the heap, and the HSA calls
+// on it (peers, locking) are skipped.
+static bool isHostAccelerator(const hc::accelerator &acc)
+{
+    return !acc.is_hsa_accelerator();
+}
+
+
 //---
 // Remove all tracked locations, and free the associated memory (if the range was originally allocated by AM).
+// Blocks of slabs are freed with their slab, by am_memtracker_reset.
+// Host memory locked for a CPU accelerator is unlocked.
 // Returns count of ranges removed.
 size_t AmPointerTracker::reset (const hc::accelerator &acc) 
 {
@@ -191,7 +225,12 @@ size_t AmPointerTracker::reset (const hc::accelerator &acc)
     // relies on C++11 (erase returns iterator)
     for (auto iter = _tracker.begin() ; iter != _tracker.end(); ) {
         if (iter->second._acc == acc) {
-            if (iter->second._isAmManaged) {
+            if (iter->second._isAmManaged && isHostAccelerator(acc)) {
+                Kalmar::kalmar_aligned_free(const_cast<void*> (iter->first._basePointer));
+            } else if (isHostAccelerator(acc)) {
+                // am_memory_host_lock
+                munlock(iter->second._hostPointer, iter->second._sizeBytes);
+            } else if (iter->second._isAmManaged && !amSlabOf(iter->first._basePointer)) {
                 hsa_amd_memory_pool_free(const_cast<void*> (iter->first._basePointer));
             }
             count++;
@@ -215,8 +254,9 @@ void AmPointerTracker::update_peers (const hc::accelerator &acc, int peerCnt, hs
 
     // relies on C++11 (erase returns iterator)
     for (auto iter = _tracker.begin() ; iter != _tracker.end(); ) {
-        if (iter->second._acc == acc) {
-            hsa_amd_agents_allow_access(peerCnt, peerAgents, NULL, const_cast<void*> (iter->first._basePointer));
+        if (iter->second._acc == acc && !isHostAccelerator(acc)) {
+            void *slab = amSlabOf(iter->first._basePointer);
+            hsa_amd_agents_allow_access(peerCnt, peerAgents, NULL, slab ? slab : const_cast<void*> (iter->first._basePointer));
         } 
         iter++;
     }
@@ -229,6 +269,220 @@ void AmPointerTracker::update_peers (const hc::accelerator &acc, int peerCnt, hs
 AmPointerTracker g_amPointerTracker;  // Track all am pointer allocations.
 
 
+//=========================================================================================================
+// Allocation cache:
+//=========================================================================================================
+// Blocks freed with am_free are kept for later am_alloc calls of the same
+// accelerator, pool and flags when HCC_AM_CACHE_SIZE is set to the number of
+// MB of free blocks to keep.  Blocks above a quarter of that go straight to
+// the pool.
+struct AmAllocKey {
+    uint64_t agent;
+    uint64_t pool;
+    unsigned flags;
+
+    bool operator<(const AmAllocKey &other) const {
+        if (agent != other.agent) return agent < other.agent;
+        if (pool != other.pool) return pool < other.pool;
+        return flags < other.flags;
+    }
+};
+
+struct AmPoolBackend {
+    typedef AmAllocKey Key;
+
+    void* allocate(const AmAllocKey &key, size_t size) {
+        hsa_amd_memory_pool_t pool;
+        pool.handle = key.pool;
+        void *ptr = NULL;
+        if (hsa_amd_memory_pool_allocate(pool, size, 0, &ptr) != HSA_STATUS_SUCCESS) {
+            return NULL;
+        }
+        return ptr;
+    }
+
+    void free(const AmAllocKey &key, void *ptr) {
+        hsa_amd_memory_pool_free(ptr);
+    }
+};
+
+typedef Kalmar::AllocCache<AmPoolBackend> AmAllocCache;
+
+// NULL if the cache is disabled.
+// Never destroyed: the cached blocks can't be freed after the runtime is shut down at exit.
+static AmAllocCache *getAllocCache()
+{
+    static AmAllocCache *cache = [] () -> AmAllocCache* {
+        size_t maxBytes = Kalmar::getContext()->getAmCacheSize();
+        return maxBytes ? new AmAllocCache(AmPoolBackend(), maxBytes, maxBytes / 4) : NULL;
+    } ();
+    return cache;
+}
+
+//=========================================================================================================
+// Slabs:
+//=========================================================================================================
+// Device memory allocations up to HCC_AM_SLAB_MAX_SIZE KB are carved out of
+// slabs of the pool, per accelerator.  Each block has its own tracker entry;
+// the slab is the allocation HSA knows about, eg for the peer access.
+// Disabled by default: HSA calls which take the start of an allocation (such
+// as IPC handles) do not work on the blocks.
+class AmSlabs;
+
+struct AmSlabBackend {
+    AmAllocKey key;
+    AmSlabs *slabs;  // indexes the slabs by address
+
+    void* allocate(size_t size);
+    void free(void *ptr);
+};
+
+typedef Kalmar::SlabAllocator<AmSlabBackend> AmSlabAllocator;
+
+// The slab allocators of each accelerator, pool and flags, and the slabs of
+// all of them by address, so that freeing a block looks up its allocator
+// rather than asking each of them.  _mutex is never held while calling an
+// allocator, whose backend takes it to index the slabs.
+class AmSlabs {
+public:
+    AmSlabs(size_t maxSize) : _maxSize(maxSize) {}
+
+    void *allocate(const AmAllocKey &key, size_t sizeBytes) {
+        if (sizeBytes > _maxSize) {
+            return NULL;
+        }
+        AmSlabAllocator *slab;
+        {
+            std::lock_guard<std::mutex> l (_mutex);
+            AmSlabAllocator *&s = _slabs[key];
+            if (!s) {
+                s = new AmSlabAllocator(AmSlabBackend{ key, this }, _maxSize);
+            }
+            slab = s;
+        }
+        return slab->allocate(sizeBytes);
+    }
+
+    // Return true if ptr was a block of a slab.
+    bool free(void *ptr) {
+        AmSlabAllocator *slab = NULL;
+        {
+            std::lock_guard<std::mutex> l (_mutex);
+            auto it = find(ptr);
+            if (it == _ranges.end()) {
+                return false;
+            }
+            slab = it->second.allocator;
+        }
+        return slab->free(ptr);
+    }
+
+    void *slabOf(const void *ptr) {
+        std::lock_guard<std::mutex> l (_mutex);
+        auto it = find(ptr);
+        return (it != _ranges.end()) ? reinterpret_cast<void*>(it->first) : NULL;
+    }
+
+    // Free the slabs of an agent, including their blocks.
+    void reset(uint64_t agent) {
+        std::vector<AmSlabAllocator*> slabs;
+        {
+            std::lock_guard<std::mutex> l (_mutex);
+            for (auto &s : _slabs) {
+                if (s.first.agent == agent) {
+                    slabs.push_back(s.second);
+                }
+            }
+        }
+        for (AmSlabAllocator *s : slabs) {
+            s->reset();
+        }
+    }
+
+    // Called by the backend of the allocator of key.
+    void addSlab(const AmAllocKey &key, void *base, size_t bytes) {
+        std::lock_guard<std::mutex> l (_mutex);
+        _ranges[reinterpret_cast<uintptr_t>(base)] = SlabRange{ bytes, _slabs[key] };
+    }
+
+    void removeSlab(void *base) {
+        std::lock_guard<std::mutex> l (_mutex);
+        _ranges.erase(reinterpret_cast<uintptr_t>(base));
+    }
+
+private:
+    struct SlabRange {
+        size_t bytes;
+        AmSlabAllocator *allocator;
+    };
+
+    // slab containing ptr, _mutex held
+    std::map<uintptr_t, SlabRange>::iterator find(const void *ptr) {
+        uintptr_t p = reinterpret_cast<uintptr_t>(ptr);
+        auto it = _ranges.upper_bound(p);
+        if (it == _ranges.begin()) {
+            return _ranges.end();
+        }
+        --it;
+        return (p < it->first + it->second.bytes) ? it : _ranges.end();
+    }
+
+    const size_t _maxSize;
+    std::mutex _mutex;
+    std::map<AmAllocKey, AmSlabAllocator*> _slabs;  // never deleted, like the cache
+    std::map<uintptr_t, SlabRange> _ranges;         // slabs of all the allocators, by base address
+};
+
+void* AmSlabBackend::allocate(size_t size)
+{
+    void *base = AmPoolBackend().allocate(key, size);
+    if (base) {
+        slabs->addSlab(key, base, size);
+    }
+    return base;
+}
+
+void AmSlabBackend::free(void *ptr)
+{
+    slabs->removeSlab(ptr);
+    hsa_amd_memory_pool_free(ptr);
+}
+
+// NULL if the slabs are disabled.
+static AmSlabs *getAmSlabs()
+{
+    static AmSlabs *slabs = [] () -> AmSlabs* {
+        size_t maxBytes = Kalmar::getContext()->getAmSlabMaxSize();
+        return maxBytes ? new AmSlabs(maxBytes) : NULL;
+    } ();
+    return slabs;
+}
+
+static void *amSlabOf(const void *ptr)
+{
+    AmSlabs *slabs = getAmSlabs();
+    return slabs ? slabs->slabOf(ptr) : NULL;
+}
+
+static void *allocBlock(AmAllocCache *cache, const AmAllocKey &key, size_t sizeBytes, bool *fresh)
+{
+    if (cache) {
+        return cache->allocate(key, sizeBytes, fresh);
+    }
+    *fresh = true;
+    return AmPoolBackend().allocate(key, sizeBytes);
+}
+
+static void discardBlock(AmAllocCache *cache, const AmAllocKey &key, void *ptr)
+{
+    if (cache) {
+        cache->discard(key, ptr);
+    } else {
+        hsa_amd_memory_pool_free(ptr);
+    }
+}
+
+
 //=========================================================================================================
 // API Definitions.
 //=========================================================================================================
@@ -257,24 +511,31 @@ auto_voidp am_alloc(size_t sizeBytes, hc::accelerator &acc, unsigned flags)
 
             if (alloc_region && alloc_region->handle != -1) {
 
-                hsa_status_t s1 = hsa_amd_memory_pool_allocate(*alloc_region, sizeBytes, 0, &ptr);
+                AmAllocCache *cache = getAllocCache();
+                AmAllocKey key = { hsa_agent->handle, alloc_region->handle, flags & (amHostPinned|amHostCoherent) };
+                bool fresh = true;
 
-                if (s1 != HSA_STATUS_SUCCESS) {
-                    ptr = NULL;
-                } else {
+                AmSlabs *slabs = (flags & (amHostPinned|amHostCoherent)) ? NULL : getAmSlabs();
+                if (slabs) {
+                    ptr = slabs->allocate(key, sizeBytes);
+                }
+                if (ptr == NULL) {
+                    ptr = allocBlock(cache, key, sizeBytes, &fresh);
+                }
+
+                if (ptr != NULL) {
                     if (flags & (amHostPinned|amHostCoherent)) {
-                        if (s1 != HSA_STATUS_SUCCESS) {
-                            hsa_amd_memory_pool_free(ptr);
-                            ptr = NULL;
-                        } else {
-                            hc::AmPointerInfo ampi(ptr/*hostPointer*/, ptr /*devicePointer*/, sizeBytes, acc, false/*isDevice*/, true /*isAMManaged*/);
-                            g_amPointerTracker.insert(ptr,ampi);
-
-                            // Host memory is always mapped to all possible peers:
+                        hc::AmPointerInfo ampi(ptr/*hostPointer*/, ptr /*devicePointer*/, sizeBytes, acc, false/*isDevice*/, true /*isAMManaged*/);
+                        g_amPointerTracker.insert(ptr,ampi);
+
+                        // Host memory is always mapped to all possible peers.
+                        // A cached block keeps the mapping of its first allocation.
+                        if (fresh) {
                             auto accs = hc::accelerator::get_all();
                             auto s2 = am_map_to_peers(ptr, accs.size(), accs.data());
                             if (s2 != AM_SUCCESS) {
-                                hsa_amd_memory_pool_free(ptr);
+                                g_amPointerTracker.remove(ptr);
+                                discardBlock(cache, key, ptr);
                                 ptr = NULL;
                             }
                         }
@@ -284,6 +545,14 @@ auto_voidp am_alloc(size_t sizeBytes, hc::accelerator &acc, unsigned flags)
                     }
                 }
             }
+        } else {
+            // CPU accelerator: the "device" memory is host memory too, accessible from both sides.
+            ptr = Kalmar::kalmar_aligned_alloc(0x1000, sizeBytes);
+            if (ptr != NULL) {
+                bool isDevice = !(flags & (amHostPinned|amHostCoherent));
+                hc::AmPointerInfo ampi(ptr/*hostPointer*/, ptr /*devicePointer*/, sizeBytes, acc, isDevice, true /*isAMManaged*/);
+                g_amPointerTracker.insert(ptr,ampi);
+            }
         }
     }
 
@@ -291,26 +560,74 @@ auto_voidp am_alloc(size_t sizeBytes, hc::accelerator &acc, unsigned flags)
 };
 
 
+// Blocks of the pools of alloc_async, see am_memtracker_set_pool_owned.
+static std::mutex g_poolOwnedMutex;
+static std::set<const void*> g_poolOwned;
+
+am_status_t am_memtracker_set_pool_owned(void* ptr, bool owned)
+{
+    if (g_amPointerTracker.find(ptr) == g_amPointerTracker.end()) {
+        return AM_ERROR_MISC;
+    }
+    std::lock_guard<std::mutex> l (g_poolOwnedMutex);
+    if (owned) {
+        g_poolOwned.insert(ptr);
+    } else {
+        g_poolOwned.erase(ptr);
+    }
+    return AM_SUCCESS;
+}
+
+
 am_status_t am_free(void* ptr) 
 {
     am_status_t status = AM_SUCCESS;
 
     if (ptr != NULL) {
+        {
+            // the pool of alloc_async would hand the block out again
+            std::lock_guard<std::mutex> l (g_poolOwnedMutex);
+            if (g_poolOwned.count(ptr)) {
+                return AM_ERROR_MISC;
+            }
+        }
 
-        int numRemoved = g_amPointerTracker.remove(ptr) ;
+        hc::AmPointerInfo info(NULL, NULL, 0, hc::accelerator(), false, false);
+        int numRemoved = g_amPointerTracker.remove(ptr, &info) ;
         if (numRemoved == 0) {
             status = AM_ERROR_MISC;
+        } else if (isHostAccelerator(info._acc)) {
+            Kalmar::kalmar_aligned_free(ptr);
         } else {
             // See also tracker::reset which can free memory.
-            hsa_amd_memory_pool_free(ptr);
+            AmSlabs *slabs = getAmSlabs();
+            AmAllocCache *cache = getAllocCache();
+            if (slabs && slabs->free(ptr)) {
+                // back in its slab
+            } else if (!cache || !cache->release(ptr)) {
+                hsa_amd_memory_pool_free(ptr);
+            }
         }
     }
     return status;
 }
 
 
+// Whether ptr is memory of a CPU accelerator.
+static bool isHostAcceleratorMemory(const void *ptr)
+{
+    auto iter = g_amPointerTracker.find(ptr);
+    return iter != g_amPointerTracker.end() && isHostAccelerator(iter->second._acc);
+}
+
 am_status_t am_copy(void*  dst, const void*  src, size_t sizeBytes)
 {
+    // Memory of the CPU accelerators is on the host, as is the memory it is copied from or to.
+    if (isHostAcceleratorMemory(dst) || isHostAcceleratorMemory(src)) {
+        memmove(dst, src, sizeBytes);
+        return AM_SUCCESS;
+    }
+
     am_status_t am_status = AM_ERROR_MISC;
     hsa_status_t err = hsa_memory_copy(dst, src, sizeBytes);
 
@@ -439,7 +756,9 @@ void am_memtracker_print(void *targetAddress)
         for (auto iter = g_amPointerTracker.readerLockBegin() ; iter != g_amPointerTracker.end(); iter++) {
             os << setw(PTRW) << iter->first._basePointer << "-" << setw(PTRW) << iter->first._endPointer << ": ";
             printShortPointerInfo(os, iter->second);
-            printRocrPointerInfo(os, iter->first._basePointer);
+            if (iter->second._acc.is_hsa_accelerator()) {
+                printRocrPointerInfo(os, iter->first._basePointer);
+            }
             os << "\n";
         }
     }
@@ -472,13 +791,41 @@ void am_memtracker_sizeinfo(const hc::accelerator &acc, size_t *deviceMemSize, s
 
 
 //---
+// Agent handle of an accelerator, 0 if it is not an HSA accelerator.
+static uint64_t get_agent_handle(const hc::accelerator &acc)
+{
+    if (!acc.is_hsa_accelerator()) {
+        return 0;
+    }
+    return static_cast<hsa_agent_t*> (acc.get_default_view().get_hsa_agent())->handle;
+}
+
 size_t am_memtracker_reset(const hc::accelerator &acc)
 {
-    return g_amPointerTracker.reset(acc);
+    // Free the cached blocks of acc and drop the ones in use, which the tracker frees.
+    uint64_t agent = get_agent_handle(acc);
+    AmAllocCache *cache = getAllocCache();
+    if (cache) {
+        cache->reset([agent] (const AmAllocKey &key) { return key.agent == agent; });
+    }
+    size_t count = g_amPointerTracker.reset(acc);
+
+    // The tracker leaves the blocks of slabs: free the slabs.
+    AmSlabs *slabs = getAmSlabs();
+    if (slabs) {
+        slabs->reset(agent);
+    }
+    return count;
 }
 
 void am_memtracker_update_peers (const hc::accelerator &acc, int peerCnt, hsa_agent_t *peerAgents) 
 {
+    // Cached blocks are not tracked: free them rather than leave them with the old peers.
+    AmAllocCache *cache = getAllocCache();
+    if (cache) {
+        uint64_t agent = get_agent_handle(acc);
+        cache->flush([agent] (const AmAllocKey &key) { return key.agent == agent; });
+    }
     return g_amPointerTracker.update_peers(acc, peerCnt, peerAgents);
 }
 
@@ -494,6 +841,10 @@ am_status_t am_map_to_peers(void* ptr, size_t num_peer, const hc::accelerator* p
     if(AM_SUCCESS != status)
         return status;
 
+    // host memory of a CPU accelerator: every agent can access it already
+    if (isHostAccelerator(info._acc))
+        return AM_SUCCESS;
+
         hsa_amd_memory_pool_t* pool = nullptr;
     if(info._isInDeviceMem)
     {
@@ -563,7 +914,9 @@ am_status_t am_map_to_peers(void* ptr, size_t num_peer, const hc::accelerator* p
     // allow access to the agents
     if(peer_count)
     {
-        hsa_status_t status = hsa_amd_agents_allow_access(peer_count, agents, NULL, ptr);
+        // the slab of a sub-allocated block is the allocation HSA knows
+        void *slab = amSlabOf(ptr);
+        hsa_status_t status = hsa_amd_agents_allow_access(peer_count, agents, NULL, slab ? slab : ptr);
         return status == HSA_STATUS_SUCCESS ? AM_SUCCESS : AM_ERROR_MISC;
     }
    
@@ -572,6 +925,17 @@ am_status_t am_map_to_peers(void* ptr, size_t num_peer, const hc::accelerator* p
 
 am_status_t am_memory_host_lock(hc::accelerator &ac, void *hostPtr, size_t size, hc::accelerator *visible_ac, size_t num_visible_ac)
 {
+    if (isHostAccelerator(ac)) {
+        // Nothing to map for a CPU accelerator: keep the pages resident, if the memlock limit allows.
+        if (hostPtr == NULL || size == 0) {
+            return AM_ERROR_MISC;
+        }
+        mlock(hostPtr, size);
+        hc::AmPointerInfo ampi(hostPtr, hostPtr, size, ac, false, false);
+        g_amPointerTracker.insert(hostPtr, ampi);
+        return AM_SUCCESS;
+    }
+
     am_status_t am_status = AM_ERROR_MISC;
     void *devPtr;
     std::vector<hsa_agent_t> agents;
@@ -594,8 +958,14 @@ am_status_t am_memory_host_unlock(hc::accelerator &ac, void *hostPtr)
     am_status_t am_status = AM_ERROR_MISC;
     hc::AmPointerInfo amPointerInfo(NULL, NULL, 0, ac, 0, 0);
     am_status = am_memtracker_getinfo(&amPointerInfo, hostPtr);
-    if(am_status == AM_SUCCESS)
+    if(am_status == AM_SUCCESS && isHostAccelerator(ac))
     {
+        munlock(amPointerInfo._hostPointer, amPointerInfo._sizeBytes);
+        am_status = am_memtracker_remove(hostPtr);
+    }
+    else if(am_status == AM_SUCCESS)
+    {
+        am_memory_host_cache_invalidate(amPointerInfo._hostPointer, amPointerInfo._sizeBytes);
         hsa_status_t hsa_status = hsa_amd_memory_unlock(hostPtr);
         if (hsa_status == HSA_STATUS_SUCCESS) {
             am_status = am_memtracker_remove(hostPtr);
@@ -606,4 +976,39 @@ am_status_t am_memory_host_unlock(hc::accelerator &ac, void *hostPtr)
     return am_status;
 }
 
+am_status_t am_memory_host_cache_invalidate(const void *hostPtr, size_t size)
+{
+    for (auto &acc : hc::accelerator::get_all()) {
+        acc.get_dev_ptr()->invalidatePinnedHost(hostPtr, size);
+    }
+    return AM_SUCCESS;
+}
+
+am_status_t am_memory_host_cache_stats(const hc::accelerator &ac, AmPinnedHostCacheStats *stats)
+{
+    if (stats == nullptr) {
+        return AM_ERROR_MISC;
+    }
+    return ac.get_dev_ptr()->getPinnedHostStats(stats) ? AM_SUCCESS : AM_ERROR_MISC;
+}
+
+am_status_t am_alloc_cache_stats(AmAllocCacheStats *stats)
+{
+    AmAllocCache *cache = getAllocCache();
+    if (stats == nullptr || cache == nullptr) {
+        return AM_ERROR_MISC;
+    }
+    *stats = cache->getStats();
+    return AM_SUCCESS;
+}
+
+am_status_t am_alloc_cache_trim()
+{
+    AmAllocCache *cache = getAllocCache();
+    if (cache) {
+        cache->trim();
+    }
+    return AM_SUCCESS;
+}
+
 } // end namespace hc.
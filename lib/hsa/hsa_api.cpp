@@ -0,0 +1,52 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+// Dispatch table over the HSA entry points, see hsa_api.h
+
+#define KALMAR_HSA_API_IMPL
+#include "hsa_api.h"
+
+namespace Kalmar {
+
+#ifndef KALMAR_HSA_API_NO_ROCR
+
+#define KALMAR_HSA_API_ROCR(name) &::name,
+
+static const HsaApiTable rocrHsaApi = {
+    KALMAR_HSA_API_FUNCTIONS(KALMAR_HSA_API_ROCR)
+};
+
+// constant initialized, so usable from the static constructors of the backend
+HsaApiTable hsaApi = {
+    KALMAR_HSA_API_FUNCTIONS(KALMAR_HSA_API_ROCR)
+};
+
+#undef KALMAR_HSA_API_ROCR
+
+const HsaApiTable& getRocrHsaApi() {
+    return rocrHsaApi;
+}
+
+#else
+
+// Built without the ROCr runtime (hc_am of the CPU runtime): the table holds
+// the CPU emulation.  hc_am skips the HSA calls on the memory of the CPU
+// accelerators, so the emulation only serves the calls of HSA memory, which
+// such a build never allocates.
+HsaApiTable hsaApi = {};
+
+static struct UseMockHsaApi {
+    UseMockHsaApi() { useMockHsaApi(0); }
+} useMockHsaApiAtLoad;
+
+const HsaApiTable& getRocrHsaApi() {
+    return hsaApi;
+}
+
+#endif // KALMAR_HSA_API_NO_ROCR
+
+} // namespace Kalmar
@@ -0,0 +1,153 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+// Dispatch table over the HSA entry points used by the HSA backend.
+//
+// The backend (mcwamp_hsa.cpp, unpinned_copy_engine.cpp, hc_am.cpp) calls the
+// HSA runtime through Kalmar::hsaApi, which holds the ROCr entry points by
+// default.  Including this header after the HSA headers redirects the hsa_*
+// calls of the file to the table, so the call sites read as plain HSA calls.
+//
+// useMockHsaApi() switches the table to a CPU emulation of the runtime
+// (HCC_HSA_RUNTIME=mock), to exercise and profile the host side of the
+// backend without a GPU:
+//  - one CPU and one GPU agent, with host allocations as memory pools;
+//  - signals as atomics;
+//  - queues as in-memory AQL rings serviced by a thread per queue, which
+//    processes the packets up to the last doorbell: barriers wait for their
+//    dependencies, kernel dispatches complete without running the kernel
+//    (after kernelUs microseconds), and report profiling timestamps;
+//  - asynchronous copies as memcpy on a copy thread.
+// It must be selected before hsa_init.
+//
+// Defining KALMAR_HSA_API_NO_ROCR builds the table without the ROCr entry
+// points, holding the emulation from the start: hc_am is built so for the CPU
+// runtime when ROCr is not available.
+
+#pragma once
+
+#include <hsa/hsa.h>
+#include <hsa/hsa_ext_amd.h>
+
+#include <cstdint>
+
+#define KALMAR_HSA_API_FUNCTIONS(F) \
+    F(hsa_init) \
+    F(hsa_shut_down) \
+    F(hsa_system_get_info) \
+    F(hsa_system_get_extension_table) \
+    F(hsa_iterate_agents) \
+    F(hsa_agent_get_info) \
+    F(hsa_signal_create) \
+    F(hsa_signal_destroy) \
+    F(hsa_signal_load_acquire) \
+    F(hsa_signal_load_relaxed) \
+    F(hsa_signal_store_relaxed) \
+    F(hsa_signal_store_release) \
+    F(hsa_signal_wait_acquire) \
+    F(hsa_signal_wait_relaxed) \
+    F(hsa_queue_create) \
+    F(hsa_queue_destroy) \
+    F(hsa_queue_load_read_index_acquire) \
+    F(hsa_queue_load_write_index_relaxed) \
+    F(hsa_queue_store_write_index_relaxed) \
+    F(hsa_memory_copy) \
+    F(hsa_code_object_deserialize) \
+    F(hsa_code_object_destroy) \
+    F(hsa_code_object_get_info) \
+    F(hsa_isa_compatible) \
+    F(hsa_executable_create) \
+    F(hsa_executable_destroy) \
+    F(hsa_executable_freeze) \
+    F(hsa_executable_get_symbol) \
+    F(hsa_executable_load_code_object) \
+    F(hsa_executable_symbol_get_info) \
+    F(hsa_amd_agent_iterate_memory_pools) \
+    F(hsa_amd_agent_memory_pool_get_info) \
+    F(hsa_amd_agents_allow_access) \
+    F(hsa_amd_memory_async_copy) \
+    F(hsa_amd_memory_lock) \
+    F(hsa_amd_memory_unlock) \
+    F(hsa_amd_memory_pool_allocate) \
+    F(hsa_amd_memory_pool_free) \
+    F(hsa_amd_memory_pool_get_info) \
+    F(hsa_amd_pointer_info) \
+    F(hsa_amd_profiling_get_dispatch_time) \
+    F(hsa_amd_profiling_set_profiler_enabled) \
+    F(hsa_amd_queue_cu_set_mask) \
+    F(hsa_amd_queue_set_deadline) \
+    F(hsa_amd_queue_set_priority) \
+    F(hsa_amd_signal_async_handler)
+
+namespace Kalmar {
+
+struct HsaApiTable {
+#define KALMAR_HSA_API_MEMBER(name) decltype(&::name) name;
+    KALMAR_HSA_API_FUNCTIONS(KALMAR_HSA_API_MEMBER)
+#undef KALMAR_HSA_API_MEMBER
+};
+
+/// entry points used by the backend
+extern HsaApiTable hsaApi;
+
+/// entry points of the ROCr runtime
+const HsaApiTable& getRocrHsaApi();
+
+/// route the backend to the CPU emulation of the runtime, kernel dispatches
+/// complete after @p kernelUs microseconds
+void useMockHsaApi(uint32_t kernelUs);
+
+} // namespace Kalmar
+
+#ifndef KALMAR_HSA_API_IMPL
+#define hsa_init Kalmar::hsaApi.hsa_init
+#define hsa_shut_down Kalmar::hsaApi.hsa_shut_down
+#define hsa_system_get_info Kalmar::hsaApi.hsa_system_get_info
+#define hsa_system_get_extension_table Kalmar::hsaApi.hsa_system_get_extension_table
+#define hsa_iterate_agents Kalmar::hsaApi.hsa_iterate_agents
+#define hsa_agent_get_info Kalmar::hsaApi.hsa_agent_get_info
+#define hsa_signal_create Kalmar::hsaApi.hsa_signal_create
+#define hsa_signal_destroy Kalmar::hsaApi.hsa_signal_destroy
+#define hsa_signal_load_acquire Kalmar::hsaApi.hsa_signal_load_acquire
+#define hsa_signal_load_relaxed Kalmar::hsaApi.hsa_signal_load_relaxed
+#define hsa_signal_store_relaxed Kalmar::hsaApi.hsa_signal_store_relaxed
+#define hsa_signal_store_release Kalmar::hsaApi.hsa_signal_store_release
+#define hsa_signal_wait_acquire Kalmar::hsaApi.hsa_signal_wait_acquire
+#define hsa_signal_wait_relaxed Kalmar::hsaApi.hsa_signal_wait_relaxed
+#define hsa_queue_create Kalmar::hsaApi.hsa_queue_create
+#define hsa_queue_destroy Kalmar::hsaApi.hsa_queue_destroy
+#define hsa_queue_load_read_index_acquire Kalmar::hsaApi.hsa_queue_load_read_index_acquire
+#define hsa_queue_load_write_index_relaxed Kalmar::hsaApi.hsa_queue_load_write_index_relaxed
+#define hsa_queue_store_write_index_relaxed Kalmar::hsaApi.hsa_queue_store_write_index_relaxed
+#define hsa_memory_copy Kalmar::hsaApi.hsa_memory_copy
+#define hsa_code_object_deserialize Kalmar::hsaApi.hsa_code_object_deserialize
+#define hsa_code_object_destroy Kalmar::hsaApi.hsa_code_object_destroy
+#define hsa_code_object_get_info Kalmar::hsaApi.hsa_code_object_get_info
+#define hsa_isa_compatible Kalmar::hsaApi.hsa_isa_compatible
+#define hsa_executable_create Kalmar::hsaApi.hsa_executable_create
+#define hsa_executable_destroy Kalmar::hsaApi.hsa_executable_destroy
+#define hsa_executable_freeze Kalmar::hsaApi.hsa_executable_freeze
+#define hsa_executable_get_symbol Kalmar::hsaApi.hsa_executable_get_symbol
+#define hsa_executable_load_code_object Kalmar::hsaApi.hsa_executable_load_code_object
+#define hsa_executable_symbol_get_info Kalmar::hsaApi.hsa_executable_symbol_get_info
+#define hsa_amd_agent_iterate_memory_pools Kalmar::hsaApi.hsa_amd_agent_iterate_memory_pools
+#define hsa_amd_agent_memory_pool_get_info Kalmar::hsaApi.hsa_amd_agent_memory_pool_get_info
+#define hsa_amd_agents_allow_access Kalmar::hsaApi.hsa_amd_agents_allow_access
+#define hsa_amd_memory_async_copy Kalmar::hsaApi.hsa_amd_memory_async_copy
+#define hsa_amd_memory_lock Kalmar::hsaApi.hsa_amd_memory_lock
+#define hsa_amd_memory_unlock Kalmar::hsaApi.hsa_amd_memory_unlock
+#define hsa_amd_memory_pool_allocate Kalmar::hsaApi.hsa_amd_memory_pool_allocate
+#define hsa_amd_memory_pool_free Kalmar::hsaApi.hsa_amd_memory_pool_free
+#define hsa_amd_memory_pool_get_info Kalmar::hsaApi.hsa_amd_memory_pool_get_info
+#define hsa_amd_pointer_info Kalmar::hsaApi.hsa_amd_pointer_info
+#define hsa_amd_profiling_get_dispatch_time Kalmar::hsaApi.hsa_amd_profiling_get_dispatch_time
+#define hsa_amd_profiling_set_profiler_enabled Kalmar::hsaApi.hsa_amd_profiling_set_profiler_enabled
+#define hsa_amd_queue_cu_set_mask Kalmar::hsaApi.hsa_amd_queue_cu_set_mask
+#define hsa_amd_queue_set_deadline Kalmar::hsaApi.hsa_amd_queue_set_deadline
+#define hsa_amd_queue_set_priority Kalmar::hsaApi.hsa_amd_queue_set_priority
+#define hsa_amd_signal_async_handler Kalmar::hsaApi.hsa_amd_signal_async_handler
+#endif
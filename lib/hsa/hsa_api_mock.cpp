@@ -0,0 +1,966 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+// CPU emulation of the HSA runtime, see hsa_api.h
+
+#define KALMAR_HSA_API_IMPL
+#include "hsa_api.h"
+
+#include <hsa/amd_hsa_kernel_code.h>
+#include <hsa/hsa_ven_amd_loader.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Kalmar {
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+// HSA_SYSTEM_INFO_TIMESTAMP, in ns
+uint64_t mockTimestamp() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+}
+
+uint32_t mockKernelUs = 0;
+
+// runs the posted functions in order on its thread
+class MockWorker {
+public:
+    ~MockWorker() {
+        stop();
+    }
+
+    void start() {
+        stopping = false;
+        thread = std::thread([this] { run(); });
+    }
+
+    // runs the functions already posted first
+    void stop() {
+        {
+            std::lock_guard<std::mutex> l(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    void post(std::function<void()> f) {
+        {
+            std::lock_guard<std::mutex> l(mutex);
+            jobs.push_back(std::move(f));
+        }
+        cv.notify_one();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> l(mutex);
+        for (;;) {
+            cv.wait(l, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            std::function<void()> f = std::move(jobs.front());
+            jobs.pop_front();
+            l.unlock();
+            f();
+            l.lock();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> jobs;
+    std::thread thread;
+    bool stopping = false;
+};
+
+MockWorker handlerWorker;  // hsa_amd_signal_async_handler callbacks
+MockWorker copyWorker;     // hsa_amd_memory_async_copy, in order like a DMA engine
+
+//-------------------------------------------------------------------------------------------------
+// Signals
+
+struct MockHandler {
+    hsa_signal_condition_t cond;
+    hsa_signal_value_t value;
+    hsa_amd_signal_handler handler;
+    void* arg;
+};
+
+struct MockSignal {
+    explicit MockSignal(hsa_signal_value_t value) : value(value), start(0), end(0) {}
+
+    std::atomic<hsa_signal_value_t> value;
+    std::mutex mutex;             // held while changing the value, for the waiters
+    std::condition_variable cv;
+    std::vector<MockHandler> handlers;
+
+    // of the packet or copy which completed the signal
+    std::atomic<uint64_t> start;
+    std::atomic<uint64_t> end;
+};
+
+MockSignal* toSignal(hsa_signal_t signal) {
+    return reinterpret_cast<MockSignal*>(signal.handle);
+}
+
+bool satisfied(hsa_signal_condition_t cond, hsa_signal_value_t value, hsa_signal_value_t compare) {
+    switch (cond) {
+        case HSA_SIGNAL_CONDITION_EQ:  return value == compare;
+        case HSA_SIGNAL_CONDITION_NE:  return value != compare;
+        case HSA_SIGNAL_CONDITION_LT:  return value < compare;
+        case HSA_SIGNAL_CONDITION_GTE: return value >= compare;
+    }
+    return false;
+}
+
+void registerHandler(MockSignal* s, const MockHandler& h);
+
+void fireHandler(MockSignal* s, const MockHandler& h, hsa_signal_value_t value) {
+    handlerWorker.post([s, h, value] {
+        if (h.handler(value, h.arg)) {
+            registerHandler(s, h);
+        }
+    });
+}
+
+void registerHandler(MockSignal* s, const MockHandler& h) {
+    hsa_signal_value_t value;
+    {
+        std::lock_guard<std::mutex> l(s->mutex);
+        value = s->value.load(std::memory_order_relaxed);
+        if (!satisfied(h.cond, value, h.value)) {
+            s->handlers.push_back(h);
+            return;
+        }
+    }
+    fireHandler(s, h, value);
+}
+
+// apply @update to the value, wake up the waiters and fire the handlers
+template <typename Update>
+void updateSignal(MockSignal* s, Update update) {
+    std::vector<MockHandler> fired;
+    hsa_signal_value_t value;
+    {
+        std::lock_guard<std::mutex> l(s->mutex);
+        value = update(s->value);
+        for (auto it = s->handlers.begin(); it != s->handlers.end(); ) {
+            if (satisfied(it->cond, value, it->value)) {
+                fired.push_back(*it);
+                it = s->handlers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    s->cv.notify_all();
+    for (const MockHandler& h : fired) {
+        fireHandler(s, h, value);
+    }
+}
+
+void storeSignal(MockSignal* s, hsa_signal_value_t value) {
+    updateSignal(s, [value](std::atomic<hsa_signal_value_t>& v) {
+        v.store(value, std::memory_order_release);
+        return value;
+    });
+}
+
+// completion of a packet or copy started at @start
+void completeSignal(hsa_signal_t signal, uint64_t start) {
+    if (signal.handle == 0) {
+        return;
+    }
+    MockSignal* s = toSignal(signal);
+    s->start = start;
+    s->end = mockTimestamp();
+    updateSignal(s, [](std::atomic<hsa_signal_value_t>& v) {
+        return v.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    });
+}
+
+hsa_signal_value_t waitSignal(hsa_signal_t signal, hsa_signal_condition_t cond, hsa_signal_value_t compare,
+                              uint64_t timeout, hsa_wait_state_t state) {
+    MockSignal* s = toSignal(signal);
+    hsa_signal_value_t value = s->value.load(std::memory_order_acquire);
+    if (satisfied(cond, value, compare)) {
+        return value;
+    }
+
+    // timestamps are in ns; UINT64_MAX, or anything that long, waits forever
+    clock_type::time_point deadline = clock_type::time_point::max();
+    if (timeout < 3600ull * 1000000000ull) {
+        deadline = clock_type::now() + std::chrono::nanoseconds(timeout);
+    }
+
+    if (state == HSA_WAIT_STATE_ACTIVE) {
+        while (clock_type::now() < deadline) {
+            value = s->value.load(std::memory_order_acquire);
+            if (satisfied(cond, value, compare)) {
+                return value;
+            }
+        }
+        return s->value.load(std::memory_order_acquire);
+    }
+
+    std::unique_lock<std::mutex> l(s->mutex);
+    auto done = [&] { return satisfied(cond, s->value.load(std::memory_order_acquire), compare); };
+    if (deadline == clock_type::time_point::max()) {
+        s->cv.wait(l, done);
+    } else {
+        s->cv.wait_until(l, deadline, done);
+    }
+    return s->value.load(std::memory_order_acquire);
+}
+
+// dependencies of barrier packets and copies are met at 0
+void waitDependency(hsa_signal_t signal) {
+    if (signal.handle != 0) {
+        waitSignal(signal, HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_BLOCKED);
+    }
+}
+
+hsa_status_t mockSignalCreate(hsa_signal_value_t initial_value, uint32_t num_consumers,
+                              const hsa_agent_t* consumers, hsa_signal_t* signal) {
+    if (signal == nullptr) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    signal->handle = reinterpret_cast<uint64_t>(new MockSignal(initial_value));
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockSignalDestroy(hsa_signal_t signal) {
+    if (signal.handle == 0) {
+        return HSA_STATUS_ERROR_INVALID_SIGNAL;
+    }
+    delete toSignal(signal);
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_signal_value_t mockSignalLoad(hsa_signal_t signal) {
+    return toSignal(signal)->value.load(std::memory_order_acquire);
+}
+
+void mockSignalStore(hsa_signal_t signal, hsa_signal_value_t value) {
+    storeSignal(toSignal(signal), value);
+}
+
+hsa_status_t mockSignalAsyncHandler(hsa_signal_t signal, hsa_signal_condition_t cond, hsa_signal_value_t value,
+                                    hsa_amd_signal_handler handler, void* arg) {
+    if (signal.handle == 0 || handler == nullptr) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    registerHandler(toSignal(signal), MockHandler{ cond, value, handler, arg });
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockGetDispatchTime(hsa_agent_t agent, hsa_signal_t signal, hsa_amd_profiling_dispatch_time_t* time) {
+    if (signal.handle == 0 || time == nullptr) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    time->start = toSignal(signal)->start;
+    time->end = toSignal(signal)->end;
+    return HSA_STATUS_SUCCESS;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Agents and memory pools
+
+struct MockAgent;
+
+struct MockPool {
+    hsa_amd_segment_t segment;
+    uint32_t flags;
+    size_t size;
+    MockAgent* owner;
+};
+
+struct MockAgent {
+    hsa_device_type_t type;
+    const char* name;
+    uint32_t node;
+    std::vector<MockPool*> pools;
+};
+
+// a host with one discrete GPU
+struct MockSystem {
+    MockAgent cpu;
+    MockAgent gpu;
+    MockPool fineSystem;
+    MockPool coarseSystem;
+    MockPool group;
+    MockPool local;
+
+    MockSystem() {
+        cpu = MockAgent{ HSA_DEVICE_TYPE_CPU, "mock-cpu", 0, {} };
+        gpu = MockAgent{ HSA_DEVICE_TYPE_GPU, "mock-gpu", 1, {} };
+        fineSystem = MockPool{ HSA_AMD_SEGMENT_GLOBAL,
+                               HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_KERNARG_INIT | HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_FINE_GRAINED,
+                               size_t(16) << 30, &cpu };
+        coarseSystem = MockPool{ HSA_AMD_SEGMENT_GLOBAL, HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_COARSE_GRAINED,
+                                 size_t(16) << 30, &cpu };
+        group = MockPool{ HSA_AMD_SEGMENT_GROUP, 0, 64 * 1024, &gpu };
+        local = MockPool{ HSA_AMD_SEGMENT_GLOBAL, HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_COARSE_GRAINED,
+                          size_t(8) << 30, &gpu };
+        cpu.pools = { &fineSystem, &coarseSystem };
+        gpu.pools = { &group, &local };
+    }
+};
+
+MockSystem& mockSystem() {
+    static MockSystem system;
+    return system;
+}
+
+MockAgent* toAgent(hsa_agent_t agent) {
+    return reinterpret_cast<MockAgent*>(agent.handle);
+}
+
+hsa_agent_t toHandle(MockAgent* agent) {
+    hsa_agent_t handle;
+    handle.handle = reinterpret_cast<uint64_t>(agent);
+    return handle;
+}
+
+MockPool* toPool(hsa_amd_memory_pool_t pool) {
+    return reinterpret_cast<MockPool*>(pool.handle);
+}
+
+const uint32_t MOCK_QUEUE_MAX_SIZE = 128 * 1024;
+const uint64_t MOCK_ISA = 1;
+
+hsa_status_t mockIterateAgents(hsa_status_t (*callback)(hsa_agent_t agent, void* data), void* data) {
+    MockSystem& system = mockSystem();
+    for (MockAgent* agent : { &system.cpu, &system.gpu }) {
+        hsa_status_t status = callback(toHandle(agent), data);
+        if (status != HSA_STATUS_SUCCESS) {
+            return status;
+        }
+    }
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockAgentGetInfo(hsa_agent_t agent, hsa_agent_info_t attribute, void* value) {
+    MockAgent* a = toAgent(agent);
+    bool gpu = a->type == HSA_DEVICE_TYPE_GPU;
+    switch (static_cast<int>(attribute)) {
+        case HSA_AGENT_INFO_NAME:
+        case HSA_AGENT_INFO_VENDOR_NAME:
+            std::memset(value, 0, 64);
+            std::strncpy(static_cast<char*>(value), attribute == HSA_AGENT_INFO_NAME ? a->name : "AMD", 63);
+            break;
+        case HSA_AGENT_INFO_NODE:
+            *static_cast<uint32_t*>(value) = a->node;
+            break;
+        case HSA_AGENT_INFO_DEVICE:
+            *static_cast<hsa_device_type_t*>(value) = a->type;
+            break;
+        case HSA_AGENT_INFO_VERSION_MAJOR:
+        case HSA_AGENT_INFO_VERSION_MINOR:
+            *static_cast<uint16_t*>(value) = 1;
+            break;
+        case HSA_AGENT_INFO_QUEUE_MAX_SIZE:
+            *static_cast<uint32_t*>(value) = gpu ? MOCK_QUEUE_MAX_SIZE : 0;
+            break;
+        case HSA_AGENT_INFO_WORKGROUP_MAX_SIZE:
+            *static_cast<uint32_t*>(value) = 1024;
+            break;
+        case HSA_AGENT_INFO_WORKGROUP_MAX_DIM: {
+            uint16_t* dims = static_cast<uint16_t*>(value);
+            dims[0] = dims[1] = dims[2] = 1024;
+            break;
+        }
+        case HSA_AGENT_INFO_ISA:
+            static_cast<hsa_isa_t*>(value)->handle = gpu ? MOCK_ISA : 0;
+            break;
+        case HSA_AGENT_INFO_PROFILE:
+            *static_cast<hsa_profile_t*>(value) = gpu ? HSA_PROFILE_BASE : HSA_PROFILE_FULL;
+            break;
+        case HSA_AMD_AGENT_INFO_COMPUTE_UNIT_COUNT:
+            *static_cast<uint32_t*>(value) = gpu ? 64 : std::thread::hardware_concurrency();
+            break;
+        default:
+            return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockSystemGetInfo(hsa_system_info_t attribute, void* value) {
+    switch (attribute) {
+        case HSA_SYSTEM_INFO_VERSION_MAJOR:
+        case HSA_SYSTEM_INFO_VERSION_MINOR:
+            *static_cast<uint16_t*>(value) = 1;
+            break;
+        case HSA_SYSTEM_INFO_TIMESTAMP:
+            *static_cast<uint64_t*>(value) = mockTimestamp();
+            break;
+        case HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY:
+            *static_cast<uint64_t*>(value) = 1000000000;
+            break;
+        default:
+            return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockIteratePools(hsa_agent_t agent, hsa_status_t (*callback)(hsa_amd_memory_pool_t pool, void* data),
+                              void* data) {
+    for (MockPool* p : toAgent(agent)->pools) {
+        hsa_amd_memory_pool_t pool;
+        pool.handle = reinterpret_cast<uint64_t>(p);
+        hsa_status_t status = callback(pool, data);
+        if (status != HSA_STATUS_SUCCESS) {
+            return status;
+        }
+    }
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockPoolGetInfo(hsa_amd_memory_pool_t pool, hsa_amd_memory_pool_info_t attribute, void* value) {
+    MockPool* p = toPool(pool);
+    switch (attribute) {
+        case HSA_AMD_MEMORY_POOL_INFO_SEGMENT:
+            *static_cast<hsa_amd_segment_t*>(value) = p->segment;
+            break;
+        case HSA_AMD_MEMORY_POOL_INFO_GLOBAL_FLAGS:
+            *static_cast<uint32_t*>(value) = p->flags;
+            break;
+        case HSA_AMD_MEMORY_POOL_INFO_SIZE:
+            *static_cast<size_t*>(value) = p->size;
+            break;
+        case HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALLOWED:
+            *static_cast<bool*>(value) = p->segment == HSA_AMD_SEGMENT_GLOBAL;
+            break;
+        default:
+            return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    return HSA_STATUS_SUCCESS;
+}
+
+// like a discrete GPU: the host never accesses device memory, the device
+// accesses system memory once allowed
+hsa_status_t mockAgentPoolGetInfo(hsa_agent_t agent, hsa_amd_memory_pool_t pool,
+                                  hsa_amd_agent_memory_pool_info_t attribute, void* value) {
+    if (attribute != HSA_AMD_AGENT_MEMORY_POOL_INFO_ACCESS) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    MockAgent* a = toAgent(agent);
+    MockPool* p = toPool(pool);
+    hsa_amd_memory_pool_access_t access = HSA_AMD_MEMORY_POOL_ACCESS_ALLOWED_BY_DEFAULT;
+    if (p->owner != a) {
+        access = (a->type == HSA_DEVICE_TYPE_CPU) ? HSA_AMD_MEMORY_POOL_ACCESS_NEVER_ALLOWED
+                                                  : HSA_AMD_MEMORY_POOL_ACCESS_DISALLOWED_BY_DEFAULT;
+    }
+    *static_cast<hsa_amd_memory_pool_access_t*>(value) = access;
+    return HSA_STATUS_SUCCESS;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Memory: pool allocations and locked ranges are host memory
+
+struct MockAllocation {
+    size_t size;
+    hsa_amd_pointer_type_t type;
+    int locks;
+};
+
+std::mutex allocationsMutex;
+std::map<uintptr_t, MockAllocation> allocations;
+
+// allocation containing @ptr, or end
+std::map<uintptr_t, MockAllocation>::iterator findAllocation(const void* ptr) {
+    uintptr_t p = reinterpret_cast<uintptr_t>(ptr);
+    auto it = allocations.upper_bound(p);
+    if (it == allocations.begin()) {
+        return allocations.end();
+    }
+    --it;
+    if (p >= it->first + it->second.size) {
+        return allocations.end();
+    }
+    return it;
+}
+
+hsa_status_t mockPoolAllocate(hsa_amd_memory_pool_t pool, size_t size, uint32_t flags, void** ptr) {
+    if (size == 0 || ptr == nullptr || toPool(pool)->segment != HSA_AMD_SEGMENT_GLOBAL) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    const size_t page = 4096;
+    size = (size + page - 1) & ~(page - 1);
+    if (posix_memalign(ptr, page, size) != 0) {
+        return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    }
+    std::lock_guard<std::mutex> l(allocationsMutex);
+    allocations[reinterpret_cast<uintptr_t>(*ptr)] = MockAllocation{ size, HSA_EXT_POINTER_TYPE_HSA, 0 };
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockPoolFree(void* ptr) {
+    {
+        std::lock_guard<std::mutex> l(allocationsMutex);
+        auto it = allocations.find(reinterpret_cast<uintptr_t>(ptr));
+        if (it == allocations.end() || it->second.type != HSA_EXT_POINTER_TYPE_HSA) {
+            return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+        }
+        allocations.erase(it);
+    }
+    free(ptr);
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockMemoryLock(void* host_ptr, size_t size, hsa_agent_t* agents, int num_agent, void** agent_ptr) {
+    if (host_ptr == nullptr || size == 0 || agent_ptr == nullptr) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    std::lock_guard<std::mutex> l(allocationsMutex);
+    auto it = findAllocation(host_ptr);
+    if (it == allocations.end()) {
+        allocations[reinterpret_cast<uintptr_t>(host_ptr)] = MockAllocation{ size, HSA_EXT_POINTER_TYPE_LOCKED, 1 };
+    } else if (it->second.type == HSA_EXT_POINTER_TYPE_LOCKED) {
+        it->second.locks++;
+    }
+    *agent_ptr = host_ptr;
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockMemoryUnlock(void* host_ptr) {
+    std::lock_guard<std::mutex> l(allocationsMutex);
+    auto it = allocations.find(reinterpret_cast<uintptr_t>(host_ptr));
+    if (it != allocations.end() && it->second.type == HSA_EXT_POINTER_TYPE_LOCKED && --it->second.locks == 0) {
+        allocations.erase(it);
+    }
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockPointerInfo(void* ptr, hsa_amd_pointer_info_t* info, void* (*alloc)(size_t),
+                             uint32_t* num_agents_accessible, hsa_agent_t** accessible) {
+    if (info == nullptr) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    info->type = HSA_EXT_POINTER_TYPE_UNKNOWN;
+    info->agentBaseAddress = nullptr;
+    info->hostBaseAddress = nullptr;
+    info->sizeInBytes = 0;
+    info->userData = nullptr;
+    {
+        std::lock_guard<std::mutex> l(allocationsMutex);
+        auto it = findAllocation(ptr);
+        if (it != allocations.end()) {
+            info->type = it->second.type;
+            info->agentBaseAddress = reinterpret_cast<void*>(it->first);
+            info->hostBaseAddress = reinterpret_cast<void*>(it->first);
+            info->sizeInBytes = it->second.size;
+        }
+    }
+
+    if (num_agents_accessible && accessible && alloc) {
+        *num_agents_accessible = 0;
+        *accessible = nullptr;
+        if (info->type != HSA_EXT_POINTER_TYPE_UNKNOWN) {
+            MockSystem& system = mockSystem();
+            *accessible = static_cast<hsa_agent_t*>(alloc(2 * sizeof(hsa_agent_t)));
+            (*accessible)[0] = toHandle(&system.cpu);
+            (*accessible)[1] = toHandle(&system.gpu);
+            *num_agents_accessible = 2;
+        }
+    }
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockMemoryCopy(void* dst, const void* src, size_t size) {
+    std::memcpy(dst, src, size);
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockAsyncCopy(void* dst, hsa_agent_t dst_agent, const void* src, hsa_agent_t src_agent, size_t size,
+                           uint32_t num_dep_signals, const hsa_signal_t* dep_signals, hsa_signal_t completion_signal) {
+    if ((size != 0 && (dst == nullptr || src == nullptr)) || (num_dep_signals != 0 && dep_signals == nullptr)) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    std::vector<hsa_signal_t> deps(dep_signals, dep_signals + num_dep_signals);
+    copyWorker.post([=] {
+        for (hsa_signal_t dep : deps) {
+            waitDependency(dep);
+        }
+        uint64_t start = mockTimestamp();
+        std::memcpy(dst, src, size);
+        completeSignal(completion_signal, start);
+    });
+    return HSA_STATUS_SUCCESS;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Queues: AQL rings processed by a thread per queue
+
+struct MockQueue {
+    hsa_queue_t queue;  // first, the queues handed out are MockQueues
+    std::atomic<uint64_t> readIndex;
+    std::atomic<uint64_t> writeIndex;
+    std::atomic<bool> stopping;
+    MockSignal* doorbell;
+    std::thread thread;
+};
+
+static_assert(std::is_standard_layout<MockQueue>::value, "MockQueue must start with its hsa_queue_t");
+
+MockQueue* toQueue(const hsa_queue_t* queue) {
+    return reinterpret_cast<MockQueue*>(const_cast<hsa_queue_t*>(queue));
+}
+
+uint16_t packetType(uint16_t header) {
+    return (header >> HSA_PACKET_HEADER_TYPE) & ((1 << HSA_PACKET_HEADER_WIDTH_TYPE) - 1);
+}
+
+void processPacket(void* packet) {
+    std::atomic<uint16_t>* header = reinterpret_cast<std::atomic<uint16_t>*>(packet);
+    uint64_t start = mockTimestamp();
+
+    // the completion signal is at the same offset in all packet types
+    hsa_signal_t completion = static_cast<hsa_barrier_and_packet_t*>(packet)->completion_signal;
+
+    switch (packetType(header->load(std::memory_order_acquire))) {
+        case HSA_PACKET_TYPE_KERNEL_DISPATCH:
+            if (mockKernelUs) {
+                std::this_thread::sleep_for(std::chrono::microseconds(mockKernelUs));
+            }
+            break;
+        case HSA_PACKET_TYPE_BARRIER_AND: {
+            hsa_barrier_and_packet_t* barrier = static_cast<hsa_barrier_and_packet_t*>(packet);
+            for (hsa_signal_t dep : barrier->dep_signal) {
+                waitDependency(dep);
+            }
+            break;
+        }
+        case HSA_PACKET_TYPE_BARRIER_OR: {
+            hsa_barrier_or_packet_t* barrier = static_cast<hsa_barrier_or_packet_t*>(packet);
+            bool any = false;
+            bool met = false;
+            while (!met) {
+                for (hsa_signal_t dep : barrier->dep_signal) {
+                    if (dep.handle != 0) {
+                        any = true;
+                        met = met || waitSignal(dep, HSA_SIGNAL_CONDITION_LT, 1, 100000, HSA_WAIT_STATE_BLOCKED) < 1;
+                    }
+                }
+                met = met || !any;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    completeSignal(completion, start);
+    header->store(HSA_PACKET_TYPE_INVALID << HSA_PACKET_HEADER_TYPE, std::memory_order_release);
+}
+
+// processes the packets up to the last doorbell, in order
+void serviceQueue(MockQueue* q) {
+    MockSignal* doorbell = q->doorbell;
+    char* ring = static_cast<char*>(q->queue.base_address);
+    for (;;) {
+        uint64_t read = q->readIndex.load(std::memory_order_relaxed);
+        {
+            std::unique_lock<std::mutex> l(doorbell->mutex);
+            doorbell->cv.wait(l, [&] {
+                hsa_signal_value_t rung = doorbell->value.load(std::memory_order_acquire);
+                return q->stopping || (rung >= 0 && uint64_t(rung) >= read);
+            });
+        }
+        if (q->stopping) {
+            return;
+        }
+
+        void* packet = ring + (read & (q->queue.size - 1)) * 64;
+        std::atomic<uint16_t>* header = reinterpret_cast<std::atomic<uint16_t>*>(packet);
+        while (packetType(header->load(std::memory_order_acquire)) == HSA_PACKET_TYPE_INVALID) {
+            if (q->stopping) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        processPacket(packet);
+        q->readIndex.store(read + 1, std::memory_order_release);
+    }
+}
+
+std::atomic<uint64_t> queueIds(0);
+
+hsa_status_t mockQueueCreate(hsa_agent_t agent, uint32_t size, hsa_queue_type32_t type,
+                             void (*callback)(hsa_status_t status, hsa_queue_t* source, void* data), void* data,
+                             uint32_t private_segment_size, uint32_t group_segment_size, hsa_queue_t** queue) {
+    if (queue == nullptr || toAgent(agent)->type != HSA_DEVICE_TYPE_GPU ||
+        size == 0 || (size & (size - 1)) != 0 || size > MOCK_QUEUE_MAX_SIZE) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+
+    void* ring = nullptr;
+    if (posix_memalign(&ring, 64, size_t(size) * 64) != 0) {
+        return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    }
+    for (uint32_t i = 0; i < size; ++i) {
+        uint16_t* header = reinterpret_cast<uint16_t*>(static_cast<char*>(ring) + size_t(i) * 64);
+        *header = HSA_PACKET_TYPE_INVALID << HSA_PACKET_HEADER_TYPE;
+    }
+
+    MockQueue* q = new MockQueue();
+    q->queue.type = type;
+    q->queue.features = HSA_QUEUE_FEATURE_KERNEL_DISPATCH;
+    q->queue.base_address = ring;
+    q->queue.size = size;
+    q->queue.id = queueIds++;
+    q->readIndex = 0;
+    q->writeIndex = 0;
+    q->stopping = false;
+    q->doorbell = new MockSignal(-1);
+    q->queue.doorbell_signal.handle = reinterpret_cast<uint64_t>(q->doorbell);
+    q->thread = std::thread(serviceQueue, q);
+
+    *queue = &q->queue;
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockQueueDestroy(hsa_queue_t* queue) {
+    if (queue == nullptr) {
+        return HSA_STATUS_ERROR_INVALID_QUEUE;
+    }
+    MockQueue* q = toQueue(queue);
+    updateSignal(q->doorbell, [q](std::atomic<hsa_signal_value_t>& v) {
+        q->stopping = true;
+        return v.load();
+    });
+    q->thread.join();
+    free(q->queue.base_address);
+    delete q->doorbell;
+    delete q;
+    return HSA_STATUS_SUCCESS;
+}
+
+uint64_t mockQueueLoadReadIndex(const hsa_queue_t* queue) {
+    return toQueue(queue)->readIndex.load(std::memory_order_acquire);
+}
+
+uint64_t mockQueueLoadWriteIndex(const hsa_queue_t* queue) {
+    return toQueue(queue)->writeIndex.load(std::memory_order_relaxed);
+}
+
+void mockQueueStoreWriteIndex(const hsa_queue_t* queue, uint64_t value) {
+    toQueue(queue)->writeIndex.store(value, std::memory_order_relaxed);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Code objects: every symbol exists, kernels have an empty descriptor and
+// variables 256 bytes of storage
+
+struct MockCodeObject {};
+
+struct MockSymbol {
+    amd_kernel_code_t code;
+    uint64_t variable[32];
+};
+
+struct MockExecutable {
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<MockSymbol>> symbols;
+};
+
+hsa_status_t mockCodeObjectDeserialize(void* serialized_code_object, size_t serialized_code_object_size,
+                                       const char* options, hsa_code_object_t* code_object) {
+    if (serialized_code_object == nullptr || code_object == nullptr) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    code_object->handle = reinterpret_cast<uint64_t>(new MockCodeObject());
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockCodeObjectDestroy(hsa_code_object_t code_object) {
+    delete reinterpret_cast<MockCodeObject*>(code_object.handle);
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockCodeObjectGetInfo(hsa_code_object_t code_object, hsa_code_object_info_t attribute, void* value) {
+    if (attribute != HSA_CODE_OBJECT_INFO_ISA) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    static_cast<hsa_isa_t*>(value)->handle = MOCK_ISA;
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockIsaCompatible(hsa_isa_t code_object_isa, hsa_isa_t agent_isa, bool* result) {
+    *result = code_object_isa.handle == agent_isa.handle;
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockExecutableCreate(hsa_profile_t profile, hsa_executable_state_t executable_state,
+                                  const char* options, hsa_executable_t* executable) {
+    executable->handle = reinterpret_cast<uint64_t>(new MockExecutable());
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockExecutableDestroy(hsa_executable_t executable) {
+    delete reinterpret_cast<MockExecutable*>(executable.handle);
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockExecutableGetSymbol(hsa_executable_t executable, const char* module_name, const char* symbol_name,
+                                     hsa_agent_t agent, int32_t call_convention, hsa_executable_symbol_t* symbol) {
+    if (symbol_name == nullptr || symbol == nullptr) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    MockExecutable* e = reinterpret_cast<MockExecutable*>(executable.handle);
+    std::lock_guard<std::mutex> l(e->mutex);
+    std::unique_ptr<MockSymbol>& s = e->symbols[symbol_name];
+    if (!s) {
+        s.reset(new MockSymbol());
+        std::memset(s.get(), 0, sizeof(MockSymbol));
+    }
+    symbol->handle = reinterpret_cast<uint64_t>(s.get());
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockSymbolGetInfo(hsa_executable_symbol_t symbol, hsa_executable_symbol_info_t attribute, void* value) {
+    MockSymbol* s = reinterpret_cast<MockSymbol*>(symbol.handle);
+    switch (attribute) {
+        case HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_OBJECT:
+            *static_cast<uint64_t*>(value) = reinterpret_cast<uint64_t>(&s->code);
+            break;
+        case HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_GROUP_SEGMENT_SIZE:
+        case HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_PRIVATE_SEGMENT_SIZE:
+        case HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_KERNARG_SEGMENT_SIZE:
+            *static_cast<uint32_t*>(value) = 0;
+            break;
+        case HSA_EXECUTABLE_SYMBOL_INFO_VARIABLE_ADDRESS:
+            *static_cast<uint64_t*>(value) = reinterpret_cast<uint64_t>(s->variable);
+            break;
+        default:
+            return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    return HSA_STATUS_SUCCESS;
+}
+
+// kernel objects are host addresses already
+hsa_status_t mockQueryHostAddress(const void* device_address, const void** host_address) {
+    *host_address = device_address;
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockGetExtensionTable(uint16_t extension, uint16_t version_major, uint16_t version_minor, void* table) {
+    if (extension != HSA_EXTENSION_AMD_LOADER || table == nullptr) {
+        return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+    }
+    hsa_ven_amd_loader_1_00_pfn_t* loader = static_cast<hsa_ven_amd_loader_1_00_pfn_t*>(table);
+    std::memset(loader, 0, sizeof(*loader));
+    loader->hsa_ven_amd_loader_query_host_address = mockQueryHostAddress;
+    return HSA_STATUS_SUCCESS;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Initialization
+
+std::mutex initMutex;
+int initCount = 0;
+
+hsa_status_t mockInit() {
+    std::lock_guard<std::mutex> l(initMutex);
+    if (initCount++ == 0) {
+        handlerWorker.start();
+        copyWorker.start();
+    }
+    return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t mockShutDown() {
+    std::lock_guard<std::mutex> l(initMutex);
+    if (initCount == 0) {
+        return HSA_STATUS_ERROR_NOT_INITIALIZED;
+    }
+    if (--initCount == 0) {
+        copyWorker.stop();
+        handlerWorker.stop();
+    }
+    return HSA_STATUS_SUCCESS;
+}
+
+// entry points with nothing to emulate
+template <typename... Args>
+hsa_status_t mockSuccess(Args...) {
+    return HSA_STATUS_SUCCESS;
+}
+
+} // namespace
+
+void useMockHsaApi(uint32_t kernelUs) {
+    mockKernelUs = kernelUs;
+
+    HsaApiTable& t = hsaApi;
+    t.hsa_init = mockInit;
+    t.hsa_shut_down = mockShutDown;
+    t.hsa_system_get_info = mockSystemGetInfo;
+    t.hsa_system_get_extension_table = mockGetExtensionTable;
+    t.hsa_iterate_agents = mockIterateAgents;
+    t.hsa_agent_get_info = mockAgentGetInfo;
+    t.hsa_signal_create = mockSignalCreate;
+    t.hsa_signal_destroy = mockSignalDestroy;
+    t.hsa_signal_load_acquire = mockSignalLoad;
+    t.hsa_signal_load_relaxed = mockSignalLoad;
+    t.hsa_signal_store_relaxed = mockSignalStore;
+    t.hsa_signal_store_release = mockSignalStore;
+    t.hsa_signal_wait_acquire = waitSignal;
+    t.hsa_signal_wait_relaxed = waitSignal;
+    t.hsa_queue_create = mockQueueCreate;
+    t.hsa_queue_destroy = mockQueueDestroy;
+    t.hsa_queue_load_read_index_acquire = mockQueueLoadReadIndex;
+    t.hsa_queue_load_write_index_relaxed = mockQueueLoadWriteIndex;
+    t.hsa_queue_store_write_index_relaxed = mockQueueStoreWriteIndex;
+    t.hsa_memory_copy = mockMemoryCopy;
+    t.hsa_code_object_deserialize = mockCodeObjectDeserialize;
+    t.hsa_code_object_destroy = mockCodeObjectDestroy;
+    t.hsa_code_object_get_info = mockCodeObjectGetInfo;
+    t.hsa_isa_compatible = mockIsaCompatible;
+    t.hsa_executable_create = mockExecutableCreate;
+    t.hsa_executable_destroy = mockExecutableDestroy;
+    t.hsa_executable_freeze = mockSuccess;
+    t.hsa_executable_get_symbol = mockExecutableGetSymbol;
+    t.hsa_executable_load_code_object = mockSuccess;
+    t.hsa_executable_symbol_get_info = mockSymbolGetInfo;
+    t.hsa_amd_agent_iterate_memory_pools = mockIteratePools;
+    t.hsa_amd_agent_memory_pool_get_info = mockAgentPoolGetInfo;
+    t.hsa_amd_agents_allow_access = mockSuccess;
+    t.hsa_amd_memory_async_copy = mockAsyncCopy;
+    t.hsa_amd_memory_lock = mockMemoryLock;
+    t.hsa_amd_memory_unlock = mockMemoryUnlock;
+    t.hsa_amd_memory_pool_allocate = mockPoolAllocate;
+    t.hsa_amd_memory_pool_free = mockPoolFree;
+    t.hsa_amd_memory_pool_get_info = mockPoolGetInfo;
+    t.hsa_amd_pointer_info = mockPointerInfo;
+    t.hsa_amd_profiling_get_dispatch_time = mockGetDispatchTime;
+    t.hsa_amd_profiling_set_profiler_enabled = mockSuccess;
+    t.hsa_amd_queue_cu_set_mask = mockSuccess;
+    t.hsa_amd_queue_set_deadline = mockSuccess;
+    t.hsa_amd_queue_set_priority = mockSuccess;
+    t.hsa_amd_signal_async_handler = mockSignalAsyncHandler;
+}
+
+} // namespace Kalmar
@@ -19,6 +19,7 @@
 #include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <algorithm>
@@ -30,8 +31,14 @@
 #include <hsa/amd_hsa_kernel_code.h>
 #include <hsa/hsa_ven_amd_loader.h>
 
+#include "hsa_api.h"
+
 #include "kalmar_runtime.h"
 #include "kalmar_aligned_alloc.h"
+#include "kalmar_wait.h"
+#include "kalmar_queue_scheduler.h"
+#include "kalmar_stream_pool.h"
+#include "kalmar_trace.h"
 
 #include <hc_am.hpp>
 
@@ -87,6 +94,9 @@ int HCC_PRINT_ENV=0;
 
 int HCC_UNPINNED_COPY_MODE = UnpinnedCopyEngine::ChooseBest;
 
+// Measurements of the copy algorithms for UnpinnedCopyEngine::UseCalibrated.
+std::string HCC_COPY_PROFILE;
+
 int HCC_CHECK_COPY=0;
 
 // Copy thresholds, in KB.  These are used for "choose-best" copy mode.
@@ -94,15 +104,49 @@ long int HCC_H2D_STAGING_THRESHOLD    = 64;
 long int HCC_H2D_PININPLACE_THRESHOLD = 4096;
 long int HCC_D2H_PININPLACE_THRESHOLD = 1024;
 
+// Size (in MB) of the pinned host memory kept for copies, per device.  Off by
+// default: a range kept pinned goes stale when the application frees the
+// memory, see am_memory_host_cache_invalidate.
+long int HCC_PIN_CACHE_SIZE = 0;
+
+// Staging buffers of unpinned copies, per device and direction.
+// 0 picks 64KB, or 1MB with HCC_STAGING_PACK_THREADS so that the helper
+// threads have a buffer worth splitting.
+long int HCC_STAGING_BUFFER_SIZE = 0;   // KB
+int HCC_STAGING_BUFFER_COUNT = 2;       // buffers per ring
+int HCC_STAGING_RINGS = 4;              // copies which can stage concurrently
+int HCC_STAGING_PACK_THREADS = 0;       // helper threads for the CPU side, per device
+
 int HCC_SERIALIZE_KERNEL = 0;
 int HCC_SERIALIZE_COPY = 0;
 
 int HCC_OPT_FLUSH=1;
 
+// Default wait mode of the queues (hcWaitMode), and budgets of adaptive waits.
+int HCC_WAIT_MODE = Kalmar::hcWaitModeBlocked;
+int HCC_WAIT_SPIN_US = 200;
+int HCC_WAIT_YIELD_US = 50;
+
 
 unsigned HCC_DB = 0;
 
 int HCC_MAX_QUEUES = 256;
+int HCC_QUEUE_BORROW = 0;
+
+// Size (in MB) of the memory freed with free_async kept for alloc_async, per accelerator_view.
+long int HCC_ASYNC_POOL_SIZE = 64;
+
+// Largest buffer (in KB) of HSADevice::create and CPUDevice::create carved out of slabs, 0=disable.
+long int HCC_SLAB_MAX_SIZE = 64;
+
+// Size (in MB) of the memory freed with am_free kept for am_alloc by hc_am, 0=disable.
+long int HCC_AM_CACHE_SIZE = 0;
+
+// Largest block (in KB) of am_alloc carved out of slabs by hc_am, 0=disable.
+long int HCC_AM_SLAB_MAX_SIZE = 0;
+
+std::string HCC_HSA_RUNTIME;
+int HCC_MOCK_KERNEL_US = 0;
 
 
 // Track a short thread-id, for debugging:
@@ -342,6 +386,7 @@ private:
     uint32_t static_group_segment_size;
     uint32_t private_segment_size;
     uint16_t workitem_vgpr_count;
+    mutable std::atomic<const char*> traceName;  // kernel name kept by the tracer, set by the first traced dispatch
     friend class HSADispatch;
 
 public:
@@ -351,7 +396,8 @@ public:
         kernelName(_kernelName),
         executable(_executable),
         hsaExecutableSymbol(_hsaExecutableSymbol),
-        kernelCodeHandle(_kernelCodeHandle) {
+        kernelCodeHandle(_kernelCodeHandle),
+        traceName(nullptr) {
 
         hsa_status_t status =
             hsa_executable_symbol_get_info(
@@ -385,17 +431,98 @@ public:
     //TODO - fix this so all Kernels set the _kernelName to something sensible.
     std::string getKernelName() const { return !kernelName.empty() ? kernelName : "<unknown>";}
 
+    // name of the kernel in the trace of the runtime events
+    const char* getTraceName() const {
+        const char* name = traceName.load(std::memory_order_relaxed);
+        if (name == nullptr) {
+            name = Kalmar::Tracer::get().intern(getKernelName());
+            traceName.store(name, std::memory_order_relaxed);
+        }
+        return name;
+    }
+
     ~HSAKernel() {
         DBOUT(DB_INIT, "HSAKernel::~HSAKernel\n");
     }
 }; // end of HSAKernel
 
+// Call @callback(@data) from the async signal handler thread of the HSA
+// runtime once @signal drops to 0, which is how the completion signals of
+// packets and copies report completion.
+static bool notifySignalCompletion(hsa_signal_t signal, void (*callback)(void*), void* data) {
+    if (signal.handle == 0) {
+        return false;
+    }
+    typedef std::pair<void (*)(void*), void*> Handler;
+    Handler* handler = new Handler(callback, data);
+    hsa_status_t status = hsa_amd_signal_async_handler(signal, HSA_SIGNAL_CONDITION_EQ, 0,
+        [] (hsa_signal_value_t, void* arg) -> bool {
+            Handler* h = static_cast<Handler*>(arg);
+            h->first(h->second);
+            delete h;
+            // one-shot
+            return false;
+        }, handler);
+    if (status != HSA_STATUS_SUCCESS) {
+        delete handler;
+        return false;
+    }
+    return true;
+}
+
+// Spin-then-block waits of hcWaitModeAdaptive, which learn their spin budget
+// from the previous waits on the same kernel, or copies of similar size.
+static Kalmar::AdaptiveWaitPolicy& adaptiveWaitPolicy() {
+    static Kalmar::AdaptiveWaitPolicy policy(HCC_WAIT_SPIN_US, HCC_WAIT_YIELD_US);
+    return policy;
+}
+
+// keys of adaptive waits which are not kernels
+static const void* copyWaitKey(size_t sizeBytes) {
+    // one per power of 2 of the size, not a valid address
+    int log2 = 0;
+    while ((sizeBytes >>= 1) != 0) {
+        log2++;
+    }
+    return reinterpret_cast<const void*>(uintptr_t(1 + log2));
+}
+static const void* const barrierWaitKey = reinterpret_cast<const void*>(uintptr_t(128));
+
+// Wait until @signal satisfies @condition against @value: as
+// hsa_signal_wait_acquire() does with @waitState, or spin-then-block with
+// the budget learned for @key if @adaptive.
+static void waitSignal(hsa_signal_t signal, hsa_signal_condition_t condition, hsa_signal_value_t value,
+                       hsa_wait_state_t waitState, bool adaptive, const void* key) {
+    if (!adaptive) {
+        hsa_signal_wait_acquire(signal, condition, value, UINT64_MAX, waitState);
+        return;
+    }
+
+    struct Waiter {
+        hsa_signal_t signal;
+        hsa_signal_condition_t condition;
+        hsa_signal_value_t value;
+
+        bool done() {
+            hsa_signal_value_t v = hsa_signal_load_acquire(signal);
+            return (condition == HSA_SIGNAL_CONDITION_EQ) ? (v == value) : (v < value);
+        }
+        void block() {
+            hsa_signal_wait_acquire(signal, condition, value, UINT64_MAX, HSA_WAIT_STATE_BLOCKED);
+        }
+    } waiter = { signal, condition, value };
+
+    Kalmar::AdaptiveWaitPolicy::Phase phase = adaptiveWaitPolicy().wait(key, waiter);
+    DBOUT(DB_WAIT, "  adaptive wait completed in phase " << phase << "\n");
+}
+
 class HSACopy : public Kalmar::KalmarAsyncOp {
 private:
     hsa_signal_t signal;
     int signalIndex;
     bool isSubmitted;
     hsa_wait_state_t waitMode;
+    bool adaptiveWait;  // hcWaitModeAdaptive, waitMode is the state to block in
 
     std::shared_future<void>* future;
 
@@ -416,15 +543,22 @@ private:
     // bytes to be copied
     size_t sizeBytes;
 
+    // host memory locked by the queue for this copy, unlocked on completion
+    const void* lockedHost;
+    bool lockedHostCached;
+
 
 public:
     Kalmar::HSAQueue * hsaQueue() const;
     std::shared_future<void>* getFuture() override { return future; }
     const Kalmar::HSADevice* getCopyDevice() { return copyDevice; } ;  // Which device did the copy.
 
+    void setLockedHost(const void* host, bool cached) { lockedHost = host; lockedHostCached = cached; }
+
     void* getNativeHandle() override { return &signal; }
 
     void setWaitMode(Kalmar::hcWaitMode mode) override {
+        adaptiveWait = false;
         switch (mode) {
             case Kalmar::hcWaitModeBlocked:
                 waitMode = HSA_WAIT_STATE_BLOCKED;
@@ -432,6 +566,10 @@ public:
             case Kalmar::hcWaitModeActive:
                 waitMode = HSA_WAIT_STATE_ACTIVE;
             break;
+            case Kalmar::hcWaitModeAdaptive:
+                waitMode = HSA_WAIT_STATE_BLOCKED;
+                adaptiveWait = true;
+            break;
         }
     }
 
@@ -439,13 +577,18 @@ public:
         return (hsa_signal_load_acquire(signal) == 0);
     }
 
+    bool notifyOnCompletion(void (*callback)(void*), void* data) override {
+        return isSubmitted && notifySignalCompletion(signal, callback, data);
+    }
+
 
     // Copy mode will be set later on.
     // HSA signals would be waited in HSA_WAIT_STATE_ACTIVE by default for HSACopy instances
     HSACopy(Kalmar::KalmarQueue *queue, const void* src_, void* dst_, size_t sizeBytes_) : KalmarAsyncOp(queue, Kalmar::hcCommandInvalid),
-        isSubmitted(false), future(nullptr), depAsyncOp(nullptr), copyDevice(nullptr), waitMode(HSA_WAIT_STATE_ACTIVE),
+        isSubmitted(false), future(nullptr), depAsyncOp(nullptr), copyDevice(nullptr), waitMode(HSA_WAIT_STATE_ACTIVE), adaptiveWait(false),
         src(src_), dst(dst_),
         sizeBytes(sizeBytes_),
+        lockedHost(nullptr), lockedHostCached(false),
         signalIndex(-1) {
     }
 
@@ -498,6 +641,7 @@ private:
     int signalIndex;
     bool isDispatched;
     hsa_wait_state_t waitMode;
+    bool adaptiveWait;  // hcWaitModeAdaptive, waitMode is the state to block in
 
 
     std::shared_future<void>* future;
@@ -522,6 +666,7 @@ public:
     void* getNativeHandle() override { return &signal; }
 
     void setWaitMode(Kalmar::hcWaitMode mode) override {
+        adaptiveWait = false;
         switch (mode) {
             case Kalmar::hcWaitModeBlocked:
                 waitMode = HSA_WAIT_STATE_BLOCKED;
@@ -529,6 +674,10 @@ public:
             case Kalmar::hcWaitModeActive:
                 waitMode = HSA_WAIT_STATE_ACTIVE;
             break;
+            case Kalmar::hcWaitModeAdaptive:
+                waitMode = HSA_WAIT_STATE_BLOCKED;
+                adaptiveWait = true;
+            break;
         }
     }
 
@@ -536,13 +685,17 @@ public:
         return (hsa_signal_load_acquire(signal) == 0);
     }
 
+    bool notifyOnCompletion(void (*callback)(void*), void* data) override {
+        return isDispatched && notifySignalCompletion(signal, callback, data);
+    }
+
 
     Kalmar::HSAQueue * hsaQueue() const;
 
 
 
     // constructor with 1 prior dependency
-    HSABarrier(Kalmar::KalmarQueue *queue, std::shared_ptr <Kalmar::KalmarAsyncOp> dependent_op) : KalmarAsyncOp(queue, Kalmar::hcCommandMarker), isDispatched(false), future(nullptr), _acquire_scope(hc::no_scope), waitMode(HSA_WAIT_STATE_BLOCKED) {
+    HSABarrier(Kalmar::KalmarQueue *queue, std::shared_ptr <Kalmar::KalmarAsyncOp> dependent_op) : KalmarAsyncOp(queue, Kalmar::hcCommandMarker), isDispatched(false), future(nullptr), _acquire_scope(hc::no_scope), waitMode(HSA_WAIT_STATE_BLOCKED), adaptiveWait(false) {
         if (dependent_op != nullptr) {
             depAsyncOps[0] = dependent_op;
             depCount = 1;
@@ -552,7 +705,7 @@ public:
     }
 
     // constructor with at most 5 prior dependencies
-    HSABarrier(Kalmar::KalmarQueue *queue, int count, std::shared_ptr <Kalmar::KalmarAsyncOp> *dependent_op_array) : KalmarAsyncOp(queue, Kalmar::hcCommandMarker), isDispatched(false), future(nullptr), _acquire_scope(hc::no_scope), waitMode(HSA_WAIT_STATE_BLOCKED), depCount(0) {
+    HSABarrier(Kalmar::KalmarQueue *queue, int count, std::shared_ptr <Kalmar::KalmarAsyncOp> *dependent_op_array) : KalmarAsyncOp(queue, Kalmar::hcCommandMarker), isDispatched(false), future(nullptr), _acquire_scope(hc::no_scope), waitMode(HSA_WAIT_STATE_BLOCKED), adaptiveWait(false), depCount(0) {
         if ((count >= 0) && (count <= 5)) {
             for (int i = 0; i < count; ++i) {
                 if (dependent_op_array[i]) {
@@ -616,10 +769,15 @@ private:
     hsa_kernel_dispatch_packet_t aql;
     bool isDispatched;
     hsa_wait_state_t waitMode;
+    bool adaptiveWait;  // hcWaitModeAdaptive, waitMode is the state to block in
 
 
     std::shared_future<void>* future;
 
+    // buffers passed to the kernel, registered by HSAQueue::Push()
+    // first: buffer, second: true if the kernel may write it
+    std::vector< std::pair<void*, bool> > bufferAccesses;
+
 
 public:
     Kalmar::HSAQueue * hsaQueue() const;
@@ -628,6 +786,7 @@ public:
     void* getNativeHandle() override { return &signal; }
 
     void setWaitMode(Kalmar::hcWaitMode mode) override {
+        adaptiveWait = false;
         switch (mode) {
             case Kalmar::hcWaitModeBlocked:
                 waitMode = HSA_WAIT_STATE_BLOCKED;
@@ -635,6 +794,10 @@ public:
             case Kalmar::hcWaitModeActive:
                 waitMode = HSA_WAIT_STATE_ACTIVE;
             break;
+            case Kalmar::hcWaitModeAdaptive:
+                waitMode = HSA_WAIT_STATE_BLOCKED;
+                adaptiveWait = true;
+            break;
         }
     }
 
@@ -642,6 +805,13 @@ public:
         return (hsa_signal_load_acquire(signal) == 0);
     }
 
+    bool notifyOnCompletion(void (*callback)(void*), void* data) override {
+        return isDispatched && notifySignalCompletion(signal, callback, data);
+    }
+
+    void addBufferAccess(void* buffer, bool modify) { bufferAccesses.emplace_back(buffer, modify); }
+    const std::vector< std::pair<void*, bool> >& getBufferAccesses() const { return bufferAccesses; }
+
     ~HSADispatch() {
 
         if (isDispatched) {
@@ -688,6 +858,9 @@ public:
 
     void dispose();
 
+    // report the duration of the completed kernel to the profiler
+    void profile();
+
     uint64_t getTimestampFrequency() override {
         // get system tick frequency
         uint64_t timestamp_frequency_hz = 0L;
@@ -805,22 +978,6 @@ struct RocrQueue {
     RocrQueue(hsa_agent_t agent, size_t queue_size, HSAQueue *hccQueue, queue_priority priority, uint64_t deadline)
 		: _priority(priority), _deadline(deadline)
     {
-
-        // Map queue_priority to hsa_amd_queue_priority_t
-        hsa_amd_queue_priority_t queue_priority;
-        switch (priority) {
-            case priority_low:
-                queue_priority = HSA_AMD_QUEUE_PRIORITY_LOW;
-                break;
-            case priority_high:
-                queue_priority = HSA_AMD_QUEUE_PRIORITY_HIGH;
-                break;
-            case priority_normal:
-            default:
-                queue_priority = HSA_AMD_QUEUE_PRIORITY_NORMAL;
-                break;
-        }
-
         assert(queue_size != 0);
 
         /// Create a queue using the maximum size.
@@ -829,8 +986,7 @@ struct RocrQueue {
         DBOUT(DB_QUEUE, "  " <<  __func__ << ": created an HSA command queue: " << _hwQueue << "\n");
 
         STATUS_CHECK(status, __LINE__);
-        status = hsa_amd_queue_set_priority(_hwQueue, queue_priority);
-        DBOUT(DB_QUEUE, "  " <<  __func__ << ": set priority for HSA command queue: " << _hwQueue << " to " << queue_priority << "\n");
+        setPriority(priority);
 
 	status = hsa_amd_queue_set_deadline(_hwQueue, _deadline);
         DBOUT(DB_QUEUE, "  " <<  __func__ << ": set deadline for HSA command queue: " << _hwQueue << " to " << deadline << "\n");
@@ -854,6 +1010,28 @@ struct RocrQueue {
 
     hsa_status_t setCuMask(HSAQueue *hccQueue);
 
+    // also used when the queue is handed to an accelerator_view of another priority
+    void setPriority(queue_priority priority) {
+        // Map queue_priority to hsa_amd_queue_priority_t
+        hsa_amd_queue_priority_t queue_priority;
+        switch (priority) {
+            case priority_low:
+                queue_priority = HSA_AMD_QUEUE_PRIORITY_LOW;
+                break;
+            case priority_high:
+                queue_priority = HSA_AMD_QUEUE_PRIORITY_HIGH;
+                break;
+            case priority_normal:
+            default:
+                queue_priority = HSA_AMD_QUEUE_PRIORITY_NORMAL;
+                break;
+        }
+
+        hsa_amd_queue_set_priority(_hwQueue, queue_priority);
+        DBOUT(DB_QUEUE, "  " <<  __func__ << ": set priority for HSA command queue: " << _hwQueue << " to " << queue_priority << "\n");
+        _priority = priority;
+    }
+
     hsa_queue_t *_hwQueue; // Pointer to the HSA queue this entry tracks.
 
     HSAQueue *_hccQueue;  // Pointe to the HCC "HSA" queue which is assigned to use the rocrQueue
@@ -869,12 +1047,47 @@ struct RocrQueue {
 };
 
 
+// Device memory of alloc_async, freed once the op enqueued last before the
+// free_async has completed.
+struct HsaStreamPoolBackend {
+    typedef std::shared_ptr<KalmarAsyncOp> Event;
+
+    KalmarDevice* device;
+
+    bool isDone(const Event& event) {
+        return !event || event->isReady();
+    }
+    void wait(const Event& event) {
+        if (event) {
+            event->getFuture()->wait();
+        }
+    }
+    // am_free rejects the blocks while they belong to the pool
+    void* allocate(size_t size) {
+        hc::accelerator acc(device->get_path());
+        void* ptr = hc::am_alloc(size, acc, 0);
+        if (ptr != nullptr) {
+            hc::am_memtracker_set_pool_owned(ptr, true);
+        }
+        return ptr;
+    }
+    void free(void* ptr) {
+        hc::am_memtracker_set_pool_owned(ptr, false);
+        hc::am_free(ptr);
+    }
+    void disown(void* ptr) {
+        hc::am_memtracker_set_pool_owned(ptr, false);
+    }
+};
+typedef Kalmar::StreamOrderedPool<HsaStreamPoolBackend> HsaStreamPool;
+
 
 class HSAQueue final : public KalmarQueue
 {
 private:
     friend class Kalmar::HSADevice;
     friend class RocrQueue;
+    friend struct HsaQueueBackend;
     friend std::ostream& operator<<(std::ostream& os, const HSAQueue & hav);
 
     // ROCR queue associated with this HSAQueue instance. 
@@ -919,38 +1132,47 @@ private:
     std::vector<uint32_t> cu_arrays;
 
     //
-    // kernelBufferMap and bufferKernelMap forms the dependency graph of
-    // kernel / kernel dispatches / buffers
-    //
-    // For a particular kernel k, kernelBufferMap[k] holds a vector of
-    // host buffers used by k. The vector is filled at HSAQueue::Push(),
-    // when kernel arguments are prepared.
+    // Hazards on the buffers used by kernels of the queue.
     //
-    // When a kenrel k is to be dispatched, kernelBufferMap[k] will be traversed
-    // to figure out if there is any previous kernel dispatch associated for
-    // each buffer b used by k.  This is done by checking bufferKernelMap[b].
-    // If there are previous kernel dispatches which use b, then we wait on
-    // them before dispatch kernel k. bufferKernelMap[b] will be cleared then.
+    // HSAQueue::Push() registers each buffer passed to a kernel with the
+    // dispatch, with whether the kernel may write it.  After the dispatch,
+    // bufferAccess[b] records it as the writer of b (forgetting the readers)
+    // or as one of the readers of b since the writer.
     //
-    // After kernel k is dispatched, we'll get a KalmarAsync object f, we then
-    // walk through each buffer b used by k and mark the association as:
-    // bufferKernelMap[b] = f
-    //
-    // Finally kernelBufferMap[k] will be cleared.
+    // A kernel reading b depends on the writer of b, a kernel writing b also
+    // depends on the readers; kernels reading b do not depend on each other.
+    // See enqueueBufferDeps() for kernels and waitForDependentAsyncOps() for
+    // host accesses.  Only queues which look the hazards up record them, see
+    // tracksBufferAccesses(), and the records of completed kernels are pruned
+    // whenever the map has doubled since the last pruning.
     //
+    struct BufferAccess {
+        std::weak_ptr<KalmarAsyncOp>                 writer;
+        std::vector< std::weak_ptr<KalmarAsyncOp> >  readers;
+    };
+    std::unordered_map<void*, BufferAccess> bufferAccess;
+    size_t bufferAccessPruneSize;  // size of bufferAccess which triggers pruning
+
+    // host memory locked for the copies in flight, see lockHostMemory()
+    struct LockedHostMemory {
+        void*   va;     // pointer used by the copy engine
+        size_t  size;
+        int     refs;   // copies using the lock
+    };
+    std::map<const void*, LockedHostMemory> lockedHostMemory;
+    // protects lockedHostMemory: copies are unlocked by the thread waiting
+    // for them, not necessarily the one enqueuing copies
+    std::mutex lockedHostMemoryMutex;
 
-    // association between buffers and kernel dispatches
-    // key: buffer address
-    // value: a vector of kernel dispatches
-    std::map<void*, std::vector< std::weak_ptr<KalmarAsyncOp> > > bufferKernelMap;
+    // decides when written packets are made visible to the packet processor,
+    // protected by qmutex like the rocrQueue
+    DoorbellCoalescer doorbell;
 
-    // association between a kernel and buffers used by it
-    // key: kernel
-    // value: a vector of buffers used by the kernel
-    std::map<void*, std::vector<void*> > kernelBufferMap;
+    // memory of alloc_async, created with the queue and destroyed by dispose()
+    std::unique_ptr<HsaStreamPool> streamPool;
 
-    // signal used by sync copy only
-    hsa_signal_t  sync_copy_signal;
+    // runtime events of this queue, also counted on the device
+    Kalmar::RuntimeCounters counters;
 
 
 public:
@@ -964,6 +1186,13 @@ public:
 
     Kalmar::HSADevice * getHSADev() const;
 
+    uint64_t getQueueSeqNum() const { return queueSeqNum; }
+
+    // Count a runtime event of this queue and of its device.
+    void countEvent(hcRuntimeCounter counter);
+
+    Kalmar::RuntimeCounterValues getRuntimeCounters() override { return counters.snapshot(); }
+
     void dispose() override;
 
     ~HSAQueue() {
@@ -975,8 +1204,8 @@ public:
         DBOUT(DB_INIT, "HSAQueue::~HSAQueue() out\n");
     }
 
-    // FIXME: implement flush
-    //
+    // make packets held back by a batch visible to the device
+    void flush() override;
     void printAsyncOps(std::ostream &s = std::cerr)
     {
         hsa_signal_value_t oldv=0;
@@ -1028,6 +1257,8 @@ public:
         if (asyncOps.size() >= MAX_INFLIGHT_COMMANDS_PER_QUEUE) {
             DBOUT(DB_WAIT, "*** Hit max inflight ops asyncOps.size=" << asyncOps.size() << ". op#" << opSeqNums << " force sync\n");
             DBOUT(DB_RESOURCE, "*** Hit max inflight ops asyncOps.size=" << asyncOps.size() << ". op#" << opSeqNums << " force sync\n");
+            Kalmar::traceInstant(Kalmar::TraceWait, "max inflight ops, force sync", hcWaitModeBlocked, queueSeqNum);
+            countEvent(Kalmar::hcCounterInflightDrain);
 
             wait();
         }
@@ -1054,7 +1285,8 @@ public:
 
         assert (newCommandKind != hcCommandInvalid);
 
-        if (!asyncOps.empty()) {
+        // the youngest op is null if it has already been waited on
+        if (!asyncOps.empty() && asyncOps.back() != nullptr) {
             assert (youngestCommandKind != hcCommandInvalid);
 
 
@@ -1143,12 +1375,17 @@ public:
         // Go in reverse order (from youngest to oldest).
         // Ensures younger ops have chance to complete before older ops reclaim their resources
         //
+        Kalmar::TraceScope trace(Kalmar::TraceWait, "queue wait", mode, queueSeqNum);
 
+        // commands without a signal are not waited on, make sure the ones
+        // held back by a batch get executed
+        flush();
   
         if (HCC_OPT_FLUSH && nextSyncNeedsSysRelease()) {
 
             // In the loop below, this will be the first op waited on
             auto marker = EnqueueMarker(hc::system_scope);
+            countEvent(Kalmar::hcCounterSysReleaseMarker);
 
             DBOUT(DB_CMD, " Sys-release needed, enqueued marker to release written data " << marker<<"\n");
             
@@ -1162,6 +1399,10 @@ public:
         for (int i = asyncOps.size()-1; i >= 0;  i--) {
             if (asyncOps[i] != nullptr) {
                 auto asyncOp = asyncOps[i];
+                // blocked waits keep the wait state of each kind of op
+                if (resolve_wait_mode(mode) != hcWaitModeBlocked) {
+                    asyncOp->setWaitMode(resolve_wait_mode(mode));
+                }
                 // wait on valid futures only
                 std::shared_future<void>* future = asyncOp->getFuture();
                 if (future->valid()) {
@@ -1185,11 +1426,8 @@ public:
             local = tmp_local;
         dispatch->setLaunchConfiguration(nr_dim, global, local, dynamic_group_size);
 
-        // wait for previous kernel dispatches be completed
-        std::for_each(std::begin(kernelBufferMap[ker]), std::end(kernelBufferMap[ker]),
-                      [&] (void* buffer) {
-                        waitForDependentAsyncOps(buffer);
-                      });
+        // order after previous commands using the buffers
+        enqueueBufferDeps(dispatch);
 
         waitForStreamDeps(dispatch);
 
@@ -1199,10 +1437,6 @@ public:
         // and wait for its completion
         dispatch->dispatchKernelWaitComplete();
 
-        // clear data in kernelBufferMap
-        kernelBufferMap[ker].clear();
-        kernelBufferMap.erase(ker);
-
         delete(dispatch);
     }
 
@@ -1222,16 +1456,8 @@ public:
         dispatch->setLaunchConfiguration(nr_dim, global, local, dynamic_group_size);
 
 
-        bool hasArrayViewBufferDeps = (kernelBufferMap.find(ker) != kernelBufferMap.end());
-
-
-	    if (hasArrayViewBufferDeps) {
-            // wait for previous kernel dispatches be completed
-            std::for_each(std::begin(kernelBufferMap[ker]), std::end(kernelBufferMap[ker]),
-                      [&] (void* buffer) {
-                        waitForDependentAsyncOps(buffer);
-                     });
-	    }
+        // order after previous commands using the buffers
+        enqueueBufferDeps(dispatch);
 
         waitForStreamDeps(dispatch);
 
@@ -1246,17 +1472,8 @@ public:
         // associate the kernel dispatch with this queue
         pushAsyncOp(sp_dispatch);
 
-	    if (hasArrayViewBufferDeps) {
-            // associate all buffers used by the kernel with the kernel dispatch instance
-            std::for_each(std::begin(kernelBufferMap[ker]), std::end(kernelBufferMap[ker]),
-                          [&] (void* buffer) {
-                            bufferKernelMap[buffer].push_back(sp_dispatch);
-                          });
-
-            // clear data in kernelBufferMap
-            kernelBufferMap[ker].clear();
-            kernelBufferMap.erase(ker);
-        }
+        // later commands using the buffers depend on the kernel
+        recordBufferAccesses(dispatch, sp_dispatch);
 
         return sp_dispatch;
     }
@@ -1267,52 +1484,174 @@ public:
         if (HCC_OPT_FLUSH && nextSyncNeedsSysRelease()) {
             // In the loop below, this will be the first op waited on
             auto marker= EnqueueMarker(hc::system_scope);
+            countEvent(Kalmar::hcCounterSysReleaseMarker);
 
             DBOUT(DB_CMD, " In waitForDependentAsyncOps, sys-release needed: enqueued marker to release written data " << marker<<"\n");
         };
     }
 
 
-    // wait for dependent async operations to complete
-    void waitForDependentAsyncOps(void* buffer) {
-        auto&& dependentAsyncOpVector = bufferKernelMap[buffer];
-        for (int i = 0; i < dependentAsyncOpVector.size(); ++i) {
-          auto dependentAsyncOp = dependentAsyncOpVector[i];
-          if (!dependentAsyncOp.expired()) {
-            auto dependentAsyncOpPointer = dependentAsyncOp.lock();
+    // pending op of a BufferAccess record, or null
+    static std::shared_ptr<KalmarAsyncOp> pendingOp(const std::weak_ptr<KalmarAsyncOp>& op) {
+        std::shared_ptr<KalmarAsyncOp> p = op.lock();
+        return (p && !p->isReady()) ? p : nullptr;
+    }
+
+    // Order a kernel after the commands it has a hazard with.  An in-order
+    // queue already runs its commands in order (barrier bit and stream
+    // dependencies).  On an any-order queue the dependencies become
+    // barrier-AND packets ahead of the kernel, the host does not wait.
+    void enqueueBufferDeps(HSADispatch* dispatch) {
+        if (get_execute_order() != execute_any_order) {
+            return;
+        }
+
+        std::vector< std::shared_ptr<KalmarAsyncOp> > deps;
+        auto addDep = [&] (const std::weak_ptr<KalmarAsyncOp>& op) {
+            std::shared_ptr<KalmarAsyncOp> p = pendingOp(op);
+            if (p && (std::find(deps.begin(), deps.end(), p) == deps.end())) {
+                deps.push_back(p);
+            }
+        };
+        for (auto& access : dispatch->getBufferAccesses()) {
+            auto it = bufferAccess.find(access.first);
+            if (it == bufferAccess.end()) {
+                continue;
+            }
+            addDep(it->second.writer);
+            if (access.second) {
+                for (auto& reader : it->second.readers) {
+                    addDep(reader);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < deps.size(); i += HSA_BARRIER_DEP_SIGNAL_CNT) {
+            int count = std::min<size_t>(HSA_BARRIER_DEP_SIGNAL_CNT, deps.size() - i);
+            DBOUT(DB_CMD, "buffer hazards: enqueue barrier on " << count << " ops\n");
+            EnqueueMarkerWithDependency(count, &deps[i], HCC_OPT_FLUSH ? hc::no_scope : hc::system_scope);
+            countEvent(Kalmar::hcCounterBufferBarrier);
+        }
+    }
+
+    // Kernels of an any-order queue depend on the hazards, and host copies
+    // wait for them on any-order queues and unified devices.  Otherwise the
+    // queue orders its commands by itself and nothing reads the records.
+    bool tracksBufferAccesses() {
+        return (get_execute_order() == execute_any_order) || getDev()->is_unified();
+    }
+
+    void recordBufferAccesses(HSADispatch* dispatch, const std::shared_ptr<KalmarAsyncOp>& op) {
+        if (!tracksBufferAccesses()) {
+            return;
+        }
+        for (auto& access : dispatch->getBufferAccesses()) {
+            BufferAccess& b = bufferAccess[access.first];
+            if (access.second) {
+                b.writer = op;
+                b.readers.clear();
+            } else {
+                // forget the readers which have completed
+                b.readers.erase(std::remove_if(b.readers.begin(), b.readers.end(),
+                                               [] (const std::weak_ptr<KalmarAsyncOp>& r) { return pendingOp(r) == nullptr; }),
+                                b.readers.end());
+                b.readers.push_back(op);
+            }
+        }
+
+        if (bufferAccess.size() >= bufferAccessPruneSize) {
+            pruneBufferAccesses();
+        }
+    }
+
+    // forget the buffers whose writer and readers have all completed, such as
+    // the buffers freed since their last kernel
+    void pruneBufferAccesses() {
+        for (auto it = bufferAccess.begin(); it != bufferAccess.end(); ) {
+            BufferAccess& b = it->second;
+            bool pending = (pendingOp(b.writer) != nullptr) ||
+                           std::any_of(b.readers.begin(), b.readers.end(),
+                                       [] (const std::weak_ptr<KalmarAsyncOp>& r) { return pendingOp(r) != nullptr; });
+            it = pending ? std::next(it) : bufferAccess.erase(it);
+        }
+        bufferAccessPruneSize = std::max<size_t>(64, 2 * bufferAccess.size());
+    }
+
+    // wait for the kernels @buffer has a hazard with: its writer, and its
+    // readers too if the host is going to write it (@modify)
+    void waitForDependentAsyncOps(void* buffer, bool modify = true) {
+        auto it = bufferAccess.find(buffer);
+        if (it == bufferAccess.end()) {
+            return;
+        }
+        auto waitOp = [] (const std::weak_ptr<KalmarAsyncOp>& op) {
+            std::shared_ptr<KalmarAsyncOp> p = pendingOp(op);
             // wait on valid futures only
-            std::shared_future<void>* future = dependentAsyncOpPointer->getFuture();
-            if (future->valid()) {
-              future->wait();
+            if (p && p->getFuture()->valid()) {
+                p->getFuture()->wait();
             }
-          }
+        };
+        waitOp(it->second.writer);
+        if (modify) {
+            for (auto& reader : it->second.readers) {
+                waitOp(reader);
+            }
+            // nothing pending on the buffer any more
+            bufferAccess.erase(it);
+        } else {
+            it->second.writer.reset();
         }
-        dependentAsyncOpVector.clear();
+    }
 
+
+    // Copies of array and array_view buffers are commands of the queue: they
+    // are ordered after the commands already enqueued by the stream
+    // dependencies (see detectStreamDeps), like kernels, and do not wait on
+    // the host.  Kernels of an any-order queue are not ordered though, and
+    // a unified device accesses buffers with host copies, so those still
+    // wait for the kernels writing the buffer.
+    void waitForBufferCopyDeps(void* buffer, bool modify) {
+        if (getDev()->is_unified() || (get_execute_order() == execute_any_order)) {
+            waitForDependentAsyncOps(buffer, modify);
+        }
     }
 
+    // Make host memory accessible to the device for a copy, and return the
+    // pointer the copy engine has to use.  The memory stays locked until the
+    // matching unlockHostMemory(); @cached tells whether the device's pinned
+    // host cache holds the lock.
+    void* lockHostMemory(const void* host, size_t size, bool* cached);
 
-    void sync_copy(void* dst, hsa_agent_t dst_agent,
-                   const void* src, hsa_agent_t src_agent,
-                   size_t size) {
+    void unlockHostMemory(const void* host, bool cached);
 
-#if KALMAR_DEBUG
-      dumpHSAAgentInfo(src_agent, "sync_copy source agent");
-      dumpHSAAgentInfo(dst_agent, "sync_copy destination agent");
-#endif
+    // Start of the allocation holding the device buffer @p ptr, which
+    // hsa_amd_agents_allow_access requires: the slab of small buffers.
+    void* deviceAllocationOf(void* ptr);
 
-      hsa_status_t status;
-      hsa_signal_store_relaxed(sync_copy_signal, 1);
-      status = hsa_amd_memory_async_copy(dst, dst_agent,
-                                          src, src_agent,
-                                          size, 0, nullptr, sync_copy_signal);
-      STATUS_CHECK(status, __LINE__);
-      hsa_signal_wait_acquire(sync_copy_signal, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX, HSA_WAIT_STATE_BLOCKED);
-      return;
+    // enqueue a copy from or to a buffer of this queue
+    // @lockedHost: host pointer passed to lockHostMemory() for the copy, if any
+    // @cached: the lock is held by the pinned host cache
+    std::shared_ptr<KalmarAsyncOp> enqueueBufferCopy(void* dst, bool dstInDeviceMem,
+                                                     const void* src, bool srcInDeviceMem,
+                                                     size_t count, const void* lockedHost,
+                                                     bool cached = false) {
+        hc::accelerator acc;
+        hc::AmPointerInfo srcPtrInfo(const_cast<void*>(src), const_cast<void*>(src), count, acc, srcInDeviceMem);
+        hc::AmPointerInfo dstPtrInfo(dst, dst, count, acc, dstInDeviceMem);
+
+        std::shared_ptr<HSACopy> copyCommand = std::make_shared<HSACopy>(this, src, dst, count);
+        copyCommand->setLockedHost(lockedHost, cached);
+
+        hsa_status_t status = copyCommand->enqueueAsyncCopyCommand(getHSADev(), srcPtrInfo, dstPtrInfo);
+        STATUS_CHECK(status, __LINE__);
+
+        pushAsyncOp(copyCommand);
+
+        return copyCommand;
     }
 
     void read(void* device, void* dst, size_t count, size_t offset) override {
-        waitForDependentAsyncOps(device);
+        waitForBufferCopyDeps(device, false);
         releaseToSystemIfNeeded();
 
         // do read
@@ -1321,29 +1660,16 @@ public:
 #if KALMAR_DEBUG
                 std::cerr << "read(" << device << "," << dst << "," << count << "," << offset << "): use HSA memory copy\n";
 #endif
-                hsa_status_t status = HSA_STATUS_SUCCESS;
                 // Make sure host memory is accessible to gpu
-                // FIXME: host memory is allocated through OS allocator, if not, correct it.
                 // dst--host buffer might be allocated through either OS allocator or hsa allocator.
                 // Things become complicated, we may need some query API to query the pointer info, i.e.
                 // allocator info. Same as write.
-                hsa_agent_t* agent = static_cast<hsa_agent_t*>(getHSAAgent());
-                void* va = nullptr;
-                status = hsa_amd_memory_lock(dst, count, agent, 1, &va);
-                // TODO: If host buffer is not allocated through OS allocator, so far, lock
-                // API will return nullptr to va, this is not specified in the spec, but will use it to
-                // check if host buffer is allocated by hsa allocator
-                if(va == NULL || status != HSA_STATUS_SUCCESS)
-                {
-                    status = hsa_amd_agents_allow_access(1, agent, NULL, dst);
-                    STATUS_CHECK(status, __LINE__);
-                    va = dst;
-                }
+                bool cached;
+                void* va = lockHostMemory(dst, count, &cached);
+                auto copyOp = enqueueBufferCopy(va, false, (char*)device + offset, true, count, dst, cached);
 
-                sync_copy(va, *static_cast<hsa_agent_t*>(getHostAgent()),  (char*)device + offset, *static_cast<hsa_agent_t*>(getHSAAgent()), count);
-
-                // Unlock the host memory
-                status = hsa_amd_memory_unlock(dst);
+                // the caller uses the data on return
+                copyOp->getFuture()->wait();
             } else {
 #if KALMAR_DEBUG
                 std::cerr << "read(" << device << "," << dst << "," << count << "," << offset << "): use host memory copy\n";
@@ -1353,8 +1679,12 @@ public:
         }
     }
 
+    // A non-blocking write returns once the copy is enqueued, @src must stay
+    // valid until the queue is waited on.  This is the case of the
+    // serialization stage, which writes the host data of array_views used by
+    // a kernel.
     void write(void* device, const void* src, size_t count, size_t offset, bool blocking) override {
-        waitForDependentAsyncOps(device);
+        waitForBufferCopyDeps(device, true);
         releaseToSystemIfNeeded(); // may not be needed.
 
         // do write
@@ -1363,24 +1693,14 @@ public:
 #if KALMAR_DEBUG
                 std::cerr << "write(" << device << "," << src << "," << count << "," << offset << "," << blocking << "): use HSA memory copy\n";
 #endif
-                hsa_status_t status = HSA_STATUS_SUCCESS;
                 // Make sure host memory is accessible to gpu
-                // FIXME: host memory is allocated through OS allocator, if not, correct it.
-                hsa_agent_t* agent = static_cast<hsa_agent_t*>(getHSAAgent());
-                const void* va = nullptr;
-                status = hsa_amd_memory_lock(const_cast<void*>(src), count, agent, 1, (void**)&va);
+                bool cached;
+                const void* va = lockHostMemory(src, count, &cached);
+                auto copyOp = enqueueBufferCopy(((char*)device) + offset, true, va, false, count, src, cached);
 
-                if(va == NULL || status != HSA_STATUS_SUCCESS)
-                {
-                    status = hsa_amd_agents_allow_access(1, agent, NULL, src);
-                    STATUS_CHECK(status, __LINE__);
-                    va = src;
+                if (blocking) {
+                    copyOp->getFuture()->wait();
                 }
-                sync_copy(((char*)device) + offset,  *agent, va,    *static_cast<hsa_agent_t*>(getHostAgent()), count);
-
-                STATUS_CHECK(status, __LINE__);
-                // Unlock the host memory
-                status = hsa_amd_memory_unlock(const_cast<void*>(src));
             } else {
 #if KALMAR_DEBUG
                 std::cerr << "write(" << device << "," << src << "," << count << "," << offset << "," << blocking << "): use host memory copy\n";
@@ -1394,8 +1714,8 @@ public:
 
     //FIXME: this API doesn't work in the P2P world because we don't who the source agent is!!!
     void copy(void* src, void* dst, size_t count, size_t src_offset, size_t dst_offset, bool blocking) override {
-        waitForDependentAsyncOps(dst);
-        waitForDependentAsyncOps(src);
+        waitForBufferCopyDeps(dst, true);
+        waitForBufferCopyDeps(src, false);
         releaseToSystemIfNeeded();
 
         // do copy
@@ -1407,10 +1727,13 @@ public:
                 hsa_status_t status = HSA_STATUS_SUCCESS;
                 // FIXME: aftre p2p enabled, if this function is not expected to copy between two buffers from different device, then, delete allow_access API call.
                 hsa_agent_t* agent = static_cast<hsa_agent_t*>(getHSAAgent());
-                status = hsa_amd_agents_allow_access(1, agent, NULL, src);
-                STATUS_CHECK(status, __LINE__);
-                status = hsa_memory_copy((char*)dst + dst_offset, (char*)src + src_offset, count);
+                status = hsa_amd_agents_allow_access(1, agent, NULL, deviceAllocationOf(src));
                 STATUS_CHECK(status, __LINE__);
+                auto copyOp = enqueueBufferCopy((char*)dst + dst_offset, true, (char*)src + src_offset, true, count, nullptr);
+
+                if (blocking) {
+                    copyOp->getFuture()->wait();
+                }
             } else {
 #if KALMAR_DEBUG
                 std::cerr << "copy(" << src << "," << dst << "," << count << "," << src_offset << "," << dst_offset << "," << blocking << "): use host memory copy\n";
@@ -1424,7 +1747,7 @@ public:
 #if KALMAR_DEBUG
         dumpHSAAgentInfo(*static_cast<hsa_agent_t*>(getHSAAgent()), "map(...)");
 #endif
-        waitForDependentAsyncOps(device);
+        waitForBufferCopyDeps(device, modify);
         releaseToSystemIfNeeded();
 
         // do map
@@ -1456,7 +1779,7 @@ public:
                 std::wcerr << getDev()->get_path();
                 std::cerr << ": map() copy device buffer to host buffer\n";
 #endif
-                sync_copy(data, *static_cast<hsa_agent_t*>(getHostAgent()), ((char*)device) + offset, *agent, count);
+                enqueueBufferCopy(data, false, ((char*)device) + offset, true, count, nullptr)->getFuture()->wait();
 #if KALMAR_DEBUG
                 std::wcerr << getDev()->get_path();
                 std::cerr << ": map() copy done\n";
@@ -1503,11 +1826,8 @@ public:
                 std::wcerr << getDev()->get_path();
                 std::cerr << ": unmap() copy host buffer to device buffer\n";
 #endif
-                // copy data from host buffer to device buffer
-                hsa_status_t status = HSA_STATUS_SUCCESS;
-
-                hsa_agent_t* agent = static_cast<hsa_agent_t*>(getHSAAgent());
-                sync_copy(((char*)device) + offset, *agent, addr, *static_cast<hsa_agent_t*>(getHostAgent()), count);
+                // copy data from host buffer to device buffer, before it is freed below
+                enqueueBufferCopy(((char*)device) + offset, true, addr, false, count, nullptr)->getFuture()->wait();
 #if KALMAR_DEBUG
                 std::wcerr << getDev()->get_path();
                 std::cerr << ": unmap() copy done\n";
@@ -1528,12 +1848,9 @@ public:
     void Push(void *kernel, int idx, void *device, bool modify) override {
         PushArgImpl(kernel, idx, sizeof(void*), &device);
 
-        // register the buffer with the kernel
-        // when the buffer may be read/written by the kernel
-        // the buffer is not registered if it's only read by the kernel
-        if (modify) {
-          kernelBufferMap[kernel].push_back(device);
-        }
+        // register the buffer with the kernel, reads are tracked as well
+        // since a later write has to wait for them
+        reinterpret_cast<HSADispatch*>(kernel)->addBufferAccess(device, modify);
     }
 
     void* getHSAQueue() override {
@@ -1567,6 +1884,23 @@ public:
 
     void ring_doorbell() override;
 
+    void begin_batch(uint32_t maxPackets, uint32_t maxMicroseconds) override;
+
+    void end_batch() override;
+
+    // Called with the rocr queue locked, after the packet at @p index was
+    // written and published with the write index.  Rings the doorbell unless
+    // the coalescing policy holds the packet back.
+    void packetWritten(hsa_queue_t *lockedHsaQueue, uint64_t index, bool deferred);
+
+    // Ring the doorbell up to @p index, which also releases every older packet
+    // held back.  Called with the rocr queue locked.
+    void ringDoorbell(hsa_queue_t *lockedHsaQueue, uint64_t index);
+
+    // Ring the doorbell for the packets held back, if any.  Called with the
+    // rocr queue locked.
+    void ringPendingDoorbell();
+
     bool set_cu_mask(const std::vector<bool>& cu_mask) override {
         // get device's total compute unit count
         auto device = getDev();
@@ -1608,6 +1942,54 @@ public:
     }
 
     // enqueue a barrier packet
+    void* allocAsync(size_t size_bytes) override {
+        if (size_bytes == 0) {
+            return nullptr;
+        }
+        return streamPool->allocate(size_bytes, get_execute_order() == execute_in_order);
+    }
+
+    void freeAsync(void* ptr) override {
+        if (ptr == nullptr) {
+            return;
+        }
+
+        // The commands enqueued so far complete with the youngest one in an
+        // in-order queue.  Otherwise nothing orders the packets of the queue
+        // (barrier-AND packets carry no barrier bit), so markers depend on
+        // every pending command, HSA_BARRIER_DEP_SIGNAL_CNT per packet, each
+        // marker after the first depending on the previous one.
+        std::shared_ptr<KalmarAsyncOp> event;
+        if (get_execute_order() == execute_in_order) {
+            for (int i = asyncOps.size()-1; i >= 0 && !event; i--) {
+                event = asyncOps[i];
+            }
+        } else {
+            std::vector< std::shared_ptr<KalmarAsyncOp> > pending;
+            for (auto& op : asyncOps) {
+                if (op && !op->isReady()) {
+                    pending.push_back(op);
+                }
+            }
+            size_t i = 0;
+            while (i < pending.size()) {
+                std::shared_ptr<KalmarAsyncOp> deps[HSA_BARRIER_DEP_SIGNAL_CNT];
+                int count = 0;
+                if (event) {
+                    deps[count++] = event;
+                }
+                while ((count < HSA_BARRIER_DEP_SIGNAL_CNT) && (i < pending.size())) {
+                    deps[count++] = pending[i++];
+                }
+                event = EnqueueMarkerWithDependency(count, deps, hc::no_scope);
+            }
+        }
+
+        if (!streamPool->release(ptr, event)) {
+            throw Kalmar::runtime_exception("free_async of a pointer not allocated with alloc_async on this accelerator_view", 0);
+        }
+    }
+
     std::shared_ptr<KalmarAsyncOp> EnqueueMarker(memory_scope release_scope) override {
 
         hsa_status_t status = HSA_STATUS_SUCCESS;
@@ -1768,6 +2150,93 @@ hsa_status_t RocrQueue::setCuMask(HSAQueue *hccQueue) {
 }
 
 
+// HwQueueScheduler backend assigning the RocrQueues of a device to its HSAQueues.
+struct HsaQueueBackend {
+    typedef RocrQueue Queue;
+    typedef HSAQueue Owner;
+
+    hsa_agent_t agent;
+    size_t queueSize;
+
+    RocrQueue* create(int priority, HSAQueue* owner) {
+        RocrQueue* rq = new RocrQueue(agent, queueSize, owner, queue_priority(priority), owner->get_queue_deadline());
+        DBOUT(DB_QUEUE, "Create new rocrQueue=" << rq << " for thief=" << owner << "\n")
+        return rq;
+    }
+
+    void destroy(RocrQueue* rq) {
+        delete rq; // this will delete the HSA HW queue.
+    }
+
+    void setPriority(RocrQueue* rq, int priority) {
+        rq->setPriority(queue_priority(priority));
+    }
+
+    void assign(RocrQueue* rq, HSAQueue* owner) {
+        DBOUT(DB_QUEUE, "Assign rocrQueue=" << rq << " to hccQueue=" << owner << ".  hwQueue=" << rq->_hwQueue << "\n")
+        rq->assignHccQueue(owner);
+    }
+
+    // the victim may be waiting for a queue itself while holding its lock,
+    // or stealing from the thief: only try the lock
+    bool tryDetach(RocrQueue* rq, HSAQueue* victim) {
+        if (!victim->qmutex.try_lock()) {
+            return false;
+        }
+        std::lock_guard<std::mutex> l(victim->qmutex, std::adopt_lock);
+
+        // packets held back by a batch would never complete and keep the
+        // victim busy forever
+        victim->ringPendingDoorbell();
+        if (!victim->isEmpty()) {
+            return false;
+        }
+        assert (victim->rocrQueue == rq);  // ensure the link is consistent.
+        victim->rocrQueue = nullptr;
+        rq->_hccQueue = nullptr;
+        DBOUT(DB_QUEUE, "Stole rocrQueue=" << rq << " from victimHccQueue=" << victim << "\n")
+        Kalmar::traceInstant(Kalmar::TraceQueueSteal, "queue steal", victim->queueSeqNum, rq->_hwQueue->id);
+        victim->countEvent(Kalmar::hcCounterQueueSteal);
+        return true;
+    }
+};
+
+typedef Kalmar::HwQueueScheduler<HsaQueueBackend> HsaQueueScheduler;
+
+
+// Slabs of the small buffers of HSADevice::create, from the device memory
+// pool or from host memory on unified devices
+struct HsaSlabBackend {
+    hsa_agent_t agent;
+    hsa_amd_memory_pool_t pool;
+    bool unified;
+
+    void* allocate(size_t size) {
+        if (unified) {
+            return kalmar_aligned_alloc(0x1000, size);
+        }
+        void* ptr = nullptr;
+        if (hsa_amd_memory_pool_allocate(pool, size, 0, &ptr) != HSA_STATUS_SUCCESS) {
+            return nullptr;
+        }
+        if (hsa_amd_agents_allow_access(1, &agent, NULL, ptr) != HSA_STATUS_SUCCESS) {
+            hsa_amd_memory_pool_free(ptr);
+            return nullptr;
+        }
+        return ptr;
+    }
+    void free(void* ptr) {
+        if (unified) {
+            kalmar_aligned_free(ptr);
+        } else {
+            hsa_amd_memory_pool_free(ptr);
+        }
+    }
+};
+
+typedef Kalmar::SlabAllocator<HsaSlabBackend> HsaSlabAllocator;
+
+
 class HSADevice final : public KalmarDevice
 {
     friend std::ostream& operator<<(std::ostream& os, const HSAQueue & hav);
@@ -1787,8 +2256,11 @@ private:
     std::mutex queues_mutex; // protects access to the queues vector:
     std::vector< std::weak_ptr<KalmarQueue> > queues;
 
-    std::mutex                  rocrQueuesMutex; // protects rocrQueues
-    std::vector< RocrQueue *>    rocrQueues[3];
+    // assigns the hardware queues to the HSAQueues, up to HCC_MAX_QUEUES per priority
+    HsaQueueScheduler           *queueScheduler;
+
+    // buffers of create() up to HCC_SLAB_MAX_SIZE
+    HsaSlabAllocator            *slabs;
 
     pool_iterator ri;
 
@@ -1822,98 +2294,33 @@ public:
     class UnpinnedCopyEngine      *copy_engine[2]; // one for each direction.
     UnpinnedCopyEngine::CopyMode  copy_mode;
 
-    // Creates or steals a rocrQueue and returns it in theif->rocrQueue
-    void createOrstealRocrQueue(Kalmar::HSAQueue *thief, queue_priority priority = priority_normal, uint64_t deadline = -1) {
-        
-        std::lock_guard<std::mutex> (this->rocrQueuesMutex);
-
-        if (rocrQueues[priority].size() < HCC_MAX_QUEUES) {
-
-        	// TODO: Do we want the max queues for each priority to be different?
-            // Allocate a new queue, we are belowthe HCC_MAX_QUEUES limit :
-            //
-
-            RocrQueue *foundRQ = new RocrQueue(agent, this->queue_size, thief, priority, deadline);
+    // Host memory ranges kept pinned for copies, shared by the queues and copy engines of the device.
+    HsaPinnedHostCache            *pinnedHostCache;
 
-            rocrQueues[priority].push_back(foundRQ);
+    // Helper threads of the copy engines, may be NULL.
+    Kalmar::CopyWorkerPool        *stagingPackers;
 
-            DBOUT(DB_QUEUE, "Create new rocrQueue=" << foundRQ << " for thief=" << thief << "\n")
+    // Runtime events of the device, its queues and its copy engines.
+    Kalmar::RuntimeCounters       counters;
 
-        } else {
-            RocrQueue *foundRQ = nullptr;
-            while (!foundRQ) {
-                // First make a pass to see if we can find an unused queue:
-                for (auto rq : rocrQueues[priority]) {
-                    if (rq->_hccQueue == nullptr) {
-                        DBOUT(DB_QUEUE, "Found unused rocrQueue=" << rq << " for thief=" << thief << ".  hwQueue=" << rq->_hwQueue << "\n")
-                        foundRQ = rq;
-                        break;
-                    }
-                } 
-                if (!foundRQ) {
-                    for (auto rq : rocrQueues[priority]) {
-                        if (rq->_hccQueue != thief)  {
-                            auto victimHccQueue = rq->_hccQueue;
-                            // victimHccQueue==nullptr should be detected by above loop.
-                            std::lock_guard<std::mutex> (victimHccQueue->qmutex);
-                            if (victimHccQueue->isEmpty()) {
-                                DBOUT(DB_LOCK, " ptr:" << this << " lock_guard...\n");
-
-                                assert (victimHccQueue->rocrQueue == rq);  // ensure the link is consistent.
-                                victimHccQueue->rocrQueue = nullptr; 
-                                foundRQ = rq;
-                                DBOUT(DB_QUEUE, "Stole existing rocrQueue=" << rq << " from victimHccQueue=" << victimHccQueue << " to hccQueue=" << thief << "\n")
-                                break;
-                            }
-                        }
-                    }
-                }
-                if (foundRQ) {
-                    
-                    // update the queue pointers to indicate the theft:
-                    foundRQ->assignHccQueue(thief);
-
-                    break; // while !foundVictim
-                };
-
-                // Allow other threads a small window to release threads to make progress:
-                this->rocrQueuesMutex.unlock();
-                this->rocrQueuesMutex.lock();
-            }
-
-        }
+    // Creates or steals a rocrQueue and returns it in theif->rocrQueue.
+    // Blocks until one is available, see HwQueueScheduler.
+    void createOrstealRocrQueue(Kalmar::HSAQueue *thief, queue_priority priority = priority_normal) {
+        RocrQueue *foundRQ = queueScheduler->acquire(thief, priority);
+        DBOUT(DB_QUEUE, "rocrQueue=" << foundRQ << " assigned to thief=" << thief << "\n")
     };
 
-    void removeRocrQueue(RocrQueue *rocrQueue) {
+    void removeRocrQueue(RocrQueue *rocrQueue, Kalmar::HSAQueue *hccQueue) {
 
         // queues already locked:
         size_t hccSize = queues.size();
 
-        { 
-            std::lock_guard<std::mutex> (this->rocrQueuesMutex);
-
-            // a perf optimization to keep the HSA queue if we have more HCC queues that might want it.
-            // This defers expensive queue deallocation if an hccQueue that holds an hwQueue is destroyed - 
-            // keep the hwqueue around until the number of hccQueues drops below the number of hwQueues
-            // we have already allocated.
-			// TODO: Do we want to track HCC queues independently for each priority?
-			// Or maybe modify queue stealing to steal unused HSA queue from other priority pools &
-			// change priority as required?
-			auto rqSize = rocrQueues[0].size()+rocrQueues[1].size()+rocrQueues[2].size();
-            if (hccSize < rqSize)  {
-            	queue_priority priority = rocrQueue->_priority;
-                auto iter = std::find(rocrQueues[priority].begin(), rocrQueues[priority].end(), rocrQueue);
-                assert (iter != rocrQueues[priority].end()); 
-                // Remove the pointer from the list:
-                rocrQueues[priority].erase(iter);
-                DBOUT(DB_QUEUE, "removeRocrQueue-hard: rocrQueue=" << rocrQueue << " hccQueues/rocrQueues=" << hccSize << "/" << rqSize << "\n")
-                delete rocrQueue; // this will delete the HSA HW queue.
-            } else {
-                DBOUT(DB_QUEUE, "removeRocrQueue-soft: rocrQueue=" << rocrQueue << " keep hwQUeue, set _hccQueue link to nullptr" << " hccQueues/rocrQueues=" << hccSize << "/" << rqSize << "\n");
-                rocrQueue->_hccQueue = nullptr; // mark it as available.
-            }
-        }
-
+        // a perf optimization to keep the HSA queue if we have more HCC queues that might want it.
+        // This defers expensive queue deallocation if an hccQueue that holds an hwQueue is destroyed -
+        // keep the hwqueue around until the number of hccQueues drops below the number of hwQueues
+        // we have already allocated.
+        DBOUT(DB_QUEUE, "removeRocrQueue: rocrQueue=" << rocrQueue << " hccQueues=" << hccSize << "\n")
+        queueScheduler->release(rocrQueue, hccQueue, hccSize);
     };
 
 
@@ -2076,6 +2483,13 @@ public:
         queues.clear();
         queues_mutex.unlock();
 
+        // the disposed queues have released their hardware queues
+        delete queueScheduler;
+        queueScheduler = nullptr;
+
+        delete slabs;
+        slabs = nullptr;
+
         // deallocate kernarg buffers in the pool
 #if KERNARG_POOL_SIZE > 0
         kernargPoolMutex.lock();
@@ -2113,6 +2527,16 @@ public:
             }
         }
 
+        // after the copy engines, which release their ranges in it
+        if (pinnedHostCache) {
+            delete pinnedHostCache;
+            pinnedHostCache = NULL;
+        }
+        if (stagingPackers) {
+            delete stagingPackers;
+            stagingPackers = NULL;
+        }
+
 
         DBOUT(DB_INIT, "HSADevice::~HSADevice() out\n");
     }
@@ -2134,8 +2558,18 @@ public:
 
     bool has_cpu_accessible_am() const override { return cpu_accessible_am; }
 
+    // the slab of @p ptr if it is a buffer of create() carved out of one,
+    // nullptr otherwise
+    void* slabOf(const void* ptr) {
+        return slabs ? slabs->slabOf(ptr) : nullptr;
+    }
+
     void* create(size_t count, struct rw_info* key) override {
-        void *data = nullptr;
+        void *data = slabs->allocate(count);
+        if (data != nullptr) {
+            DBOUT(DB_INIT, "create(" << count << "," << key << "): from slab -> " << data << "\n");
+            return data;
+        }
 
         if (!is_unified()) {
 #if KALMAR_DEBUG
@@ -2169,7 +2603,9 @@ public:
 
     void release(void *ptr, struct rw_info* key ) override {
         hsa_status_t status = HSA_STATUS_SUCCESS;
-        if (!is_unified()) {
+        if (slabs && slabs->free(ptr)) {
+            DBOUT(DB_INIT, "release(" << ptr << "," << key << "): to slab\n");
+        } else if (!is_unified()) {
             DBOUT(DB_INIT, "release(" << ptr << "," << key << "): use HSA memory deallocator\n");
             status = hsa_amd_memory_pool_free(ptr);
             STATUS_CHECK(status, __LINE__);
@@ -2401,6 +2837,22 @@ public:
         return cpu_accessible_am;
     };
 
+    void invalidatePinnedHost(const void* ptr, size_t size) override {
+        if (pinnedHostCache) {
+            pinnedHostCache->invalidate(ptr, size);
+        }
+    }
+
+    Kalmar::RuntimeCounterValues getRuntimeCounters() override;
+
+    bool getPinnedHostStats(Kalmar::PinnedHostCacheStats* stats) override {
+        if (pinnedHostCache) {
+            *stats = pinnedHostCache->getStats();
+            return true;
+        }
+        return false;
+    }
+
     void releaseKernargBuffer(void* kernargBuffer, int kernargBufferIndex) {
         if ( (KERNARG_POOL_SIZE > 0) && (kernargBufferIndex >= 0) ) {
             kernargPoolMutex.lock();
@@ -2475,6 +2927,8 @@ public:
                     assert(oldKernargPoolSize == oldKernargPoolFlagSize);
 
                     DBOUTL(DB_RESOURCE, "Growing kernarg pool from " << kernargPool.size() << " to " << kernargPool.size() + KERNARG_POOL_SIZE);
+                    Kalmar::TraceScope trace(Kalmar::TracePoolGrowth, "kernarg pool growth", kernargPool.size() + KERNARG_POOL_SIZE);
+                    counters.add(Kalmar::hcCounterKernargPoolGrowth);
 
                     // pre-allocate kernarg buffers
                     void* kernargMemory = nullptr;
@@ -2529,6 +2983,8 @@ public:
             STATUS_CHECK(status, __LINE__);
 
             DBOUTL(DB_RESOURCE, "Allocating non-pool kernarg buffer size=" << size );
+            Kalmar::traceInstant(Kalmar::TracePoolGrowth, "non-pool kernarg buffer", size);
+            counters.add(Kalmar::hcCounterKernargNonPool);
 
             // set cursor value as -1 to notice the buffer would be deallocated
             // instead of recycled back into the pool
@@ -2672,9 +3128,23 @@ static void hccgetenv(const char *var_name, T *var, const char *usage)
     };
 }
 
+static void hccgetenv(const char *var_name, std::string *var, const char *usage)
+{
+    char * env = getenv(var_name);
+
+    if (env != NULL) {
+        *var = env;
+    }
+
+    if (HCC_PRINT_ENV) {
+        std::cout << std::left << std::setw(30) << var_name << " = " << *var << " : " << usage << std::endl;
+    };
+}
+
 // Helper function to return environment var:
 // Handles signed int or long int types, note call to strol above:
 #define GET_ENV_INT(envVar, usage)  hccgetenv (#envVar, &envVar, usage)
+#define GET_ENV_STRING(envVar, usage)  hccgetenv (#envVar, &envVar, usage)
 
 
 // Global free function to read HCC_ENV vars.  Really this should be called once per process not once-per-event.
@@ -2694,11 +3164,20 @@ void ReadHccEnv()
 
     GET_ENV_INT(HCC_DB, "Enable HCC trace debug");
 
+    // HCC_TRACE, HCC_TRACE_BUFFER, HCC_TRACE_SIGNAL: binary trace of the runtime events, see kalmar_trace.h
+    Kalmar::Tracer::get();
+    // HCC_PROFILE, HCC_PROFILE_FILE: kernel and copy profile reported at exit, see kalmar_profiler.h
+    Kalmar::KernelProfiler::get();
+
     GET_ENV_INT(HCC_OPT_FLUSH, "Perform system-scope acquire/release only at CPU sync boundaries (rather than after each kernel)");
     GET_ENV_INT(HCC_MAX_QUEUES, "Set max number of HSA queues this process will use.  accelerator_views will share the allotted queues and steal from each other as necessary");
+    GET_ENV_STRING(HCC_HSA_RUNTIME, "HSA runtime to use. mock=CPU emulation without a GPU, for testing and profiling the host side of the runtime: kernels are not run");
+    GET_ENV_INT(HCC_MOCK_KERNEL_US, "Time in microseconds kernel dispatches take with HCC_HSA_RUNTIME=mock");
+    GET_ENV_INT(HCC_QUEUE_BORROW, "1=accelerator_views may use HSA queues of another priority when all queues of their own priority are busy, never taking one from a higher priority view");
 
 
-    GET_ENV_INT(HCC_UNPINNED_COPY_MODE, "Select algorithm for unpinned copies. 0=ChooseBest(see thresholds), 1=PinInPlace, 2=StagingBuffer, 3=Memcpy");
+    GET_ENV_INT(HCC_UNPINNED_COPY_MODE, "Select algorithm for unpinned copies. 0=ChooseBest(see thresholds), 1=PinInPlace, 2=StagingBuffer, 3=Memcpy, 4=Calibrated(fastest measured for the size when the device is created, about a second without HCC_COPY_PROFILE)");
+    GET_ENV_STRING(HCC_COPY_PROFILE, "File to load the measurements of HCC_UNPINNED_COPY_MODE=4 from, or to save them to after measuring them once. Debug output with HCC_DB=0x100");
 
     GET_ENV_INT(HCC_CHECK_COPY, "Check dst == src after each copy operation.  Only works on large-bar systems.");
 
@@ -2707,12 +3186,30 @@ void ReadHccEnv()
     GET_ENV_INT (HCC_H2D_STAGING_THRESHOLD,    "Min size (in KB) to use staging buffer algorithm for H2D copy if ChooseBest algorithm selected");
     GET_ENV_INT (HCC_H2D_PININPLACE_THRESHOLD, "Min size (in KB) to use pin-in-place algorithm for H2D copy if ChooseBest algorithm selected");
     GET_ENV_INT (HCC_D2H_PININPLACE_THRESHOLD, "Min size (in KB) to use pin-in-place for D2H copy if ChooseBest algorithm selected");
+
+    GET_ENV_INT (HCC_PIN_CACHE_SIZE, "Max size (in MB) of host memory kept pinned for later copies, per device; the application must call am_memory_host_cache_invalidate before freeing copied memory. 0=unpin when copies complete (default), -1=disable cache");
+    GET_ENV_INT (HCC_SLAB_MAX_SIZE, "Max size (in KB) of the array buffers sub-allocated from larger slabs of memory, per device including the cpu accelerator, at most 64. 0=allocate each buffer on its own");
+    GET_ENV_INT (HCC_ASYNC_POOL_SIZE, "Max size (in MB) of the memory released with free_async kept for alloc_async, per accelerator_view");
+    GET_ENV_INT (HCC_AM_CACHE_SIZE, "Max size (in MB) of the memory freed with am_free kept for later am_alloc calls. 0=disable cache (default)");
+    GET_ENV_INT (HCC_AM_SLAB_MAX_SIZE, "Max size (in KB) of the device memory blocks of am_alloc sub-allocated from larger slabs, at most 64. 0=allocate each block on its own (default)");
+
+    GET_ENV_INT (HCC_STAGING_BUFFER_SIZE,  "Size (in KB) of each staging buffer used for unpinned copies. 0=64KB, or 1MB with HCC_STAGING_PACK_THREADS (default)");
+    GET_ENV_INT (HCC_STAGING_BUFFER_COUNT, "Number of staging buffers in each staging ring, max 16");
+    GET_ENV_INT (HCC_STAGING_RINGS,        "Number of staging rings per device and direction, ie copies which can use staging buffers concurrently, max 16");
+    GET_ENV_INT (HCC_STAGING_PACK_THREADS, "Number of helper threads splitting the CPU copies of each staging buffer, per device. 0=copy on the calling thread");
+
+    GET_ENV_INT (HCC_WAIT_MODE,     "Wait mode of blocked waits on new accelerator_views. 0=blocked, 2=adaptive(spin, yield, then block)");
+    GET_ENV_INT (HCC_WAIT_SPIN_US,  "Max time (in us) an adaptive wait spins, waits known to take longer do not spin");
+    GET_ENV_INT (HCC_WAIT_YIELD_US, "Time (in us) an adaptive wait yields the core after spinning, before blocking");
 };
 
 class HSAContext final : public KalmarContext
 {
 public:
     std::map<uint64_t, HSADevice *> agentToDeviceMap_;
+
+    // Runtime events of the resources shared by the devices: the signal pool.
+    Kalmar::RuntimeCounters counters;
 private:
     /// memory pool for signals
     std::vector<hsa_signal_t> signalPool;
@@ -2792,6 +3289,14 @@ public:
 
         ReadHccEnv();
 
+        // the cpu accelerator is created by KalmarContext, before the settings are read
+        static_cast<CPUDevice*>(Devices[0])->setSlabMaxSize(HCC_SLAB_MAX_SIZE > 0 ? size_t(HCC_SLAB_MAX_SIZE) * 1024 : 0);
+
+        if (HCC_HSA_RUNTIME == "mock") {
+            DBOUT(DB_INIT, "HSAContext::HSAContext(): using the mock HSA runtime\n");
+            Kalmar::useMockHsaApi(HCC_MOCK_KERNEL_US);
+        }
+
         // initialize HSA runtime
         
         DBOUT(DB_INIT,"HSAContext::HSAContext(): init HSA runtime");
@@ -2912,6 +3417,8 @@ public:
                 assert(oldSignalPoolSize == oldSignalPoolFlagSize);
 
                 DBOUTL(DB_RESOURCE, "Growing signal pool from " << signalPool.size() << " to " << signalPool.size() + SIGNAL_POOL_SIZE);
+                Kalmar::TraceScope trace(Kalmar::TracePoolGrowth, "signal pool growth", signalPool.size() + SIGNAL_POOL_SIZE);
+                counters.add(Kalmar::hcCounterSignalPoolGrowth);
 
                 // increase signal pool on demand for another SIGNAL_POOL_SIZE
                 for (int i = 0; i < SIGNAL_POOL_SIZE; ++i) {
@@ -3004,6 +3511,14 @@ public:
         hsa_system_get_info(HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY, &timestamp_frequency_hz);
         return timestamp_frequency_hz;
     }
+
+    size_t getAmCacheSize() override {
+        return (HCC_AM_CACHE_SIZE > 0) ? size_t(HCC_AM_CACHE_SIZE) * 1024 * 1024 : 0;
+    }
+
+    size_t getAmSlabMaxSize() override {
+        return (HCC_AM_SLAB_MAX_SIZE > 0) ? size_t(HCC_AM_SLAB_MAX_SIZE) * 1024 : 0;
+    }
 };
 
 static HSAContext ctx;
@@ -3019,7 +3534,7 @@ namespace Kalmar {
 HSADevice::HSADevice(hsa_agent_t a, hsa_agent_t host, int x_accSeqNum) : KalmarDevice(access_type_read_write),
                                agent(a), programs(), max_tile_static_size(0),
                                queue_size(0), queues(), queues_mutex(),
-                               rocrQueues(/*empty*/), rocrQueuesMutex(),
+                               queueScheduler(nullptr),
                                ri(),
                                useCoarseGrainedRegion(false),
                                kernargPool(), kernargPoolFlag(), kernargCursor(0), kernargPoolMutex(),
@@ -3170,6 +3685,7 @@ HSADevice::HSADevice(hsa_agent_t a, hsa_agent_t host, int x_accSeqNum) : KalmarD
         case UnpinnedCopyEngine::UsePinInPlace: //1
         case UnpinnedCopyEngine::UseStaging:    //2
         case UnpinnedCopyEngine::UseMemcpy:     //3
+        case UnpinnedCopyEngine::UseCalibrated: //4
             break;
         default:
             this->copy_mode = UnpinnedCopyEngine::ChooseBest;
@@ -3179,21 +3695,59 @@ HSADevice::HSADevice(hsa_agent_t a, hsa_agent_t host, int x_accSeqNum) : KalmarD
     HCC_H2D_PININPLACE_THRESHOLD *= 1024;
     HCC_D2H_PININPLACE_THRESHOLD *= 1024;
 
-    static const size_t stagingSize = 64*1024;
+    const size_t stagingSize = (HCC_STAGING_BUFFER_SIZE > 0 ? HCC_STAGING_BUFFER_SIZE :
+                                HCC_STAGING_PACK_THREADS > 0 ? 1024 : 64) * 1024;
     this->cpu_accessible_am = hasAccess(hostAgent, ri._am_memory_pool);
     hsa_amd_memory_pool_t hostPool = (getHSAAMHostRegion());
-    copy_engine[0] = new UnpinnedCopyEngine(agent, hostAgent, stagingSize, 2/*staging buffers*/,
+    // HCC_PIN_CACHE_SIZE < 0 disables the cache, 0 keeps it only for the copies in flight
+    this->pinnedHostCache = NULL;
+    if (HCC_PIN_CACHE_SIZE >= 0) {
+        HsaPinBackend pinBackend = { agent };
+        this->pinnedHostCache = new HsaPinnedHostCache(pinBackend, size_t(HCC_PIN_CACHE_SIZE) * 1024 * 1024);
+    }
+
+    this->stagingPackers = NULL;
+    if (HCC_STAGING_PACK_THREADS > 0) {
+        // a full staging buffer is split among all of the threads, in slices
+        // of at least 16KB below which waking up a helper costs more than it copies
+        const size_t minSlice = std::max(stagingSize / (HCC_STAGING_PACK_THREADS + 1), size_t(16 * 1024));
+        this->stagingPackers = new Kalmar::CopyWorkerPool(HCC_STAGING_PACK_THREADS, minSlice);
+    }
+
+    this->queueScheduler = new HsaQueueScheduler(HsaQueueBackend{ agent, queue_size }, HCC_MAX_QUEUES, HCC_QUEUE_BORROW != 0);
+
+    this->slabs = new HsaSlabAllocator(HsaSlabBackend{ agent, getHSAAMRegion(), is_unified() },
+                                       HCC_SLAB_MAX_SIZE > 0 ? size_t(HCC_SLAB_MAX_SIZE) * 1024 : 0);
+
+    copy_engine[0] = new UnpinnedCopyEngine(agent, hostAgent, stagingSize, HCC_STAGING_BUFFER_COUNT,
                                             this->cpu_accessible_am,
                                             HCC_H2D_STAGING_THRESHOLD,
                                             HCC_H2D_PININPLACE_THRESHOLD,
-                                            HCC_D2H_PININPLACE_THRESHOLD);
+                                            HCC_D2H_PININPLACE_THRESHOLD,
+                                            this->pinnedHostCache,
+                                            HCC_STAGING_RINGS,
+                                            this->stagingPackers);
 
-    copy_engine[1] = new UnpinnedCopyEngine(agent, hostAgent, stagingSize, 2/*staging Buffers*/,
+    copy_engine[1] = new UnpinnedCopyEngine(agent, hostAgent, stagingSize, HCC_STAGING_BUFFER_COUNT,
                                             this->cpu_accessible_am,
                                             HCC_H2D_STAGING_THRESHOLD,
                                             HCC_H2D_PININPLACE_THRESHOLD,
-                                            HCC_D2H_PININPLACE_THRESHOLD);
+                                            HCC_D2H_PININPLACE_THRESHOLD,
+                                            this->pinnedHostCache,
+                                            HCC_STAGING_RINGS,
+                                            this->stagingPackers);
+
 
+    copy_engine[0]->SetCopyProfile(HCC_COPY_PROFILE);
+    copy_engine[1]->SetCopyProfile(HCC_COPY_PROFILE);
+    copy_engine[0]->SetCounters(&counters);
+    copy_engine[1]->SetCounters(&counters);
+
+    // measure the copy algorithms now rather than in the first copies of the application
+    if (this->copy_mode == UnpinnedCopyEngine::UseCalibrated) {
+        copy_engine[0]->PrepareCalibrated(UnpinnedCopyEngine::H2D);
+        copy_engine[1]->PrepareCalibrated(UnpinnedCopyEngine::D2H);
+    }
 
     if (HCC_CHECK_COPY && !this->cpu_accessible_am) {
         throw Kalmar::runtime_exception("HCC_CHECK_COPY can only be used on machines where accelerator memory is visible to CPU (ie large-bar systems)", 0);
@@ -3209,6 +3763,14 @@ HSADevice::getHSAAgent() override {
     return static_cast<void*>(&getAgent());
 }
 
+// The signal pool is shared by the devices, its growths are counted for the process.
+Kalmar::RuntimeCounterValues
+HSADevice::getRuntimeCounters() {
+    Kalmar::RuntimeCounterValues values = counters.snapshot();
+    values[Kalmar::hcCounterSignalPoolGrowth] += ctx.counters.get(Kalmar::hcCounterSignalPoolGrowth);
+    return values;
+}
+
 static int get_seqnum_from_agent(hsa_agent_t hsaAgent) 
 {
     auto i = ctx.agentToDeviceMap_.find(hsaAgent.handle);
@@ -3250,7 +3812,7 @@ inline std::ostream& operator<<(std::ostream& os, const HSADispatch & op)
 HSAQueue::HSAQueue(KalmarDevice* pDev, hsa_agent_t agent, execute_order order, queue_priority priority, uint64_t deadline) : 
     KalmarQueue(pDev, queuing_mode_automatic, order, priority, deadline),
     rocrQueue(nullptr),
-    asyncOps(), opSeqNums(0), valid(true), _nextSyncNeedsSysRelease(false), _nextKernelNeedsSysAcquire(false), bufferKernelMap(), kernelBufferMap() 
+    asyncOps(), opSeqNums(0), valid(true), _nextSyncNeedsSysRelease(false), _nextKernelNeedsSysAcquire(false), bufferAccess(), bufferAccessPruneSize(64)
 {
     { 
         // Protect the HSA queue we can steal it.
@@ -3259,20 +3821,21 @@ HSAQueue::HSAQueue(KalmarDevice* pDev, hsa_agent_t agent, execute_order order, q
         std::lock_guard<std::mutex> (this->qmutex);
 
         auto device = static_cast<Kalmar::HSADevice*>(this->getDev());
-        device->createOrstealRocrQueue(this, priority, deadline);
+        device->createOrstealRocrQueue(this, priority);
     }
 
 
     youngestCommandKind = hcCommandInvalid;
 
-    hsa_status_t status= hsa_signal_create(1, 1, &agent, &sync_copy_signal);
-    STATUS_CHECK(status, __LINE__);
+    if (HCC_WAIT_MODE == hcWaitModeAdaptive) {
+        set_wait_mode(hcWaitModeAdaptive);
+    }
+
+    streamPool.reset(new HsaStreamPool(HsaStreamPoolBackend{ pDev }, size_t(HCC_ASYNC_POOL_SIZE) * 1024 * 1024));
 }
 
 
 void HSAQueue::dispose() override {
-    hsa_status_t status;
-
     DBOUT(DB_INIT, "HSAQueue::dispose() in\n");
     {
         DBOUT(DB_LOCK, " ptr:" << this << " dispose lock_guard...\n");
@@ -3284,31 +3847,20 @@ void HSAQueue::dispose() override {
 
         this->valid = false;
 
-        // clear bufferKernelMap
-        for (auto iter = bufferKernelMap.begin(); iter != bufferKernelMap.end(); ++iter) {
-           iter->second.clear();
-        }
-        bufferKernelMap.clear();
+        bufferAccess.clear();
 
-        // clear kernelBufferMap
-        for (auto iter = kernelBufferMap.begin(); iter != kernelBufferMap.end(); ++iter) {
-            iter->second.clear();
-        }
-        kernelBufferMap.clear();
+        // the frees have completed: give the memory of alloc_async back
+        streamPool.reset();
 
 
         Kalmar::HSADevice* device = static_cast<Kalmar::HSADevice*>(getDev());
         if (this->rocrQueue != nullptr) {
             
-            device->removeRocrQueue(rocrQueue);
+            device->removeRocrQueue(rocrQueue, this);
             rocrQueue = nullptr;
         }
     }
 
-    status = hsa_signal_destroy(sync_copy_signal);
-
-    STATUS_CHECK(status, __LINE__);
-
     DBOUT(DB_INIT, "HSAQueue::dispose() out\n");
 }
 
@@ -3316,12 +3868,95 @@ Kalmar::HSADevice * HSAQueue::getHSADev() const {
     return static_cast<Kalmar::HSADevice*>(this->getDev()); 
 };
 
+void HSAQueue::countEvent(hcRuntimeCounter counter) {
+    counters.add(counter);
+    getHSADev()->counters.add(counter);
+}
+
+void* HSAQueue::deviceAllocationOf(void* ptr) {
+    // the buffer may be of another device, for peer copies
+    for (auto& dev : Kalmar::ctx.agentToDeviceMap_) {
+        void* slab = dev.second->slabOf(ptr);
+        if (slab != nullptr) {
+            return slab;
+        }
+    }
+    return ptr;
+}
+
+void* HSAQueue::lockHostMemory(const void* host, size_t size, bool* cached) {
+    *cached = false;
+
+    // FIXME: host memory is allocated through OS allocator, if not, correct it.
+    hsa_agent_t* agent = static_cast<hsa_agent_t*>(getHSAAgent());
+    HsaPinnedHostCache* cache = getHSADev()->pinnedHostCache;
+    void* va = nullptr;
+    if (cache) {
+        switch (cache->acquire(host, size, &va)) {
+            case HsaPinnedHostCache::PIN_OK:
+                *cached = true;
+                return va;
+            case HsaPinnedHostCache::PIN_FAILED: {
+                // not memory from the OS allocator
+                hsa_status_t status = hsa_amd_agents_allow_access(1, agent, NULL, host);
+                STATUS_CHECK(status, __LINE__);
+                // nothing to unlock
+                return const_cast<void*>(host);
+            }
+            case HsaPinnedHostCache::PIN_BUSY:
+                // overlaps a range in use by another copy: lock it for this copy only
+                break;
+        }
+    }
+
+    std::unique_lock<std::mutex> l(lockedHostMemoryMutex);
+    auto it = lockedHostMemory.find(host);
+    while ((it != lockedHostMemory.end()) && (it->second.size < size)) {
+        // locked for a smaller copy: let it complete and lock again, the
+        // waits unlock the completed copies
+        l.unlock();
+        wait();
+        l.lock();
+        it = lockedHostMemory.find(host);
+    }
+    if (it != lockedHostMemory.end()) {
+        it->second.refs++;
+        return it->second.va;
+    }
+
+    hsa_status_t status = hsa_amd_memory_lock(const_cast<void*>(host), size, agent, 1, &va);
+    // TODO: If host buffer is not allocated through OS allocator, so far, lock
+    // API will return nullptr to va, this is not specified in the spec, but will use it to
+    // check if host buffer is allocated by hsa allocator
+    if (va == NULL || status != HSA_STATUS_SUCCESS) {
+        status = hsa_amd_agents_allow_access(1, agent, NULL, host);
+        STATUS_CHECK(status, __LINE__);
+        // nothing to unlock
+        return const_cast<void*>(host);
+    }
+    lockedHostMemory[host] = { va, size, 1 };
+    return va;
+}
+
+void HSAQueue::unlockHostMemory(const void* host, bool cached) {
+    if (cached) {
+        getHSADev()->pinnedHostCache->release(host);
+        return;
+    }
+    std::lock_guard<std::mutex> l(lockedHostMemoryMutex);
+    auto it = lockedHostMemory.find(host);
+    if ((it != lockedHostMemory.end()) && (--it->second.refs == 0)) {
+        hsa_amd_memory_unlock(const_cast<void*>(host));
+        lockedHostMemory.erase(it);
+    }
+}
+
 hsa_queue_t *HSAQueue::acquireLockedRocrQueue() {
     DBOUT(DB_LOCK, " ptr:" << this << " lock...\n");
     this->qmutex.lock();
     if (this->rocrQueue == nullptr) {
         auto device = static_cast<Kalmar::HSADevice*>(this->getDev());
-        device->createOrstealRocrQueue(this);
+        device->createOrstealRocrQueue(this, get_queue_priority());
     }
 
     DBOUT (DB_QUEUE, "acquireLockedRocrQueue returned hwQueue=" << this->rocrQueue->_hwQueue << "\n");
@@ -3519,19 +4154,61 @@ HSAQueue::dispatch_hsa_kernel(const hsa_kernel_dispatch_packet_t *aql,
 };
 
 void
-HSAQueue::ring_doorbell()
+HSAQueue::packetWritten(hsa_queue_t *lockedHsaQueue, uint64_t index, bool deferred)
 {
-    hsa_queue_t* rocrQueue = acquireLockedRocrQueue();
+    if (doorbell.packetWritten(deferred, lockedHsaQueue->size)) {
+        ringDoorbell(lockedHsaQueue, index);
+    } else {
+        DBOUT(DB_AQL, " doorbell deferred, " << doorbell.getPending() << " packets pending\n");
+    }
+}
+
+void
+HSAQueue::ringDoorbell(hsa_queue_t *lockedHsaQueue, uint64_t index)
+{
+    hsa_signal_store_relaxed(lockedHsaQueue->doorbell_signal, index);
+    doorbell.rung();
+}
+
+void
+HSAQueue::ringPendingDoorbell()
+{
+    // packets are only written with a rocr queue attached, and the pending
+    // ones are rung before it can be stolen
+    if (doorbell.getPending() != 0 && rocrQueue != nullptr) {
+        hsa_queue_t *hwQueue = rocrQueue->_hwQueue;
+        // the write index is one past the youngest packet
+        ringDoorbell(hwQueue, hsa_queue_load_write_index_relaxed(hwQueue) - 1);
+    }
+}
 
-    uint64_t index = hsa_queue_load_write_index_relaxed(rocrQueue);
+void
+HSAQueue::flush()
+{
+    std::lock_guard<std::mutex> l(this->qmutex);
+    ringPendingDoorbell();
+}
+
+void
+HSAQueue::ring_doorbell()
+{
+    flush();
+}
 
-    printf("Manually ringing the doorbell\n");
-    // index - 1 because index gets incremented by the dispatchKernel
-    // function. Without this, a call to hipDeviceSynchronize() would
-    // hang indefinitely
-    hsa_signal_store_relaxed(rocrQueue->doorbell_signal, index - 1);
+void
+HSAQueue::begin_batch(uint32_t maxPackets, uint32_t maxMicroseconds)
+{
+    std::lock_guard<std::mutex> l(this->qmutex);
+    doorbell.beginBatch(maxPackets, maxMicroseconds);
+}
 
-    releaseLockedRocrQueue();
+void
+HSAQueue::end_batch()
+{
+    std::lock_guard<std::mutex> l(this->qmutex);
+    if (doorbell.endBatch()) {
+        ringPendingDoorbell();
+    }
 }
 
 } // namespace Kalmar
@@ -3548,6 +4225,7 @@ HSADispatch::HSADispatch(Kalmar::HSADevice* _device, Kalmar::KalmarQueue *queue,
     kernel(_kernel),
     isDispatched(false),
     waitMode(HSA_WAIT_STATE_BLOCKED),
+    adaptiveWait(false),
     future(nullptr),
     kernargMemory(nullptr)
 {
@@ -3735,11 +4413,9 @@ HSADispatch::dispatchKernel(hsa_queue_t* lockedHsaQueue, const void *hostKernarg
     }
 
 
-    // Ring door bell
-    if (lastKernel == 1) {
-        printf("Ring the doorbell cause this is the last kernel\n");
-        //hsa_signal_store_relaxed(lockedHsaQueue->doorbell_signal, index);
-    }
+    // Ring door bell, unless held back by a batch.  lastKernel == 0 also
+    // holds the packet back until a later packet, flush() or wait() rings.
+    hsaQueue()->packetWritten(lockedHsaQueue, index, lastKernel == 0);
 
     isDispatched = true;
 
@@ -3759,10 +4435,16 @@ HSADispatch::waitComplete() {
 
 
     if (signal.handle) {
+        // the dispatch may still be held back by a batch
+        if (this->hsaQueue() != nullptr) {
+            this->hsaQueue()->flush();
+        }
+
         DBOUT(DB_MISC, "wait for kernel dispatch op#" << getSeqNum() << " completion with wait flag: " << waitMode << "  signal="<< std::hex  << signal.handle << std::dec << "\n");
 
         // wait for completion
-        if (hsa_signal_wait_acquire(signal, HSA_SIGNAL_CONDITION_LT, 1, uint64_t(-1), waitMode)!=0) {
+        waitSignal(signal, HSA_SIGNAL_CONDITION_LT, 1, waitMode, adaptiveWait, kernel);
+        if (hsa_signal_load_acquire(signal) != 0) {
             throw Kalmar::runtime_exception("Signal wait returned unexpected value\n", 0);
         }
 
@@ -3847,6 +4529,9 @@ HSADispatch::dispatchKernelAsync(const void *hostKernarg, int hostKernargSize, b
     hsaQueue()->setNextSyncNeedsSysRelease(true);
 
     {
+        Kalmar::TraceScope trace(Kalmar::TraceDispatch, Kalmar::traceEnabled() ? kernel->getTraceName() : nullptr,
+                                 uint64_t(aql.grid_size_x) * aql.grid_size_y * aql.grid_size_z, hsaQueue()->getQueueSeqNum());
+
         // extract hsa_queue_t from HSAQueue
         hsa_queue_t* rocrQueue = hsaQueue()->acquireLockedRocrQueue();
 
@@ -3875,6 +4560,13 @@ HSADispatch::dispatchKernelAsync(const void *hostKernarg, int hostKernargSize, b
 inline void
 HSADispatch::dispose() {
     hsa_status_t status;
+
+    // the profiler takes the duration of the completed dispatches with a signal
+    if (Kalmar::profilingEnabled() && isDispatched && signal.handle != 0 &&
+        hsa_signal_load_relaxed(signal) == 0) {
+        profile();
+    }
+
     if (kernargMemory != nullptr) {
       device->releaseKernargBuffer(kernargMemory, kernargMemoryIndex);
       kernargMemory = nullptr;
@@ -3891,6 +4583,34 @@ HSADispatch::dispose() {
     }
 }
 
+inline void
+HSADispatch::profile() {
+    // ticks of the profiling timestamps per second
+    static const uint64_t frequency = [] {
+        uint64_t hz = 0;
+        hsa_system_get_info(HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY, &hz);
+        return hz;
+    }();
+
+    hsa_amd_profiling_dispatch_time_t time;
+    if (frequency == 0 ||
+        hsa_amd_profiling_get_dispatch_time(agent, signal, &time) != HSA_STATUS_SUCCESS ||
+        time.end < time.start) {
+        return;
+    }
+
+    Kalmar::KernelDims dims;
+    dims.dims = (aql.setup >> HSA_KERNEL_DISPATCH_PACKET_SETUP_DIMENSIONS) & 0x3;
+    dims.grid[0] = aql.grid_size_x;
+    dims.grid[1] = aql.grid_size_y;
+    dims.grid[2] = aql.grid_size_z;
+    dims.tile[0] = aql.workgroup_size_x;
+    dims.tile[1] = aql.workgroup_size_y;
+    dims.tile[2] = aql.workgroup_size_z;
+    uint64_t ns = uint64_t((time.end - time.start) * (1e9 / frequency));
+    Kalmar::KernelProfiler::get().recordKernel(kernel->getKernelName().c_str(), dims, getQueue(), ns);
+}
+
 inline uint64_t
 HSADispatch::getBeginTimestamp() override {
     Kalmar::HSADevice* device = static_cast<Kalmar::HSADevice*>(hsaQueue()->getDev());
@@ -4019,7 +4739,7 @@ HSABarrier::waitComplete() {
     DBOUT(DB_WAIT,  "  wait for barrier op#" << getSeqNum() << " completion with wait flag: " << waitMode << "  signal="<< std::hex  << signal.handle << std::dec <<"...\n");
 
     // Wait on completion signal until the barrier is finished
-    hsa_signal_wait_acquire(signal, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX, waitMode);
+    waitSignal(signal, HSA_SIGNAL_CONDITION_EQ, 0, waitMode, adaptiveWait, barrierWaitKey);
 
 
     // unregister this async operation from HSAQueue
@@ -4036,6 +4756,8 @@ HSABarrier::waitComplete() {
 inline hsa_status_t
 HSABarrier::enqueueAsync(hc::memory_scope releaseScope) {
 
+    Kalmar::TraceScope trace(Kalmar::TraceMarker, "marker", releaseScope, hsaQueue()->getQueueSeqNum());
+
     // extract hsa_queue_t from HSAQueue
     //
    
@@ -4125,9 +4847,11 @@ HSABarrier::enqueueAsync(hc::memory_scope releaseScope) {
         DBOUTL(DB_AQL2, *barrier);
 
 
-        // Increment write index and ring doorbell to dispatch the kernel
+        // Increment write index and ring doorbell to dispatch the kernel.
+        // Barriers are never held back: something is usually about to wait
+        // on them, and ringing also releases the packets of an open batch.
         hsa_queue_store_write_index_relaxed(rocrQueue, nextIndex);
-        hsa_signal_store_relaxed(rocrQueue->doorbell_signal, index);
+        hsaQueue()->ringDoorbell(rocrQueue, index);
 
         hsaQueue()->releaseLockedRocrQueue();
     }
@@ -4200,8 +4924,18 @@ HSACopy::waitComplete() {
         DBOUT(DB_WAIT, "  wait for copy op#" << getSeqNum() << " completion with wait flag: " << waitMode << "signal="<< std::hex  << signal.handle << std::dec <<" currentVal=" << v << "...\n");
     }
 
+    // the copy may depend on a command held back by a batch
+    if (this->hsaQueue() != nullptr) {
+        this->hsaQueue()->flush();
+    }
+
     // Wait on completion signal until the async copy is finished
-    hsa_signal_wait_acquire(signal, HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, waitMode);
+    waitSignal(signal, HSA_SIGNAL_CONDITION_LT, 1, waitMode, adaptiveWait, copyWaitKey(sizeBytes));
+
+    if (lockedHost != nullptr) {
+        hsaQueue()->unlockHostMemory(lockedHost, lockedHostCached);
+        lockedHost = nullptr;
+    }
 
 
     // unregister this async operation from HSAQueue
@@ -4340,6 +5074,9 @@ static Kalmar::hcCommandKind resolveMemcpyDirection(bool srcInDeviceMem, bool ds
 inline hsa_status_t
 HSACopy::enqueueAsyncCopyCommand(const Kalmar::HSADevice *copyDevice, const hc::AmPointerInfo &srcPtrInfo, const hc::AmPointerInfo &dstPtrInfo) {
 
+    Kalmar::TraceScope trace(Kalmar::TraceCopy, "copy_async", sizeBytes,
+                             resolveMemcpyDirection(srcPtrInfo._isInDeviceMem, dstPtrInfo._isInDeviceMem));
+
     hsa_status_t status = HSA_STATUS_SUCCESS;
 
 
@@ -4365,6 +5102,10 @@ HSACopy::enqueueAsyncCopyCommand(const Kalmar::HSADevice *copyDevice, const hc::
         int depSignalCnt = 0;
         hsa_signal_t depSignal;
         setCommandKind (resolveMemcpyDirection(srcPtrInfo._isInDeviceMem, dstPtrInfo._isInDeviceMem));
+        if (Kalmar::profilingEnabled()) {
+            // asynchronous: counted, not timed
+            Kalmar::KernelProfiler::get().recordCopy(getCommandKind(), sizeBytes, 0);
+        }
 
         auto releaseScope = (hsaQueue()->nextSyncNeedsSysRelease()) ? hc::system_scope : hc::no_scope;
         depAsyncOp = hsaQueue()->detectStreamDeps(this->getCommandKind(), this);
@@ -4392,6 +5133,10 @@ HSACopy::enqueueAsyncCopyCommand(const Kalmar::HSADevice *copyDevice, const hc::
             depSignalCnt = 1;
 
             DBOUT( DB_CMD, "  asyncCopy sent with dependency on op#" << depAsyncOp->getSeqNum() << " depSignal="<< std::hex  << depSignal.handle << std::dec <<"\n");
+
+            // the copy engine does not see the doorbell of the queue, the
+            // command it depends on may still be held back by a batch
+            hsaQueue()->flush();
         }
 
 
@@ -4465,6 +5210,9 @@ HSACopy::getEndTimestamp() override {
 void
 HSACopy::syncCopyExt(hc::hcCommandKind copyDir, const hc::AmPointerInfo &srcPtrInfo, const hc::AmPointerInfo &dstPtrInfo, const Kalmar::HSADevice *copyDevice, bool forceUnpinnedCopy)
 {
+    Kalmar::TraceScope trace(Kalmar::TraceCopy, "copy", sizeBytes, copyDir);
+    Kalmar::CopyProfileScope profile(copyDir, sizeBytes);
+
     bool srcInTracker = (srcPtrInfo._sizeBytes != 0);
     bool dstInTracker = (dstPtrInfo._sizeBytes != 0);
 
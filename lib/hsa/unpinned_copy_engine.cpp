@@ -21,6 +21,13 @@ THE SOFTWARE.
 
 #include <hsa/hsa_ext_amd.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
 #include "unpinned_copy_engine.h"
 #include "hc_rt_debug.h"
 
@@ -81,15 +88,21 @@ static hsa_status_t find_gpu(hsa_agent_t agent, void *data) {
 //-------------------------------------------------------------------------------------------------
 UnpinnedCopyEngine::UnpinnedCopyEngine(hsa_agent_t hsaAgent, hsa_agent_t cpuAgent, size_t bufferSize, int numBuffers, 
                                        bool isLargeBar, int thresholdH2DDirectStaging, 
-                                       int thresholdH2DStagingPinInPlace, int thresholdD2H) :
+                                       int thresholdH2DStagingPinInPlace, int thresholdD2H,
+                                       HsaPinnedHostCache *pinnedHostCache, int numRings, Kalmar::CopyWorkerPool *packers) :
     _hsaAgent(hsaAgent),
     _cpuAgent(cpuAgent),
     _bufferSize(bufferSize),
-    _numBuffers(numBuffers > _max_buffers ? _max_buffers : numBuffers),
+    _numBuffers(numBuffers > _max_buffers ? _max_buffers : (numBuffers < 1 ? 1 : numBuffers)),
+    _numRings(numRings > _max_rings ? _max_rings : (numRings < 1 ? 1 : numRings)),
     _isLargeBar(isLargeBar),
     _hipH2DTransferThresholdDirectOrStaging(thresholdH2DDirectStaging),
     _hipH2DTransferThresholdStagingOrPininplace(thresholdH2DStagingPinInPlace),
-    _hipD2HTransferThreshold(thresholdD2H)
+    _hipD2HTransferThreshold(thresholdD2H),
+    _pinnedHostCache(pinnedHostCache),
+    _counters(nullptr),
+    _nextRing(0),
+    _packers(packers)
 {
     hsa_amd_memory_pool_t sys_pool;
     hsa_status_t err = hsa_amd_agent_iterate_memory_pools(_cpuAgent, findGlobalPool, &sys_pool);
@@ -107,23 +120,26 @@ UnpinnedCopyEngine::UnpinnedCopyEngine(hsa_agent_t hsaAgent, hsa_agent_t cpuAgen
     };
 
     ErrorCheck(err);
-    for (int i=0; i<_numBuffers; i++) {
+    for (int r=0; r<_numRings; r++) {
+      StagingRing &ring = _rings[r];
+      for (int i=0; i<_numBuffers; i++) {
         // TODO - experiment with alignment here.
-        err = hsa_amd_memory_pool_allocate(sys_pool, _bufferSize, 0, (void**)(&_pinnedStagingBuffer[i]));
+        err = hsa_amd_memory_pool_allocate(sys_pool, _bufferSize, 0, (void**)(&ring._pinnedStagingBuffer[i]));
         ErrorCheck(err);
 
-        if ((err != HSA_STATUS_SUCCESS) || (_pinnedStagingBuffer[i] == NULL)) {
+        if ((err != HSA_STATUS_SUCCESS) || (ring._pinnedStagingBuffer[i] == NULL)) {
             THROW_ERROR(hipErrorMemoryAllocation, err);
         }
 
         // Allow access from every agent:
         // This is used in peer-to-peer copies, since we use the buffers to copy from different agents.
         // TODO - may want to review this algorithm for NUMA locality - it might be faster to use staging buffer closer to devices?
-        err = hsa_amd_agents_allow_access(agents.size(), agentBlock, NULL, _pinnedStagingBuffer[i]);
+        err = hsa_amd_agents_allow_access(agents.size(), agentBlock, NULL, ring._pinnedStagingBuffer[i]);
         ErrorCheck(err);
 
-        hsa_signal_create(0, 0, NULL, &_completionSignal[i]);
-        hsa_signal_create(0, 0, NULL, &_completionSignal2[i]);
+        hsa_signal_create(0, 0, NULL, &ring._completionSignal[i]);
+        hsa_signal_create(0, 0, NULL, &ring._completionSignal2[i]);
+      }
     }
 
 };
@@ -132,17 +148,91 @@ UnpinnedCopyEngine::UnpinnedCopyEngine(hsa_agent_t hsaAgent, hsa_agent_t cpuAgen
 //---
 UnpinnedCopyEngine::~UnpinnedCopyEngine()
 {
-    for (int i=0; i<_numBuffers; i++) {
-        if (_pinnedStagingBuffer[i]) {
-            hsa_amd_memory_pool_free(_pinnedStagingBuffer[i]);
-            _pinnedStagingBuffer[i] = NULL;
+    for (int r=0; r<_numRings; r++) {
+      StagingRing &ring = _rings[r];
+      for (int i=0; i<_numBuffers; i++) {
+        if (ring._pinnedStagingBuffer[i]) {
+            hsa_amd_memory_pool_free(ring._pinnedStagingBuffer[i]);
+            ring._pinnedStagingBuffer[i] = NULL;
+        }
+        hsa_signal_destroy(ring._completionSignal[i]);
+        hsa_signal_destroy(ring._completionSignal2[i]);
+      }
+    }
+}
+
+
+//---
+// Take the first ring not in use, starting from a different ring for each copy so that
+// the buffers are used evenly.  If all the rings are busy, wait for the first one tried.
+UnpinnedCopyEngine::StagingRing &UnpinnedCopyEngine::LockRing()
+{
+    unsigned first = _nextRing.fetch_add(1, std::memory_order_relaxed) % _numRings;
+    for (int i=0; i<_numRings; i++) {
+        StagingRing &ring = _rings[(first + i) % _numRings];
+        if (ring._copyLock.try_lock()) {
+            return ring;
         }
-        hsa_signal_destroy(_completionSignal[i]);
-        hsa_signal_destroy(_completionSignal2[i]);
     }
+    _rings[first]._copyLock.lock();
+    return _rings[first];
+}
+
+
+void UnpinnedCopyEngine::PackStaging(void *dst, const void *src, size_t sizeBytes)
+{
+    if (_packers) {
+        _packers->copy(dst, src, sizeBytes, true/*nonTemporal*/);
+    } else {
+        Kalmar::memcpy_nt(dst, src, sizeBytes);
+    }
+}
+
+
+// The destination is application memory which is likely to be read soon, keep it in cache.
+void UnpinnedCopyEngine::UnpackStaging(void *dst, const void *src, size_t sizeBytes)
+{
+    if (_packers) {
+        _packers->copy(dst, src, sizeBytes, false/*nonTemporal*/);
+    } else {
+        memcpy(dst, src, sizeBytes);
+    }
+}
+
+
+
+//---
+// Pin host memory through the pinned host cache if there is one, else lock it for this copy only.
+// Ranges the cache can't pin, e.g. overlapping a range in use by another copy, are locked for this
+// copy only too.
+void *UnpinnedCopyEngine::PinHostMemory(const void *host, size_t sizeBytes, bool *cached)
+{
+    void *va = nullptr;
+    *cached = false;
+    if (_pinnedHostCache) {
+        if (_pinnedHostCache->acquire(host, sizeBytes, &va) == HsaPinnedHostCache::PIN_OK) {
+            *cached = true;
+            return va;
+        }
+    }
+
+    hsa_status_t hsa_status = hsa_amd_memory_lock(const_cast<void*> (host), sizeBytes, &_hsaAgent, 1, &va);
+    if (hsa_status != HSA_STATUS_SUCCESS) {
+        THROW_ERROR (hipErrorRuntimeMemory, hsa_status);
+    }
+    return va;
 }
 
 
+void UnpinnedCopyEngine::UnpinHostMemory(const void *host, bool cached)
+{
+    if (cached) {
+        _pinnedHostCache->release(host);
+    } else {
+        hsa_amd_memory_unlock(const_cast<void*> (host));
+    }
+}
+
 
 //---
 //Copies sizeBytes from src to dst, using either a copy to a staging buffer or a staged pin-in-place strategy
@@ -151,13 +241,14 @@ UnpinnedCopyEngine::~UnpinnedCopyEngine()
 //IN: waitFor - hsaSignal to wait for - the copy will begin only when the specified dependency is resolved.  May be NULL indicating no dependency.
 void UnpinnedCopyEngine::CopyHostToDevicePinInPlace(void* dst, const void* src, size_t sizeBytes, hsa_signal_t *waitFor)
 {
-    std::lock_guard<std::mutex> l (_copyLock);
+    StagingRing &ring = LockRing();
+    std::lock_guard<std::mutex> l (ring._copyLock, std::adopt_lock);
 
     const char *srcp = static_cast<const char*> (src);
     char *dstp = static_cast<char*> (dst);
 
     for (int i=0; i<_numBuffers; i++) {
-        hsa_signal_store_relaxed(_completionSignal[i], 0);
+        hsa_signal_store_relaxed(ring._completionSignal[i], 0);
     }
 
     if (sizeBytes >= UINT64_MAX/2) {
@@ -166,31 +257,24 @@ void UnpinnedCopyEngine::CopyHostToDevicePinInPlace(void* dst, const void* src,
     int bufferIndex = 0;
 
     size_t theseBytes= sizeBytes;
-    //tprintf (DB_COPY2, "H2D: waiting... on completion signal handle=%lu\n", _completionSignal[bufferIndex].handle);
-    //hsa_signal_wait_acquire(_completionSignal[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
+    //tprintf (DB_COPY2, "H2D: waiting... on completion signal handle=%lu\n", ring._completionSignal[bufferIndex].handle);
+    //hsa_signal_wait_acquire(ring._completionSignal[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
 
-    //void * masked_srcp = (void*) ((uintptr_t)srcp & (uintptr_t)(~0x3f)) ; // TODO
-    void *locked_srcp;
-    //hsa_status_t hsa_status = hsa_amd_memory_lock(masked_srcp, theseBytes, &_hsaAgent, 1, &locked_srcp);
-    hsa_status_t hsa_status = hsa_amd_memory_lock(const_cast<char*> (srcp), theseBytes, &_hsaAgent, 1, &locked_srcp);
+    bool cached;
+    void *locked_srcp = PinHostMemory(srcp, theseBytes, &cached);
     //tprintf (DB_COPY2, "H2D: bytesRemaining=%zu: pin-in-place:%p+%zu bufferIndex[%d]\n", bytesRemaining, srcp, theseBytes, bufferIndex);
-    //printf ("status=%x srcp=%p, masked_srcp=%p, locked_srcp=%p\n", hsa_status, srcp, masked_srcp, locked_srcp);
 
-    if (hsa_status != HSA_STATUS_SUCCESS) {
-        THROW_ERROR (hipErrorRuntimeMemory, hsa_status);
-    }
-
-    hsa_signal_store_relaxed(_completionSignal[bufferIndex], 1);
+    hsa_signal_store_relaxed(ring._completionSignal[bufferIndex], 1);
 
-    hsa_status = hsa_amd_memory_async_copy(dstp, _hsaAgent, locked_srcp, _hsaAgent, theseBytes, waitFor ? 1:0, waitFor, _completionSignal[bufferIndex]);
-    //tprintf (DB_COPY2, "H2D: bytesRemaining=%zu: async_copy %zu bytes %p to %p status=%x\n", bytesRemaining, theseBytes, _pinnedStagingBuffer[bufferIndex], dstp, hsa_status);
+    hsa_status_t hsa_status = hsa_amd_memory_async_copy(dstp, _hsaAgent, locked_srcp, _hsaAgent, theseBytes, waitFor ? 1:0, waitFor, ring._completionSignal[bufferIndex]);
+    //tprintf (DB_COPY2, "H2D: bytesRemaining=%zu: async_copy %zu bytes %p to %p status=%x\n", bytesRemaining, theseBytes, ring._pinnedStagingBuffer[bufferIndex], dstp, hsa_status);
 
     if (hsa_status != HSA_STATUS_SUCCESS) {
         THROW_ERROR (hipErrorRuntimeMemory, hsa_status);
     }
-    DBOUTL (DB_COPY2, "H2D: waiting... on completion signal handle=" << _completionSignal[bufferIndex].handle);
-    hsa_signal_wait_acquire(_completionSignal[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
-    hsa_amd_memory_unlock(const_cast<char*> (srcp));
+    DBOUTL (DB_COPY2, "H2D: waiting... on completion signal handle=" << ring._completionSignal[bufferIndex].handle);
+    hsa_signal_wait_acquire(ring._completionSignal[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
+    UnpinHostMemory(srcp, cached);
     // Assume subsequent commands are dependent on previous and don't need dependency after first copy submitted, HIP_ONESHOT_COPY_DEP=1
     waitFor = NULL;
 }
@@ -216,7 +300,7 @@ void UnpinnedCopyEngine::CopyHostToDevice(UnpinnedCopyEngine::CopyMode copyMode,
     bool isLocked = false;
     const char *srcp = static_cast<const char*> (src);
     info.size = sizeof(info);
-    if((copyMode == ChooseBest) || (copyMode == UsePinInPlace)) {
+    if((copyMode == ChooseBest) || (copyMode == UsePinInPlace) || (copyMode == UseCalibrated)) {
         hsa_status = hsa_amd_pointer_info(const_cast<char*> (srcp), &info, nullptr, nullptr, nullptr);
         if(hsa_status != HSA_STATUS_SUCCESS) {
             THROW_ERROR(hipErrorInvalidValue, HSA_STATUS_ERROR_INVALID_ARGUMENT);
@@ -226,6 +310,12 @@ void UnpinnedCopyEngine::CopyHostToDevice(UnpinnedCopyEngine::CopyMode copyMode,
             isLocked = true;
         }
     }
+    if (copyMode == UseCalibrated) {
+        copyMode = ChooseCalibrated(H2D, sizeBytes);
+        if ((copyMode == UsePinInPlace) && isLocked) {
+            copyMode = UseStaging;
+        }
+    }
     if (copyMode == ChooseBest) {
         if (_isLargeBar && (sizeBytes < _hipH2DTransferThresholdDirectOrStaging)) {
             copyMode = UseMemcpy;
@@ -237,12 +327,15 @@ void UnpinnedCopyEngine::CopyHostToDevice(UnpinnedCopyEngine::CopyMode copyMode,
     }
 
     if (copyMode == UseMemcpy) {
+        if (_counters) _counters->add(Kalmar::hcCounterCopyH2DMemcpy);
         CopyHostToDeviceMemcpy(dst, src, sizeBytes, waitFor);
 
 	} else if ((copyMode == UsePinInPlace) && (!isLocked)) {
+        if (_counters) _counters->add(Kalmar::hcCounterCopyH2DPinInPlace);
         CopyHostToDevicePinInPlace(dst, src, sizeBytes, waitFor);
 
 	} else if (copyMode == UseStaging) {
+        if (_counters) _counters->add(Kalmar::hcCounterCopyH2DStaging);
         CopyHostToDeviceStaging(dst, src, sizeBytes, waitFor);
 
     } else {
@@ -260,13 +353,14 @@ void UnpinnedCopyEngine::CopyHostToDevice(UnpinnedCopyEngine::CopyMode copyMode,
 void UnpinnedCopyEngine::CopyHostToDeviceStaging(void* dst, const void* src, size_t sizeBytes, hsa_signal_t *waitFor)
 {
 	{
-        std::lock_guard<std::mutex> l (_copyLock);
+        StagingRing &ring = LockRing();
+        std::lock_guard<std::mutex> l (ring._copyLock, std::adopt_lock);
 
         const char *srcp = static_cast<const char*> (src);
         char *dstp = static_cast<char*> (dst);
 
         for (int i=0; i<_numBuffers; i++) {
-            hsa_signal_store_relaxed(_completionSignal[i], 0);
+            hsa_signal_store_relaxed(ring._completionSignal[i], 0);
         }
 
         if (sizeBytes >= UINT64_MAX/2) {
@@ -277,19 +371,18 @@ void UnpinnedCopyEngine::CopyHostToDeviceStaging(void* dst, const void* src, siz
 
             size_t theseBytes = (bytesRemaining > _bufferSize) ? _bufferSize : bytesRemaining;
 
-            DBOUTL (DB_COPY2,  "H2D: waiting... on completion signal handle=" << _completionSignal[bufferIndex].handle);
-            hsa_signal_wait_acquire(_completionSignal[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
+            DBOUTL (DB_COPY2,  "H2D: waiting... on completion signal handle=" << ring._completionSignal[bufferIndex].handle);
+            hsa_signal_wait_acquire(ring._completionSignal[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
 
             DBOUTL (DB_COPY2, "H2D: bytesRemaining=" << bytesRemaining << ": copy " << theseBytes << " bytes " 
-                    << static_cast<const void*>(srcp) << " to stagingBuf[" << bufferIndex << "]:" << static_cast<void*>(_pinnedStagingBuffer[bufferIndex])); 
-            // TODO - use uncached memcpy, someday.
-            memcpy(_pinnedStagingBuffer[bufferIndex], srcp, theseBytes);
+                    << static_cast<const void*>(srcp) << " to stagingBuf[" << bufferIndex << "]:" << static_cast<void*>(ring._pinnedStagingBuffer[bufferIndex])); 
+            PackStaging(ring._pinnedStagingBuffer[bufferIndex], srcp, theseBytes);
 
 
-            hsa_signal_store_relaxed(_completionSignal[bufferIndex], 1);
-            hsa_status_t hsa_status = hsa_amd_memory_async_copy(dstp, _hsaAgent, _pinnedStagingBuffer[bufferIndex], _hsaAgent, theseBytes, waitFor ? 1:0, waitFor, _completionSignal[bufferIndex]);
+            hsa_signal_store_relaxed(ring._completionSignal[bufferIndex], 1);
+            hsa_status_t hsa_status = hsa_amd_memory_async_copy(dstp, _hsaAgent, ring._pinnedStagingBuffer[bufferIndex], _hsaAgent, theseBytes, waitFor ? 1:0, waitFor, ring._completionSignal[bufferIndex]);
             DBOUTL (DB_COPY2, "H2D: bytesRemaining=" << bytesRemaining << ": async_copy " << theseBytes << " bytes " 
-                    << static_cast<void*>(_pinnedStagingBuffer[bufferIndex]) << " to " << static_cast<void*>(dstp) << " status=" << hsa_status);
+                    << static_cast<void*>(ring._pinnedStagingBuffer[bufferIndex]) << " to " << static_cast<void*>(dstp) << " status=" << hsa_status);
             if (hsa_status != HSA_STATUS_SUCCESS) {
                 THROW_ERROR (hipErrorRuntimeMemory, hsa_status);
             }
@@ -306,7 +399,7 @@ void UnpinnedCopyEngine::CopyHostToDeviceStaging(void* dst, const void* src, siz
 
 
         for (int i=0; i<_numBuffers; i++) {
-            hsa_signal_wait_acquire(_completionSignal[i], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
+            hsa_signal_wait_acquire(ring._completionSignal[i], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
         }
 	}
 }
@@ -314,13 +407,14 @@ void UnpinnedCopyEngine::CopyHostToDeviceStaging(void* dst, const void* src, siz
 
 void UnpinnedCopyEngine::CopyDeviceToHostPinInPlace(void* dst, const void* src, size_t sizeBytes, hsa_signal_t *waitFor)
 {
-    std::lock_guard<std::mutex> l (_copyLock);
+    StagingRing &ring = LockRing();
+    std::lock_guard<std::mutex> l (ring._copyLock, std::adopt_lock);
 
     const char *srcp = static_cast<const char*> (src);
     char *dstp = static_cast<char*> (dst);
 
     for (int i=0; i<_numBuffers; i++) {
-        hsa_signal_store_relaxed(_completionSignal[i], 0);
+        hsa_signal_store_relaxed(ring._completionSignal[i], 0);
     }
 
     if (sizeBytes >= UINT64_MAX/2) {
@@ -328,25 +422,19 @@ void UnpinnedCopyEngine::CopyDeviceToHostPinInPlace(void* dst, const void* src,
     }
     int bufferIndex = 0;
     size_t theseBytes= sizeBytes;
-    void *locked_destp;
+    bool cached;
+    void *locked_destp = PinHostMemory(dstp, theseBytes, &cached);
 
-    hsa_status_t hsa_status = hsa_amd_memory_lock(const_cast<char*> (dstp), theseBytes, &_hsaAgent, 1, &locked_destp);
+    hsa_signal_store_relaxed(ring._completionSignal[bufferIndex], 1);
 
+    hsa_status_t hsa_status = hsa_amd_memory_async_copy(locked_destp,_hsaAgent , srcp, _hsaAgent, theseBytes, waitFor ? 1:0, waitFor, ring._completionSignal[bufferIndex]);
 
     if (hsa_status != HSA_STATUS_SUCCESS) {
         THROW_ERROR (hipErrorRuntimeMemory, hsa_status);
     }
-
-    hsa_signal_store_relaxed(_completionSignal[bufferIndex], 1);
-
-    hsa_status = hsa_amd_memory_async_copy(locked_destp,_hsaAgent , srcp, _hsaAgent, theseBytes, waitFor ? 1:0, waitFor, _completionSignal[bufferIndex]);
-
-    if (hsa_status != HSA_STATUS_SUCCESS) {
-        THROW_ERROR (hipErrorRuntimeMemory, hsa_status);
-    }
-    DBOUTL (DB_COPY2, "D2H: waiting... on completion signal handle=\n" << _completionSignal[bufferIndex].handle);
-    hsa_signal_wait_acquire(_completionSignal[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
-    hsa_amd_memory_unlock(const_cast<char*> (dstp));
+    DBOUTL (DB_COPY2, "D2H: waiting... on completion signal handle=\n" << ring._completionSignal[bufferIndex].handle);
+    hsa_signal_wait_acquire(ring._completionSignal[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
+    UnpinHostMemory(dstp, cached);
 
     // Assume subsequent commands are dependent on previous and don't need dependency after first copy submitted, HIP_ONESHOT_COPY_DEP=1
     waitFor = NULL;
@@ -355,6 +443,9 @@ void UnpinnedCopyEngine::CopyDeviceToHostPinInPlace(void* dst, const void* src,
 
 void UnpinnedCopyEngine::CopyDeviceToHost(CopyMode copyMode ,void* dst, const void* src, size_t sizeBytes, hsa_signal_t *waitFor)
 {
+    if (copyMode == UseCalibrated) {
+        copyMode = ChooseCalibrated(D2H, sizeBytes);
+    }
     if (copyMode == ChooseBest) {
         if (sizeBytes > _hipD2HTransferThreshold) {
             copyMode = UsePinInPlace;
@@ -365,8 +456,10 @@ void UnpinnedCopyEngine::CopyDeviceToHost(CopyMode copyMode ,void* dst, const vo
 
 
 	if (copyMode == UsePinInPlace) {
+        if (_counters) _counters->add(Kalmar::hcCounterCopyD2HPinInPlace);
         CopyDeviceToHostPinInPlace(dst, src, sizeBytes, waitFor);
     } else if (copyMode == UseStaging) { 
+        if (_counters) _counters->add(Kalmar::hcCounterCopyD2HStaging);
         CopyDeviceToHostStaging(dst, src, sizeBytes, waitFor);
     } else {
         // Unknown copy mode.
@@ -382,13 +475,14 @@ void UnpinnedCopyEngine::CopyDeviceToHost(CopyMode copyMode ,void* dst, const vo
 void UnpinnedCopyEngine::CopyDeviceToHostStaging(void* dst, const void* src, size_t sizeBytes, hsa_signal_t *waitFor)
 {
     {
-        std::lock_guard<std::mutex> l (_copyLock);
+        StagingRing &ring = LockRing();
+        std::lock_guard<std::mutex> l (ring._copyLock, std::adopt_lock);
 
         const char *srcp0 = static_cast<const char*> (src);
         char *dstp1 = static_cast<char*> (dst);
 
         for (int i=0; i<_numBuffers; i++) {
-            hsa_signal_store_relaxed(_completionSignal[i], 0);
+            hsa_signal_store_relaxed(ring._completionSignal[i], 0);
         }
 
         if (sizeBytes >= UINT64_MAX/2) {
@@ -406,9 +500,9 @@ void UnpinnedCopyEngine::CopyDeviceToHostStaging(void* dst, const void* src, siz
                 size_t theseBytes = (bytesRemaining0 > _bufferSize) ? _bufferSize : bytesRemaining0;
 
                 DBOUTL (DB_COPY2, "D2H: bytesRemaining0=" << bytesRemaining0 << ": copy " << theseBytes << " bytes " 
-                        << static_cast<const void*>(srcp0) << " to stagingBuf[" << bufferIndex << "]:" << static_cast<void*>(_pinnedStagingBuffer[bufferIndex])); 
-                hsa_signal_store_relaxed(_completionSignal[bufferIndex], 1);
-                hsa_status_t hsa_status = hsa_amd_memory_async_copy(_pinnedStagingBuffer[bufferIndex], _hsaAgent, srcp0, _hsaAgent, theseBytes, waitFor ? 1:0, waitFor, _completionSignal[bufferIndex]);
+                        << static_cast<const void*>(srcp0) << " to stagingBuf[" << bufferIndex << "]:" << static_cast<void*>(ring._pinnedStagingBuffer[bufferIndex])); 
+                hsa_signal_store_relaxed(ring._completionSignal[bufferIndex], 1);
+                hsa_status_t hsa_status = hsa_amd_memory_async_copy(ring._pinnedStagingBuffer[bufferIndex], _hsaAgent, srcp0, _hsaAgent, theseBytes, waitFor ? 1:0, waitFor, ring._completionSignal[bufferIndex]);
                 if (hsa_status != HSA_STATUS_SUCCESS) {
                     THROW_ERROR (hipErrorRuntimeMemory, hsa_status);
                 }
@@ -426,11 +520,11 @@ void UnpinnedCopyEngine::CopyDeviceToHostStaging(void* dst, const void* src, siz
                 size_t theseBytes = (bytesRemaining1 > _bufferSize) ? _bufferSize : bytesRemaining1;
 
                 DBOUTL (DB_COPY2, "D2H: wait_completion[" << bufferIndex << "] bytesRemaining=" << bytesRemaining1);
-                hsa_signal_wait_acquire(_completionSignal[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
+                hsa_signal_wait_acquire(ring._completionSignal[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
 
                 DBOUTL (DB_COPY2, "D2H: bytesRemaining1=" << bytesRemaining1 << ": copy " << theseBytes << " bytes " 
-                        << " stagingBuf[" << bufferIndex << "]:" << static_cast<void*>(_pinnedStagingBuffer[bufferIndex]) << " to dst " << static_cast<void*>(dstp1)); 
-                memcpy(dstp1, _pinnedStagingBuffer[bufferIndex], theseBytes);
+                        << " stagingBuf[" << bufferIndex << "]:" << static_cast<void*>(ring._pinnedStagingBuffer[bufferIndex]) << " to dst " << static_cast<void*>(dstp1)); 
+                UnpackStaging(dstp1, ring._pinnedStagingBuffer[bufferIndex], theseBytes);
 
                 dstp1 += theseBytes;
             }
@@ -446,14 +540,15 @@ void UnpinnedCopyEngine::CopyDeviceToHostStaging(void* dst, const void* src, siz
 //IN: waitFor - hsaSignal to wait for - the copy will begin only when the specified dependency is resolved.  May be NULL indicating no dependency.
 void UnpinnedCopyEngine::CopyPeerToPeer(void* dst, hsa_agent_t dstAgent, const void* src, hsa_agent_t srcAgent, size_t sizeBytes, hsa_signal_t *waitFor)
 {
-    std::lock_guard<std::mutex> l (_copyLock);
+    StagingRing &ring = LockRing();
+    std::lock_guard<std::mutex> l (ring._copyLock, std::adopt_lock);
 
     const char *srcp0 = static_cast<const char*> (src);
     char *dstp1 = static_cast<char*> (dst);
 
     for (int i=0; i<_numBuffers; i++) {
-        hsa_signal_store_relaxed(_completionSignal[i], 0);
-        hsa_signal_store_relaxed(_completionSignal2[i], 0);
+        hsa_signal_store_relaxed(ring._completionSignal[i], 0);
+        hsa_signal_store_relaxed(ring._completionSignal2[i], 0);
     }
 
     if (sizeBytes >= UINT64_MAX/2) {
@@ -472,13 +567,13 @@ void UnpinnedCopyEngine::CopyPeerToPeer(void* dst, hsa_agent_t dstAgent, const v
             size_t theseBytes = (bytesRemaining0 > _bufferSize) ? _bufferSize : bytesRemaining0;
 
             // Wait to make sure we are not overwriting a buffer before it has been drained:
-            hsa_signal_wait_acquire(_completionSignal2[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
+            hsa_signal_wait_acquire(ring._completionSignal2[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
 
             DBOUTL (DB_COPY2, "P2P: bytesRemaining0=" << bytesRemaining0 << ": async_copy " << theseBytes << " bytes " 
-                    << static_cast<const void*>(srcp0) << " to stagingBuf[" << bufferIndex << "]:" << static_cast<void*>(_pinnedStagingBuffer[bufferIndex])); 
-            hsa_signal_store_relaxed(_completionSignal[bufferIndex], 1);
+                    << static_cast<const void*>(srcp0) << " to stagingBuf[" << bufferIndex << "]:" << static_cast<void*>(ring._pinnedStagingBuffer[bufferIndex])); 
+            hsa_signal_store_relaxed(ring._completionSignal[bufferIndex], 1);
             // Select CPU-agent here to ensure Runtime picks the H2D blit kernel.  Makes a 5X-10X difference in performance.
-            hsa_status_t hsa_status = hsa_amd_memory_async_copy(_pinnedStagingBuffer[bufferIndex], _cpuAgent, srcp0, srcAgent, theseBytes, waitFor ? 1:0, waitFor, _completionSignal[bufferIndex]);
+            hsa_status_t hsa_status = hsa_amd_memory_async_copy(ring._pinnedStagingBuffer[bufferIndex], _cpuAgent, srcp0, srcAgent, theseBytes, waitFor ? 1:0, waitFor, ring._completionSignal[bufferIndex]);
             if (hsa_status != HSA_STATUS_SUCCESS) {
                 THROW_ERROR (hipErrorRuntimeMemory, hsa_status);
             }
@@ -501,16 +596,16 @@ void UnpinnedCopyEngine::CopyPeerToPeer(void* dst, hsa_agent_t dstAgent, const v
 
             if (hostWait) {
                 // Host-side wait, should not be necessary:
-                hsa_signal_wait_acquire(_completionSignal[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
+                hsa_signal_wait_acquire(ring._completionSignal[bufferIndex], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
             }
 
             DBOUTL (DB_COPY2, "P2P: bytesRemaining1=" << bytesRemaining1 << ": copy " << theseBytes << " bytes " 
-                    << " stagingBuf[" << bufferIndex << "]:" << static_cast<void*>(_pinnedStagingBuffer[bufferIndex]) << " to dst " << static_cast<void*>(dstp1)); 
-            hsa_signal_store_relaxed(_completionSignal2[bufferIndex], 1);
+                    << " stagingBuf[" << bufferIndex << "]:" << static_cast<void*>(ring._pinnedStagingBuffer[bufferIndex]) << " to dst " << static_cast<void*>(dstp1)); 
+            hsa_signal_store_relaxed(ring._completionSignal2[bufferIndex], 1);
             // Select CPU-agent here to ensure Runtime picks the H2D blit kernel.  Makes a 5X-10X difference in performance.
-            hsa_status_t hsa_status = hsa_amd_memory_async_copy(dstp1, dstAgent, _pinnedStagingBuffer[bufferIndex], _cpuAgent, theseBytes,
-                                      hostWait ? 0:1, hostWait ? NULL : &_completionSignal[bufferIndex],
-                                      _completionSignal2[bufferIndex]);
+            hsa_status_t hsa_status = hsa_amd_memory_async_copy(dstp1, dstAgent, ring._pinnedStagingBuffer[bufferIndex], _cpuAgent, theseBytes,
+                                      hostWait ? 0:1, hostWait ? NULL : &ring._completionSignal[bufferIndex],
+                                      ring._completionSignal2[bufferIndex]);
 
             dstp1 += theseBytes;
         }
@@ -519,6 +614,191 @@ void UnpinnedCopyEngine::CopyPeerToPeer(void* dst, hsa_agent_t dstAgent, const v
 
     // Wait for the staging-buffer to dest copies to complete:
     for (int i=0; i<_numBuffers; i++) {
-        hsa_signal_wait_acquire(_completionSignal2[i], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
+        hsa_signal_wait_acquire(ring._completionSignal2[i], HSA_SIGNAL_CONDITION_LT, 1, UINT64_MAX, HSA_WAIT_STATE_ACTIVE);
+    }
+}
+
+
+//---
+// Calibration of the copy algorithms for UseCalibrated.
+
+static const char *copyModeName(UnpinnedCopyEngine::CopyMode mode)
+{
+    switch (mode) {
+        case UnpinnedCopyEngine::UsePinInPlace: return "PinInPlace";
+        case UnpinnedCopyEngine::UseStaging:    return "Staging";
+        case UnpinnedCopyEngine::UseMemcpy:     return "Memcpy";
+        default:                                return "ChooseBest";
+    }
+}
+
+
+static hsa_status_t findDevicePool(hsa_amd_memory_pool_t pool, void* data)
+{
+    hsa_amd_segment_t segment;
+    uint32_t flag;
+    bool allowed;
+    ErrorCheck(hsa_amd_memory_pool_get_info(pool, HSA_AMD_MEMORY_POOL_INFO_SEGMENT, &segment));
+    ErrorCheck(hsa_amd_memory_pool_get_info(pool, HSA_AMD_MEMORY_POOL_INFO_GLOBAL_FLAGS, &flag));
+    ErrorCheck(hsa_amd_memory_pool_get_info(pool, HSA_AMD_MEMORY_POOL_INFO_RUNTIME_ALLOC_ALLOWED, &allowed));
+    if ((HSA_AMD_SEGMENT_GLOBAL == segment) && allowed &&
+        (flag & HSA_AMD_MEMORY_POOL_GLOBAL_FLAG_COARSE_GRAINED)) {
+        *((hsa_amd_memory_pool_t*)data) = pool;
+        return HSA_STATUS_INFO_BREAK;
+    }
+    return HSA_STATUS_SUCCESS;
+}
+
+
+void UnpinnedCopyEngine::PrepareCalibrated(CopyDir dir)
+{
+    std::call_once(_calibrated[dir], [this, dir] {
+        if (!LoadProfile(dir)) {
+            Calibrate(dir);
+            SaveProfile(dir);
+        }
+        for (const Kalmar::CopyChoice &c : _calibration[dir].get()) {
+            DBOUTL (DB_COPY, "Calibrated " << (dir == H2D ? "H2D" : "D2H") << " copy " << c.sizeBytes << " bytes: "
+                    << copyModeName(static_cast<CopyMode> (c.mode)) << " " << c.bandwidth << " MB/s");
+        }
+    });
+}
+
+
+UnpinnedCopyEngine::CopyMode UnpinnedCopyEngine::ChooseCalibrated(CopyDir dir, size_t sizeBytes)
+{
+    PrepareCalibrated(dir);
+    return static_cast<CopyMode> (_calibration[dir].choose(sizeBytes, ChooseBest));
+}
+
+
+// Time each algorithm on sizes from 4KB to 16MB, between a temporary device buffer and unpinned
+// host memory.  Host memory is unpinned from the cache before each pin-in-place copy so that the
+// pinning cost is included, as for host buffers copied for the first time.
+void UnpinnedCopyEngine::Calibrate(CopyDir dir)
+{
+    static const size_t sizes[] = { 4<<10, 16<<10, 64<<10, 256<<10, 1<<20, 4<<20, 16<<20 };
+    static const size_t maxSize = 16<<20;
+
+    hsa_amd_memory_pool_t devPool = { 0 };
+    hsa_amd_agent_iterate_memory_pools(_hsaAgent, findDevicePool, &devPool);
+    void *devBuf = nullptr;
+    if ((devPool.handle == 0) || (hsa_amd_memory_pool_allocate(devPool, maxSize, 0, &devBuf) != HSA_STATUS_SUCCESS)) {
+        DBOUTL (DB_COPY, "Unpinned copy calibration: can't allocate device memory, using thresholds");
+        return;
+    }
+    if (_isLargeBar) {
+        hsa_amd_agents_allow_access(1, &_cpuAgent, NULL, devBuf);
+    }
+    char *hostBuf = static_cast<char*> (malloc(maxSize));
+    if (hostBuf == nullptr) {
+        DBOUTL (DB_COPY, "Unpinned copy calibration: can't allocate host memory, using thresholds");
+        hsa_amd_memory_pool_free(devBuf);
+        return;
+    }
+    memset(hostBuf, 0, maxSize);
+
+    std::vector<CopyMode> modes = { UseStaging, UsePinInPlace };
+    if ((dir == H2D) && _isLargeBar) {
+        modes.push_back(UseMemcpy);
+    }
+
+    auto run = [&](CopyMode mode, size_t size) {
+        if ((mode == UsePinInPlace) && _pinnedHostCache) {
+            _pinnedHostCache->invalidate(hostBuf, size);
+        }
+        if (dir == H2D) {
+            switch (mode) {
+                case UseStaging:    CopyHostToDeviceStaging(devBuf, hostBuf, size, NULL); break;
+                case UsePinInPlace: CopyHostToDevicePinInPlace(devBuf, hostBuf, size, NULL); break;
+                default:            CopyHostToDeviceMemcpy(devBuf, hostBuf, size, NULL); break;
+            }
+        } else {
+            switch (mode) {
+                case UseStaging:    CopyDeviceToHostStaging(hostBuf, devBuf, size, NULL); break;
+                default:            CopyDeviceToHostPinInPlace(hostBuf, devBuf, size, NULL); break;
+            }
+        }
+    };
+
+    for (size_t size : sizes) {
+        Kalmar::CopyChoice best = { size, ChooseBest, 0.0 };
+        int reps = static_cast<int> ((64<<20) / size);
+        reps = reps < 3 ? 3 : (reps > 64 ? 64 : reps);
+
+        for (CopyMode mode : modes) {
+            run(mode, size); // warm up
+
+            auto start = std::chrono::steady_clock::now();
+            for (int i=0; i<reps; i++) {
+                run(mode, size);
+            }
+            double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            double bandwidth = (double(size) * reps) / s / 1e6;
+
+            DBOUTL (DB_COPY2, "Unpinned copy calibration: " << (dir == H2D ? "H2D " : "D2H ") << copyModeName(mode)
+                    << " " << size << " bytes: " << bandwidth << " MB/s");
+            if (bandwidth > best.bandwidth) {
+                best.mode = mode;
+                best.bandwidth = bandwidth;
+            }
+        }
+        _calibration[dir].add(best);
+    }
+
+    if (_pinnedHostCache) {
+        _pinnedHostCache->invalidate(hostBuf, maxSize);
+    }
+    free(hostBuf);
+    hsa_amd_memory_pool_free(devBuf);
+}
+
+
+// Measurements depend on the device and on the NUMA node of the host memory.
+std::string UnpinnedCopyEngine::ProfileKey(CopyDir dir)
+{
+    char name[64] = { 0 };
+    uint32_t node = 0, cpuNode = 0;
+    hsa_agent_get_info(_hsaAgent, HSA_AGENT_INFO_NAME, name);
+    hsa_agent_get_info(_hsaAgent, HSA_AGENT_INFO_NODE, &node);
+    hsa_agent_get_info(_cpuAgent, HSA_AGENT_INFO_NODE, &cpuNode);
+
+    std::ostringstream key;
+    key << name << ":" << node << ":" << cpuNode << " " << (dir == H2D ? "H2D" : "D2H");
+    return key.str();
+}
+
+
+// Profile lines are "<device>:<node>:<cpu node> <H2D|D2H> <size> <mode> <MB/s>".
+bool UnpinnedCopyEngine::LoadProfile(CopyDir dir)
+{
+    if (_profilePath.empty()) {
+        return false;
+    }
+    std::ifstream in(_profilePath);
+    bool memcpyAllowed = (dir == H2D) && _isLargeBar;
+    return _calibration[dir].load(in, ProfileKey(dir), [memcpyAllowed](int mode) {
+        return (mode == UseStaging) || (mode == UsePinInPlace) || ((mode == UseMemcpy) && memcpyAllowed);
+    });
+}
+
+
+void UnpinnedCopyEngine::SaveProfile(CopyDir dir)
+{
+    if (_profilePath.empty() || _calibration[dir].empty()) {
+        return;
+    }
+    // engines of all the devices share the file
+    static std::mutex profileLock;
+    std::lock_guard<std::mutex> l (profileLock);
+
+    std::string tmpPath = _profilePath + ".tmp";
+    {
+        std::ifstream in(_profilePath);
+        std::ofstream out(tmpPath);
+        if (!_calibration[dir].save(in, out, ProfileKey(dir))) {
+            return;
+        }
     }
+    rename(tmpPath.c_str(), _profilePath.c_str());
 }
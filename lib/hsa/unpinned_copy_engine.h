@@ -21,7 +21,34 @@ THE SOFTWARE.
 #ifndef STAGING_BUFFER_H
 #define STAGING_BUFFER_H
 
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include "hsa/hsa.h"
+#include "hsa/hsa_ext_amd.h"
+#include "hsa_api.h"
+
+#include "kalmar_counters.h"
+#include "kalmar_copy_profile.h"
+#include "kalmar_pinned_cache.h"
+#include "kalmar_staging.h"
+
+
+//-------------------------------------------------------------------------------------------------
+// Pins host memory for a single agent, backend of the pinned host memory cache.
+struct HsaPinBackend {
+    hsa_agent_t agent;
+
+    bool lock(void* host, size_t size, void** va) {
+        return hsa_amd_memory_lock(host, size, &agent, 1, va) == HSA_STATUS_SUCCESS;
+    }
+    void unlock(void* host) {
+        hsa_amd_memory_unlock(host);
+    }
+};
+
+typedef Kalmar::PinnedHostCache<HsaPinBackend> HsaPinnedHostCache;
 
 
 //-------------------------------------------------------------------------------------------------
@@ -34,19 +61,42 @@ THE SOFTWARE.
 // with the DMA copies.
 //
 // PinInPlace is another algorithm which pins the host memory "in-place", and copies it with the DMA
-// engine.  This routine is under development.
+// engine.  If a pinned host cache is provided, the pinned ranges are kept in it for later copies
+// instead of being unpinned after each copy.
 //
-// Staging buffer provides thread-safe access via a mutex.
+// The staging buffers are organized in independent rings, each protected by a mutex, so that copies
+// from several threads proceed in parallel.  A copy takes the first free ring.  The CPU side of
+// large staging copies is split over helper threads, and H2D packing uses streaming stores since
+// the staging buffers are only read by the DMA engine.
+//
+// UseCalibrated picks the algorithm from the bandwidth of each one, measured on this machine for a
+// range of sizes, or read from a profile saved by an earlier run.  Measuring copies about 500MB in
+// each direction and takes a second or so: the device measures when it is created with that mode,
+// see PrepareCalibrated, rather than inside of the first copy of the application.
 struct UnpinnedCopyEngine {
 
-    enum CopyMode {ChooseBest=0, UsePinInPlace=1, UseStaging=2, UseMemcpy=3} ; 
+    enum CopyMode {ChooseBest=0, UsePinInPlace=1, UseStaging=2, UseMemcpy=3, UseCalibrated=4} ; 
+    enum CopyDir {H2D=0, D2H=1};
 
-    static const int _max_buffers = 4;
+    static const int _max_buffers = 16;
+    static const int _max_rings = 16;
 
     UnpinnedCopyEngine(hsa_agent_t hsaAgent,hsa_agent_t cpuAgent, size_t bufferSize, int numBuffers, 
-                       bool isLargeBar, int thresholdH2D_directStaging, int thresholdH2D_stagingPinInPlace, int thresholdD2H) ;
+                       bool isLargeBar, int thresholdH2D_directStaging, int thresholdH2D_stagingPinInPlace, int thresholdD2H,
+                       HsaPinnedHostCache *pinnedHostCache=nullptr, int numRings=1,
+                       Kalmar::CopyWorkerPool *packers=nullptr) ;
     ~UnpinnedCopyEngine();
 
+    // File to read the UseCalibrated measurements from, or to save them to once made.  Empty to
+    // measure in each process.
+    void SetCopyProfile(const std::string &path) { _profilePath = path; }
+
+    // Load or measure the algorithms used by UseCalibrated copies in direction dir, if not done yet.
+    void PrepareCalibrated(CopyDir dir);
+
+    // Counters of the algorithms chosen by CopyHostToDevice and CopyDeviceToHost, may be NULL.
+    void SetCounters(Kalmar::RuntimeCounters *counters) { _counters = counters; }
+
     // Use hueristic to choose best copy algorithm 
     void CopyHostToDevice(CopyMode copyMode, void* dst, const void* src, size_t sizeBytes, hsa_signal_t *waitFor);
     void CopyDeviceToHost(CopyMode copyMode, void* dst, const void* src, size_t sizeBytes, hsa_signal_t *waitFor);
@@ -68,21 +118,54 @@ struct UnpinnedCopyEngine {
 
 
 private:
+    // Staging buffers and signals used by one copy at a time.
+    struct StagingRing {
+        char            *_pinnedStagingBuffer[_max_buffers];
+        hsa_signal_t     _completionSignal[_max_buffers];
+        hsa_signal_t     _completionSignal2[_max_buffers]; // P2P needs another set of signals.
+        std::mutex       _copyLock;    // provide thread-safe access
+    };
+
+    // Algorithm for a UseCalibrated copy, ChooseBest if it could not be measured.
+    CopyMode ChooseCalibrated(CopyDir dir, size_t sizeBytes);
+    void Calibrate(CopyDir dir);
+    bool LoadProfile(CopyDir dir);
+    void SaveProfile(CopyDir dir);
+    std::string ProfileKey(CopyDir dir);
+
+    // Returns a ring with its _copyLock held, preferring one no other copy is using.
+    StagingRing &LockRing();
+
+    // Pin host memory for a pin-in-place copy, returns the pointer the DMA engine uses.
+    void *PinHostMemory(const void *host, size_t sizeBytes, bool *cached);
+    void UnpinHostMemory(const void *host, bool cached);
+
+    // CPU copies into and out of the staging buffers.
+    void PackStaging(void *dst, const void *src, size_t sizeBytes);
+    void UnpackStaging(void *dst, const void *src, size_t sizeBytes);
+
     hsa_agent_t     _hsaAgent;
     hsa_agent_t     _cpuAgent;
     size_t          _bufferSize;  // Size of the buffers.
     int             _numBuffers;
+    int             _numRings;
 
     // True if system supports large-bar and thus can benefit from CPU directly performing copy operation.
     bool            _isLargeBar;
 
-    char            *_pinnedStagingBuffer[_max_buffers];
-    hsa_signal_t     _completionSignal[_max_buffers];
-    hsa_signal_t     _completionSignal2[_max_buffers]; // P2P needs another set of signals.
-    std::mutex       _copyLock;    // provide thread-safe access
+    StagingRing     _rings[_max_rings];
+    std::atomic<unsigned> _nextRing;
+
+    Kalmar::CopyWorkerPool *_packers; // splits the CPU copies, may be NULL
     size_t              _hipH2DTransferThresholdDirectOrStaging;
     size_t              _hipH2DTransferThresholdStagingOrPininplace;
     size_t              _hipD2HTransferThreshold;
+    HsaPinnedHostCache  *_pinnedHostCache; // may be NULL
+    Kalmar::RuntimeCounters *_counters;    // may be NULL
+
+    std::string              _profilePath;
+    Kalmar::CopyProfile      _calibration[2];  // per CopyDir
+    std::once_flag           _calibrated[2];
 };
 
 #endif
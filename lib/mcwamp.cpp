@@ -374,6 +374,14 @@ KalmarContext *getContext() {
   return static_cast<KalmarContext*>(CLAMP::GetOrInitRuntime()->m_GetContextImpl());
 }
 
+void addCompletionCallback(const std::shared_ptr<KalmarAsyncOp>& op,
+                           const std::shared_future<void>& future,
+                           std::function<void()> callback) {
+  // created on first use, runs the remaining continuations at exit
+  static CompletionDispatcher dispatcher;
+  dispatcher.add(op, future, std::move(callback));
+}
+
 // Kalmar runtime bootstrap logic
 class KalmarBootstrap {
 private:
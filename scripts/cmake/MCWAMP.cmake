@@ -97,8 +97,13 @@ macro(add_mcwamp_library_hc_am name )
   amp_target(${name})
   # LLVM and Clang shall be compiled beforehand
   add_dependencies(${name} llvm-link opt clang rocdl)
-  # add HSA libraries
-  target_link_libraries(${name} hsa-runtime64)
+  # add HSA libraries, or only the HSA headers for the CPU runtime
+  if (HAS_ROCM EQUAL 1)
+    target_link_libraries(${name} hsa-runtime64)
+  else (HAS_ROCM EQUAL 1)
+    target_include_directories(${name} SYSTEM PRIVATE ${HSA_HEADER})
+    target_compile_definitions(${name} PRIVATE KALMAR_HSA_API_NO_ROCR)
+  endif (HAS_ROCM EQUAL 1)
   target_link_libraries(${name} pthread)
 
   if (USE_LIBCXX)
@@ -0,0 +1,259 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+// Checks the cache behind am_alloc / am_free, on top of a stand-in memory
+// pool backend which counts the allocations and can run out of memory.
+
+#include <kalmar_alloc_cache.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Pool {
+    std::mutex mutex;
+    std::map<void*, size_t> live;
+    size_t bytes = 0;
+    size_t capacity = size_t(-1);
+    int allocs = 0;
+    int frees = 0;
+};
+
+struct FakeBackend {
+    typedef int Key;  // the pool
+
+    Pool* pools;
+
+    void* allocate(const int& key, size_t size) {
+        Pool& p = pools[key];
+        std::lock_guard<std::mutex> l(p.mutex);
+        if (p.bytes + size > p.capacity) {
+            return nullptr;
+        }
+        void* ptr = malloc(size);
+        p.live[ptr] = size;
+        p.bytes += size;
+        p.allocs++;
+        return ptr;
+    }
+
+    void free(const int& key, void* ptr) {
+        Pool& p = pools[key];
+        std::lock_guard<std::mutex> l(p.mutex);
+        auto it = p.live.find(ptr);
+        if (it == p.live.end()) {
+            abort();  // freed twice, or to the wrong pool
+        }
+        p.bytes -= it->second;
+        p.live.erase(it);
+        p.frees++;
+        ::free(ptr);
+    }
+};
+
+typedef Kalmar::AllocCache<FakeBackend> Cache;
+
+#define MB (1024 * 1024)
+
+#define CHECK(cond) \
+    if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); return false; }
+
+// 4 size classes per power of two, with a minimum
+bool test_classes() {
+    Pool pools[1];
+    Cache cache(FakeBackend{pools}, 64 * MB, 16 * MB);
+    CHECK(cache.blockSize(1) == 4096);
+    CHECK(cache.blockSize(4097) == 5120);
+    CHECK(cache.blockSize(6000) == 6144);
+    CHECK(cache.blockSize(8192) == 8192);
+    CHECK(cache.blockSize(MB + 1) == MB + MB / 4);
+    CHECK(cache.blockSize(32 * MB) == 32 * MB);
+    return true;
+}
+
+// released blocks are handed out again for the same key and class only
+bool test_reuse() {
+    Pool pools[2];
+    {
+        Cache cache(FakeBackend{pools}, 64 * MB, 16 * MB);
+        bool fresh;
+        void* a = cache.allocate(0, 5000, &fresh);
+        CHECK(a && fresh);
+        CHECK(cache.release(a));
+        CHECK(cache.getStats().bytesCached == 5120);
+
+        CHECK(cache.allocate(0, 4500, &fresh) == a && !fresh);
+        void* b = cache.allocate(0, 7000, &fresh);
+        CHECK(b != a && fresh);
+        cache.release(a);
+        void* c = cache.allocate(1, 5000, &fresh);
+        CHECK(c != a && fresh);
+
+        Kalmar::AllocCacheStats stats = cache.getStats();
+        CHECK(stats.hits == 1 && stats.misses == 3);
+        CHECK(stats.bytesInUse == 7168 + 5120 && stats.bytesCached == 5120);
+        CHECK(pools[0].allocs == 2 && pools[1].allocs == 1);
+
+        // not from the cache: left to the caller
+        int x;
+        CHECK(!cache.release(&x));
+        cache.release(b);
+        cache.release(c);
+    }
+    // everything freed with the cache
+    CHECK(pools[0].live.empty() && pools[1].live.empty());
+    return true;
+}
+
+// large blocks bypass the cache, and the cached bytes stay under the cap
+bool test_cap() {
+    Pool pools[1];
+    Cache cache(FakeBackend{pools}, 4 * MB, MB);
+    bool fresh;
+
+    void* big = cache.allocate(0, 2 * MB, &fresh);
+    CHECK(!cache.release(big));
+    FakeBackend{pools}.free(0, big);
+    CHECK(cache.getStats().bypassed == 1);
+
+    std::vector<void*> blocks;
+    for (int i = 0; i < 8; ++i) {
+        blocks.push_back(cache.allocate(0, MB, &fresh));
+    }
+    for (void* b : blocks) {
+        cache.release(b);
+    }
+    Kalmar::AllocCacheStats stats = cache.getStats();
+    CHECK(stats.bytesCached == 4 * MB && stats.evictions == 4);
+    CHECK(pools[0].live.size() == 4);
+
+    // the least recently released were freed
+    for (int i = 4; i < 8; ++i) {
+        CHECK(pools[0].live.count(blocks[i]) == 1);
+    }
+    return true;
+}
+
+// running out of memory frees the cached blocks of every key and retries
+bool test_trim() {
+    Pool pools[2];
+    Cache cache(FakeBackend{pools}, 64 * MB, 16 * MB);
+    bool fresh;
+    pools[0].capacity = 8 * MB;
+
+    void* a = cache.allocate(0, 4 * MB, &fresh);
+    void* b = cache.allocate(0, 4 * MB, &fresh);
+    void* c = cache.allocate(1, MB, &fresh);
+    cache.release(b);
+    cache.release(c);
+
+    // another class: needs the cached block's memory
+    void* d = cache.allocate(0, 2 * MB, &fresh);
+    CHECK(d != nullptr && fresh);
+    Kalmar::AllocCacheStats stats = cache.getStats();
+    CHECK(stats.trims == 1 && stats.failures == 0 && stats.blocksCached == 0);
+    CHECK(pools[1].live.empty());
+
+    // nothing left to trim
+    CHECK(cache.allocate(0, 4 * MB, &fresh) == nullptr);
+    CHECK(cache.getStats().failures == 1);
+
+    cache.release(a);
+    cache.release(d);
+    return true;
+}
+
+// reset frees the cached blocks of the matching keys and forgets the ones in
+// use, which their owner frees itself
+bool test_reset() {
+    Pool pools[2];
+    Cache cache(FakeBackend{pools}, 64 * MB, 16 * MB);
+    bool fresh;
+
+    void* a = cache.allocate(0, MB, &fresh);
+    void* b = cache.allocate(0, MB, &fresh);
+    void* c = cache.allocate(1, MB, &fresh);
+    cache.release(a);
+    cache.release(c);
+
+    CHECK(cache.reset([](int key) { return key == 0; }) == 1);
+    CHECK(pools[0].live.size() == 1 && pools[1].live.size() == 1);
+    CHECK(!cache.release(b));
+    FakeBackend{pools}.free(0, b);
+
+    // discard frees to the backend
+    void* d = cache.allocate(1, MB, &fresh);
+    CHECK(d == c && !fresh);
+    cache.discard(1, d);
+    CHECK(pools[1].live.empty() && cache.getStats().bytesInUse == 0);
+    return true;
+}
+
+// many threads allocating and freeing scratch buffers of a few sizes
+bool test_threads() {
+    const int threads = 8;
+    const int iters = 2000;
+    Pool pools[2];
+    std::atomic<int> errors(0);
+    {
+        Cache cache(FakeBackend{pools}, 16 * MB, 4 * MB);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                unsigned seed = t;
+                std::vector<char*> held;
+                for (int i = 0; i < iters; ++i) {
+                    seed = seed * 1103515245 + 12345;
+                    if (held.size() < 4 && (seed >> 16) % 3 != 0) {
+                        size_t size = size_t(1) << (10 + (seed >> 20) % 12);
+                        int key = (seed >> 8) & 1;
+                        bool fresh;
+                        char* p = static_cast<char*>(cache.allocate(key, size, &fresh));
+                        // blocks are never handed out twice
+                        p[0] = char(t);
+                        p[size - 1] = char(t);
+                        held.push_back(p);
+                    } else if (!held.empty()) {
+                        char* p = held.back();
+                        if (p[0] != char(t)) {
+                            errors++;
+                        }
+                        cache.release(p);
+                        held.pop_back();
+                    }
+                }
+                for (char* p : held) {
+                    cache.release(p);
+                }
+            });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+        Kalmar::AllocCacheStats stats = cache.getStats();
+        printf("threads: hits %llu misses %llu evictions %llu\n",
+               (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+               (unsigned long long)stats.evictions);
+        CHECK(stats.bytesInUse == 0 && stats.bytesCached <= 16 * MB);
+        CHECK(stats.hits > stats.misses);
+    }
+    CHECK(errors == 0);
+    CHECK(pools[0].live.empty() && pools[1].live.empty());
+    return true;
+}
+
+int main() {
+    bool ret = true;
+
+    ret &= test_classes();
+    ret &= test_reuse();
+    ret &= test_cap();
+    ret &= test_trim();
+    ret &= test_reset();
+    ret &= test_threads();
+
+    return !(ret == true);
+}
@@ -0,0 +1,125 @@
+// RUN: %hc %s -o %t.out -lhc_am && HCC_RUNTIME=CPU %t.out
+
+// Checks the am_* API on the CPU accelerator (HCC_RUNTIME=CPU): am_alloc
+// returns tracked host memory, copies, peer mapping and host locking work
+// without a GPU, and am_free / am_memtracker_reset release the memory and
+// the locks.
+
+#include <hc.hpp>
+#include <hc_am.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define CHECK(cond) \
+  if (!(cond)) { std::cerr << "line " << __LINE__ << ": " #cond " failed\n"; return false; }
+
+// allocations are tracked like device memory
+bool test_alloc() {
+  hc::accelerator acc;
+  CHECK(!acc.is_hsa_accelerator());
+
+  char* d = static_cast<char*>(hc::am_alloc(1000, acc, 0));
+  char* h = static_cast<char*>(hc::am_alloc(1000, acc, amHostPinned));
+  CHECK(d && h);
+
+  hc::AmPointerInfo info(nullptr, nullptr, 0, acc, false, false);
+  CHECK(hc::am_memtracker_getinfo(&info, d + 10) == AM_SUCCESS);
+  CHECK(info._devicePointer == d && info._sizeBytes == 1000);
+  CHECK(info._isInDeviceMem && info._isAmManaged && info._acc == acc);
+  CHECK(hc::am_memtracker_getinfo(&info, h) == AM_SUCCESS);
+  CHECK(!info._isInDeviceMem && info._hostPointer == h);
+
+  // peers: nothing to map
+  CHECK(hc::am_map_to_peers(d, 1, &acc) == AM_SUCCESS);
+
+  CHECK(hc::am_free(d) == AM_SUCCESS);
+  CHECK(hc::am_free(h) == AM_SUCCESS);
+  CHECK(hc::am_memtracker_getinfo(&info, d) != AM_SUCCESS);
+  CHECK(hc::am_free(d) != AM_SUCCESS);
+  return true;
+}
+
+// am_copy and accelerator_view::copy between host and "device" memory
+bool test_copy() {
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.get_default_view();
+  const int n = 1 << 16;
+  std::vector<int> src(n), dst(n, 0);
+  for (int i = 0; i < n; ++i)
+    src[i] = i;
+
+  int* d = static_cast<int*>(hc::am_alloc(n * sizeof(int), acc, 0));
+  CHECK(hc::am_copy(d, src.data(), n * sizeof(int)) == AM_SUCCESS);
+  av.copy(d, dst.data(), n * sizeof(int));
+  CHECK(dst == src);
+
+  // kernels see the memory
+  hc::parallel_for_each(av, hc::extent<1>(n), [=](hc::index<1> i) [[hc]] {
+    d[i[0]] *= 2;
+  });
+  CHECK(hc::am_copy(dst.data(), d, n * sizeof(int)) == AM_SUCCESS);
+  for (int i = 0; i < n; ++i)
+    CHECK(dst[i] == 2 * i);
+
+  hc::am_free(d);
+  return true;
+}
+
+// locking host memory tracks it
+bool test_host_lock() {
+  hc::accelerator acc;
+  std::vector<char> buffer(1 << 16);
+  CHECK(hc::am_memory_host_lock(acc, buffer.data(), buffer.size(), &acc, 1) == AM_SUCCESS);
+
+  hc::AmPointerInfo info(nullptr, nullptr, 0, acc, false, false);
+  CHECK(hc::am_memtracker_getinfo(&info, buffer.data() + 100) == AM_SUCCESS);
+  CHECK(!info._isAmManaged && info._hostPointer == buffer.data());
+
+  CHECK(hc::am_memory_host_unlock(acc, buffer.data()) == AM_SUCCESS);
+  CHECK(hc::am_memtracker_getinfo(&info, buffer.data()) != AM_SUCCESS);
+  return true;
+}
+
+// kB of locked memory of the process
+long lockedKb() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmLck:") == 0)
+      return std::stol(line.substr(6));
+  }
+  return -1;
+}
+
+// the reset frees the allocations of the accelerator, and unlocks the host
+// memory locked for it
+bool test_reset() {
+  hc::accelerator acc;
+  for (int i = 0; i < 10; ++i)
+    CHECK(hc::am_alloc(4096, acc, 0) != nullptr);
+  CHECK(hc::am_memtracker_reset(acc) == 10);
+
+  std::vector<char> buffer(1 << 16);
+  long before = lockedKb();
+  CHECK(hc::am_memory_host_lock(acc, buffer.data(), buffer.size(), &acc, 1) == AM_SUCCESS);
+  bool locked = lockedKb() > before;
+  CHECK(hc::am_memtracker_reset(acc) == 1);
+  // the lock is best effort, within the memlock limit
+  if (locked)
+    CHECK(lockedKb() == before);
+  return true;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test_alloc();
+  ret &= test_copy();
+  ret &= test_host_lock();
+  ret &= test_reset();
+
+  return !(ret == true);
+}
@@ -0,0 +1,122 @@
+// RUN: %hc %s -o %t.out -lhc_am && HCC_HSA_RUNTIME=mock HCC_AM_SLAB_MAX_SIZE=64 %t.out
+
+// Checks am_alloc / am_free of small device buffers sub-allocated from slabs
+// (HCC_AM_SLAB_MAX_SIZE), on the CPU emulation of the HSA runtime: each block
+// has its own tracker entry, and copies, frees and the tracker reset work on
+// the blocks.
+
+#include <hc.hpp>
+#include <hc_am.hpp>
+
+#include <iostream>
+#include <vector>
+
+#define CHECK(cond) \
+  if (!(cond)) { std::cerr << "line " << __LINE__ << ": " #cond " failed\n"; return false; }
+
+// neighbour blocks of a slab, each with its own base and size
+bool test_tracker() {
+  hc::accelerator acc;
+
+  char* a = static_cast<char*>(hc::am_alloc(1000, acc, 0));
+  char* b = static_cast<char*>(hc::am_alloc(1000, acc, 0));
+  CHECK(a && b && b == a + 1024);
+
+  hc::AmPointerInfo info(nullptr, nullptr, 0, acc, false, false);
+  CHECK(hc::am_memtracker_getinfo(&info, b + 10) == AM_SUCCESS);
+  CHECK(info._devicePointer == b && info._sizeBytes == 1000);
+  CHECK(info._isInDeviceMem && info._isAmManaged);
+
+  // the rest of a's block is not tracked
+  CHECK(hc::am_memtracker_getinfo(&info, a + 1000) != AM_SUCCESS);
+
+  CHECK(hc::am_free(a) == AM_SUCCESS);
+  CHECK(hc::am_memtracker_getinfo(&info, a) != AM_SUCCESS);
+  CHECK(hc::am_memtracker_getinfo(&info, b) == AM_SUCCESS);
+
+  // a's block is handed out again
+  char* c = static_cast<char*>(hc::am_alloc(800, acc, 0));
+  CHECK(c == a);
+  hc::am_free(b);
+  hc::am_free(c);
+  return true;
+}
+
+// larger buffers and pinned host memory are allocated on their own
+bool test_bypass() {
+  hc::accelerator acc;
+
+  char* small = static_cast<char*>(hc::am_alloc(64 * 1024, acc, 0));
+  char* big = static_cast<char*>(hc::am_alloc(64 * 1024 + 1, acc, 0));
+  char* pinned = static_cast<char*>(hc::am_alloc(256, acc, amHostPinned));
+  CHECK(small && big && pinned);
+
+  hc::AmPointerInfo info(nullptr, nullptr, 0, acc, false, false);
+  CHECK(hc::am_memtracker_getinfo(&info, pinned) == AM_SUCCESS && !info._isInDeviceMem);
+
+  hc::am_free(small);
+  hc::am_free(big);
+  hc::am_free(pinned);
+  return true;
+}
+
+// copies to and from blocks of the same slab
+bool test_copies() {
+  const int N = 200;
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.get_default_view();
+
+  std::vector<int> host(N), back(N, 0);
+  for (int i = 0; i < N; ++i) {
+    host[i] = i;
+  }
+
+  int* p = static_cast<int*>(hc::am_alloc(N * sizeof(int), acc, 0));
+  int* q = static_cast<int*>(hc::am_alloc(N * sizeof(int), acc, 0));
+  av.copy(host.data(), p, N * sizeof(int));
+  av.copy(p, q, N * sizeof(int));
+  av.copy(q, back.data(), N * sizeof(int));
+  CHECK(back == host);
+
+  // a kernel on the blocks
+  hc::parallel_for_each(av, hc::extent<1>(N), [=](hc::index<1> idx) [[hc]] {
+    q[idx[0]] = p[idx[0]] * 2;
+  });
+  av.copy(q, back.data(), N * sizeof(int));
+  for (int i = 0; i < N; ++i) {
+    CHECK(back[i] == 2 * i);
+  }
+  hc::am_free(p);
+  hc::am_free(q);
+  return true;
+}
+
+// the tracker reset frees the slabs with the blocks still allocated
+bool test_reset() {
+  hc::accelerator acc;
+
+  std::vector<void*> blocks;
+  for (int i = 0; i < 100; ++i) {
+    blocks.push_back(hc::am_alloc(512, acc, 0));
+  }
+  CHECK(hc::am_memtracker_reset(acc) >= blocks.size());
+
+  hc::AmPointerInfo info(nullptr, nullptr, 0, acc, false, false);
+  CHECK(hc::am_memtracker_getinfo(&info, blocks[0]) != AM_SUCCESS);
+
+  void* p = hc::am_alloc(512, acc, 0);
+  CHECK(p != nullptr);
+  hc::am_free(p);
+  return true;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test_tracker();
+  ret &= test_bypass();
+  ret &= test_copies();
+  ret &= test_reset();
+
+  return !(ret == true);
+}
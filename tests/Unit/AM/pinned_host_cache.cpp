@@ -0,0 +1,237 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+// Checks the pinned host memory cache used by the runtime for unpinned
+// copies, on top of a stand-in backend which records the lock/unlock calls.
+
+#include <kalmar_pinned_cache.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+
+#define PAGE 4096
+
+struct Pins {
+    std::map<uintptr_t, size_t> locked;
+    int locks = 0;
+    int unlocks = 0;
+    bool fail = false;
+};
+
+struct FakeBackend {
+    Pins* pins;
+
+    bool lock(void* host, size_t size, void** va) {
+        if (pins->fail) {
+            return false;
+        }
+        uintptr_t p = reinterpret_cast<uintptr_t>(host);
+        // ranges pinned by the cache never overlap
+        for (auto& l : pins->locked) {
+            if (l.first < p + size && p < l.first + l.second) {
+                return false;
+            }
+        }
+        pins->locked[p] = size;
+        pins->locks++;
+        // device view at a fixed offset, to check the translation
+        *va = reinterpret_cast<void*>(p + 0x10000000);
+        return true;
+    }
+
+    void unlock(void* host) {
+        pins->locked.erase(reinterpret_cast<uintptr_t>(host));
+        pins->unlocks++;
+    }
+};
+
+typedef Kalmar::PinnedHostCache<FakeBackend> Cache;
+
+static void* addr(uintptr_t page, uintptr_t offset = 0) {
+    return reinterpret_cast<void*>(0x100000000ull + page * PAGE + offset);
+}
+
+#define CHECK(cond) \
+    if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); return false; }
+
+// a hit reuses the pinned range and translates the pointer within it
+bool test_hit() {
+    Pins pins;
+    Cache cache(FakeBackend{&pins}, 16 * PAGE);
+    void* va;
+
+    CHECK(cache.acquire(addr(0, 100), 2 * PAGE, &va) == Cache::PIN_OK);
+    CHECK(va == static_cast<char*>(addr(0, 100)) + 0x10000000);
+    CHECK(pins.locks == 1 && pins.locked[reinterpret_cast<uintptr_t>(addr(0))] == 3 * PAGE);
+    cache.release(addr(0, 100));
+
+    for (int i = 0; i < 10; ++i) {
+        CHECK(cache.acquire(addr(1, 8), PAGE, &va) == Cache::PIN_OK);
+        CHECK(va == static_cast<char*>(addr(1, 8)) + 0x10000000);
+        cache.release(addr(1, 8));
+    }
+
+    Kalmar::PinnedHostCacheStats stats = cache.getStats();
+    CHECK(stats.hits == 10 && stats.misses == 1);
+    CHECK(stats.entries == 1 && stats.bytesPinned == 3 * PAGE);
+    CHECK(pins.locks == 1 && pins.unlocks == 0);
+    return true;
+}
+
+// a miss merges the unused ranges it overlaps or touches
+bool test_merge() {
+    Pins pins;
+    Cache cache(FakeBackend{&pins}, 64 * PAGE);
+    void* va;
+
+    CHECK(cache.acquire(addr(0), PAGE, &va) == Cache::PIN_OK);
+    cache.release(addr(0));
+    CHECK(cache.acquire(addr(4), PAGE, &va) == Cache::PIN_OK);
+    cache.release(addr(4));
+    CHECK(cache.acquire(addr(10), PAGE, &va) == Cache::PIN_OK);
+    cache.release(addr(10));
+
+    // overlaps page 4, touches page 0
+    CHECK(cache.acquire(addr(1), 4 * PAGE, &va) == Cache::PIN_OK);
+    cache.release(addr(1));
+
+    Kalmar::PinnedHostCacheStats stats = cache.getStats();
+    CHECK(stats.merges == 2 && stats.entries == 2);
+    CHECK(pins.locked.size() == 2);
+    CHECK(pins.locked[reinterpret_cast<uintptr_t>(addr(0))] == 5 * PAGE);
+
+    // the union is a hit now
+    CHECK(cache.acquire(addr(0), 5 * PAGE, &va) == Cache::PIN_OK);
+    cache.release(addr(0));
+    CHECK(cache.getStats().hits == 1);
+    return true;
+}
+
+// ranges in use are neither merged nor evicted
+bool test_busy() {
+    Pins pins;
+    Cache cache(FakeBackend{&pins}, 0);
+    void* va;
+    void* va2;
+
+    CHECK(cache.acquire(addr(0), 2 * PAGE, &va) == Cache::PIN_OK);
+    CHECK(cache.acquire(addr(1), 2 * PAGE, &va2) == Cache::PIN_BUSY);
+    // adjacent range in use: pinned separately
+    CHECK(cache.acquire(addr(2), PAGE, &va2) == Cache::PIN_OK);
+    CHECK(pins.locked.size() == 2);
+
+    // cap 0: unpinned as soon as released
+    cache.release(addr(2));
+    CHECK(pins.locked.size() == 1);
+    cache.release(addr(0));
+    CHECK(pins.locked.empty() && pins.unlocks == 2);
+    CHECK(cache.getStats().bytesPinned == 0);
+    return true;
+}
+
+// least recently used ranges are unpinned first to stay under the cap
+bool test_lru() {
+    Pins pins;
+    Cache cache(FakeBackend{&pins}, 3 * PAGE);
+    void* va;
+
+    for (int i = 0; i < 3; ++i) {
+        CHECK(cache.acquire(addr(2 * i), PAGE, &va) == Cache::PIN_OK);
+        cache.release(addr(2 * i));
+    }
+    // make page 0 the most recently used
+    CHECK(cache.acquire(addr(0), PAGE, &va) == Cache::PIN_OK);
+    cache.release(addr(0));
+
+    CHECK(cache.acquire(addr(8), PAGE, &va) == Cache::PIN_OK);
+    cache.release(addr(8));
+
+    Kalmar::PinnedHostCacheStats stats = cache.getStats();
+    CHECK(stats.evictions == 1 && stats.bytesPinned == 3 * PAGE);
+    CHECK(pins.locked.count(reinterpret_cast<uintptr_t>(addr(2))) == 0);
+    CHECK(pins.locked.count(reinterpret_cast<uintptr_t>(addr(0))) == 1);
+    return true;
+}
+
+// invalidated ranges are unpinned, when no longer in use if they are
+bool test_invalidate() {
+    Pins pins;
+    Cache cache(FakeBackend{&pins}, 64 * PAGE);
+    void* va;
+
+    CHECK(cache.acquire(addr(0), PAGE, &va) == Cache::PIN_OK);
+    cache.release(addr(0));
+    CHECK(cache.acquire(addr(4), PAGE, &va) == Cache::PIN_OK);
+
+    cache.invalidate(addr(0, 16), 8 * PAGE);
+    CHECK(pins.locked.size() == 1);
+    CHECK(cache.getStats().invalidations == 2);
+
+    // the stale range is neither reused nor merged
+    void* va2;
+    CHECK(cache.acquire(addr(4), PAGE, &va2) == Cache::PIN_BUSY);
+
+    cache.release(addr(4));
+    CHECK(pins.locked.empty());
+
+    CHECK(cache.acquire(addr(4), PAGE, &va) == Cache::PIN_OK);
+    cache.release(addr(4));
+    CHECK(cache.getStats().misses == 4);
+    return true;
+}
+
+// with a cap of 0 nothing outlives its copies: memory freed and mapped again
+// at the same address is pinned again
+bool test_no_retention() {
+    Pins pins;
+    Cache cache(FakeBackend{&pins}, 0);
+    void* va;
+
+    CHECK(cache.acquire(addr(0), 4 * PAGE, &va) == Cache::PIN_OK);
+    void* va2;
+    CHECK(cache.acquire(addr(1), PAGE, &va2) == Cache::PIN_OK);
+    CHECK(cache.getStats().hits == 1);
+    cache.release(addr(1));
+    CHECK(pins.locked.size() == 1);
+    cache.release(addr(0));
+    CHECK(pins.locked.empty());
+
+    CHECK(cache.acquire(addr(0), 4 * PAGE, &va) == Cache::PIN_OK);
+    cache.release(addr(0));
+    CHECK(pins.locks == 2 && pins.locked.empty());
+    return true;
+}
+
+// backend failures are reported and nothing is cached
+bool test_failure() {
+    Pins pins;
+    void* va;
+    {
+        Cache cache(FakeBackend{&pins}, 64 * PAGE);
+        pins.fail = true;
+        CHECK(cache.acquire(addr(0), PAGE, &va) == Cache::PIN_FAILED);
+        cache.release(addr(0));
+        CHECK(cache.getStats().failures == 1 && cache.getStats().entries == 0);
+
+        pins.fail = false;
+        CHECK(cache.acquire(addr(0), PAGE, &va) == Cache::PIN_OK);
+        cache.release(addr(0));
+    }
+    // the cache unpins everything on destruction
+    CHECK(pins.locked.empty() && pins.locks == pins.unlocks);
+    return true;
+}
+
+int main() {
+    bool ret = true;
+
+    ret &= test_hit();
+    ret &= test_merge();
+    ret &= test_busy();
+    ret &= test_lru();
+    ret &= test_invalidate();
+    ret &= test_no_retention();
+    ret &= test_failure();
+
+    return !(ret == true);
+}
@@ -0,0 +1,71 @@
+// RUN: %hc %s -o %t.out -lhc_am && %t.out && HCC_PIN_CACHE_SIZE=256 %t.out
+
+// Host memory copied to the device, freed, and allocated again at the same
+// address is copied with its new pages: by default the pinned ranges do not
+// outlive their copies, and with HCC_PIN_CACHE_SIZE > 0 the application
+// invalidates them before freeing.
+
+#include <hc.hpp>
+#include <hc_am.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#define CHECK(cond) \
+  if (!(cond)) { std::cerr << "line " << __LINE__ << ": " #cond " failed\n"; return false; }
+
+// large enough for malloc to map it on its own, and for pin-in-place copies
+#define SIZE (64 << 20)
+
+bool test_realloc(bool invalidate) {
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.get_default_view();
+  const size_t n = SIZE / sizeof(int);
+
+  int* dev = static_cast<int*>(hc::am_alloc(SIZE, acc, 0));
+  CHECK(dev != nullptr);
+  std::vector<int> back(n);
+
+  int* first = nullptr;
+  int sameAddress = 0;
+  for (int round = 0; round < 4; ++round) {
+    int* host = static_cast<int*>(malloc(SIZE));
+    CHECK(host != nullptr);
+    sameAddress += (host == first);
+    first = host;
+    for (size_t i = 0; i < n; ++i)
+      host[i] = round * 7 + int(i);
+
+    av.copy(host, dev, SIZE);
+    av.copy(dev, back.data(), SIZE);
+    for (size_t i = 0; i < n; i += 4099)
+      CHECK(back[i] == round * 7 + int(i));
+
+    if (invalidate)
+      hc::am_memory_host_cache_invalidate(host, SIZE);
+    free(host);
+  }
+  if (sameAddress == 0)
+    std::cout << "note: malloc never returned the freed address\n";
+
+  hc::AmPinnedHostCacheStats stats;
+  if (!invalidate && hc::am_memory_host_cache_stats(acc, &stats) == AM_SUCCESS)
+    CHECK(stats.bytesPinned == 0);
+
+  hc::am_free(dev);
+  return true;
+}
+
+int main() {
+  bool ret = true;
+
+  const char* size = getenv("HCC_PIN_CACHE_SIZE");
+  bool retains = size && atoi(size) > 0;
+
+  if (!retains)
+    ret &= test_realloc(false);
+  ret &= test_realloc(true);
+
+  return !(ret == true);
+}
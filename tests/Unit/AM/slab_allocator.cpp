@@ -0,0 +1,266 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+// Checks the slab sub-allocator behind small array buffers and am_alloc, on
+// top of a stand-in backend which counts the slabs: the memory reserved for
+// many small blocks, the blocks and slabs of interior pointers, and the
+// release of empty slabs.
+
+#include <kalmar_slab.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Slabs {
+    std::mutex mutex;
+    std::map<void*, size_t> live;
+    size_t bytes = 0;
+    int allocs = 0;
+    int frees = 0;
+};
+
+struct FakeBackend {
+    Slabs* slabs;
+
+    void* allocate(size_t size) {
+        std::lock_guard<std::mutex> l(slabs->mutex);
+        void* ptr = Kalmar::kalmar_aligned_alloc(0x1000, size);
+        slabs->live[ptr] = size;
+        slabs->bytes += size;
+        slabs->allocs++;
+        return ptr;
+    }
+
+    void free(void* ptr) {
+        std::lock_guard<std::mutex> l(slabs->mutex);
+        auto it = slabs->live.find(ptr);
+        if (it == slabs->live.end()) {
+            abort();  // not a slab, or freed twice
+        }
+        slabs->bytes -= it->second;
+        slabs->live.erase(it);
+        slabs->frees++;
+        Kalmar::kalmar_aligned_free(ptr);
+    }
+};
+
+typedef Kalmar::SlabAllocator<FakeBackend> Allocator;
+
+#define KB 1024
+
+#define CHECK(cond) \
+    if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); return false; }
+
+// many small buffers take a fraction of a page each, instead of a page
+bool test_overhead() {
+    const int count = 10000;
+    Slabs slabs;
+    {
+        Allocator alloc(FakeBackend{&slabs}, 64 * KB);
+        std::vector<void*> blocks;
+        for (int i = 0; i < count; ++i) {
+            void* p = alloc.allocate(48);
+            CHECK(p != nullptr);
+            CHECK(reinterpret_cast<uintptr_t>(p) % 256 == 0);
+            blocks.push_back(p);
+        }
+        Kalmar::SlabStats stats = alloc.getStats();
+        printf("overhead: %d blocks of 48 bytes in %zu bytes, %zu slabs\n",
+               count, stats.bytesReserved, stats.slabs);
+        CHECK(stats.bytesUsed == size_t(count) * 256);
+        CHECK(stats.bytesReserved < size_t(count) * 4096 / 10);
+        CHECK(slabs.bytes == stats.bytesReserved);
+
+        for (void* p : blocks) {
+            CHECK(alloc.free(p));
+        }
+        // one empty slab kept for the next allocations
+        stats = alloc.getStats();
+        CHECK(stats.bytesUsed == 0 && stats.slabs == 1);
+    }
+    CHECK(slabs.live.empty());
+    return true;
+}
+
+// blocks of a class are packed in the same slab, other classes get theirs,
+// larger sizes are left to the caller
+bool test_classes() {
+    Slabs slabs;
+    Allocator alloc(FakeBackend{&slabs}, 64 * KB);
+
+    char* a = static_cast<char*>(alloc.allocate(1000));
+    char* b = static_cast<char*>(alloc.allocate(1024));
+    CHECK(b == a + 1024);
+    CHECK(alloc.blockSize(a) == 1024);
+
+    char* c = static_cast<char*>(alloc.allocate(5000));
+    CHECK(alloc.blockSize(c) == 5120);
+    CHECK(alloc.slabOf(c) != alloc.slabOf(a));
+
+    // 4 blocks of 64 KB: slabs are at most 256 KB
+    size_t bytes = 0;
+    void* d = alloc.allocate(64 * KB);
+    CHECK(d != nullptr && alloc.slabOf(d, &bytes) == d && bytes == 256 * KB);
+
+    CHECK(!alloc.handles(64 * KB + 1) && alloc.allocate(64 * KB + 1) == nullptr);
+    CHECK(!alloc.handles(0) && alloc.allocate(0) == nullptr);
+    CHECK(slabs.allocs == 3);
+
+    alloc.free(a);
+    alloc.free(b);
+    alloc.free(c);
+    alloc.free(d);
+    return true;
+}
+
+// interior pointers belong to their block's slab, but only block starts can
+// be freed
+bool test_interior() {
+    Slabs slabs;
+    Allocator alloc(FakeBackend{&slabs}, 64 * KB);
+
+    char* a = static_cast<char*>(alloc.allocate(4096));
+    char* b = static_cast<char*>(alloc.allocate(4096));
+    size_t bytes = 0;
+    void* base = alloc.slabOf(a + 100, &bytes);
+    CHECK(base == a && bytes == 128 * KB);
+    CHECK(alloc.slabOf(b + 4095) == base);
+    CHECK(alloc.slabOf(a + bytes) == nullptr);
+
+    CHECK(!alloc.free(a + 100));
+    int x;
+    CHECK(!alloc.free(&x) && alloc.slabOf(&x) == nullptr);
+    CHECK(alloc.getStats().frees == 0);
+
+    CHECK(alloc.free(a));
+    CHECK(alloc.free(b));
+    return true;
+}
+
+// a slab whose blocks are all free is given back once its class has another
+// empty slab, and freed blocks are reused first
+bool test_release() {
+    Slabs slabs;
+    Allocator alloc(FakeBackend{&slabs}, 64 * KB);
+
+    // 2 KB blocks, 32 per 64 KB slab
+    std::vector<void*> blocks;
+    for (int i = 0; i < 96; ++i) {
+        blocks.push_back(alloc.allocate(2 * KB));
+    }
+    CHECK(slabs.allocs == 3);
+
+    alloc.free(blocks[5]);
+    CHECK(alloc.allocate(2 * KB) == blocks[5]);
+
+    for (int i = 0; i < 64; ++i) {
+        alloc.free(blocks[i]);
+    }
+    Kalmar::SlabStats stats = alloc.getStats();
+    CHECK(stats.slabs == 2 && stats.slabsReleased == 1);
+    CHECK(slabs.frees == 1 && slabs.live.size() == 2);
+
+    // reset frees the slabs, blocks in use included
+    alloc.reset();
+    CHECK(slabs.live.empty() && alloc.getStats().bytesUsed == 0);
+    return true;
+}
+
+// blocks above 64 KB are never carved out of slabs, and the empty slabs kept
+// for later allocations stay under 1 MB
+bool test_limits() {
+    Slabs slabs;
+    Allocator alloc(FakeBackend{&slabs}, 1024 * KB);
+    CHECK(alloc.handles(64 * KB) && !alloc.handles(64 * KB + 1));
+    CHECK(alloc.allocate(128 * KB) == nullptr && slabs.allocs == 0);
+
+    // one block of each class from 16 KB to 64 KB, a 256 KB slab each
+    std::vector<void*> blocks;
+    for (size_t size = 16 * KB; size <= 64 * KB; size += 4 * KB) {
+        blocks.push_back(alloc.allocate(size));
+    }
+    Kalmar::SlabStats stats = alloc.getStats();
+    CHECK(stats.slabs == 9 && stats.bytesReserved == 9 * 256 * KB);
+
+    for (void* p : blocks) {
+        CHECK(alloc.free(p));
+    }
+    stats = alloc.getStats();
+    CHECK(stats.bytesUsed == 0 && stats.slabs == 4 && stats.bytesReserved == 1024 * KB);
+
+    // a kept slab is used again, which makes room for another one
+    void* p = alloc.allocate(16 * KB);
+    CHECK(p == blocks[0] && alloc.getStats().slabsCreated == 9);
+    CHECK(alloc.free(p));
+    return true;
+}
+
+// many threads allocating and freeing small buffers
+bool test_threads() {
+    const int threads = 8;
+    const int iters = 20000;
+    Slabs slabs;
+    std::atomic<int> errors(0);
+    {
+        Allocator alloc(FakeBackend{&slabs}, 64 * KB);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                unsigned seed = t;
+                std::vector<std::pair<char*, size_t> > held;
+                for (int i = 0; i < iters; ++i) {
+                    seed = seed * 1103515245 + 12345;
+                    if (held.size() < 64 && (seed >> 16) % 3 != 0) {
+                        size_t size = 16 + (seed >> 8) % (16 * KB);
+                        char* p = static_cast<char*>(alloc.allocate(size));
+                        // blocks are never handed out twice
+                        p[0] = char(t);
+                        p[size - 1] = char(t);
+                        held.push_back(std::make_pair(p, size));
+                    } else if (!held.empty()) {
+                        std::pair<char*, size_t> b = held.back();
+                        if (b.first[0] != char(t) || b.first[b.second - 1] != char(t)) {
+                            errors++;
+                        }
+                        if (!alloc.free(b.first)) {
+                            errors++;
+                        }
+                        held.pop_back();
+                    }
+                }
+                for (auto& b : held) {
+                    alloc.free(b.first);
+                }
+            });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+        Kalmar::SlabStats stats = alloc.getStats();
+        printf("threads: %llu allocations from %llu slabs\n",
+               (unsigned long long)stats.allocs, (unsigned long long)stats.slabsCreated);
+        CHECK(stats.bytesUsed == 0 && stats.allocs == stats.frees);
+        CHECK(stats.slabsCreated < stats.allocs / 100);
+    }
+    CHECK(errors == 0);
+    CHECK(slabs.live.empty());
+    return true;
+}
+
+int main() {
+    bool ret = true;
+
+    ret &= test_overhead();
+    ret &= test_classes();
+    ret &= test_interior();
+    ret &= test_release();
+    ret &= test_limits();
+    ret &= test_threads();
+
+    return !(ret == true);
+}
@@ -0,0 +1,93 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+// Checks the spin-then-block policy of hcWaitModeAdaptive on simulated
+// signals.
+
+#include <kalmar_wait.h>
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+// completes after a number of polls, or once blocked on if polls < 0
+struct FakeSignal {
+    int polls;
+    std::chrono::microseconds blockTime;
+    int blocked;
+
+    FakeSignal(int polls, std::chrono::microseconds blockTime = std::chrono::microseconds(0))
+        : polls(polls), blockTime(blockTime), blocked(0) {}
+
+    bool done() {
+        return polls >= 0 && polls-- == 0;
+    }
+    void block() {
+        blocked++;
+        std::this_thread::sleep_for(blockTime);
+        polls = 0;
+    }
+};
+
+#define CHECK(cond) \
+    if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); return false; }
+
+static int shortKernel;
+static int longKernel;
+
+// short operations are caught while spinning, and learn a short budget
+bool test_short() {
+    Kalmar::AdaptiveWaitPolicy policy(200, 50);
+    const void* key = &shortKernel;
+
+    CHECK(policy.spinBudget(key) == std::chrono::microseconds(200));
+    for (int i = 0; i < 10; ++i) {
+        FakeSignal s(100);
+        CHECK(policy.wait(key, s) == Kalmar::AdaptiveWaitPolicy::SPIN);
+        CHECK(s.blocked == 0);
+    }
+    CHECK(policy.spinBudget(key) < std::chrono::microseconds(200));
+    CHECK(policy.getStats().spins == 10 && policy.getStats().blocks == 0);
+    return true;
+}
+
+// long operations stop spinning once known
+bool test_long() {
+    Kalmar::AdaptiveWaitPolicy policy(200, 50);
+    const void* key = &longKernel;
+
+    FakeSignal first(-1, std::chrono::milliseconds(2));
+    CHECK(policy.wait(key, first) == Kalmar::AdaptiveWaitPolicy::BLOCK);
+    CHECK(first.blocked == 1);
+    CHECK(policy.spinBudget(key) == std::chrono::microseconds(0));
+
+    // no spinning: the time before blocking is the yield budget only
+    FakeSignal next(-1, std::chrono::milliseconds(2));
+    auto t0 = std::chrono::steady_clock::now();
+    CHECK(policy.wait(key, next) == Kalmar::AdaptiveWaitPolicy::BLOCK);
+    auto t1 = std::chrono::steady_clock::now();
+    CHECK(t1 - t0 < std::chrono::milliseconds(2) + std::chrono::microseconds(200));
+
+    CHECK(policy.getStats().blocks == 2);
+    // other keys are not affected
+    CHECK(policy.spinBudget(&shortKernel) == std::chrono::microseconds(200));
+    return true;
+}
+
+// an operation already done does not wait at all
+bool test_done() {
+    Kalmar::AdaptiveWaitPolicy policy(200, 50);
+    FakeSignal s(0);
+    CHECK(policy.wait(&shortKernel, s) == Kalmar::AdaptiveWaitPolicy::SPIN);
+    CHECK(s.blocked == 0);
+    return true;
+}
+
+int main() {
+    bool ret = true;
+
+    ret &= test_short();
+    ret &= test_long();
+    ret &= test_done();
+
+    return !(ret == true);
+}
@@ -0,0 +1,91 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+#include <hc.hpp>
+
+#include <vector>
+
+// loop to deliberately slow down kernel execution
+#define LOOP_COUNT (10240)
+
+/// test the hazards between kernels using the same array_view instances on
+/// an any-order accelerator_view, where kernels are not ordered by the queue
+///
+/// pfe1: in1 -> av2             (writes av2)
+/// pfe2: in1 -> av3             (reads av1 with pfe1, no dependency)
+/// pfe3: av2 + av3 -> av1       (read after write of av2 and av3,
+///                               write after read of av1)
+/// pfe4: av1 -> av2             (read after write of av1, write after write
+///                               of av2)
+///
+/// in1 is a read-only view of av1, and av3 is fresh: pfe2 enqueues no
+/// barrier packet, see hcCounterBufferBarrier.
+template<size_t grid_size>
+bool test1D() {
+  bool ret = true;
+
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.create_view(hc::execute_any_order);
+
+  std::vector<int> table1(grid_size);
+  std::vector<int> table2(grid_size);
+  std::vector<int> table3(grid_size);
+
+  for (int i = 0; i < grid_size; ++i) {
+    table1[i] = i;
+  }
+
+  hc::array_view<int, 1> av1(grid_size, table1);
+  hc::array_view<int, 1> av2(grid_size, table2);
+  hc::array_view<int, 1> av3(grid_size, table3);
+  hc::array_view<const int, 1> in1(av1);
+
+  hc::parallel_for_each(av, hc::extent<1>(grid_size), [=](hc::index<1>& idx) [[hc]] {
+    // av2 = i * 2
+    for (int i = 0; i < LOOP_COUNT; ++i)
+      av2(idx) = in1(idx) * 2;
+  });
+
+  uint64_t barriers = av.get_runtime_counters()[hc::hcCounterBufferBarrier];
+  hc::parallel_for_each(av, hc::extent<1>(grid_size), [=](hc::index<1>& idx) [[hc]] {
+    // av3 = i * 3
+    for (int i = 0; i < LOOP_COUNT; ++i)
+      av3(idx) = in1(idx) * 3;
+  });
+  // the readers of av1 are not ordered
+  ret &= (av.get_runtime_counters()[hc::hcCounterBufferBarrier] == barriers);
+
+  hc::parallel_for_each(av, hc::extent<1>(grid_size), [=](hc::index<1>& idx) [[hc]] {
+    // av1 = i * 5
+    for (int i = 0; i < LOOP_COUNT; ++i)
+      av1(idx) = av2(idx) + av3(idx);
+  });
+
+  hc::completion_future fut = hc::parallel_for_each(av, hc::extent<1>(grid_size), [=](hc::index<1>& idx) [[hc]] {
+    // av2 = i * 10
+    for (int i = 0; i < LOOP_COUNT; ++i)
+      av2(idx) = av1(idx) * 2;
+  });
+
+  fut.wait();
+
+  av1.synchronize();
+  av2.synchronize();
+  av3.synchronize();
+  for (int i = 0; i < grid_size; ++i) {
+    ret &= (table1[i] == i * 5);
+    ret &= (table2[i] == i * 10);
+    ret &= (table3[i] == i * 3);
+  }
+
+  return ret;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test1D<64>();
+  ret &= test1D<1024>();
+  ret &= test1D<65536>();
+
+  return !(ret == true);
+}
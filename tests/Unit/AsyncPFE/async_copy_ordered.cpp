@@ -0,0 +1,86 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+#include <hc.hpp>
+
+#include <vector>
+
+// loop to deliberately slow down kernel execution
+#define LOOP_COUNT (10240)
+
+/// test that array and array_view copies are ordered with the kernels of an
+/// accelerator_view: copies are enqueued as commands of the queue, so a copy
+/// has to observe the results of the kernels enqueued before it, and the
+/// kernels enqueued after it have to observe the copied data
+template<size_t grid_size>
+bool test(hc::accelerator_view av) {
+  bool ret = true;
+
+  std::vector<int> host(grid_size);
+  for (int i = 0; i < grid_size; ++i)
+    host[i] = i;
+
+  // write, slow kernel, read
+  {
+    hc::array<int, 1> a(grid_size, av);
+    hc::copy(host.begin(), host.end(), a);
+    hc::parallel_for_each(av, a.get_extent(), [&a](hc::index<1>& idx) [[hc]] {
+      for (int i = 0; i < LOOP_COUNT; ++i)
+        a(idx) = a(idx) + 1;
+    });
+    std::vector<int> result(grid_size);
+    hc::copy(a, result.begin());
+    for (int i = 0; i < grid_size; ++i)
+      ret &= (result[i] == i + LOOP_COUNT);
+  }
+
+  // back-to-back copies of one host buffer, with kernels in between
+  {
+    hc::array<int, 1> a(grid_size, av);
+    hc::array<int, 1> b(grid_size, av);
+    hc::copy(host.begin(), host.end(), a);
+    hc::parallel_for_each(av, a.get_extent(), [&a](hc::index<1>& idx) [[hc]] {
+      for (int i = 0; i < LOOP_COUNT; ++i)
+        a(idx) = a(idx) + 1;
+    });
+    hc::copy(host.begin(), host.end(), b);
+    hc::parallel_for_each(av, b.get_extent(), [&a, &b](hc::index<1>& idx) [[hc]] {
+      b(idx) = a(idx) - b(idx);
+    });
+    std::vector<int> result(grid_size);
+    hc::copy(b, result.begin());
+    for (int i = 0; i < grid_size; ++i)
+      ret &= (result[i] == LOOP_COUNT);
+  }
+
+  // array_view data written when kernels are launched
+  {
+    std::vector<int> table(host);
+    hc::array_view<int, 1> data(grid_size, table);
+    for (int k = 0; k < 4; ++k) {
+      hc::parallel_for_each(av, data.get_extent(), [=](hc::index<1>& idx) [[hc]] {
+        data(idx) = data(idx) * 2;
+      });
+    }
+    data.synchronize();
+    for (int i = 0; i < grid_size; ++i)
+      ret &= (table[i] == i * 16);
+  }
+
+  av.wait();
+  return ret;
+}
+
+int main() {
+  bool ret = true;
+
+  hc::accelerator acc;
+  hc::accelerator_view in_order = acc.create_view(hc::execute_in_order);
+  hc::accelerator_view any_order = acc.create_view(hc::execute_any_order);
+
+  ret &= test<64>(in_order);
+  ret &= test<1024>(in_order);
+  ret &= test<64>(any_order);
+  ret &= test<1024>(any_order);
+
+  return !(ret == true);
+}
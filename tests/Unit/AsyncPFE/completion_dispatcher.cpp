@@ -0,0 +1,158 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+// Checks the dispatcher running the continuations of completion_future::then,
+// with stand-in operations completed by the test.
+
+#include <kalmar_completion.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// an operation notifying its completion, or not if !canNotify
+struct FakeOp {
+    std::promise<void> promise;
+    std::shared_future<void> future;
+    bool canNotify;
+    bool done = false;
+    std::vector<std::pair<void (*)(void*), void*>> handlers;
+    std::mutex mutex;
+
+    FakeOp(bool canNotify = true) : future(promise.get_future().share()), canNotify(canNotify) {}
+
+    bool notifyOnCompletion(void (*callback)(void*), void* data) {
+        if (!canNotify) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> l(mutex);
+            if (!done) {
+                handlers.emplace_back(callback, data);
+                return true;
+            }
+        }
+        callback(data);
+        return true;
+    }
+
+    void complete() {
+        std::vector<std::pair<void (*)(void*), void*>> h;
+        {
+            std::lock_guard<std::mutex> l(mutex);
+            done = true;
+            h.swap(handlers);
+        }
+        promise.set_value();
+        for (auto& p : h) {
+            p.first(p.second);
+        }
+    }
+};
+
+#define CHECK(cond) \
+    if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); return false; }
+
+static bool waitFor(Kalmar::CompletionDispatcher& d, size_t count) {
+    for (int i = 0; i < 5000 && d.getPendingCount() != count; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return d.getPendingCount() == count;
+}
+
+// continuations run once their operation completes, in completion order,
+// and in attachment order for one operation
+bool test_order() {
+    Kalmar::CompletionDispatcher d;
+    std::mutex m;
+    std::vector<int> order;
+    auto record = [&] (int i) { return [&, i] { std::lock_guard<std::mutex> l(m); order.push_back(i); }; };
+
+    auto a = std::make_shared<FakeOp>();
+    auto b = std::make_shared<FakeOp>();
+    d.add(a, a->future, record(1));
+    d.add(b, b->future, record(2));
+    d.add(a, a->future, record(3));
+    CHECK(d.getPendingCount() == 3);
+    // one notification per operation
+    CHECK(a->handlers.size() == 1 && b->handlers.size() == 1);
+
+    b->complete();
+    CHECK(waitFor(d, 2));
+    a->complete();
+    CHECK(waitFor(d, 0));
+
+    CHECK((order == std::vector<int>{2, 1, 3}));
+
+    // already completed
+    d.add(a, a->future, record(4));
+    CHECK(waitFor(d, 0));
+    CHECK(order.back() == 4);
+    return true;
+}
+
+// operations which can't notify and plain futures are waited for
+bool test_fallback() {
+    Kalmar::CompletionDispatcher d;
+    std::atomic<int> count(0);
+
+    auto a = std::make_shared<FakeOp>(false);
+    d.add(a, a->future, [&] { count++; });
+
+    std::promise<void> p;
+    d.add(std::shared_ptr<FakeOp>(), p.get_future().share(), [&] { count++; });
+
+    // deferred futures are run by the waiter
+    std::shared_future<void> deferred = std::async(std::launch::deferred, [&] { count++; }).share();
+    d.add(std::shared_ptr<FakeOp>(), deferred, [&] { count++; });
+
+    CHECK(count == 0);
+    a->complete();
+    p.set_value();
+    CHECK(waitFor(d, 0));
+    CHECK(count == 4);
+    return true;
+}
+
+// a continuation attaches another one, the operations are kept alive until
+// their continuations ran
+bool test_chain() {
+    const int n = 10000;
+    std::atomic<int> count(0);
+    std::weak_ptr<FakeOp> first;
+    std::function<void()> next;
+    {
+        Kalmar::CompletionDispatcher d;
+        next = [&] {
+            if (++count < n) {
+                auto op = std::make_shared<FakeOp>();
+                d.add(op, op->future, next);
+                op->complete();
+            }
+        };
+        auto op = std::make_shared<FakeOp>();
+        first = op;
+        d.add(op, op->future, next);
+        op.reset();
+        CHECK(!first.expired());
+        first.lock()->complete();
+        // the destructor runs the continuations still pending
+    }
+    CHECK(count == n);
+    CHECK(first.expired());
+    return true;
+}
+
+int main() {
+    bool ret = true;
+
+    ret &= test_order();
+    ret &= test_fallback();
+    ret &= test_chain();
+
+    return !(ret == true);
+}
@@ -0,0 +1,120 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+// Checks the measurements of HCC_UNPINNED_COPY_MODE=4: parsing and saving
+// the lines of a profile shared by several devices, and choosing the
+// algorithm of the measured size closest to a copy.
+
+#include <kalmar_copy_profile.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#define CHECK(cond) \
+  if (!(cond)) { std::cerr << "line " << __LINE__ << ": " #cond " failed\n"; return false; }
+
+// UnpinnedCopyEngine::CopyMode
+enum { ChooseBest = 0, UsePinInPlace = 1, UseStaging = 2, UseMemcpy = 3 };
+
+static const char* profileText =
+  "gfx900:1:0 H2D 65536 2 3000\n"
+  "gfx900:1:0 H2D 4096 3 900\n"
+  "gfx900:1:0 D2H 4096 2 800\n"
+  "gfx900:2:0 H2D 4096 1 10\n"
+  "gfx900:1:0 H2D 1048576 1 9000\n"
+  "gfx900:1:0 H2D 4194304 9 9500\n"     // unknown algorithm
+  "gfx900:1:0 H2D garbage\n"
+  "gfx900:1:0 H2Dx 16 2 1\n"
+  "gfx900:1:0 H2D 16777216 1 11000\n";
+
+bool any(int mode) { return mode == UsePinInPlace || mode == UseStaging || mode == UseMemcpy; }
+bool noMemcpy(int mode) { return mode == UsePinInPlace || mode == UseStaging; }
+
+bool test_load() {
+  Kalmar::CopyProfile p;
+  std::istringstream in(profileText);
+  CHECK(p.load(in, "gfx900:1:0 H2D", any));
+
+  // lines of the key only, well formed, sorted by size
+  CHECK(p.get().size() == 4);
+  CHECK(p.get()[0].sizeBytes == 4096 && p.get()[0].mode == UseMemcpy && p.get()[0].bandwidth == 900);
+  CHECK(p.get()[1].sizeBytes == 65536 && p.get()[1].mode == UseStaging);
+  CHECK(p.get()[2].sizeBytes == 1048576 && p.get()[2].mode == UsePinInPlace);
+  CHECK(p.get()[3].sizeBytes == 16777216);
+
+  // algorithms the engine can't use are dropped
+  Kalmar::CopyProfile q;
+  std::istringstream in2(profileText);
+  CHECK(q.load(in2, "gfx900:1:0 H2D", noMemcpy));
+  CHECK(q.get().size() == 3 && q.get()[0].sizeBytes == 65536);
+
+  Kalmar::CopyProfile none;
+  std::istringstream in3(profileText);
+  CHECK(!none.load(in3, "gfx906:1:0 H2D", any));
+  std::istringstream empty("");
+  CHECK(!none.load(empty, "gfx900:1:0 H2D", any));
+  return true;
+}
+
+bool test_choose() {
+  Kalmar::CopyProfile p;
+  CHECK(p.choose(4096, ChooseBest) == ChooseBest);
+
+  p.add({ 1 << 20, UsePinInPlace, 9000 });
+  p.add({ 4 << 10, UseMemcpy, 900 });
+  p.add({ 64 << 10, UseStaging, 3000 });
+
+  // closest measured size on a log scale: 16KB between 4KB and 64KB,
+  // 256KB between 64KB and 1MB
+  CHECK(p.choose(0, ChooseBest) == UseMemcpy);
+  CHECK(p.choose(4 << 10, ChooseBest) == UseMemcpy);
+  CHECK(p.choose((16 << 10) - 1, ChooseBest) == UseMemcpy);
+  CHECK(p.choose(16 << 10, ChooseBest) == UseStaging);
+  CHECK(p.choose(64 << 10, ChooseBest) == UseStaging);
+  CHECK(p.choose((256 << 10) - 1, ChooseBest) == UseStaging);
+  CHECK(p.choose(256 << 10, ChooseBest) == UsePinInPlace);
+  CHECK(p.choose(size_t(1) << 34, ChooseBest) == UsePinInPlace);
+  return true;
+}
+
+bool test_save() {
+  Kalmar::CopyProfile p;
+  p.add({ 4096, UseStaging, 1200 });
+  p.add({ 1 << 20, UsePinInPlace, 8000 });
+
+  // the measurements of the key are replaced, the other lines are kept
+  std::istringstream in(profileText);
+  std::ostringstream out;
+  CHECK(p.save(in, out, "gfx900:1:0 H2D"));
+  std::string saved = out.str();
+  CHECK(saved.find("gfx900:1:0 H2D 65536") == std::string::npos);
+  CHECK(saved.find("gfx900:1:0 H2D garbage") == std::string::npos);
+  CHECK(saved.find("gfx900:1:0 D2H 4096 2 800\n") != std::string::npos);
+  CHECK(saved.find("gfx900:2:0 H2D 4096 1 10\n") != std::string::npos);
+  CHECK(saved.find("gfx900:1:0 H2Dx 16 2 1\n") != std::string::npos);
+
+  // and read back
+  Kalmar::CopyProfile back;
+  std::istringstream again(saved);
+  CHECK(back.load(again, "gfx900:1:0 H2D", any));
+  CHECK(back.get().size() == 2);
+  CHECK(back.get()[0].sizeBytes == 4096 && back.get()[0].mode == UseStaging && back.get()[0].bandwidth == 1200);
+  CHECK(back.get()[1].sizeBytes == (1 << 20) && back.get()[1].mode == UsePinInPlace);
+
+  // saving to a missing profile
+  std::istringstream missing("");
+  std::ostringstream fresh;
+  CHECK(p.save(missing, fresh, "gfx900:1:0 D2H"));
+  CHECK(fresh.str() == "gfx900:1:0 D2H 4096 2 1200\ngfx900:1:0 D2H 1048576 1 8000\n");
+  return true;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test_load();
+  ret &= test_choose();
+  ret &= test_save();
+
+  return !(ret == true);
+}
@@ -0,0 +1,146 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+// Checks the huge page backed allocation of the large buffers of the CPU
+// runtime: the size threshold, the 2 MB alignment, the bookkeeping of the
+// mappings, and, when transparent huge pages are enabled, that the kernel
+// backs the buffers with them.
+
+#include <kalmar_huge_pages.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define MB (size_t(1) << 20)
+
+#define CHECK(cond) \
+    if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); return false; }
+
+// "always" or "madvise" in /sys/kernel/mm/transparent_hugepage/enabled
+bool thpEnabled() {
+    std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string line;
+    std::getline(file, line);
+    return line.find("[never]") == std::string::npos && !line.empty();
+}
+
+// AnonHugePages of the mapping at ptr, in KB, -1 if not found
+long anonHugePages(void* ptr) {
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool inside = false;
+    while (std::getline(smaps, line)) {
+        unsigned long begin, end;
+        if (sscanf(line.c_str(), "%lx-%lx ", &begin, &end) == 2) {
+            uintptr_t p = reinterpret_cast<uintptr_t>(ptr);
+            inside = begin <= p && p < end;
+        } else if (inside && line.compare(0, 14, "AnonHugePages:") == 0) {
+            return atol(line.c_str() + 14);
+        }
+    }
+    return -1;
+}
+
+// only buffers of at least the threshold are mapped, aligned to 2 MB
+bool test_threshold() {
+    Kalmar::HugePageAllocator huge(4 * MB, false);
+    CHECK(!huge.handles(4 * MB - 1) && huge.allocate(4 * MB - 1) == nullptr);
+    CHECK(huge.handles(4 * MB));
+
+    void* p = huge.allocate(5 * MB);
+    CHECK(p != nullptr);
+    CHECK(reinterpret_cast<uintptr_t>(p) % (2 * MB) == 0);
+    memset(p, 1, 5 * MB);
+
+    Kalmar::HugePageStats stats = huge.getStats();
+    CHECK(stats.allocs == 1 && stats.bytesMapped == 6 * MB);
+
+    // not from the allocator: left to the caller
+    int x;
+    CHECK(!huge.free(&x));
+    CHECK(huge.free(p));
+    CHECK(!huge.free(p));
+    stats = huge.getStats();
+    CHECK(stats.frees == 1 && stats.bytesMapped == 0);
+
+    // disabled
+    Kalmar::HugePageAllocator off(0, false);
+    CHECK(!off.handles(64 * MB) && off.allocate(64 * MB) == nullptr);
+    return true;
+}
+
+// touched buffers are backed by huge pages
+bool test_backing() {
+    if (!thpEnabled()) {
+        printf("transparent huge pages disabled, backing not checked\n");
+        return true;
+    }
+    Kalmar::HugePageAllocator huge(4 * MB, false);
+    const size_t bytes = 32 * MB;
+    char* p = static_cast<char*>(huge.allocate(bytes));
+    CHECK(p != nullptr);
+    memset(p, 1, bytes);
+    long kb = anonHugePages(p);
+    printf("backing: %ld KB of %zu KB in huge pages\n", kb, bytes / 1024);
+    CHECK(kb > 0);
+    huge.free(p);
+    return true;
+}
+
+// the hugetlbfs pool, with the fallback when it is empty
+bool test_hugetlb() {
+    Kalmar::HugePageAllocator huge(4 * MB, true);
+    void* p = huge.allocate(8 * MB);
+    CHECK(p != nullptr);
+    CHECK(reinterpret_cast<uintptr_t>(p) % (2 * MB) == 0);
+    memset(p, 1, 8 * MB);
+    Kalmar::HugePageStats stats = huge.getStats();
+    CHECK(stats.hugetlbAllocs + stats.fallbacks == 1);
+    CHECK(huge.free(p));
+    return true;
+}
+
+// threads allocating and freeing large buffers
+bool test_threads() {
+    Kalmar::HugePageAllocator huge(4 * MB, false);
+    std::vector<std::thread> workers;
+    std::vector<int> errors(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < 20; ++i) {
+                size_t bytes = (4 + (t + i) % 5) * MB;
+                char* p = static_cast<char*>(huge.allocate(bytes));
+                p[0] = char(t);
+                p[bytes - 1] = char(t);
+                if (p[0] != char(t) || !huge.free(p)) {
+                    errors[t]++;
+                }
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    for (int e : errors) {
+        CHECK(e == 0);
+    }
+    Kalmar::HugePageStats stats = huge.getStats();
+    CHECK(stats.allocs == 80 && stats.frees == 80 && stats.bytesMapped == 0);
+    return true;
+}
+
+int main() {
+    bool ret = true;
+
+    ret &= test_threshold();
+    ret &= test_backing();
+    ret &= test_hugetlb();
+    ret &= test_threads();
+
+    return !(ret == true);
+}
@@ -0,0 +1,185 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+// Checks the NUMA policy of the CPU accelerator: the setting through
+// hc::accelerator, the pinning of the kernel workers, and the placement of
+// the pages of arrays, which is checked against the node of their worker on
+// NUMA hosts.
+
+#include <hc.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define CHECK(cond) \
+  if (!(cond)) { std::cerr << "line " << __LINE__ << ": " #cond " failed\n"; return false; }
+
+// node of each page, -1 if unknown
+std::vector<int> pageNodes(const char* p, size_t bytes) {
+  long page = sysconf(_SC_PAGESIZE);
+  std::vector<void*> pages;
+  for (size_t offset = 0; offset < bytes; offset += page)
+    pages.push_back(const_cast<char*>(p) + offset);
+  std::vector<int> status(pages.size(), -1);
+#if defined(SYS_move_pages)
+  if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) != 0)
+    std::fill(status.begin(), status.end(), -1);
+#endif
+  return status;
+}
+
+// only the CPU accelerator has a policy
+bool test_setting() {
+  hc::accelerator cpu(L"cpu");
+  CHECK(cpu.set_cpu_numa_policy(hc::hcNumaPolicyInterleave, false));
+  CHECK(cpu.get_cpu_numa_policy() == hc::hcNumaPolicyInterleave);
+  CHECK(cpu.set_cpu_numa_policy(hc::hcNumaPolicyNone, false));
+
+  hc::accelerator acc;
+  if (acc.get_device_path() != L"cpu" && acc.get_device_path() != L"fallback") {
+    CHECK(!acc.set_cpu_numa_policy(hc::hcNumaPolicyFirstTouch));
+    CHECK(acc.get_cpu_numa_policy() == hc::hcNumaPolicyNone);
+  }
+  return true;
+}
+
+// each worker runs on the CPU of its part
+bool test_pinning() {
+  const Kalmar::CpuTopology& topology = Kalmar::CpuTopology::get();
+  CHECK(!topology.cpus().empty() && !topology.nodes().empty());
+
+  Kalmar::cpuNumaSettings().pinWorkers = true;
+  const int parts = 4;
+  std::vector<int> ran(parts, -1);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < parts; ++i) {
+    workers.emplace_back([&ran, i] {
+      Kalmar::pinCpuWorker(i, parts);
+      ran[i] = sched_getcpu();
+    });
+  }
+  for (auto& w : workers)
+    w.join();
+  Kalmar::cpuNumaSettings().pinWorkers = false;
+
+  for (int i = 0; i < parts; ++i) {
+    CHECK(ran[i] == topology.cpuOfWorker(i, parts));
+    // consecutive workers stay on a node
+    if (i > 0) {
+      CHECK(topology.nodeOf(ran[i]) >= topology.nodeOf(ran[i - 1]));
+    }
+  }
+  return true;
+}
+
+// arrays to place are fresh mappings, whose pages nobody has touched yet
+bool test_fresh_pages() {
+  Kalmar::NumaPageAllocator numaPages;
+  const size_t bytes = 8 << 20;
+  CHECK(numaPages.allocate(bytes) == nullptr);
+
+  Kalmar::cpuNumaSettings().policy = hc::hcNumaPolicyFirstTouch;
+  CHECK(numaPages.allocate(Kalmar::CpuNumaSettings::MIN_BYTES - 1) == nullptr);
+  char* p = static_cast<char*>(numaPages.allocate(bytes));
+  Kalmar::cpuNumaSettings().policy = hc::hcNumaPolicyNone;
+  CHECK(p != nullptr);
+
+  long page = sysconf(_SC_PAGESIZE);
+  CHECK(reinterpret_cast<uintptr_t>(p) % page == 0);
+  std::vector<unsigned char> resident(bytes / page, 1);
+  CHECK(mincore(p, bytes, resident.data()) == 0);
+  CHECK(std::count(resident.begin(), resident.end(), 0) == int(resident.size()));
+
+  memset(p, 1, bytes);
+  int x;
+  CHECK(!numaPages.free(&x));
+  CHECK(numaPages.free(p));
+  CHECK(!numaPages.free(p));
+  return true;
+}
+
+// the rows of each worker are on its node
+bool test_first_touch() {
+  const Kalmar::CpuTopology& topology = Kalmar::CpuTopology::get();
+  const size_t bytes = 64 << 20;
+  const int parts = 8;
+
+  Kalmar::NumaPageAllocator numaPages;
+  Kalmar::cpuNumaSettings().policy = hc::hcNumaPolicyFirstTouch;
+  char* p = static_cast<char*>(numaPages.allocate(bytes));
+  Kalmar::cpuNumaSettings().policy = hc::hcNumaPolicyNone;
+  CHECK(p != nullptr);
+  Kalmar::numaFirstTouch(p, bytes, parts);
+  if (topology.nodes().size() > 1) {
+    std::vector<int> nodes = pageNodes(p, bytes);
+    size_t page = bytes / nodes.size();
+    int misplaced = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      int part = int(i * page * parts / bytes);
+      if (nodes[i] >= 0 && nodes[i] != topology.nodeOf(topology.cpuOfWorker(part, parts)))
+        misplaced++;
+    }
+    CHECK(misplaced < int(nodes.size() / 100));
+  }
+  CHECK(numaPages.free(p));
+  return true;
+}
+
+// the pages are spread over the nodes
+bool test_interleave() {
+  const Kalmar::CpuTopology& topology = Kalmar::CpuTopology::get();
+  const size_t bytes = 16 << 20;
+
+  char* p = static_cast<char*>(Kalmar::kalmar_aligned_alloc(0x1000, bytes));
+  bool interleaved = Kalmar::numaInterleave(p, bytes);
+  CHECK(interleaved == (topology.nodes().size() > 1));
+  memset(p, 1, bytes);
+  if (interleaved) {
+    std::vector<int> nodes = pageNodes(p, bytes);
+    std::vector<int> count(topology.nodes().back() + 1, 0);
+    for (int n : nodes)
+      if (n >= 0)
+        count[n]++;
+    for (int n : topology.nodes())
+      CHECK(count[n] > int(nodes.size() / topology.nodes().size() / 2));
+  }
+  Kalmar::kalmar_aligned_free(p);
+  return true;
+}
+
+// arrays of the CPU accelerator are computed on as usual with any policy
+bool test_arrays() {
+  const int N = 1 << 20;
+  hc::accelerator cpu(L"cpu");
+  const hc::hcNumaPolicy policies[] = { hc::hcNumaPolicyNone, hc::hcNumaPolicyFirstTouch, hc::hcNumaPolicyInterleave };
+  for (hc::hcNumaPolicy policy : policies) {
+    cpu.set_cpu_numa_policy(policy, true);
+    std::vector<int> host(N);
+    for (int i = 0; i < N; ++i)
+      host[i] = i;
+    hc::array<int, 1> a(N, host.begin(), cpu.get_default_view());
+    std::vector<int> back(N, 0);
+    hc::copy(a, back.begin());
+    CHECK(back == host);
+  }
+  cpu.set_cpu_numa_policy(hc::hcNumaPolicyNone, false);
+  return true;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test_setting();
+  ret &= test_pinning();
+  ret &= test_fresh_pages();
+  ret &= test_first_touch();
+  ret &= test_interleave();
+  ret &= test_arrays();
+
+  return !(ret == true);
+}
@@ -0,0 +1,90 @@
+// RUN: %hc %s -lhc_am -o %t.out && %t.out
+
+#include <hc.hpp>
+#include <hc_am.hpp>
+
+#include <vector>
+
+#define KERNELS (256)
+#define SIZE (1024)
+
+// every kernel adds one to each element, so the result counts the kernels
+// which have executed.  The buffer is a raw pointer, kernels are therefore
+// not waited on for array_view dependencies and stay in the batch.
+void run(hc::accelerator_view& av, int* data, int kernels) {
+  for (int i = 0; i < kernels; ++i) {
+    hc::parallel_for_each(av, hc::extent<1>(SIZE), [=](hc::index<1> idx) [[hc]] {
+      data[idx[0]] += 1;
+    });
+  }
+}
+
+bool check(hc::accelerator_view& av, int* data, int expected) {
+  std::vector<int> host(SIZE);
+  av.copy(data, host.data(), SIZE * sizeof(int));
+  bool ret = true;
+  for (int i = 0; i < SIZE; ++i) {
+    ret &= (host[i] == expected);
+  }
+  return ret;
+}
+
+int main() {
+  bool ret = true;
+
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.create_view(hc::execute_in_order);
+
+  int* data = hc::am_alloc(SIZE * sizeof(int), acc, 0);
+  std::vector<int> zero(SIZE, 0);
+  av.copy(zero.data(), data, SIZE * sizeof(int));
+
+  // kernels of a batch all execute once the scope is closed
+  {
+    hc::accelerator_view::batch_scope batch(av, 32);
+    run(av, data, KERNELS);
+  }
+  av.wait();
+  ret &= check(av, data, KERNELS);
+
+  // waiting inside of a batch releases the pending kernels
+  {
+    hc::accelerator_view::batch_scope batch(av, 0, 0);
+    run(av, data, KERNELS);
+    av.wait();
+    ret &= check(av, data, 2 * KERNELS);
+  }
+
+  // so does waiting on the completion_future of a pending kernel
+  {
+    hc::accelerator_view::batch_scope batch(av, 0, 0);
+    run(av, data, 3);
+    hc::completion_future cf = hc::parallel_for_each(av, hc::extent<1>(SIZE), [=](hc::index<1> idx) [[hc]] {
+      data[idx[0]] += 1;
+    });
+    cf.wait();
+    ret &= check(av, data, 2 * KERNELS + 4);
+  }
+
+  // nested scopes, and flush()
+  {
+    hc::accelerator_view::batch_scope outer(av, 0, 0);
+    run(av, data, 10);
+    {
+      hc::accelerator_view::batch_scope inner(av, 4);
+      run(av, data, 10);
+    }
+    av.flush();
+    av.wait();
+    ret &= check(av, data, 2 * KERNELS + 24);
+  }
+
+  // no batch at all
+  run(av, data, 10);
+  av.wait();
+  ret &= check(av, data, 2 * KERNELS + 34);
+
+  hc::am_free(data);
+
+  return !(ret == true);
+}
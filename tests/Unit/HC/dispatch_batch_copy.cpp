@@ -0,0 +1,69 @@
+// RUN: %hc %s -lhc_am -o %t.out && HCC_OPT_FLUSH=0 %t.out && %t.out
+
+#include <hc.hpp>
+#include <hc_am.hpp>
+
+#include <vector>
+
+#define SIZE (1024)
+
+// Copies depending on kernels held back by a batch_scope release them:
+// the copy engine does not see the doorbell of the queue, and would wait
+// for kernels which are never rung.  HCC_OPT_FLUSH=0 makes the copies
+// depend on the kernel signals directly, without a marker.
+
+bool check(const std::vector<int>& host, int expected) {
+  bool ret = true;
+  for (int i = 0; i < SIZE; ++i) {
+    ret &= (host[i] == expected);
+  }
+  return ret;
+}
+
+int main() {
+  bool ret = true;
+
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.create_view(hc::execute_in_order);
+
+  int* data = hc::am_alloc(SIZE * sizeof(int), acc, 0);
+  std::vector<int> host(SIZE, 0);
+  av.copy(host.data(), data, SIZE * sizeof(int));
+
+  // a kernel, then a copy of its result waited on inside of the batch
+  {
+    hc::accelerator_view::batch_scope batch(av, 0, 0);
+    hc::parallel_for_each(av, hc::extent<1>(SIZE), [=](hc::index<1> idx) [[hc]] {
+      data[idx[0]] += 1;
+    });
+    hc::completion_future cf = av.copy_async(data, host.data(), SIZE * sizeof(int));
+    cf.wait();
+    ret &= check(host, 1);
+  }
+
+  // a kernel, then a synchronous copy inside of the batch
+  {
+    hc::accelerator_view::batch_scope batch(av, 0, 0);
+    hc::parallel_for_each(av, hc::extent<1>(SIZE), [=](hc::index<1> idx) [[hc]] {
+      data[idx[0]] += 1;
+    });
+    av.copy(data, host.data(), SIZE * sizeof(int));
+    ret &= check(host, 2);
+  }
+
+  // a copy, then a kernel depending on it, then a copy back
+  {
+    hc::accelerator_view::batch_scope batch(av, 0, 0);
+    std::vector<int> ones(SIZE, 1);
+    av.copy_async(ones.data(), data, SIZE * sizeof(int));
+    hc::parallel_for_each(av, hc::extent<1>(SIZE), [=](hc::index<1> idx) [[hc]] {
+      data[idx[0]] += 1;
+    });
+    av.copy_async(data, host.data(), SIZE * sizeof(int)).wait();
+    ret &= check(host, 2);
+  }
+
+  hc::am_free(data);
+
+  return !(ret == true);
+}
@@ -0,0 +1,150 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+#include <hc.hpp>
+
+// Simulation of a hardware queue driven by Kalmar::DoorbellCoalescer, the
+// policy HSAQueue uses to decide when to ring the doorbell.  The simulated
+// packet processor only consumes packets up to the last doorbell value.
+struct SimQueue {
+  typedef Kalmar::DoorbellCoalescer::clock clock;
+
+  Kalmar::DoorbellCoalescer doorbell;
+  uint32_t size;
+  uint64_t writeIndex = 0;
+  int64_t doorbellValue = -1;
+  int rings = 0;
+
+  explicit SimQueue(uint32_t size) : size(size) {}
+
+  void dispatch(clock::time_point now = clock::now(), bool deferred = false) {
+    uint64_t index = writeIndex++;
+    if (doorbell.packetWritten(deferred, size, now))
+      ring(index);
+  }
+
+  void ring(uint64_t index) {
+    doorbellValue = index;
+    doorbell.rung();
+    ++rings;
+  }
+
+  void flush() {
+    if (doorbell.getPending())
+      ring(writeIndex - 1);
+  }
+
+  void endBatch() {
+    if (doorbell.endBatch())
+      ring(writeIndex - 1);
+  }
+
+  // number of packets the packet processor knows about
+  uint64_t visible() const { return doorbellValue + 1; }
+};
+
+bool test_unbatched() {
+  SimQueue q(1024);
+  for (int i = 0; i < 100; ++i)
+    q.dispatch();
+  return q.rings == 100 && q.visible() == 100 && q.doorbell.getPending() == 0;
+}
+
+bool test_packet_limit() {
+  SimQueue q(1024);
+  q.doorbell.beginBatch(16, 0);
+  for (int i = 0; i < 100; ++i)
+    q.dispatch();
+  // 6 full groups of 16, 4 packets still pending
+  bool ret = (q.rings == 6) && (q.visible() == 96) && (q.doorbell.getPending() == 4);
+  q.endBatch();
+  ret &= (q.rings == 7) && (q.visible() == 100) && !q.doorbell.inBatch();
+  return ret;
+}
+
+bool test_time_limit() {
+  typedef SimQueue::clock clock;
+  SimQueue q(1024);
+  clock::time_point t0 = clock::now();
+  q.doorbell.beginBatch(0, 50);
+  q.dispatch(t0);
+  q.dispatch(t0 + std::chrono::microseconds(10));
+  bool ret = (q.rings == 0) && (q.visible() == 0);
+  // the oldest packet has now waited long enough
+  q.dispatch(t0 + std::chrono::microseconds(60));
+  ret &= (q.rings == 1) && (q.visible() == 3);
+  // the clock restarts with the next pending packet
+  q.dispatch(t0 + std::chrono::microseconds(100));
+  ret &= (q.rings == 1);
+  q.dispatch(t0 + std::chrono::microseconds(140));
+  ret &= (q.rings == 1);
+  q.dispatch(t0 + std::chrono::microseconds(150));
+  ret &= (q.rings == 2) && (q.visible() == 6);
+  q.endBatch();
+  ret &= (q.rings == 2);
+  return ret;
+}
+
+bool test_nested() {
+  SimQueue q(1024);
+  q.doorbell.beginBatch(0, 0);
+  for (int i = 0; i < 10; ++i)
+    q.dispatch();
+  q.doorbell.beginBatch(4, 0);
+  for (int i = 0; i < 3; ++i)
+    q.dispatch();
+  // the inner policy applies to all pending packets
+  bool ret = (q.rings == 1) && (q.visible() == 11);
+  // closing the inner scope does not ring
+  q.endBatch();
+  ret &= (q.rings == 1) && q.doorbell.inBatch();
+  for (int i = 0; i < 10; ++i)
+    q.dispatch();
+  ret &= (q.rings == 1) && (q.visible() == 11);
+  q.endBatch();
+  ret &= (q.rings == 2) && (q.visible() == 23);
+  return ret;
+}
+
+bool test_flush_and_capacity() {
+  SimQueue q(64);
+  q.doorbell.beginBatch(0, 0);
+  for (int i = 0; i < 10; ++i)
+    q.dispatch();
+  q.flush();
+  bool ret = (q.rings == 1) && (q.visible() == 10);
+  // half of the queue pending is always rung, whatever the policy
+  for (int i = 0; i < 100; ++i) {
+    q.dispatch();
+    ret &= (q.writeIndex - q.visible() < 32);
+  }
+  q.endBatch();
+  ret &= (q.visible() == 110);
+  return ret;
+}
+
+bool test_deferred() {
+  SimQueue q(1024);
+  q.dispatch(SimQueue::clock::now(), true);
+  q.dispatch(SimQueue::clock::now(), true);
+  bool ret = (q.rings == 0);
+  // a regular packet also releases the deferred ones
+  q.dispatch();
+  ret &= (q.rings == 1) && (q.visible() == 3);
+  q.dispatch(SimQueue::clock::now(), true);
+  q.flush();
+  ret &= (q.rings == 2) && (q.visible() == 4);
+  return ret;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test_unbatched();
+  ret &= test_packet_limit();
+  ret &= test_time_limit();
+  ret &= test_nested();
+  ret &= test_flush_and_capacity();
+  ret &= test_deferred();
+
+  return !(ret == true);
+}
@@ -0,0 +1,122 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+// Checks the aggregation of the kernel profiler: per kernel and launch
+// configuration statistics, percentiles, copies per direction, and the
+// table and CSV reports.
+
+#include <kalmar_profiler.h>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CHECK(cond) \
+    if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); return false; }
+
+Kalmar::KernelDims dims1D(size_t grid, size_t tile) {
+    Kalmar::KernelDims d;
+    d.dims = 1;
+    d.grid[0] = grid;
+    d.tile[0] = tile;
+    return d;
+}
+
+// the histogram buckets are contiguous and the percentiles close
+bool test_histogram() {
+    for (int b = 1; b < Kalmar::DurationHistogram::BUCKETS; ++b) {
+        CHECK(Kalmar::DurationHistogram::lowerBound(b) ==
+              Kalmar::DurationHistogram::lowerBound(b - 1) + Kalmar::DurationHistogram::width(b - 1));
+        CHECK(Kalmar::DurationHistogram::bucketOf(Kalmar::DurationHistogram::lowerBound(b)) == b);
+    }
+    Kalmar::DurationHistogram h;
+    for (uint64_t ns = 1; ns <= 100000; ++ns) {
+        h.add(ns);
+    }
+    double p50 = h.percentile(0.5), p99 = h.percentile(0.99);
+    CHECK(p50 > 50000 * 0.94 && p50 < 50000 * 1.06);
+    CHECK(p99 > 99000 * 0.94 && p99 < 99000 * 1.06);
+    return true;
+}
+
+bool test_kernels() {
+    Kalmar::KernelProfiler& profiler = Kalmar::KernelProfiler::get();
+    CHECK(!Kalmar::profilingEnabled());
+    profiler.reset();
+    int q0, q1;
+
+    for (int i = 1; i <= 100; ++i) {
+        profiler.recordKernel("_Z6vecaddPfS_S_", dims1D(1 << 20, 256), &q0, i * 1000);
+    }
+    profiler.recordKernel("_Z6vecaddPfS_S_", dims1D(1 << 20, 256), &q1, 500);
+    profiler.recordKernel("_Z6vecaddPfS_S_", dims1D(1024, 64), &q0, 2000000);
+    profiler.recordKernel("reduce", Kalmar::KernelDims(), &q1, 10);
+
+    std::vector<Kalmar::KernelProfile> ks = profiler.getKernels();
+    CHECK(ks.size() == 3);
+    // sorted by total time, demangled
+    CHECK(ks[0].totalNs == 5050000 + 500 && ks[0].name == "vecadd(float*, float*, float*)");
+    CHECK(ks[0].count == 101 && ks[0].minNs == 500 && ks[0].maxNs == 100000);
+    CHECK(ks[0].queues.size() == 2);
+    CHECK(ks[0].p50Ns > 47000 && ks[0].p50Ns < 53000);
+    CHECK(ks[0].p99Ns > 93000 && ks[0].p99Ns <= 100000);
+    CHECK(ks[1].dims.grid[0] == 1024 && ks[1].p50Ns == 2000000);
+    CHECK(ks[2].name == "reduce" && ks[2].dims.dims == 0);
+
+    std::string table = profiler.report(false);
+    CHECK(table.find("3 kernels, 103 calls") != std::string::npos);
+    CHECK(table.find("1048576") != std::string::npos && table.find("256") != std::string::npos);
+    std::string csv = profiler.report(true);
+    CHECK(csv.find("\"vecadd(float*, float*, float*)\",1048576,256,0 1,101,5050500,") != std::string::npos);
+    return true;
+}
+
+bool test_copies() {
+    Kalmar::KernelProfiler& profiler = Kalmar::KernelProfiler::get();
+    profiler.reset();
+    profiler.recordCopy(1, 1 << 20, 100000);
+    profiler.recordCopy(1, 1 << 20, 0);
+    profiler.recordCopy(2, 4096, 1000);
+    profiler.recordCopy(-1, 4096, 1000);
+
+    std::vector<Kalmar::CopyStats> cs = profiler.getCopies();
+    CHECK(cs.size() == 2);
+    CHECK(cs[0].kind == 1 && cs[0].count == 2 && cs[0].bytes == 2 << 20);
+    CHECK(cs[0].timedCount == 1 && cs[0].timedNs == 100000);
+    CHECK(profiler.report(false).find("HostToDevice") != std::string::npos);
+    CHECK(profiler.report(true).find("DeviceToHost,1,4096,1,4096,1000") != std::string::npos);
+    return true;
+}
+
+// threads recording concurrently
+bool test_threads() {
+    Kalmar::KernelProfiler& profiler = Kalmar::KernelProfiler::get();
+    profiler.reset();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&profiler, t] {
+            for (int i = 0; i < 1000; ++i) {
+                profiler.recordKernel("k", dims1D(64, 0), &profiler, 100 + t);
+                profiler.recordCopy(3, 16, 0);
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    std::vector<Kalmar::KernelProfile> ks = profiler.getKernels();
+    CHECK(ks.size() == 1 && ks[0].count == 4000 && ks[0].minNs == 100 && ks[0].maxNs == 103);
+    CHECK(profiler.getCopies()[0].bytes == 4000 * 16);
+    return true;
+}
+
+int main() {
+    bool ret = true;
+
+    ret &= test_histogram();
+    ret &= test_kernels();
+    ret &= test_copies();
+    ret &= test_threads();
+
+    return !(ret == true);
+}
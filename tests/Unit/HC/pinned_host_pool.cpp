@@ -0,0 +1,81 @@
+// RUN: %hc -lhc_am %s -o %t.out && %t.out
+
+// Checks the pooled pinned host allocator of pinned_vector: the blocks are
+// tracked pinned host memory, growing vectors reuse the pinned blocks, and
+// allocation failures throw bad_alloc.
+
+#include <iostream>
+#include <hc.hpp>
+#include <hc_am.hpp>
+#include <pinned_vector.hpp>
+
+#define CHECK(cond) \
+  if (!(cond)) { std::cerr << "line " << __LINE__ << ": " #cond " failed\n"; return false; }
+
+// small and large blocks are pinned host memory, tracked by am
+bool test_tracked() {
+  hc::accelerator acc;
+  hc::pinned_host_pool pool(acc);
+  hc::AmPointerInfo ap(nullptr, nullptr, 0, acc);
+
+  for (std::size_t size : { std::size_t(100), std::size_t(1) << 20 }) {
+    std::vector<char, hc::am_pool_allocator<char>> v(size, 0, hc::am_pool_allocator<char>(&pool));
+    CHECK(hc::am_memtracker_getinfo(&ap, v.data()) == AM_SUCCESS);
+    CHECK(!ap._isInDeviceMem && ap._isAmManaged);
+    CHECK(ap._sizeBytes >= size);
+  }
+  return true;
+}
+
+// vectors growing by doubling pin each size class once
+bool test_reuse() {
+  hc::pinned_host_pool pool;
+  for (int round = 0; round < 5; ++round) {
+    std::vector<int, hc::am_pool_allocator<int>> v{hc::am_pool_allocator<int>(&pool)};
+    for (int i = 0; i < (1 << 20); ++i)
+      v.push_back(i);
+    for (int i = 0; i < (1 << 20); ++i)
+      CHECK(v[i] == i);
+  }
+  hc::pinned_host_pool_stats stats = pool.get_stats();
+  CHECK(stats.large.hits > 4 * stats.large.misses);
+  CHECK(stats.large.bytesInUse == 0 && stats.small.bytesUsed == 0);
+
+  pool.trim();
+  CHECK(pool.get_stats().large.bytesCached == 0);
+  return true;
+}
+
+// the default pool, and copies of allocators
+bool test_default() {
+  hc::pooled_pinned_vector<float> v(1000, 1.0f);
+  hc::pooled_pinned_vector<float> w = v;
+  CHECK(w == v);
+  CHECK(v.get_allocator() == hc::am_pool_allocator<double>());
+
+  hc::pinned_host_pool pool;
+  CHECK(hc::am_pool_allocator<float>(&pool) != v.get_allocator());
+  return true;
+}
+
+bool test_bad_alloc() {
+  try {
+    hc::pooled_pinned_vector<char> v(static_cast<std::size_t>(-1) / 2);
+  }
+  catch(std::bad_alloc& e){
+    return true;
+  }
+  std::cout << "expected bad_alloc not caught\n";
+  return false;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test_tracked();
+  ret &= test_reuse();
+  ret &= test_default();
+  ret &= test_bad_alloc();
+
+  return !(ret == true);
+}
@@ -0,0 +1,50 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+// Checks hc::set_profiling / hc::get_profile_report: the kernels launched
+// while profiling is on are reported with their launch configuration.
+
+#include <hc.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define CHECK(cond) \
+  if (!(cond)) { std::cerr << "line " << __LINE__ << ": " #cond " failed\n"; return false; }
+
+bool test_report() {
+  hc::accelerator_view av = hc::accelerator().get_default_view();
+  std::vector<int> data(4096, 1);
+  hc::array_view<int, 1> v(4096, data);
+
+  hc::reset_profile();
+  hc::set_profiling(true);
+  for (int i = 0; i < 10; ++i) {
+    hc::parallel_for_each(av, hc::extent<1>(4096).tile(64), [=](hc::tiled_index<1> idx) [[hc]] {
+      v[idx.global] += 1;
+    });
+  }
+  v.synchronize();
+  av.wait();
+  hc::set_profiling(false);
+
+  // not profiled
+  hc::parallel_for_each(av, hc::extent<1>(4096), [=](hc::index<1> idx) [[hc]] {
+    v[idx] += 1;
+  });
+  av.wait();
+
+  std::string csv = hc::get_profile_report(true);
+  std::cout << hc::get_profile_report();
+  CHECK(csv.find(",4096,64,") != std::string::npos);
+  CHECK(csv.find(",4096,-,") == std::string::npos);
+  return true;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test_report();
+
+  return !(ret == true);
+}
@@ -0,0 +1,291 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+// Checks the scheduler assigning hardware queues to accelerator_views, on
+// fake queues: reuse, LRU stealing of idle owners, blocking, borrowing across
+// priorities, and a multi-threaded stress run.
+
+#include <kalmar_queue_scheduler.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+struct FakeOwner;
+
+struct FakeQueue {
+    int priority;
+    FakeOwner* owner;
+};
+
+// an accelerator_view: its mutex is held while it uses its queue, and it is
+// busy while it has work in flight
+struct FakeOwner {
+    std::mutex mutex;
+    std::atomic<bool> busy;
+    FakeQueue* queue;
+    int priority;
+
+    FakeOwner(int priority = 1) : busy(false), queue(nullptr), priority(priority) {}
+};
+
+struct Counters {
+    std::atomic<int> live;
+    std::atomic<int> maxLive;
+    Counters() : live(0), maxLive(0) {}
+};
+
+struct FakeBackend {
+    typedef FakeQueue Queue;
+    typedef FakeOwner Owner;
+
+    Counters* counters;
+
+    FakeQueue* create(int priority, FakeOwner* owner) {
+        int live = ++counters->live;
+        int m = counters->maxLive;
+        while (live > m && !counters->maxLive.compare_exchange_weak(m, live)) {
+        }
+        FakeQueue* q = new FakeQueue{ priority, nullptr };
+        assign(q, owner);
+        return q;
+    }
+    void destroy(FakeQueue* q) {
+        counters->live--;
+        delete q;
+    }
+    void setPriority(FakeQueue* q, int priority) {
+        q->priority = priority;
+    }
+    void assign(FakeQueue* q, FakeOwner* owner) {
+        q->owner = owner;
+        owner->queue = q;
+    }
+    bool tryDetach(FakeQueue* q, FakeOwner* owner) {
+        if (!owner->mutex.try_lock()) {
+            return false;
+        }
+        std::lock_guard<std::mutex> l(owner->mutex, std::adopt_lock);
+        if (owner->busy) {
+            return false;
+        }
+        owner->queue = nullptr;
+        q->owner = nullptr;
+        return true;
+    }
+};
+
+typedef Kalmar::HwQueueScheduler<FakeBackend> Scheduler;
+
+#define CHECK(cond) \
+    if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); return false; }
+
+// released queues are reused, up to the cap queues are created
+bool test_reuse() {
+    Counters counters;
+    Scheduler sched(FakeBackend{&counters}, 2, false);
+    FakeOwner a, b, c;
+
+    FakeQueue* qa = sched.acquire(&a, 1);
+    FakeQueue* qb = sched.acquire(&b, 1);
+    CHECK(qa != qb && a.queue == qa && b.queue == qb);
+    CHECK(sched.getCount(1) == 2);
+
+    // 3 owners for 2 queues: kept
+    sched.release(qa, &a, 3);
+    a.queue = nullptr;
+    CHECK(sched.acquire(&c, 1) == qa);
+    CHECK(sched.getStats().reused == 1 && sched.getStats().created == 2);
+
+    // fewer owners than queues: destroyed
+    sched.release(qb, &b, 1);
+    CHECK(counters.live == 1 && sched.getCount(1) == 1);
+
+    // not the owner any more: ignored
+    sched.release(qa, &a, 0);
+    CHECK(c.queue == qa && counters.live == 1);
+    sched.release(qa, &c, 0);
+    CHECK(counters.live == 0);
+    return true;
+}
+
+// the least recently assigned idle owner loses its queue
+bool test_lru() {
+    Counters counters;
+    Scheduler sched(FakeBackend{&counters}, 3, false);
+    FakeOwner a, b, c, d;
+
+    sched.acquire(&a, 1);
+    sched.acquire(&b, 1);
+    sched.acquire(&c, 1);
+    a.busy = true;
+
+    FakeQueue* qb = b.queue;
+    CHECK(sched.acquire(&d, 1) == qb);
+    CHECK(b.queue == nullptr && a.queue != nullptr && c.queue != nullptr);
+    CHECK(sched.getStats().stolen == 1);
+
+    // b is now the most recent candidate after c
+    c.busy = true;
+    d.busy = true;
+    a.busy = false;
+    FakeQueue* qa = a.queue;
+    CHECK(sched.acquire(&b, 1) == qa);
+    return true;
+}
+
+// with every owner busy, an acquire blocks until a queue is released or an
+// owner becomes idle
+bool test_block() {
+    Counters counters;
+    Scheduler sched(FakeBackend{&counters}, 1, false);
+    FakeOwner a, b;
+
+    sched.acquire(&a, 1);
+    a.busy = true;
+
+    std::thread t([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        a.busy = false;
+    });
+    auto t0 = std::chrono::steady_clock::now();
+    FakeQueue* q = sched.acquire(&b, 1);
+    auto t1 = std::chrono::steady_clock::now();
+    t.join();
+
+    CHECK(q != nullptr && b.queue == q && a.queue == nullptr);
+    CHECK(t1 - t0 >= std::chrono::milliseconds(20));
+    CHECK(sched.getStats().waits > 0);
+
+    // released queue: woken up right away
+    FakeOwner c;
+    b.busy = true;
+    std::thread t2([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        std::lock_guard<std::mutex> l(b.mutex);
+        sched.release(b.queue, &b, 2);
+        b.queue = nullptr;
+    });
+    CHECK(sched.acquire(&c, 1) == q);
+    t2.join();
+    return true;
+}
+
+// queues of other priorities are borrowed only when enabled, and only taken
+// back from a higher priority owner by the priority they were borrowed from
+bool test_borrow() {
+    Counters counters;
+    {
+        Scheduler sched(FakeBackend{&counters}, 1, true);
+        FakeOwner high(0), low(2), high2(0), low2(2);
+
+        sched.acquire(&high, 0);
+        high.busy = true;
+        sched.acquire(&low, 2);
+        sched.release(low.queue, &low, 4);
+        low.queue = nullptr;
+
+        // free low priority queue, given the high priority
+        FakeQueue* q = sched.acquire(&high2, 0);
+        CHECK(q->priority == 0 && sched.getStats().borrowed == 1);
+        high2.busy = true;
+
+        // a low priority owner never gets an idle high priority queue
+        high.busy = false;
+        bool done = false;
+        std::thread t([&] {
+            sched.acquire(&low2, 2);
+            done = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(!done && high.queue != nullptr);
+
+        // but it takes back the queue borrowed from its priority once idle
+        high2.busy = false;
+        t.join();
+        CHECK(low2.queue == q && q->priority == 2 && high2.queue == nullptr);
+        CHECK(high.queue != nullptr);
+
+        sched.release(high.queue, &high, 0);
+        sched.release(low2.queue, &low2, 0);
+    }
+    CHECK(counters.live == 0);
+    return true;
+}
+
+// many owners on few queues from many threads, checking that an owner
+// always has its queue to itself while using it
+bool test_stress(bool borrow) {
+    const int threads = 16;
+    const int ownersPerThread = 8;
+    const int iters = 300;
+    const size_t maxQueues = 2;
+
+    Counters counters;
+    std::atomic<int> errors(0);
+    {
+        Scheduler sched(FakeBackend{&counters}, maxQueues, borrow);
+        std::vector<FakeOwner*> owners;
+        for (int i = 0; i < threads * ownersPerThread; ++i) {
+            owners.push_back(new FakeOwner(i % 3));
+        }
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                std::mt19937 rng(t);
+                for (int i = 0; i < iters; ++i) {
+                    FakeOwner* o = owners[t * ownersPerThread + rng() % ownersPerThread];
+                    {
+                        std::lock_guard<std::mutex> l(o->mutex);
+                        if (!o->queue) {
+                            sched.acquire(o, o->priority);
+                        }
+                        if (!o->queue || o->queue->owner != o) {
+                            errors++;
+                        }
+                        o->busy = (rng() % 4) != 0;
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(rng() % 50));
+                    o->busy = false;
+                }
+            });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+
+        for (auto o : owners) {
+            if (o->queue) {
+                sched.release(o->queue, o, 0);
+            }
+            delete o;
+        }
+        Kalmar::HwQueueSchedulerStats stats = sched.getStats();
+        printf("stress%s: created %llu reused %llu stolen %llu borrowed %llu waits %llu\n",
+               borrow ? " (borrow)" : "",
+               (unsigned long long)stats.created, (unsigned long long)stats.reused,
+               (unsigned long long)stats.stolen, (unsigned long long)stats.borrowed,
+               (unsigned long long)stats.waits);
+    }
+    CHECK(errors == 0);
+    CHECK(counters.maxLive <= int(3 * maxQueues));
+    CHECK(counters.live == 0);
+    return true;
+}
+
+int main() {
+    bool ret = true;
+
+    ret &= test_reuse();
+    ret &= test_lru();
+    ret &= test_block();
+    ret &= test_borrow();
+    ret &= test_stress(false);
+    ret &= test_stress(true);
+
+    return !(ret == true);
+}
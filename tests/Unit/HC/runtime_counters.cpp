@@ -0,0 +1,103 @@
+// RUN: %hc %s -o %t.out -lhc_am && HCC_HSA_RUNTIME=mock %t.out
+
+// Checks the runtime counters: the counting and JSON dump of
+// Kalmar::RuntimeCounters, and hc::accelerator / hc::accelerator_view
+// get_runtime_counters after unpinned copies and waits on kernels.
+
+#include <hc.hpp>
+#include <hc_am.hpp>
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CHECK(cond) \
+  if (!(cond)) { std::cerr << "line " << __LINE__ << ": " #cond " failed\n"; return false; }
+
+bool test_counters() {
+  Kalmar::RuntimeCounters counters;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&counters] {
+      for (int i = 0; i < 10000; ++i)
+        counters.add(hc::hcCounterQueueSteal);
+    });
+  }
+  for (auto& t : threads)
+    t.join();
+  counters.add(hc::hcCounterCopyD2HStaging, 3);
+
+  hc::runtime_counters values = counters.snapshot();
+  CHECK(values[hc::hcCounterQueueSteal] == 40000);
+  CHECK(values[hc::hcCounterCopyD2HStaging] == 3);
+  CHECK(values[hc::hcCounterSignalPoolGrowth] == 0);
+
+  values += values;
+  CHECK(values[hc::hcCounterQueueSteal] == 80000);
+
+  std::string json = values.to_json();
+  CHECK(json.front() == '{' && json.back() == '}');
+  CHECK(json.find("\"signal_pool_growth\":0,") != std::string::npos);
+  CHECK(json.find("\"queue_steal\":80000,") != std::string::npos);
+  CHECK(json.find("\"copy_d2h_pin_in_place\":0,") != std::string::npos);
+  CHECK(json.find("\"buffer_barrier\":0}") != std::string::npos);
+  return true;
+}
+
+// unpinned copies are counted by algorithm on the accelerator
+bool test_copies() {
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.get_default_view();
+  hc::runtime_counters before = acc.get_runtime_counters();
+
+  const int N = 1 << 20;
+  std::vector<int> host(N, 1), back(N, 0);
+  int* dev = static_cast<int*>(hc::am_alloc(N * sizeof(int), acc, 0));
+  CHECK(dev != nullptr);
+  av.copy(host.data(), dev, N * sizeof(int));
+  av.copy(dev, back.data(), N * sizeof(int));
+  CHECK(back == host);
+  hc::am_free(dev);
+
+  hc::runtime_counters after = acc.get_runtime_counters();
+  uint64_t h2d = (after[hc::hcCounterCopyH2DStaging] - before[hc::hcCounterCopyH2DStaging]) +
+                 (after[hc::hcCounterCopyH2DPinInPlace] - before[hc::hcCounterCopyH2DPinInPlace]) +
+                 (after[hc::hcCounterCopyH2DMemcpy] - before[hc::hcCounterCopyH2DMemcpy]);
+  uint64_t d2h = (after[hc::hcCounterCopyD2HStaging] - before[hc::hcCounterCopyD2HStaging]) +
+                 (after[hc::hcCounterCopyD2HPinInPlace] - before[hc::hcCounterCopyD2HPinInPlace]);
+  CHECK(h2d == 1 && d2h == 1);
+  return true;
+}
+
+// waiting on a kernel inserts a system-scope marker, counted on the
+// accelerator_view and its accelerator
+bool test_wait() {
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.create_view();
+  CHECK(av.get_runtime_counters()[hc::hcCounterSysReleaseMarker] == 0);
+  uint64_t accMarkers = acc.get_runtime_counters()[hc::hcCounterSysReleaseMarker];
+
+  const int N = 1024;
+  int* dev = static_cast<int*>(hc::am_alloc(N * sizeof(int), acc, 0));
+  hc::parallel_for_each(av, hc::extent<1>(N), [=](hc::index<1> idx) [[hc]] {
+    dev[idx[0]] = idx[0];
+  });
+  av.wait();
+  hc::am_free(dev);
+
+  CHECK(av.get_runtime_counters()[hc::hcCounterSysReleaseMarker] == 1);
+  CHECK(acc.get_runtime_counters()[hc::hcCounterSysReleaseMarker] == accMarkers + 1);
+  CHECK(acc.get_runtime_counters().to_json().find("\"sys_release_marker\":") != std::string::npos);
+  return true;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test_counters();
+  ret &= test_copies();
+  ret &= test_wait();
+
+  return !(ret == true);
+}
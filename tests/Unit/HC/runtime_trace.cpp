@@ -0,0 +1,109 @@
+// RUN: %hc %s -o %t.out && %t.out
+
+// Checks the binary tracer of runtime events: nothing is recorded while it
+// is off, each thread keeps its latest events, and the export is Chrome
+// trace JSON.
+
+#include <kalmar_trace.h>
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CHECK(cond) \
+    if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); return false; }
+
+size_t count(const std::string& s, const std::string& what) {
+    size_t n = 0;
+    for (size_t pos = s.find(what); pos != std::string::npos; pos = s.find(what, pos + 1)) {
+        ++n;
+    }
+    return n;
+}
+
+// off by default, without HCC_TRACE
+bool test_disabled() {
+    Kalmar::Tracer& tracer = Kalmar::Tracer::get();
+    CHECK(!Kalmar::traceEnabled());
+    Kalmar::traceInstant(Kalmar::TraceMarker, "marker");
+    {
+        Kalmar::TraceScope scope(Kalmar::TraceWait, "wait");
+    }
+    CHECK(tracer.snapshot().empty());
+    return true;
+}
+
+// durations, instants, names and arguments in the export
+bool test_export() {
+    Kalmar::Tracer& tracer = Kalmar::Tracer::get();
+    tracer.enable(256);
+    {
+        Kalmar::TraceScope scope(Kalmar::TraceDispatch, tracer.intern("kernel \"k\""), 1024, 3);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Kalmar::traceInstant(Kalmar::TracePoolGrowth, "signal pool", 1024);
+    tracer.disable();
+
+    std::vector<Kalmar::TraceRecord> events = tracer.snapshot();
+    CHECK(events.size() == 2);
+    CHECK(events[0].kind == Kalmar::TraceDispatch && events[0].end - events[0].begin >= 1000000);
+    CHECK(events[1].kind == Kalmar::TracePoolGrowth && events[1].end == events[1].begin);
+
+    std::ostringstream os;
+    CHECK(tracer.exportChrome(os) == 2);
+    std::string json = os.str();
+    CHECK(json.find("{\"traceEvents\":[") == 0);
+    CHECK(json.find("\"name\":\"kernel \\\"k\\\"\",\"cat\":\"dispatch\",\"ph\":\"X\"") != std::string::npos);
+    CHECK(json.find("\"grid\":1024,\"queue\":3") != std::string::npos);
+    CHECK(json.find("\"cat\":\"pool\",\"ph\":\"i\"") != std::string::npos);
+    return true;
+}
+
+// threads record concurrently, the buffers keep the latest events
+bool test_threads() {
+    Kalmar::Tracer& tracer = Kalmar::Tracer::get();
+    size_t before = tracer.snapshot().size();
+    tracer.enable(256);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([] {
+            for (int i = 0; i < 1000; ++i) {
+                Kalmar::TraceScope scope(Kalmar::TraceCopy, "copy", i, 0);
+            }
+        });
+    }
+    // export while they record
+    std::ostringstream os;
+    tracer.exportChrome(os);
+    for (auto& w : workers) {
+        w.join();
+    }
+    tracer.disable();
+
+    std::vector<Kalmar::TraceRecord> events = tracer.snapshot();
+    CHECK(events.size() == before + 4 * 256);
+    size_t last = 0;
+    for (auto& e : events) {
+        if (e.kind == Kalmar::TraceCopy && e.arg0 == 999) {
+            ++last;
+        }
+    }
+    CHECK(last == 4);
+
+    std::ostringstream all;
+    tracer.exportChrome(all);
+    CHECK(count(all.str(), "\"cat\":\"copy\"") == 4 * 256);
+    return true;
+}
+
+int main() {
+    bool ret = true;
+
+    ret &= test_disabled();
+    ret &= test_export();
+    ret &= test_threads();
+
+    return !(ret == true);
+}
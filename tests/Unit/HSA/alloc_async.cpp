@@ -0,0 +1,180 @@
+// RUN: %hc %s -o %t.out -lhc_am && HCC_HSA_RUNTIME=mock HCC_MOCK_KERNEL_US=5000 %t.out
+
+// Checks accelerator_view::alloc_async / free_async on the CPU emulation of
+// the HSA runtime, where kernels take HCC_MOCK_KERNEL_US to complete: freed
+// memory is reused right away by an in-order accelerator_view, and only once
+// the kernels using it have completed otherwise.
+
+#include <hc.hpp>
+#include <hc_am.hpp>
+
+#include <iostream>
+#include <vector>
+
+#define CHECK(cond) \
+  if (!(cond)) { std::cerr << "line " << __LINE__ << ": " #cond " failed\n"; return false; }
+
+const int N = 4096;
+
+void launch(hc::accelerator_view& av, int* p) {
+  hc::parallel_for_each(av, hc::extent<1>(N), [=](hc::index<1> idx) [[hc]] {
+    p[idx[0]] = idx[0];
+  });
+}
+
+bool test_in_order() {
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.create_view(hc::execute_in_order);
+
+  int* p = static_cast<int*>(av.alloc_async(N * sizeof(int)));
+  CHECK(p != nullptr);
+  launch(av, p);
+  av.free_async(p);
+
+  // the next kernels run after the previous one: same memory, no wait
+  int* q = static_cast<int*>(av.alloc_async(N * sizeof(int)));
+  CHECK(q == p);
+  CHECK(!av.get_is_empty());
+  launch(av, q);
+  av.free_async(q);
+
+  // another size class
+  int* r = static_cast<int*>(av.alloc_async(4 * N * sizeof(int)));
+  CHECK(r != p);
+  av.free_async(r);
+
+  av.wait();
+  return true;
+}
+
+// The free waits for every command of the queue, through markers of at most
+// five dependencies each.  The emulation runs the packets of a queue in
+// order, so it does not show whether a marker would complete ahead of the
+// kernels it misses on a GPU: it checks the chaining of the markers.
+bool test_any_order() {
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.create_view(hc::execute_any_order);
+
+  int* p = static_cast<int*>(av.alloc_async(N * sizeof(int)));
+  for (int i = 0; i < 12; ++i)
+    launch(av, p);
+  av.free_async(p);
+
+  // the kernel may still use p
+  int* q = static_cast<int*>(av.alloc_async(N * sizeof(int)));
+  CHECK(q != p);
+  av.free_async(q);
+
+  av.wait();
+  int* r = static_cast<int*>(av.alloc_async(N * sizeof(int)));
+  CHECK(r == p || r == q);
+  av.free_async(r);
+  av.wait();
+  return true;
+}
+
+// the memory is tracked like memory of am_alloc
+bool test_copies() {
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.get_default_view();
+
+  std::vector<int> host(N), back(N, 0);
+  for (int i = 0; i < N; ++i) {
+    host[i] = i;
+  }
+
+  int* p = static_cast<int*>(av.alloc_async(N * sizeof(int)));
+  hc::AmPointerInfo info(nullptr, nullptr, 0, acc, false, false);
+  CHECK(hc::am_memtracker_getinfo(&info, p) == AM_SUCCESS && info._isInDeviceMem);
+
+  av.copy(host.data(), p, N * sizeof(int));
+  av.copy(p, back.data(), N * sizeof(int));
+  CHECK(back == host);
+  av.free_async(p);
+  av.wait();
+  return true;
+}
+
+// only memory of alloc_async of the same accelerator_view
+bool test_foreign() {
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.create_view();
+  hc::accelerator_view other = acc.create_view();
+
+  void* a = hc::am_alloc(N, acc, 0);
+  void* b = other.alloc_async(N);
+  int caught = 0;
+  try {
+    av.free_async(a);
+  } catch (Kalmar::runtime_exception&) {
+    caught++;
+  }
+  try {
+    av.free_async(b);
+  } catch (Kalmar::runtime_exception&) {
+    caught++;
+  }
+  CHECK(caught == 2);
+
+  other.free_async(b);
+  hc::am_free(a);
+  return true;
+}
+
+// am_free leaves the memory to free_async, until the accelerator_view is gone
+bool test_am_free() {
+  hc::accelerator acc;
+  int* left;
+  {
+    hc::accelerator_view av = acc.create_view();
+    int* p = static_cast<int*>(av.alloc_async(N * sizeof(int)));
+    CHECK(hc::am_free(p) == AM_ERROR_MISC);
+    launch(av, p);
+    av.free_async(p);
+
+    // still handed out by the pool
+    av.wait();
+    int* q = static_cast<int*>(av.alloc_async(N * sizeof(int)));
+    CHECK(q == p);
+    av.free_async(q);
+
+    left = static_cast<int*>(av.alloc_async(N * sizeof(int)));
+    av.wait();
+  }
+  CHECK(hc::am_free(left) == AM_SUCCESS);
+  return true;
+}
+
+// an allocate -> launch -> free loop keeps reusing the same memory
+bool test_loop() {
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.create_view();
+
+  size_t dev0, host0, user0;
+  hc::am_memtracker_sizeinfo(acc, &dev0, &host0, &user0);
+
+  for (int i = 0; i < 200; ++i) {
+    int* p = static_cast<int*>(av.alloc_async(N * sizeof(int)));
+    launch(av, p);
+    av.free_async(p);
+  }
+
+  size_t dev, host, user;
+  hc::am_memtracker_sizeinfo(acc, &dev, &host, &user);
+  CHECK(dev - dev0 <= N * sizeof(int));
+  av.wait();
+  return true;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test_in_order();
+  ret &= test_any_order();
+  ret &= test_copies();
+  ret &= test_foreign();
+  ret &= test_am_free();
+  ret &= test_loop();
+
+  return !(ret == true);
+}
@@ -0,0 +1,93 @@
+// RUN: %hc %s -o %t.out -lhc_am && HCC_HSA_RUNTIME=mock %t.out
+
+// Runs the HSA backend on the CPU emulation of the HSA runtime
+// (HCC_HSA_RUNTIME=mock): copies move the data, kernels complete without
+// running, and markers and continuations complete in order.
+
+#include <hc.hpp>
+#include <hc_am.hpp>
+
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+#define CHECK(cond) \
+  if (!(cond)) { std::cerr << "line " << __LINE__ << ": " #cond " failed\n"; return false; }
+
+bool test_agent() {
+  hc::accelerator acc;
+  CHECK(acc.get_device_path().find(L"mock-gpu") != std::wstring::npos);
+  return true;
+}
+
+bool test_copies() {
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.get_default_view();
+
+  const int N = 1 << 20;
+  std::vector<int> host(N), back(N, 0);
+  for (int i = 0; i < N; ++i) {
+    host[i] = i;
+  }
+
+  int* dev = static_cast<int*>(hc::am_alloc(N * sizeof(int), acc, 0));
+  CHECK(dev != nullptr);
+  av.copy(host.data(), dev, N * sizeof(int));
+  av.copy(dev, back.data(), N * sizeof(int));
+  CHECK(back == host);
+
+  // many copies in flight
+  std::vector<hc::completion_future> futures;
+  for (int i = 0; i < 64; ++i) {
+    int offset = i * (N / 64);
+    futures.push_back(av.copy_async(dev + offset, &back[offset], (N / 64) * sizeof(int)));
+  }
+  for (auto& f : futures) {
+    f.wait();
+  }
+  CHECK(back == host);
+
+  hc::am_free(dev);
+  return true;
+}
+
+bool test_kernels() {
+  hc::accelerator acc;
+  hc::accelerator_view av = acc.get_default_view();
+
+  const int N = 1024;
+  int* dev = static_cast<int*>(hc::am_alloc(N * sizeof(int), acc, 0));
+
+  hc::completion_future last;
+  for (int i = 0; i < 100; ++i) {
+    last = hc::parallel_for_each(av, hc::extent<1>(N), [=](hc::index<1> idx) [[hc]] {
+      dev[idx[0]] = idx[0];
+    });
+  }
+  hc::completion_future marker = av.create_marker();
+
+  std::atomic<bool> called(false);
+  marker.then([&called] { called = true; });
+
+  marker.wait();
+  CHECK(last.is_ready());
+  CHECK(marker.get_begin_tick() <= marker.get_end_tick());
+  CHECK(last.get_end_tick() <= marker.get_end_tick());
+
+  av.wait();
+  while (!called) {
+  }
+
+  hc::am_free(dev);
+  return true;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test_agent();
+  ret &= test_copies();
+  ret &= test_kernels();
+
+  return !(ret == true);
+}
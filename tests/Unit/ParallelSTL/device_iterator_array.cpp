@@ -0,0 +1,97 @@
+
+// RUN: %hc %s -o %t.out && %t.out
+
+// Parallel STL headers
+#include <coordinate>
+#include <experimental/algorithm>
+#include <experimental/numeric>
+#include <experimental/execution_policy>
+
+#define _DEBUG (0)
+#include "test_base.h"
+
+// chain several algorithms on data resident in an hc::array and an
+// hc::array_view, and compare against the same chain run with std:: on host
+template<typename T, size_t SIZE>
+bool test(void) {
+  auto f = [](T& v) [[hc,cpu]] { return v * 2; };
+  auto p = [](const T& v) [[hc,cpu]] { return v > T(SIZE / 2); };
+
+  using std::experimental::parallel::par;
+  using std::experimental::parallel::device_begin;
+  using std::experimental::parallel::device_end;
+
+  bool ret = true;
+
+  std::vector<T> input(SIZE);
+  std::iota(std::begin(input), std::end(input), 1);
+
+  // expected results
+  std::vector<T> expected(SIZE);
+  std::transform(std::begin(input), std::end(input), std::begin(expected), f);
+  std::replace_if(std::begin(expected), std::end(expected), p, T{});
+  T expected_sum = std::accumulate(std::begin(expected), std::end(expected), T{});
+
+  // hc::array
+  {
+    hc::array<T> a(SIZE, std::begin(input));
+    hc::array<T> b(SIZE);
+
+    std::experimental::parallel::
+    transform(par, device_begin(a), device_end(a), device_begin(b), f);
+    std::experimental::parallel::
+    replace_if(par, device_begin(b), device_end(b), p, T{});
+    T sum = std::experimental::parallel::
+            reduce(par, device_begin(b), device_end(b), T{});
+
+    std::vector<T> result = b;
+    ret &= std::equal(std::begin(expected), std::end(expected), std::begin(result));
+    ret &= EQ(expected_sum, sum);
+  }
+
+  // hc::array_view, only the final result is synchronized to the host
+  {
+    std::vector<T> output(SIZE);
+    hc::array_view<T> av(SIZE, output);
+    hc::array<T> a(SIZE, std::begin(input));
+
+    std::experimental::parallel::
+    transform(par, device_begin(a), device_end(a), device_begin(av), f);
+    std::experimental::parallel::
+    replace_if(par, device_begin(av), device_end(av), p, T{});
+    av.synchronize();
+
+    ret &= std::equal(std::begin(expected), std::end(expected), std::begin(output));
+  }
+
+  // a sub-range of a device iterator
+  {
+    hc::array<T> a(SIZE, std::begin(input));
+    hc::array<T> b(SIZE, std::begin(input));
+    auto first = device_begin(a) + SIZE / 4;
+    auto last  = device_end(a) - SIZE / 4;
+
+    std::experimental::parallel::
+    transform(par, first, last, device_begin(b) + SIZE / 4, f);
+
+    std::vector<T> result = b;
+    for (size_t i = 0; i < SIZE; ++i) {
+      bool inside = (i >= SIZE / 4) && (i < SIZE - SIZE / 4);
+      ret &= (result[i] == (inside ? f(input[i]) : input[i]));
+    }
+  }
+
+  return ret;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test<int, TEST_SIZE>();
+  ret &= test<unsigned, TEST_SIZE>();
+  ret &= test<float, TEST_SIZE>();
+  ret &= test<double, TEST_SIZE>();
+
+  return !(ret == true);
+}
+
@@ -0,0 +1,104 @@
+
+// RUN: %hc %s -o %t.out && %t.out
+
+// Parallel STL headers
+#include <coordinate>
+#include <experimental/algorithm>
+#include <experimental/numeric>
+#include <experimental/execution_policy>
+
+#define _DEBUG (0)
+#include "test_base.h"
+
+// run algorithms through par.on(av), par_task.on(av) and par_task
+template<typename T, size_t SIZE>
+bool test(void) {
+  auto f = [](T& v) [[hc,cpu]] { return v * 2; };
+  auto g = [](T& v) [[hc,cpu]] { return v + 5566; };
+
+  using std::experimental::parallel::par;
+  using std::experimental::parallel::par_task;
+  using std::experimental::parallel::device_begin;
+  using std::experimental::parallel::device_end;
+
+  bool ret = true;
+
+  hc::accelerator acc;
+  hc::accelerator_view av1 = acc.create_view();
+  hc::accelerator_view av2 = acc.create_view();
+
+  std::vector<T> input(SIZE);
+  std::iota(std::begin(input), std::end(input), 1);
+
+  std::vector<T> expected1(SIZE), expected2(SIZE);
+  std::transform(std::begin(input), std::end(input), std::begin(expected1), f);
+  std::transform(std::begin(input), std::end(input), std::begin(expected2), g);
+
+  // synchronous, on a given accelerator_view, host iterators
+  {
+    std::vector<T> output(SIZE);
+    std::experimental::parallel::
+    transform(par.on(av1), std::begin(input), std::end(input), std::begin(output), f);
+    ret &= std::equal(std::begin(expected1), std::end(expected1), std::begin(output));
+  }
+
+  // asynchronous on two accelerator_views, device iterators
+  {
+    hc::array<T> in1(SIZE, std::begin(input), av1);
+    hc::array<T> in2(SIZE, std::begin(input), av2);
+    hc::array<T> out1(SIZE, av1);
+    hc::array<T> out2(SIZE, av2);
+
+    auto task1 = par_task.on(av1);
+    auto task2 = par_task.on(av2);
+    std::experimental::parallel::
+    transform(task1, device_begin(in1), device_end(in1), device_begin(out1), f);
+    std::experimental::parallel::
+    transform(task2, device_begin(in2), device_end(in2), device_begin(out2), g);
+
+    hc::completion_future cf1 = task1.get_future();
+    hc::completion_future cf2 = task2.get_future();
+    ret &= cf1.valid() && cf2.valid();
+    cf1.wait();
+    cf2.wait();
+
+    std::vector<T> result1 = out1;
+    std::vector<T> result2 = out2;
+    ret &= std::equal(std::begin(expected1), std::end(expected1), std::begin(result1));
+    ret &= std::equal(std::begin(expected2), std::end(expected2), std::begin(result2));
+  }
+
+  // par_task without on() waits for its kernels before returning
+  {
+    hc::array<T> in(SIZE, std::begin(input));
+    hc::array<T> out(SIZE);
+    std::experimental::parallel::
+    transform(par_task, device_begin(in), device_end(in), device_begin(out), f);
+
+    std::vector<T> result = out;
+    ret &= std::equal(std::begin(expected1), std::end(expected1), std::begin(result));
+  }
+
+  // a reduction returns its value even when launched as a task
+  {
+    hc::array<T> in(SIZE, std::begin(input), av1);
+    auto task = par_task.on(av1);
+    T sum = std::experimental::parallel::
+            reduce(task, device_begin(in), device_end(in), T{});
+    ret &= EQ(sum, std::accumulate(std::begin(input), std::end(input), T{}));
+  }
+
+  return ret;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test<int, TEST_SIZE>();
+  ret &= test<unsigned, TEST_SIZE>();
+  ret &= test<float, TEST_SIZE>();
+  ret &= test<double, TEST_SIZE>();
+
+  return !(ret == true);
+}
+
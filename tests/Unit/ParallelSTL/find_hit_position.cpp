@@ -0,0 +1,95 @@
+
+// RUN: %hc %s -o %t.out && %t.out
+
+// Parallel STL headers
+#include <coordinate>
+#include <experimental/algorithm>
+#include <experimental/execution_policy>
+
+#define _DEBUG (0)
+#include "test_base.h"
+
+// large enough for the searches to go through several windows
+#define SEARCH_SIZE (1 << 19)
+
+// place a single hit at various positions, including around window and
+// block boundaries, and compare the searching algorithms against std::
+template<typename T, size_t SIZE>
+bool test(void) {
+
+  using namespace std::experimental::parallel;
+
+  bool ret = true;
+
+  // the windows are [0, 65536), [65536, 327680) and [327680, SIZE); 100000
+  // and 300000 are inside the second one only
+  const long positions[] = { 0, 1, 2047, 2048, 65535, 65536, 65537,
+                             100000, 300000, 327679, 327680,
+                             SIZE / 2, SIZE - 4, SIZE - 1, -1 };
+
+  std::vector<T> pattern { T(-1), T(-2), T(-3) };
+
+  for (long pos : positions) {
+    std::vector<T> input(SIZE);
+    std::iota(std::begin(input), std::end(input), T{});
+    if (pos >= 0) {
+      input[pos] = T(-1);
+      // a second hit afterwards, find must return the first one and
+      // find_end the last one
+      if (pos + 3 < (long)SIZE)
+        std::copy(std::begin(pattern), std::end(pattern), std::begin(input) + pos);
+      if (pos + 16 + 3 < (long)SIZE)
+        std::copy(std::begin(pattern), std::end(pattern), std::begin(input) + pos + 16);
+    }
+    std::vector<T> other(input);
+    if (pos >= 0)
+      other[pos] = T(-5);
+
+    auto is_negative = [](const T& v) { return v < T{}; };
+    auto is_positive = [](const T& v) { return !(v < T{}); };
+
+    ret &= (std::find(std::begin(input), std::end(input), T(-1)) ==
+            find(par, std::begin(input), std::end(input), T(-1)));
+    ret &= (std::find_if(std::begin(input), std::end(input), is_negative) ==
+            find_if(par, std::begin(input), std::end(input), is_negative));
+    ret &= (std::find_if_not(std::begin(input), std::end(input), is_positive) ==
+            find_if_not(par, std::begin(input), std::end(input), is_positive));
+    ret &= (std::mismatch(std::begin(input), std::end(input), std::begin(other)) ==
+            mismatch(par, std::begin(input), std::end(input), std::begin(other)));
+    ret &= (std::find_first_of(std::begin(input), std::end(input),
+                               std::begin(pattern), std::end(pattern)) ==
+            find_first_of(par, std::begin(input), std::end(input),
+                          std::begin(pattern), std::end(pattern)));
+    ret &= (std::search(std::begin(input), std::end(input),
+                        std::begin(pattern), std::end(pattern)) ==
+            search(par, std::begin(input), std::end(input),
+                   std::begin(pattern), std::end(pattern)));
+    ret &= (std::find_end(std::begin(input), std::end(input),
+                          std::begin(pattern), std::end(pattern)) ==
+            find_end(par, std::begin(input), std::end(input),
+                     std::begin(pattern), std::end(pattern)));
+
+    // adjacent_find and search_n need equal neighbours
+    std::vector<T> runs(input);
+    if (pos >= 1)
+      runs[pos - 1] = runs[pos];
+    ret &= (std::adjacent_find(std::begin(runs), std::end(runs)) ==
+            adjacent_find(par, std::begin(runs), std::end(runs)));
+    ret &= (std::search_n(std::begin(runs), std::end(runs), 2, T(-1)) ==
+            search_n(par, std::begin(runs), std::end(runs), 2, T(-1)));
+  }
+
+  return ret;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test<int, SEARCH_SIZE>();
+  ret &= test<unsigned, SEARCH_SIZE>();
+  ret &= test<float, SEARCH_SIZE>();
+  ret &= test<double, SEARCH_SIZE>();
+
+  return !(ret == true);
+}
+
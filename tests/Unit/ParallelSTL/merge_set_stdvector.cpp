@@ -0,0 +1,120 @@
+
+// RUN: %hc %s -o %t.out && %t.out
+
+// Parallel STL headers
+#include <coordinate>
+#include <experimental/algorithm>
+#include <experimental/execution_policy>
+
+#define _DEBUG (0)
+#include "test_base.h"
+
+#include <random>
+
+// sorted inputs of different sizes with many duplicates, so runs of
+// equivalent elements cross the pieces each work-item handles
+template<typename T, size_t SIZE>
+bool test(void) {
+
+  using namespace std::experimental::parallel;
+
+  bool ret = true;
+
+  std::mt19937 gen(SIZE);
+  std::uniform_int_distribution<int> dis(0, SIZE / 8);
+
+  std::vector<T> a(SIZE), b(SIZE / 2 + 7);
+  for (auto& v : a) v = T(dis(gen));
+  for (auto& v : b) v = T(dis(gen));
+  std::sort(std::begin(a), std::end(a));
+  std::sort(std::begin(b), std::end(b));
+
+  // merge
+  {
+    std::vector<T> expected(a.size() + b.size()), result(a.size() + b.size());
+    std::merge(std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(expected));
+    auto end = merge(par, std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(result));
+    ret &= (end == std::end(result));
+    ret &= (expected == result);
+  }
+
+  // merge with a comparator, descending order
+  {
+    std::vector<T> ra(a.rbegin(), a.rend()), rb(b.rbegin(), b.rend());
+    std::vector<T> expected(a.size() + b.size()), result(a.size() + b.size());
+    std::merge(std::begin(ra), std::end(ra), std::begin(rb), std::end(rb),
+               std::begin(expected), std::greater<T>());
+    merge(par, std::begin(ra), std::end(ra), std::begin(rb), std::end(rb),
+          std::begin(result), std::greater<T>());
+    ret &= (expected == result);
+  }
+
+  // inplace_merge
+  {
+    std::vector<T> expected(a), result(a);
+    expected.insert(std::end(expected), std::begin(b), std::end(b));
+    result.insert(std::end(result), std::begin(b), std::end(b));
+    std::inplace_merge(std::begin(expected), std::begin(expected) + a.size(), std::end(expected));
+    inplace_merge(par, std::begin(result), std::begin(result) + a.size(), std::end(result));
+    ret &= (expected == result);
+  }
+
+  // set operations, compared including the returned end
+#define TEST_SET_OP(op) \
+  { \
+    std::vector<T> expected(a.size() + b.size()), result(a.size() + b.size()); \
+    auto e = std::op(std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(expected)); \
+    auto r = op(par, std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(result)); \
+    ret &= ((e - std::begin(expected)) == (r - std::begin(result))); \
+    ret &= std::equal(std::begin(expected), e, std::begin(result)); \
+  }
+
+  TEST_SET_OP(set_union)
+  TEST_SET_OP(set_intersection)
+  TEST_SET_OP(set_difference)
+  TEST_SET_OP(set_symmetric_difference)
+#undef TEST_SET_OP
+
+  // a comparator which can't be captured by a kernel runs on the host
+  {
+    std::vector<int> order { 1 };
+    auto less = [order](const T& x, const T& y) { return order[0] > 0 ? x < y : y < x; };
+    std::vector<T> expected(a.size() + b.size()), result(a.size() + b.size());
+    std::merge(std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(expected));
+    merge(par, std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(result), less);
+    ret &= (expected == result);
+
+    auto e = std::set_union(std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(expected));
+    auto r = set_union(par, std::begin(a), std::end(a), std::begin(b), std::end(b), std::begin(result), less);
+    ret &= ((e - std::begin(expected)) == (r - std::begin(result)));
+    ret &= std::equal(std::begin(expected), e, std::begin(result));
+
+    std::vector<T> merged(a);
+    merged.insert(std::end(merged), std::begin(b), std::end(b));
+    inplace_merge(par, std::begin(merged), std::begin(merged) + a.size(), std::end(merged), less);
+    ret &= std::is_sorted(std::begin(merged), std::end(merged));
+  }
+
+  // disjoint and identical ranges
+  {
+    std::vector<T> result(2 * SIZE);
+    ret &= (set_intersection(par, std::begin(a), std::end(a), std::begin(a), std::end(a),
+                             std::begin(result)) - std::begin(result) == (long)a.size());
+    ret &= (set_difference(par, std::begin(a), std::end(a), std::begin(a), std::end(a),
+                           std::begin(result)) == std::begin(result));
+  }
+
+  return ret;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test<int, TEST_SIZE>();
+  ret &= test<unsigned, TEST_SIZE>();
+  ret &= test<float, TEST_SIZE>();
+  ret &= test<double, TEST_SIZE>();
+
+  return !(ret == true);
+}
+
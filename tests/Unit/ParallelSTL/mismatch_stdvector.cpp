@@ -24,9 +24,9 @@ bool test(void) {
   ret &= run_and_compare<T, SIZE, stdVector>([&eq]
                                              (stdVector &input1, stdVector &input2, stdVector &output1,
                                                                                     stdVector &output2) {
-    auto expected = std::mismatch(std::begin(input1), std::end(input2), std::begin(input2));
+    auto expected = std::mismatch(std::begin(input1), std::end(input1), std::begin(input2));
     auto result   = std::experimental::parallel::
-                    mismatch(par, std::begin(input1), std::end(input2), std::begin(input2));
+                    mismatch(par, std::begin(input1), std::end(input1), std::begin(input2));
 
     eq = expected == result;
   }, false);
@@ -37,9 +37,9 @@ bool test(void) {
   ret &= run_and_compare<T, SIZE, stdVector>([&eq, pred]
                                              (stdVector &input1, stdVector &input2, stdVector &output1,
                                                                                     stdVector &output2) {
-    auto expected = std::mismatch(std::begin(input1), std::end(input2), std::begin(input2), pred);
+    auto expected = std::mismatch(std::begin(input1), std::end(input1), std::begin(input2), pred);
     auto result   = std::experimental::parallel::
-                    mismatch(par, std::begin(input1), std::end(input2), std::begin(input2), pred);
+                    mismatch(par, std::begin(input1), std::end(input1), std::begin(input2), pred);
 
     eq = expected == result;
   }, false);
@@ -0,0 +1,92 @@
+
+// RUN: %hc %s -o %t.out && %t.out
+
+// Parallel STL headers
+#include <coordinate>
+#include <experimental/algorithm>
+#include <experimental/execution_policy>
+
+#define _DEBUG (0)
+#include "test_base.h"
+
+#include <random>
+
+// large enough for several rounds of the parallel selection
+#define SELECT_SIZE (1 << 16)
+
+template<typename T, size_t SIZE>
+bool test(void) {
+
+  using namespace std::experimental::parallel;
+
+  bool ret = true;
+
+  std::mt19937 gen(SIZE);
+  std::uniform_int_distribution<int> dis(0, SIZE / 4);
+
+  std::vector<T> input(SIZE);
+  for (auto& v : input) v = T(dis(gen));
+  std::vector<T> sorted(input);
+  std::sort(std::begin(sorted), std::end(sorted));
+
+  const size_t positions[] = { 0, 1, SIZE / 3, SIZE / 2, SIZE - 2, SIZE - 1 };
+
+  // nth_element
+  for (size_t n : positions) {
+    std::vector<T> v(input);
+    nth_element(par, std::begin(v), std::begin(v) + n, std::end(v));
+    ret &= (v[n] == sorted[n]);
+    ret &= std::all_of(std::begin(v), std::begin(v) + n,
+                       [&](const T& x) { return !(v[n] < x); });
+    ret &= std::all_of(std::begin(v) + n, std::end(v),
+                       [&](const T& x) { return !(x < v[n]); });
+  }
+
+  // nth_element on a range of equal elements
+  {
+    std::vector<T> v(SIZE, T(7));
+    nth_element(par, std::begin(v), std::begin(v) + SIZE / 2, std::end(v));
+    ret &= (v[SIZE / 2] == T(7));
+  }
+
+  // nth_element with a comparator
+  {
+    std::vector<T> v(input);
+    nth_element(par, std::begin(v), std::begin(v) + SIZE / 4, std::end(v), std::greater<T>());
+    ret &= (v[SIZE / 4] == sorted[SIZE - 1 - SIZE / 4]);
+  }
+
+  // a comparator which can't be captured by a kernel runs on the host
+  {
+    std::vector<int> order { -1 };
+    auto less = [order](const T& x, const T& y) { return order[0] > 0 ? x < y : y < x; };
+    std::vector<T> v(input);
+    nth_element(par, std::begin(v), std::begin(v) + SIZE / 4, std::end(v), less);
+    ret &= (v[SIZE / 4] == sorted[SIZE - 1 - SIZE / 4]);
+
+    std::vector<T> w(input);
+    partial_sort(par, std::begin(w), std::begin(w) + 100, std::end(w), less);
+    ret &= std::equal(sorted.rbegin(), sorted.rbegin() + 100, std::begin(w));
+  }
+
+  // partial_sort
+  for (size_t m : { (size_t)1, (size_t)100, (size_t)SIZE / 2, (size_t)SIZE }) {
+    std::vector<T> v(input);
+    partial_sort(par, std::begin(v), std::begin(v) + m, std::end(v));
+    ret &= std::equal(std::begin(sorted), std::begin(sorted) + m, std::begin(v));
+  }
+
+  return ret;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test<int, SELECT_SIZE>();
+  ret &= test<unsigned, SELECT_SIZE>();
+  ret &= test<float, SELECT_SIZE>();
+  ret &= test<double, SELECT_SIZE>();
+
+  return !(ret == true);
+}
+
@@ -0,0 +1,99 @@
+
+// RUN: %hc %s -o %t.out && %t.out
+
+// Parallel STL headers
+#include <coordinate>
+#include <experimental/algorithm>
+#include <experimental/numeric>
+#include <experimental/execution_policy>
+
+#define _DEBUG (0)
+#include "test_base.h"
+
+// fused pipelines must give the same results as the unfused algorithms
+template<typename T, size_t SIZE>
+bool test(void) {
+  auto f = [](T& v) [[hc,cpu]] { return v * 3; };
+  auto p = [](const T& v) [[hc,cpu]] { return (static_cast<long>(v) % 2) == 0; };
+
+  using std::experimental::parallel::par;
+  using std::experimental::parallel::make_pipeline;
+
+  bool ret = true;
+
+  std::vector<T> input(SIZE);
+  std::iota(std::begin(input), std::end(input), 1);
+
+  // unfused reference: transform, then keep elements matching p
+  std::vector<T> tmp(SIZE);
+  std::experimental::parallel::
+  transform(par, std::begin(input), std::end(input), std::begin(tmp), f);
+  std::vector<T> expected;
+  std::copy_if(std::begin(tmp), std::end(tmp), std::back_inserter(expected), p);
+
+  auto pipe = make_pipeline(std::begin(input), std::end(input)).transform(f).filter(p);
+
+  // transform -> filter -> reduce
+  {
+    T expected_sum = std::experimental::parallel::
+                     reduce(par, std::begin(expected), std::end(expected), T{});
+    T sum = std::experimental::parallel::
+            reduce(par, pipe, T{}, std::plus<T>());
+    ret &= EQ(expected_sum, sum);
+  }
+
+  // transform -> filter -> copy
+  {
+    std::vector<T> output(SIZE);
+    auto end = std::experimental::parallel::
+               copy(par, pipe, std::begin(output));
+    ret &= (static_cast<size_t>(end - std::begin(output)) == expected.size());
+    ret &= std::equal(std::begin(expected), std::end(expected), std::begin(output));
+  }
+
+  // transform -> copy, no filter
+  {
+    std::vector<T> output(SIZE);
+    auto end = std::experimental::parallel::
+               copy(par, make_pipeline(std::begin(input), std::end(input)).transform(f),
+                    std::begin(output));
+    ret &= (end == std::end(output));
+    ret &= std::equal(std::begin(tmp), std::end(tmp), std::begin(output));
+  }
+
+  // transform -> filter -> inclusive_scan
+  {
+    std::vector<T> expected_scan(expected.size());
+    std::partial_sum(std::begin(expected), std::end(expected), std::begin(expected_scan));
+
+    std::vector<T> output(SIZE);
+    auto end = std::experimental::parallel::
+               inclusive_scan(par, pipe, std::begin(output), std::plus<T>());
+    ret &= (static_cast<size_t>(end - std::begin(output)) == expected.size());
+    for (size_t i = 0; i < expected_scan.size(); ++i)
+      ret &= EQ(expected_scan[i], output[i]);
+  }
+
+  // a filter dropping everything
+  {
+    auto none = make_pipeline(std::begin(input), std::end(input))
+                  .filter([](const T& v) [[hc,cpu]] { return v < T{}; });
+    std::vector<T> output(SIZE);
+    ret &= (std::experimental::parallel::copy(par, none, std::begin(output)) == std::begin(output));
+    ret &= EQ(std::experimental::parallel::reduce(par, none, T(42), std::plus<T>()), T(42));
+  }
+
+  return ret;
+}
+
+int main() {
+  bool ret = true;
+
+  ret &= test<int, TEST_SIZE>();
+  ret &= test<unsigned, TEST_SIZE>();
+  ret &= test<float, TEST_SIZE>();
+  ret &= test<double, TEST_SIZE>();
+
+  return !(ret == true);
+}
+